@@ -0,0 +1,630 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "changelog-index.h"
+#include "xml-parser.h"
+
+/*
+ * File layout:
+ *
+ *   IndexHeader
+ *   char             string data: the checksum and the pkgIds, NUL
+ *                    terminated
+ *   ChangelogPackage packages, n_packages entries, sorted by pkgId
+ *   ChangelogPoint   access points, n_points entries, by offset
+ *   guchar           windows, each compressed with zlib
+ *
+ * Offsets of packages and points are in uncompressed bytes of the
+ * metadata.  For plain metadata every point is just an offset and has no
+ * window.
+ */
+
+#define INDEX_MAGIC "YUMCLIDX"
+#define INDEX_BYTE_ORDER 0x01020304
+#define INDEX_ALIGN 8
+
+typedef struct {
+    char magic[8];
+    guint32 version;
+    guint32 byte_order;
+    guint32 n_packages;
+    guint32 n_points;
+    guint32 checksum;
+    guint32 reserved;
+    guint64 md_size;
+    guint64 strings_offset;
+    guint64 strings_len;
+    guint64 packages_offset;
+    guint64 points_offset;
+    guint64 windows_offset;
+    guint64 windows_len;
+    guint64 size;
+} IndexHeader;
+
+typedef struct {
+    guint32 pkgId;
+    guint32 length;
+    guint64 offset;
+} ChangelogPackage;
+
+typedef struct {
+    guint64 out;
+    guint64 in;
+    guint32 bits;
+    guint32 window_len;
+    guint32 window_size;
+    guint32 reserved;
+    guint64 window;
+} ChangelogPoint;
+
+GQuark
+yum_changelog_index_error_quark (void)
+{
+    static GQuark quark;
+
+    if (!quark)
+        quark = g_quark_from_static_string ("yum_changelog_index_error");
+
+    return quark;
+}
+
+char *
+yum_changelog_index_filename (const char *prefix)
+{
+    return g_strconcat (prefix, ".clidx", NULL);
+}
+
+/*****************************************************************************/
+
+/* A package before the pkgIds are laid out */
+typedef struct {
+    const char *pkgId;
+    guint32 length;
+    guint64 offset;
+} WriterPackage;
+
+struct _YumChangelogIndexWriter {
+    GStringChunk *chunk;
+    GArray *packages;
+    GArray *points;
+    GByteArray *windows;
+};
+
+YumChangelogIndexWriter *
+yum_changelog_index_writer_new (void)
+{
+    YumChangelogIndexWriter *writer;
+
+    writer = g_new0 (YumChangelogIndexWriter, 1);
+    writer->chunk = g_string_chunk_new (64 * 1024);
+    writer->packages = g_array_new (FALSE, FALSE, sizeof (WriterPackage));
+    writer->points = g_array_new (FALSE, FALSE, sizeof (ChangelogPoint));
+    writer->windows = g_byte_array_new ();
+
+    return writer;
+}
+
+void
+yum_changelog_index_writer_free (YumChangelogIndexWriter *writer)
+{
+    g_string_chunk_free (writer->chunk);
+    g_array_free (writer->packages, TRUE);
+    g_array_free (writer->points, TRUE);
+    g_byte_array_free (writer->windows, TRUE);
+
+    g_free (writer);
+}
+
+void
+yum_changelog_index_writer_add_point (YumChangelogIndexWriter *writer,
+                                      const YumGzipPoint *point,
+                                      const guchar *window)
+{
+    ChangelogPoint cp;
+
+    memset (&cp, 0, sizeof (ChangelogPoint));
+    cp.out = point->out;
+    cp.in = point->in;
+    cp.bits = point->bits;
+    cp.window_len = point->window_len;
+    cp.window = writer->windows->len;
+
+    if (point->window_len) {
+        uLongf size = compressBound (point->window_len);
+
+        g_byte_array_set_size (writer->windows, cp.window + size);
+        compress2 (writer->windows->data + cp.window, &size,
+                   window, point->window_len, Z_BEST_COMPRESSION);
+        g_byte_array_set_size (writer->windows, cp.window + size);
+        cp.window_size = size;
+    }
+
+    g_array_append_val (writer->points, cp);
+}
+
+void
+yum_changelog_index_writer_add (YumChangelogIndexWriter *writer,
+                                const char *pkgId,
+                                guint64 offset,
+                                guint32 length)
+{
+    WriterPackage pkg;
+
+    pkg.pkgId = g_string_chunk_insert (writer->chunk, pkgId);
+    pkg.length = length;
+    pkg.offset = offset;
+    g_array_append_val (writer->packages, pkg);
+}
+
+static gint
+writer_package_cmp (gconstpointer a, gconstpointer b)
+{
+    return strcmp (((const WriterPackage *) a)->pkgId,
+                   ((const WriterPackage *) b)->pkgId);
+}
+
+static gboolean
+write_section (FILE *f, guint64 *offset, gconstpointer data, gsize len)
+{
+    static const char padding[INDEX_ALIGN] = { 0 };
+    gsize pad;
+
+    if (len && fwrite (data, 1, len, f) != len)
+        return FALSE;
+    *offset += len;
+
+    pad = (INDEX_ALIGN - (*offset % INDEX_ALIGN)) % INDEX_ALIGN;
+    if (pad && fwrite (padding, 1, pad, f) != pad)
+        return FALSE;
+    *offset += pad;
+
+    return TRUE;
+}
+
+void
+yum_changelog_index_writer_write (YumChangelogIndexWriter *writer,
+                                  const char *path,
+                                  const char *checksum,
+                                  guint64 md_size,
+                                  GError **err)
+{
+    IndexHeader header;
+    GString *strings;
+    GArray *packages;
+    char *tmp_path;
+    FILE *f = NULL;
+    guint64 offset;
+    guint i;
+
+    g_array_sort (writer->packages, writer_package_cmp);
+
+    strings = g_string_sized_new (64 * 1024);
+    g_string_append_len (strings, checksum, strlen (checksum) + 1);
+
+    packages = g_array_sized_new (FALSE, FALSE, sizeof (ChangelogPackage),
+                                  writer->packages->len);
+    for (i = 0; i < writer->packages->len; i++) {
+        WriterPackage *wp = &g_array_index (writer->packages,
+                                            WriterPackage, i);
+        ChangelogPackage pkg;
+
+        pkg.pkgId = strings->len;
+        pkg.length = wp->length;
+        pkg.offset = wp->offset;
+        g_array_append_val (packages, pkg);
+
+        g_string_append_len (strings, wp->pkgId, strlen (wp->pkgId) + 1);
+    }
+
+    memset (&header, 0, sizeof (IndexHeader));
+    memcpy (header.magic, INDEX_MAGIC, sizeof (header.magic));
+    header.version = YUM_CHANGELOG_INDEX_VERSION;
+    header.byte_order = INDEX_BYTE_ORDER;
+    header.n_packages = packages->len;
+    header.n_points = writer->points->len;
+    header.checksum = 0;
+    header.md_size = md_size;
+
+#define ALIGNED(n) (((n) + INDEX_ALIGN - 1) & ~((guint64) INDEX_ALIGN - 1))
+    offset = ALIGNED (sizeof (IndexHeader));
+    header.strings_offset = offset;
+    header.strings_len = strings->len;
+    offset += ALIGNED ((guint64) strings->len);
+    header.packages_offset = offset;
+    offset += ALIGNED ((guint64) packages->len * sizeof (ChangelogPackage));
+    header.points_offset = offset;
+    offset += ALIGNED ((guint64) writer->points->len *
+                       sizeof (ChangelogPoint));
+    header.windows_offset = offset;
+    header.windows_len = writer->windows->len;
+    offset += ALIGNED ((guint64) writer->windows->len);
+    header.size = offset;
+#undef ALIGNED
+
+    /* Write to a temporary file and move it into place, so readers
+       never map a half written index */
+    tmp_path = g_strconcat (path, ".tmp", NULL);
+    f = fopen (tmp_path, "wb");
+    if (!f) {
+        g_set_error (err, YUM_CHANGELOG_INDEX_ERROR,
+                     YUM_CHANGELOG_INDEX_ERROR,
+                     "Can not create index file %s: %s",
+                     tmp_path, g_strerror (errno));
+        goto cleanup;
+    }
+
+    offset = 0;
+    if (!write_section (f, &offset, &header, sizeof (IndexHeader)) ||
+        !write_section (f, &offset, strings->str, strings->len) ||
+        !write_section (f, &offset, packages->data,
+                        packages->len * sizeof (ChangelogPackage)) ||
+        !write_section (f, &offset, writer->points->data,
+                        writer->points->len * sizeof (ChangelogPoint)) ||
+        !write_section (f, &offset, writer->windows->data,
+                        writer->windows->len)) {
+        g_set_error (err, YUM_CHANGELOG_INDEX_ERROR,
+                     YUM_CHANGELOG_INDEX_ERROR,
+                     "Can not write index file %s: %s",
+                     tmp_path, g_strerror (errno));
+        goto cleanup;
+    }
+
+    if (fclose (f) != 0) {
+        f = NULL;
+        g_set_error (err, YUM_CHANGELOG_INDEX_ERROR,
+                     YUM_CHANGELOG_INDEX_ERROR,
+                     "Can not write index file %s: %s",
+                     tmp_path, g_strerror (errno));
+        goto cleanup;
+    }
+    f = NULL;
+
+    if (rename (tmp_path, path) != 0)
+        g_set_error (err, YUM_CHANGELOG_INDEX_ERROR,
+                     YUM_CHANGELOG_INDEX_ERROR,
+                     "Can not rename index file to %s: %s",
+                     path, g_strerror (errno));
+
+ cleanup:
+    if (f)
+        fclose (f);
+    if (*err)
+        unlink (tmp_path);
+    g_free (tmp_path);
+
+    g_string_free (strings, TRUE);
+    g_array_free (packages, TRUE);
+}
+
+/*****************************************************************************/
+
+struct _YumChangelogIndex {
+    gpointer map;
+    gsize size;
+
+    const IndexHeader *header;
+    const char *strings;
+    const ChangelogPackage *packages;
+    const ChangelogPoint *points;
+    const guchar *windows;
+};
+
+static gboolean
+section_ok (const IndexHeader *header, guint64 offset, guint64 len)
+{
+    return offset % INDEX_ALIGN == 0 &&
+        offset <= header->size && len <= header->size - offset;
+}
+
+YumChangelogIndex *
+yum_changelog_index_open (const char *path, GError **err)
+{
+    YumChangelogIndex *index = NULL;
+    const IndexHeader *header;
+    struct stat st;
+    gpointer map;
+    int fd;
+
+    fd = open (path, O_RDONLY);
+    if (fd < 0) {
+        g_set_error (err, YUM_CHANGELOG_INDEX_ERROR,
+                     YUM_CHANGELOG_INDEX_ERROR,
+                     "Can not open index file %s: %s",
+                     path, g_strerror (errno));
+        return NULL;
+    }
+
+    if (fstat (fd, &st) != 0 || st.st_size < (off_t) sizeof (IndexHeader)) {
+        g_set_error (err, YUM_CHANGELOG_INDEX_ERROR,
+                     YUM_CHANGELOG_INDEX_ERROR,
+                     "Index file %s is truncated", path);
+        close (fd);
+        return NULL;
+    }
+
+    map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED) {
+        g_set_error (err, YUM_CHANGELOG_INDEX_ERROR,
+                     YUM_CHANGELOG_INDEX_ERROR,
+                     "Can not map index file %s: %s",
+                     path, g_strerror (errno));
+        return NULL;
+    }
+
+    header = (const IndexHeader *) map;
+    if (memcmp (header->magic, INDEX_MAGIC, sizeof (header->magic)) ||
+        header->byte_order != INDEX_BYTE_ORDER ||
+        header->version != YUM_CHANGELOG_INDEX_VERSION) {
+        g_set_error (err, YUM_CHANGELOG_INDEX_ERROR,
+                     YUM_CHANGELOG_INDEX_ERROR,
+                     "%s is not a version %d changelog index for this host",
+                     path, YUM_CHANGELOG_INDEX_VERSION);
+        goto error;
+    }
+
+    if (header->size != (guint64) st.st_size ||
+        !section_ok (header, header->strings_offset, header->strings_len) ||
+        !section_ok (header, header->packages_offset,
+                     (guint64) header->n_packages *
+                     sizeof (ChangelogPackage)) ||
+        !section_ok (header, header->points_offset,
+                     (guint64) header->n_points * sizeof (ChangelogPoint)) ||
+        !section_ok (header, header->windows_offset, header->windows_len) ||
+        header->strings_len == 0 ||
+        ((const char *) map)[header->strings_offset +
+                             header->strings_len - 1] != '\0' ||
+        (header->n_packages > 0 && header->n_points == 0)) {
+        g_set_error (err, YUM_CHANGELOG_INDEX_ERROR,
+                     YUM_CHANGELOG_INDEX_ERROR,
+                     "Index file %s is corrupt", path);
+        goto error;
+    }
+
+    index = g_new0 (YumChangelogIndex, 1);
+    index->map = map;
+    index->size = st.st_size;
+    index->header = header;
+
+#define SECTION(type, field) \
+    (const type *) ((const char *) map + header->field)
+    index->strings = SECTION (char, strings_offset);
+    index->packages = SECTION (ChangelogPackage, packages_offset);
+    index->points = SECTION (ChangelogPoint, points_offset);
+    index->windows = SECTION (guchar, windows_offset);
+#undef SECTION
+
+    return index;
+
+ error:
+    munmap (map, st.st_size);
+    return NULL;
+}
+
+void
+yum_changelog_index_close (YumChangelogIndex *index)
+{
+    munmap (index->map, index->size);
+    g_free (index);
+}
+
+static const char *
+index_string (YumChangelogIndex *index, guint32 offset)
+{
+    if (offset >= index->header->strings_len)
+        return "";
+
+    return index->strings + offset;
+}
+
+const char *
+yum_changelog_index_checksum (YumChangelogIndex *index)
+{
+    return index_string (index, index->header->checksum);
+}
+
+guint32
+yum_changelog_index_package_count (YumChangelogIndex *index)
+{
+    return index->header->n_packages;
+}
+
+static const ChangelogPackage *
+find_package (YumChangelogIndex *index, const char *pkgId)
+{
+    guint32 lo = 0;
+    guint32 hi = index->header->n_packages;
+
+    while (lo < hi) {
+        guint32 mid = lo + (hi - lo) / 2;
+        const ChangelogPackage *pkg = &index->packages[mid];
+        int cmp;
+
+        cmp = strcmp (pkgId, index_string (index, pkg->pkgId));
+        if (cmp == 0)
+            return pkg;
+        if (cmp < 0)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+
+    return NULL;
+}
+
+/* The last point at or before offset */
+static const ChangelogPoint *
+find_point (YumChangelogIndex *index, guint64 offset)
+{
+    guint32 lo = 0;
+    guint32 hi = index->header->n_points;
+
+    while (hi - lo > 1) {
+        guint32 mid = lo + (hi - lo) / 2;
+
+        if (index->points[mid].out <= offset)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    return &index->points[lo];
+}
+
+/* Reads the bytes of a package element, the range the writer got */
+static char *
+read_package (YumChangelogIndex *index,
+              const char *md_filename,
+              const ChangelogPackage *pkg,
+              GError **err)
+{
+    const ChangelogPoint *cp;
+    YumGzipPoint point;
+    YumGzipReader *reader;
+    guchar *window = NULL;
+    char *buf = NULL;
+    guint32 got = 0;
+
+    cp = find_point (index, pkg->offset);
+    point.out = cp->out;
+    point.in = cp->in;
+    point.bits = cp->bits;
+    point.window_len = cp->window_len;
+
+    if (cp->window_len) {
+        uLongf len = cp->window_len;
+
+        if (cp->window > index->header->windows_len ||
+            cp->window_size > index->header->windows_len - cp->window ||
+            cp->window_len > YUM_GZIP_WINDOW_SIZE) {
+            g_set_error (err, YUM_CHANGELOG_INDEX_ERROR,
+                         YUM_CHANGELOG_INDEX_ERROR,
+                         "Changelog index is corrupt");
+            return NULL;
+        }
+
+        window = g_malloc (YUM_GZIP_WINDOW_SIZE);
+        if (uncompress (window, &len, index->windows + cp->window,
+                        cp->window_size) != Z_OK || len != cp->window_len) {
+            g_set_error (err, YUM_CHANGELOG_INDEX_ERROR,
+                         YUM_CHANGELOG_INDEX_ERROR,
+                         "Changelog index is corrupt");
+            g_free (window);
+            return NULL;
+        }
+    }
+
+    reader = yum_gzip_reader_open_at (md_filename, &point, window, err);
+    g_free (window);
+    if (!reader)
+        return NULL;
+
+    if (!yum_gzip_reader_skip (reader, pkg->offset - cp->out, err))
+        goto out;
+
+    buf = g_malloc (pkg->length + 1);
+    while (got < pkg->length) {
+        gssize n;
+
+        n = yum_gzip_reader_read (reader, buf + got, pkg->length - got, err);
+        if (n < 0)
+            break;
+        if (n == 0) {
+            g_set_error (err, YUM_CHANGELOG_INDEX_ERROR,
+                         YUM_CHANGELOG_INDEX_ERROR,
+                         "%s is shorter than expected", md_filename);
+            break;
+        }
+
+        got += n;
+    }
+    buf[got] = '\0';
+
+    if (*err) {
+        g_free (buf);
+        buf = NULL;
+    }
+
+ out:
+    yum_gzip_reader_close (reader);
+
+    return buf;
+}
+
+gboolean
+yum_changelog_index_lookup (YumChangelogIndex *index,
+                            const char *md_filename,
+                            const char *pkgId,
+                            PackageFn package_fn,
+                            gpointer user_data,
+                            GError **err)
+{
+    const ChangelogPackage *pkg;
+    YumXmlParser *parser;
+    struct stat st;
+    char *buf;
+    char *start;
+
+    pkg = find_package (index, pkgId);
+    if (!pkg)
+        return FALSE;
+
+    if (stat (md_filename, &st) != 0 ||
+        (guint64) st.st_size != index->header->md_size) {
+        g_set_error (err, YUM_CHANGELOG_INDEX_ERROR,
+                     YUM_CHANGELOG_INDEX_ERROR,
+                     "%s does not match its changelog index", md_filename);
+        return FALSE;
+    }
+
+    buf = read_package (index, md_filename, pkg, err);
+    if (!buf)
+        return FALSE;
+
+    /* Drop what precedes the package, the document's opening tags for
+       the first one */
+    start = strstr (buf, "<package");
+    if (!start) {
+        g_set_error (err, YUM_CHANGELOG_INDEX_ERROR,
+                     YUM_CHANGELOG_INDEX_ERROR,
+                     "%s does not match its changelog index", md_filename);
+        g_free (buf);
+        return FALSE;
+    }
+
+    parser = yum_xml_parser_new_other (NULL, package_fn, user_data, err);
+    if (parser) {
+        yum_xml_parser_feed (parser, "<otherdata>", strlen ("<otherdata>"));
+        yum_xml_parser_feed (parser, start, strlen (start));
+        yum_xml_parser_feed (parser, "</otherdata>", strlen ("</otherdata>"));
+        yum_xml_parser_finish (parser);
+        yum_xml_parser_free (parser);
+    }
+
+    g_free (buf);
+
+    return !*err;
+}
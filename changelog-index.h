@@ -0,0 +1,84 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef __YUM_CHANGELOG_INDEX_H__
+#define __YUM_CHANGELOG_INDEX_H__
+
+#include <glib.h>
+#include "package.h"
+#include "gzip-reader.h"
+
+/* An alternative to other.sqlite for the rare changelog lookup: where
+ * every package element of other.xml(.gz) is, plus access points into
+ * the compressed file, so that one package can be decompressed and
+ * parsed on its own.  Like the lookup index the file is memory-mappable
+ * and written in host byte order; see changelog-index.c for the
+ * layout. */
+
+#define YUM_CHANGELOG_INDEX_VERSION 1
+
+/* Uncompressed bytes between access points.  Smaller spans make lookups
+   decompress less and the index bigger, by up to 32k a point. */
+#define YUM_CHANGELOG_INDEX_SPAN (1024 * 1024)
+
+#define YUM_CHANGELOG_INDEX_ERROR yum_changelog_index_error_quark()
+GQuark yum_changelog_index_error_quark (void);
+
+typedef struct _YumChangelogIndex YumChangelogIndex;
+typedef struct _YumChangelogIndexWriter YumChangelogIndexWriter;
+
+char    *yum_changelog_index_filename          (const char *prefix);
+
+/* Writer */
+
+YumChangelogIndexWriter *yum_changelog_index_writer_new (void);
+void     yum_changelog_index_writer_add_point  (YumChangelogIndexWriter *writer,
+                                                const YumGzipPoint *point,
+                                                const guchar *window);
+/* The package element starts somewhere in the length bytes at offset,
+   which may begin with whitespace or the document's opening tags */
+void     yum_changelog_index_writer_add        (YumChangelogIndexWriter *writer,
+                                                const char *pkgId,
+                                                guint64 offset,
+                                                guint32 length);
+void     yum_changelog_index_writer_write      (YumChangelogIndexWriter *writer,
+                                                const char *path,
+                                                const char *checksum,
+                                                guint64 md_size,
+                                                GError **err);
+void     yum_changelog_index_writer_free       (YumChangelogIndexWriter *writer);
+
+/* Reader */
+
+YumChangelogIndex *yum_changelog_index_open    (const char *path,
+                                                GError **err);
+void     yum_changelog_index_close             (YumChangelogIndex *index);
+
+const char *yum_changelog_index_checksum       (YumChangelogIndex *index);
+guint32  yum_changelog_index_package_count     (YumChangelogIndex *index);
+
+/* Parses the package pkgId out of md_filename, the file the index was
+   built from, and hands it to package_fn.  Returns FALSE if there is no
+   such package or on errors. */
+gboolean yum_changelog_index_lookup            (YumChangelogIndex *index,
+                                                const char *md_filename,
+                                                const char *pkgId,
+                                                PackageFn package_fn,
+                                                gpointer user_data,
+                                                GError **err);
+
+#endif /* __YUM_CHANGELOG_INDEX_H__ */
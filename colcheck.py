@@ -0,0 +1,128 @@
+#!/usr/bin/python -tt
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+"""Check that columnar exports read back as the metadata they came from.
+
+usage: colcheck.py METADATA...
+
+Exports each primary, filelists or other metadata file to columnar
+files, reads every file back and compares its rows with the packages
+the metadata iterators parse from the same file.  Exits with 1 if any
+differ."""
+
+import os
+import sys
+import shutil
+import tempfile
+import sqlitecachec
+
+EXPORTS = (('primary', 'exportPrimary', 'iterPrimary'),
+           ('filelists', 'exportFilelists', 'iterFilelists'),
+           ('other', 'exportOtherdata', 'iterOtherdata'))
+
+PRIMARY_COLUMNS = ('pkgId', 'name', 'arch', 'version', 'epoch', 'release',
+                   'summary', 'description', 'url', 'time_file',
+                   'time_build', 'rpm_license', 'rpm_vendor', 'rpm_group',
+                   'rpm_buildhost', 'rpm_sourcerpm', 'rpm_header_start',
+                   'rpm_header_end', 'rpm_packager', 'size_package',
+                   'size_installed', 'size_archive', 'location_href',
+                   'location_base', 'checksum_type')
+PACKAGE_COLUMNS = PRIMARY_COLUMNS[:6]
+DEP_COLUMNS = ('pkg', 'name', 'flags', 'epoch', 'version', 'release', 'pre')
+FILE_COLUMNS = ('pkg', 'name', 'type')
+CHANGELOG_COLUMNS = ('pkg', 'author', 'date', 'changelog')
+DEP_TABLES = ('requires', 'provides', 'conflicts', 'obsoletes',
+              'suggests', 'enhances', 'recommends', 'supplements')
+
+class Callback:
+    def log(self, level, msg):
+        pass
+
+    def progressbar(self, current, total, name):
+        pass
+
+def expected(kind, packages):
+    """The rows of every .col file of an export, from the iterator"""
+    if kind == 'primary':
+        columns = PRIMARY_COLUMNS
+    else:
+        columns = PACKAGE_COLUMNS
+
+    tables = {'packages': (columns, [])}
+    if kind == 'primary':
+        for table in DEP_TABLES:
+            tables[table] = (DEP_COLUMNS, [])
+    if kind in ('primary', 'filelists'):
+        tables['files'] = (FILE_COLUMNS, [])
+    if kind == 'other':
+        tables['changelog'] = (CHANGELOG_COLUMNS, [])
+
+    for pkg, package in enumerate(packages):
+        tables['packages'][1].append(tuple([package[c] for c in columns]))
+        for table in DEP_TABLES:
+            # Only requires carry pre, the others export it as 0
+            for dep in package.get(table, ()):
+                tables[table][1].append((pkg,) + (dep + (0,))[:6])
+        for name, type in package.get('files', ()):
+            tables['files'][1].append((pkg, name, type))
+        for author, date, text in package.get('changelogs', ()):
+            tables['changelog'][1].append((pkg, author, date, text))
+
+    return tables
+
+def check(metadata, tmpdir):
+    name = os.path.basename(metadata)
+    for kind, exporter, iterator in EXPORTS:
+        if name.find(kind) >= 0:
+            break
+    else:
+        print '%s: not primary, filelists or other metadata' % metadata
+        return False
+
+    parser = sqlitecachec.RepodataParserSqlite(tmpdir, 'colcheck',
+                                               Callback())
+    outdir = os.path.join(tmpdir, kind)
+    getattr(parser, exporter)(metadata, outdir)
+
+    ok = True
+    tables = expected(kind, getattr(parser, iterator)(metadata))
+    for table in sorted(tables):
+        names, rows = tables[table]
+        values = parser.readColumns(os.path.join(outdir, table + '.col'))
+        same = sorted(values) == sorted(names) and \
+            zip(*[values[n] for n in names]) == rows
+        if not same:
+            print '%s: %s.col DIFFERS' % (metadata, table)
+            ok = False
+
+    if ok:
+        print '%s: %d files read back the same' % (metadata, len(tables))
+    return ok
+
+def main(args):
+    if not args:
+        print __doc__
+        return 2
+
+    tmpdir = tempfile.mkdtemp(prefix='colcheck')
+    try:
+        results = [check(f, tmpdir) for f in args]
+    finally:
+        shutil.rmtree(tmpdir)
+
+    return not all(results) and 1 or 0
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
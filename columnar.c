@@ -0,0 +1,1094 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "columnar.h"
+
+/*
+ * File layout, in host byte order (the header records which), every
+ * section aligned to 8 bytes:
+ *
+ *   ColumnHeader
+ *   chunk data      for every chunk, for every column, one array of
+ *                   n_rows gint64 (YUM_COLUMN_INT), n_rows guint32
+ *                   dictionary ids (YUM_COLUMN_STRING), or guint32
+ *                   offsets[n_rows + 1] followed by the NUL terminated
+ *                   strings they point at, the last one their total
+ *                   size (YUM_COLUMN_TEXT)
+ *   dictionaries    for every string column: guint32 offsets[size + 1]
+ *                   followed by the NUL terminated strings
+ *   ColumnDesc      n_columns entries
+ *   chunk directory n_chunks entries of ChunkDesc, each followed by
+ *                   n_columns guint64 file offsets of the column arrays
+ *
+ * The header is written last, once the offsets are known.
+ */
+
+#define COLUMN_MAGIC "YUMCOLS\0"
+#define COLUMN_BYTE_ORDER 0x01020304
+#define COLUMN_ALIGN 8
+#define COLUMN_NAME_SIZE 32
+
+typedef struct {
+    char magic[8];
+    guint32 version;
+    guint32 byte_order;
+    guint32 n_columns;
+    guint32 n_chunks;
+    guint64 n_rows;
+    guint64 columns_offset;
+    guint64 chunks_offset;
+} ColumnHeader;
+
+typedef struct {
+    char name[COLUMN_NAME_SIZE];
+    guint32 type;
+    guint32 dict_size;
+    guint64 dict_offset;
+} ColumnDesc;
+
+typedef struct {
+    guint64 first_row;
+    guint32 n_rows;
+    guint32 reserved;
+} ChunkDesc;
+
+typedef struct {
+    ColumnDesc desc;
+    GArray *values;
+
+    /* Dictionary, string columns only */
+    GHashTable *dict;
+    GPtrArray *dict_list;
+    GStringChunk *dict_chunk;
+
+    /* Strings of the current chunk, text columns only */
+    GString *text;
+} Column;
+
+struct _YumColumnFile {
+    FILE *f;
+    char *path;
+    guint64 offset;
+
+    guint n_columns;
+    Column *columns;
+
+    guint32 chunk_rows;
+    guint64 n_rows;
+    GArray *chunks;
+};
+
+GQuark
+yum_column_error_quark (void)
+{
+    static GQuark quark;
+
+    if (!quark)
+        quark = g_quark_from_static_string ("yum_column_error");
+
+    return quark;
+}
+
+static gboolean
+column_write (YumColumnFile *file, gconstpointer data, gsize len)
+{
+    static const char padding[COLUMN_ALIGN] = { 0 };
+    gsize pad;
+
+    if (len && fwrite (data, 1, len, file->f) != len)
+        return FALSE;
+    file->offset += len;
+
+    pad = (COLUMN_ALIGN - (file->offset % COLUMN_ALIGN)) % COLUMN_ALIGN;
+    if (pad && fwrite (padding, 1, pad, file->f) != pad)
+        return FALSE;
+    file->offset += pad;
+
+    return TRUE;
+}
+
+static void
+column_write_error (YumColumnFile *file, GError **err)
+{
+    g_set_error (err, YUM_COLUMN_ERROR, YUM_COLUMN_ERROR,
+                 "Can not write %s: %s", file->path, g_strerror (errno));
+}
+
+YumColumnFile *
+yum_column_file_new (const char *path,
+                     const char **names,
+                     const YumColumnType *types,
+                     guint n_columns,
+                     GError **err)
+{
+    YumColumnFile *file;
+    ColumnHeader header;
+    guint i;
+
+    file = g_new0 (YumColumnFile, 1);
+    file->path = g_strdup (path);
+    file->n_columns = n_columns;
+    file->columns = g_new0 (Column, n_columns);
+    file->chunks = g_array_new (FALSE, FALSE, sizeof (guint64));
+
+    for (i = 0; i < n_columns; i++) {
+        Column *column = &file->columns[i];
+
+        strncpy (column->desc.name, names[i], COLUMN_NAME_SIZE - 1);
+        column->desc.type = types[i];
+
+        if (types[i] == YUM_COLUMN_STRING) {
+            column->values = g_array_sized_new (FALSE, FALSE, sizeof (guint32),
+                                                YUM_COLUMN_CHUNK_ROWS);
+            column->dict = g_hash_table_new (g_str_hash, g_str_equal);
+            column->dict_list = g_ptr_array_new ();
+            column->dict_chunk = g_string_chunk_new (64 * 1024);
+        } else if (types[i] == YUM_COLUMN_TEXT) {
+            column->values = g_array_sized_new (FALSE, FALSE, sizeof (guint32),
+                                                YUM_COLUMN_CHUNK_ROWS + 1);
+            column->text = g_string_sized_new (64 * 1024);
+        } else
+            column->values = g_array_sized_new (FALSE, FALSE, sizeof (gint64),
+                                                YUM_COLUMN_CHUNK_ROWS);
+    }
+
+    file->f = fopen (path, "wb");
+    if (!file->f) {
+        g_set_error (err, YUM_COLUMN_ERROR, YUM_COLUMN_ERROR,
+                     "Can not create %s: %s", path, g_strerror (errno));
+        yum_column_file_close (file, NULL);
+        return NULL;
+    }
+
+    /* Reserve room for the header, it is filled in on close */
+    memset (&header, 0, sizeof (ColumnHeader));
+    if (!column_write (file, &header, sizeof (ColumnHeader))) {
+        column_write_error (file, err);
+        yum_column_file_close (file, NULL);
+        return NULL;
+    }
+
+    return file;
+}
+
+void
+yum_column_file_set_int (YumColumnFile *file, guint column, gint64 value)
+{
+    GArray *values = file->columns[column].values;
+
+    g_array_set_size (values, file->chunk_rows + 1);
+    g_array_index (values, gint64, file->chunk_rows) = value;
+}
+
+void
+yum_column_file_set_string (YumColumnFile *file,
+                            guint column,
+                            const char *value)
+{
+    Column *col = &file->columns[column];
+    guint32 id = YUM_COLUMN_NULL;
+
+    if (col->text) {
+        /* Flushed at YUM_COLUMN_CHUNK_TEXT, far below G_MAXUINT32 */
+        if (value) {
+            id = col->text->len;
+            g_string_append_len (col->text, value, strlen (value) + 1);
+        }
+    } else if (value) {
+        gpointer found = g_hash_table_lookup (col->dict, value);
+
+        if (found)
+            id = GPOINTER_TO_UINT (found) - 1;
+        else {
+            char *copy = g_string_chunk_insert (col->dict_chunk, value);
+
+            id = col->dict_list->len;
+            g_ptr_array_add (col->dict_list, copy);
+            g_hash_table_insert (col->dict, copy, GUINT_TO_POINTER (id + 1));
+        }
+    }
+
+    g_array_set_size (col->values, file->chunk_rows + 1);
+    g_array_index (col->values, guint32, file->chunk_rows) = id;
+}
+
+static void
+column_file_flush_chunk (YumColumnFile *file, GError **err)
+{
+    ChunkDesc chunk;
+    guint64 *offsets;
+    guint i;
+
+    if (file->chunk_rows == 0)
+        return;
+
+    chunk.first_row = file->n_rows - file->chunk_rows;
+    chunk.n_rows = file->chunk_rows;
+    chunk.reserved = 0;
+
+    offsets = g_new (guint64, file->n_columns);
+
+    for (i = 0; i < file->n_columns; i++) {
+        Column *column = &file->columns[i];
+        gsize width = column->desc.type == YUM_COLUMN_INT ?
+            sizeof (gint64) : sizeof (guint32);
+        gboolean ok;
+
+        /* Columns left unset in the last row default to 0 / NULL */
+        if (column->values->len < file->chunk_rows) {
+            guint old_len = column->values->len;
+
+            g_array_set_size (column->values, file->chunk_rows);
+            if (column->desc.type == YUM_COLUMN_INT)
+                memset (column->values->data + old_len * width, 0,
+                        (file->chunk_rows - old_len) * width);
+            else
+                memset (column->values->data + old_len * width, 0xff,
+                        (file->chunk_rows - old_len) * width);
+        }
+
+        offsets[i] = file->offset;
+        if (column->text) {
+            guint32 size = column->text->len;
+
+            g_array_append_val (column->values, size);
+            ok = fwrite (column->values->data, width, file->chunk_rows + 1,
+                         file->f) == file->chunk_rows + 1;
+            if (ok) {
+                file->offset += (file->chunk_rows + 1) * width;
+                ok = column_write (file, column->text->str, size);
+            }
+            g_string_truncate (column->text, 0);
+        } else
+            ok = column_write (file, column->values->data,
+                               file->chunk_rows * width);
+
+        if (!ok) {
+            column_write_error (file, err);
+            g_free (offsets);
+            return;
+        }
+
+        g_array_set_size (column->values, 0);
+    }
+
+    /* The directory is kept as a flat array of guint64 words */
+    g_array_append_vals (file->chunks, &chunk, sizeof (ChunkDesc) /
+                         sizeof (guint64));
+    g_array_append_vals (file->chunks, offsets, file->n_columns);
+    g_free (offsets);
+
+    file->chunk_rows = 0;
+}
+
+void
+yum_column_file_next_row (YumColumnFile *file, GError **err)
+{
+    guint i;
+
+    file->chunk_rows++;
+    file->n_rows++;
+
+    if (file->chunk_rows == YUM_COLUMN_CHUNK_ROWS) {
+        column_file_flush_chunk (file, err);
+        return;
+    }
+
+    for (i = 0; i < file->n_columns; i++) {
+        GString *text = file->columns[i].text;
+
+        if (text && text->len >= YUM_COLUMN_CHUNK_TEXT) {
+            column_file_flush_chunk (file, err);
+            return;
+        }
+    }
+}
+
+static gboolean
+column_file_finish (YumColumnFile *file, GError **err)
+{
+    ColumnHeader header;
+    guint32 n_chunks;
+    guint i, j;
+
+    column_file_flush_chunk (file, err);
+    if (*err)
+        return FALSE;
+
+    for (i = 0; i < file->n_columns; i++) {
+        Column *column = &file->columns[i];
+        guint32 *offsets;
+        guint32 size;
+
+        if (column->desc.type != YUM_COLUMN_STRING)
+            continue;
+
+        size = column->dict_list->len;
+        offsets = g_new (guint32, size + 1);
+        offsets[0] = 0;
+        for (j = 0; j < size; j++)
+            offsets[j + 1] = offsets[j] +
+                strlen (g_ptr_array_index (column->dict_list, j)) + 1;
+
+        column->desc.dict_size = size;
+        column->desc.dict_offset = file->offset;
+
+        if (fwrite (offsets, sizeof (guint32), size + 1, file->f) != size + 1) {
+            g_free (offsets);
+            column_write_error (file, err);
+            return FALSE;
+        }
+        file->offset += (size + 1) * sizeof (guint32);
+        g_free (offsets);
+
+        for (j = 0; j < size; j++) {
+            const char *s = g_ptr_array_index (column->dict_list, j);
+            gsize len = strlen (s) + 1;
+
+            if (fwrite (s, 1, len, file->f) != len) {
+                column_write_error (file, err);
+                return FALSE;
+            }
+            file->offset += len;
+        }
+
+        if (!column_write (file, NULL, 0)) {
+            column_write_error (file, err);
+            return FALSE;
+        }
+    }
+
+    memset (&header, 0, sizeof (ColumnHeader));
+    memcpy (header.magic, COLUMN_MAGIC, sizeof (header.magic));
+    header.version = YUM_COLUMN_VERSION;
+    header.byte_order = COLUMN_BYTE_ORDER;
+    header.n_columns = file->n_columns;
+    header.n_rows = file->n_rows;
+
+    header.columns_offset = file->offset;
+    for (i = 0; i < file->n_columns; i++) {
+        if (!column_write (file, &file->columns[i].desc, sizeof (ColumnDesc))) {
+            column_write_error (file, err);
+            return FALSE;
+        }
+    }
+
+    n_chunks = file->chunks->len /
+        (sizeof (ChunkDesc) / sizeof (guint64) + file->n_columns);
+    header.n_chunks = n_chunks;
+    header.chunks_offset = file->offset;
+    if (!column_write (file, file->chunks->data,
+                       file->chunks->len * sizeof (guint64))) {
+        column_write_error (file, err);
+        return FALSE;
+    }
+
+    if (fseek (file->f, 0, SEEK_SET) != 0 ||
+        fwrite (&header, sizeof (ColumnHeader), 1, file->f) != 1) {
+        column_write_error (file, err);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Finishes the file and frees it; with err == NULL the file is
+   discarded instead */
+void
+yum_column_file_close (YumColumnFile *file, GError **err)
+{
+    gboolean ok = FALSE;
+    guint i;
+
+    if (file->f) {
+        if (err)
+            ok = column_file_finish (file, err);
+
+        if (fclose (file->f) != 0 && ok) {
+            column_write_error (file, err);
+            ok = FALSE;
+        }
+
+        if (!ok)
+            unlink (file->path);
+    }
+
+    for (i = 0; i < file->n_columns; i++) {
+        Column *column = &file->columns[i];
+
+        g_array_free (column->values, TRUE);
+        if (column->dict) {
+            g_hash_table_destroy (column->dict);
+            g_ptr_array_free (column->dict_list, TRUE);
+            g_string_chunk_free (column->dict_chunk);
+        }
+        if (column->text)
+            g_string_free (column->text, TRUE);
+    }
+
+    g_free (file->columns);
+    g_array_free (file->chunks, TRUE);
+    g_free (file->path);
+    g_free (file);
+}
+
+/*****************************************************************************/
+
+struct _YumColumnReader {
+    gpointer map;
+    gsize size;
+    const ColumnHeader *header;
+    const ColumnDesc *columns;
+
+    /* The chunk directory, a ChunkDesc and the column offsets per chunk */
+    const guint64 *chunks;
+    guint chunk_words;
+    guint32 last_chunk;
+};
+
+#define READER_AT(reader, offset) \
+    ((const char *) (reader)->map + (offset))
+#define READER_CHUNK(reader, i) \
+    ((const ChunkDesc *) ((reader)->chunks + (gsize) (i) * (reader)->chunk_words))
+
+static gboolean
+reader_range_ok (YumColumnReader *reader, guint64 offset, guint64 len)
+{
+    return offset % COLUMN_ALIGN == 0 && offset <= reader->size &&
+        len <= reader->size - offset;
+}
+
+/* Every string of a dictionary ends with its NUL */
+static gboolean
+reader_dict_ok (YumColumnReader *reader, const ColumnDesc *desc)
+{
+    const guint32 *offsets;
+    const char *data;
+    guint64 data_offset;
+    guint32 data_len;
+    guint32 i;
+
+    data_offset = desc->dict_offset +
+        ((guint64) desc->dict_size + 1) * sizeof (guint32);
+    if (!reader_range_ok (reader, desc->dict_offset,
+                          data_offset - desc->dict_offset))
+        return FALSE;
+
+    offsets = (const guint32 *) READER_AT (reader, desc->dict_offset);
+    data_len = offsets[desc->dict_size];
+    if (offsets[0] != 0 || data_len > reader->size - data_offset)
+        return FALSE;
+
+    data = READER_AT (reader, data_offset);
+    for (i = 0; i < desc->dict_size; i++) {
+        guint32 end = offsets[i + 1];
+
+        if (end <= offsets[i] || end > data_len || data[end - 1] != '\0')
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Every offset of a text array points into the strings of its chunk,
+   and the last of them ends with its NUL */
+static gboolean
+reader_text_ok (YumColumnReader *reader, guint64 offset, guint32 n_rows)
+{
+    const guint32 *offsets;
+    const char *data;
+    guint64 data_offset;
+    guint32 size;
+    guint32 i;
+
+    data_offset = offset + ((guint64) n_rows + 1) * sizeof (guint32);
+    if (!reader_range_ok (reader, offset, data_offset - offset))
+        return FALSE;
+
+    offsets = (const guint32 *) READER_AT (reader, offset);
+    size = offsets[n_rows];
+    if (size > reader->size - data_offset)
+        return FALSE;
+
+    data = READER_AT (reader, data_offset);
+    if (size > 0 && data[size - 1] != '\0')
+        return FALSE;
+
+    for (i = 0; i < n_rows; i++) {
+        if (offsets[i] != YUM_COLUMN_NULL && offsets[i] >= size)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* The sections the getters read, so that they never read outside the
+   mapping.  Dictionary ids are checked by yum_column_reader_get_string
+   (), which returns NULL for bad ones. */
+static gboolean
+reader_ok (YumColumnReader *reader)
+{
+    const ColumnHeader *header = reader->header;
+    guint64 next_row = 0;
+    guint32 i, j;
+
+    if (!reader_range_ok (reader, header->columns_offset,
+                          (guint64) header->n_columns * sizeof (ColumnDesc)) ||
+        !reader_range_ok (reader, header->chunks_offset,
+                          (guint64) header->n_chunks * reader->chunk_words *
+                          sizeof (guint64)))
+        return FALSE;
+
+    reader->columns = (const ColumnDesc *)
+        READER_AT (reader, header->columns_offset);
+    reader->chunks = (const guint64 *)
+        READER_AT (reader, header->chunks_offset);
+
+    for (i = 0; i < header->n_columns; i++) {
+        const ColumnDesc *desc = &reader->columns[i];
+
+        if (desc->name[COLUMN_NAME_SIZE - 1] != '\0')
+            return FALSE;
+        if (desc->type == YUM_COLUMN_STRING) {
+            if (!reader_dict_ok (reader, desc))
+                return FALSE;
+        } else if (desc->type != YUM_COLUMN_INT &&
+                   desc->type != YUM_COLUMN_TEXT)
+            return FALSE;
+    }
+
+    for (i = 0; i < header->n_chunks; i++) {
+        const ChunkDesc *chunk = READER_CHUNK (reader, i);
+        const guint64 *offsets = (const guint64 *) (chunk + 1);
+
+        if (chunk->first_row != next_row || chunk->n_rows == 0 ||
+            chunk->n_rows > YUM_COLUMN_CHUNK_ROWS)
+            return FALSE;
+        next_row += chunk->n_rows;
+
+        for (j = 0; j < header->n_columns; j++) {
+            gboolean ok;
+
+            if (reader->columns[j].type == YUM_COLUMN_INT)
+                ok = reader_range_ok (reader, offsets[j], (guint64)
+                                      chunk->n_rows * sizeof (gint64));
+            else if (reader->columns[j].type == YUM_COLUMN_STRING)
+                ok = reader_range_ok (reader, offsets[j], (guint64)
+                                      chunk->n_rows * sizeof (guint32));
+            else
+                ok = reader_text_ok (reader, offsets[j], chunk->n_rows);
+
+            if (!ok)
+                return FALSE;
+        }
+    }
+
+    return next_row == header->n_rows;
+}
+
+YumColumnReader *
+yum_column_reader_open (const char *path, GError **err)
+{
+    YumColumnReader *reader;
+    const ColumnHeader *header;
+    struct stat st;
+    gpointer map;
+    int fd;
+
+    fd = open (path, O_RDONLY);
+    if (fd < 0) {
+        g_set_error (err, YUM_COLUMN_ERROR, YUM_COLUMN_ERROR,
+                     "Can not open %s: %s", path, g_strerror (errno));
+        return NULL;
+    }
+
+    if (fstat (fd, &st) != 0 || st.st_size < (off_t) sizeof (ColumnHeader)) {
+        g_set_error (err, YUM_COLUMN_ERROR, YUM_COLUMN_ERROR,
+                     "Column file %s is truncated", path);
+        close (fd);
+        return NULL;
+    }
+
+    map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED) {
+        g_set_error (err, YUM_COLUMN_ERROR, YUM_COLUMN_ERROR,
+                     "Can not map %s: %s", path, g_strerror (errno));
+        return NULL;
+    }
+
+    reader = g_new0 (YumColumnReader, 1);
+    reader->map = map;
+    reader->size = st.st_size;
+    reader->header = header = (const ColumnHeader *) map;
+
+    if (memcmp (header->magic, COLUMN_MAGIC, sizeof (header->magic)) ||
+        header->byte_order != COLUMN_BYTE_ORDER ||
+        header->version != YUM_COLUMN_VERSION) {
+        g_set_error (err, YUM_COLUMN_ERROR, YUM_COLUMN_ERROR,
+                     "%s is not a version %d column file for this host",
+                     path, YUM_COLUMN_VERSION);
+        yum_column_reader_close (reader);
+        return NULL;
+    }
+
+    reader->chunk_words = sizeof (ChunkDesc) / sizeof (guint64) +
+        header->n_columns;
+
+    if (!reader_ok (reader)) {
+        g_set_error (err, YUM_COLUMN_ERROR, YUM_COLUMN_ERROR,
+                     "Column file %s is corrupt", path);
+        yum_column_reader_close (reader);
+        return NULL;
+    }
+
+    return reader;
+}
+
+void
+yum_column_reader_close (YumColumnReader *reader)
+{
+    munmap (reader->map, reader->size);
+    g_free (reader);
+}
+
+guint
+yum_column_reader_n_columns (YumColumnReader *reader)
+{
+    return reader->header->n_columns;
+}
+
+guint64
+yum_column_reader_n_rows (YumColumnReader *reader)
+{
+    return reader->header->n_rows;
+}
+
+const char *
+yum_column_reader_name (YumColumnReader *reader, guint column)
+{
+    if (column >= reader->header->n_columns)
+        return NULL;
+
+    return reader->columns[column].name;
+}
+
+YumColumnType
+yum_column_reader_type (YumColumnReader *reader, guint column)
+{
+    if (column >= reader->header->n_columns)
+        return 0;
+
+    return reader->columns[column].type;
+}
+
+/* The offset of the column's array in the chunk holding row, which
+   becomes the row's index in it; scans hit the last chunk again */
+static const char *
+reader_locate (YumColumnReader *reader, guint column, guint64 *row)
+{
+    const ChunkDesc *chunk;
+    guint32 low, high;
+
+    if (column >= reader->header->n_columns ||
+        *row >= reader->header->n_rows)
+        return NULL;
+
+    chunk = READER_CHUNK (reader, reader->last_chunk);
+    if (*row < chunk->first_row || *row - chunk->first_row >= chunk->n_rows) {
+        low = 0;
+        high = reader->header->n_chunks;
+        while (high - low > 1) {
+            guint32 middle = low + (high - low) / 2;
+
+            if (READER_CHUNK (reader, middle)->first_row <= *row)
+                low = middle;
+            else
+                high = middle;
+        }
+
+        reader->last_chunk = low;
+        chunk = READER_CHUNK (reader, low);
+    }
+
+    *row -= chunk->first_row;
+    return READER_AT (reader, ((const guint64 *) (chunk + 1))[column]);
+}
+
+gint64
+yum_column_reader_get_int (YumColumnReader *reader, guint column, guint64 row)
+{
+    const char *data = reader_locate (reader, column, &row);
+
+    if (!data || reader->columns[column].type != YUM_COLUMN_INT)
+        return 0;
+
+    return ((const gint64 *) data)[row];
+}
+
+const char *
+yum_column_reader_get_string (YumColumnReader *reader,
+                              guint column,
+                              guint64 row)
+{
+    const char *data = reader_locate (reader, column, &row);
+    const ColumnDesc *desc;
+    const guint32 *offsets;
+    guint32 id;
+
+    if (!data)
+        return NULL;
+
+    desc = &reader->columns[column];
+    if (desc->type == YUM_COLUMN_TEXT) {
+        const ChunkDesc *chunk = READER_CHUNK (reader, reader->last_chunk);
+
+        offsets = (const guint32 *) data;
+        if (offsets[row] == YUM_COLUMN_NULL)
+            return NULL;
+
+        return data + ((gsize) chunk->n_rows + 1) * sizeof (guint32) +
+            offsets[row];
+    }
+
+    if (desc->type != YUM_COLUMN_STRING)
+        return NULL;
+
+    id = ((const guint32 *) data)[row];
+    if (id >= desc->dict_size)
+        return NULL;
+
+    offsets = (const guint32 *) READER_AT (reader, desc->dict_offset);
+    return (const char *) (offsets + desc->dict_size + 1) + offsets[id];
+}
+
+/*****************************************************************************/
+
+typedef enum {
+    EXPORT_PRIMARY,
+    EXPORT_FILELISTS,
+    EXPORT_OTHER
+} ExportType;
+
+enum {
+    DEP_REQUIRES,
+    DEP_PROVIDES,
+    DEP_CONFLICTS,
+    DEP_OBSOLETES,
+    DEP_SUGGESTS,
+    DEP_ENHANCES,
+    DEP_RECOMMENDS,
+    DEP_SUPPLEMENTS,
+    DEP_LAST
+};
+
+static const char *dep_tables[] = {
+    "requires", "provides", "conflicts", "obsoletes",
+    "suggests", "enhances", "recommends", "supplements"
+};
+
+struct _YumColumnExport {
+    ExportType type;
+    guint64 n_packages;
+
+    YumColumnFile *packages;
+    YumColumnFile *deps[DEP_LAST];
+    YumColumnFile *files;
+    YumColumnFile *changelog;
+};
+
+/* Dictionaries for values that recur across rows, text for the
+   checksums, descriptions, paths and changelog entries that mostly
+   don't, which would only grow the dictionary */
+#define S YUM_COLUMN_STRING
+#define T YUM_COLUMN_TEXT
+#define I YUM_COLUMN_INT
+
+static const char *primary_package_names[] = {
+    "pkgId", "name", "arch", "version", "epoch", "release", "summary",
+    "description", "url", "time_file", "time_build", "rpm_license",
+    "rpm_vendor", "rpm_group", "rpm_buildhost", "rpm_sourcerpm",
+    "rpm_header_start", "rpm_header_end", "rpm_packager", "size_package",
+    "size_installed", "size_archive", "location_href", "location_base",
+    "checksum_type"
+};
+static const YumColumnType primary_package_types[] = {
+    T, S, S, S, S, S, T, T, S, I, I, S, S, S, S, S, I, I, S, I, I, I, T, S, S
+};
+
+static const char *package_names[] = {
+    "pkgId", "name", "arch", "version", "epoch", "release"
+};
+static const YumColumnType package_types[] = { T, S, S, S, S, S };
+
+static const char *dep_names[] = {
+    "pkg", "name", "flags", "epoch", "version", "release", "pre"
+};
+static const YumColumnType dep_types[] = { I, S, S, S, S, S, I };
+
+static const char *file_names[] = { "pkg", "name", "type" };
+static const YumColumnType file_types[] = { I, T, S };
+
+static const char *changelog_names[] = { "pkg", "author", "date", "changelog" };
+static const YumColumnType changelog_types[] = { I, S, I, T };
+
+#undef S
+#undef T
+#undef I
+
+static YumColumnFile *
+export_file_new (const char *dir,
+                 const char *entity,
+                 const char **names,
+                 const YumColumnType *types,
+                 guint n_columns,
+                 GError **err)
+{
+    YumColumnFile *file;
+    char *basename;
+    char *path;
+
+    basename = g_strconcat (entity, ".col", NULL);
+    path = g_build_filename (dir, basename, NULL);
+    file = yum_column_file_new (path, names, types, n_columns, err);
+    g_free (path);
+    g_free (basename);
+
+    return file;
+}
+
+static YumColumnExport *
+export_new (ExportType type, const char *dir, GError **err)
+{
+    YumColumnExport *export;
+    int i;
+
+    export = g_new0 (YumColumnExport, 1);
+    export->type = type;
+
+    if (type == EXPORT_PRIMARY)
+        export->packages = export_file_new (dir, "packages",
+                                            primary_package_names,
+                                            primary_package_types,
+                                            G_N_ELEMENTS (primary_package_names),
+                                            err);
+    else
+        export->packages = export_file_new (dir, "packages",
+                                            package_names, package_types,
+                                            G_N_ELEMENTS (package_names),
+                                            err);
+    if (*err)
+        goto error;
+
+    if (type == EXPORT_PRIMARY) {
+        for (i = 0; i < DEP_LAST; i++) {
+            export->deps[i] = export_file_new (dir, dep_tables[i],
+                                               dep_names, dep_types,
+                                               G_N_ELEMENTS (dep_names),
+                                               err);
+            if (*err)
+                goto error;
+        }
+    }
+
+    if (type == EXPORT_PRIMARY || type == EXPORT_FILELISTS) {
+        export->files = export_file_new (dir, "files",
+                                         file_names, file_types,
+                                         G_N_ELEMENTS (file_names), err);
+        if (*err)
+            goto error;
+    }
+
+    if (type == EXPORT_OTHER) {
+        export->changelog = export_file_new (dir, "changelog",
+                                             changelog_names, changelog_types,
+                                             G_N_ELEMENTS (changelog_names),
+                                             err);
+        if (*err)
+            goto error;
+    }
+
+    return export;
+
+ error:
+    yum_column_export_close (export, NULL);
+    return NULL;
+}
+
+YumColumnExport *
+yum_column_export_primary_new (const char *dir, GError **err)
+{
+    return export_new (EXPORT_PRIMARY, dir, err);
+}
+
+YumColumnExport *
+yum_column_export_filelists_new (const char *dir, GError **err)
+{
+    return export_new (EXPORT_FILELISTS, dir, err);
+}
+
+YumColumnExport *
+yum_column_export_other_new (const char *dir, GError **err)
+{
+    return export_new (EXPORT_OTHER, dir, err);
+}
+
+static void
+export_primary_package (YumColumnFile *file, Package *p)
+{
+    yum_column_file_set_string (file, 0,  p->pkgId);
+    yum_column_file_set_string (file, 1,  p->name);
+    yum_column_file_set_string (file, 2,  p->arch);
+    yum_column_file_set_string (file, 3,  p->version);
+    yum_column_file_set_string (file, 4,  p->epoch);
+    yum_column_file_set_string (file, 5,  p->release);
+    yum_column_file_set_string (file, 6,  p->summary);
+    yum_column_file_set_string (file, 7,  p->description);
+    yum_column_file_set_string (file, 8,  p->url);
+    yum_column_file_set_int    (file, 9,  p->time_file);
+    yum_column_file_set_int    (file, 10, p->time_build);
+    yum_column_file_set_string (file, 11, p->rpm_license);
+    yum_column_file_set_string (file, 12, p->rpm_vendor);
+    yum_column_file_set_string (file, 13, p->rpm_group);
+    yum_column_file_set_string (file, 14, p->rpm_buildhost);
+    yum_column_file_set_string (file, 15, p->rpm_sourcerpm);
+    yum_column_file_set_int    (file, 16, p->rpm_header_start);
+    yum_column_file_set_int    (file, 17, p->rpm_header_end);
+    yum_column_file_set_string (file, 18, p->rpm_packager);
+    yum_column_file_set_int    (file, 19, p->size_package);
+    yum_column_file_set_int    (file, 20, p->size_installed);
+    yum_column_file_set_int    (file, 21, p->size_archive);
+    yum_column_file_set_string (file, 22, p->location_href);
+    yum_column_file_set_string (file, 23, p->location_base);
+    yum_column_file_set_string (file, 24, p->checksum_type);
+}
+
+static void
+export_deps (YumColumnFile *file, gint64 pkg, GSList *deps, GError **err)
+{
+    GSList *iter;
+
+    for (iter = deps; iter && !*err; iter = iter->next) {
+        Dependency *dep = (Dependency *) iter->data;
+
+        yum_column_file_set_int    (file, 0, pkg);
+        yum_column_file_set_string (file, 1, dep->name);
+        yum_column_file_set_string (file, 2, dep->flags);
+        yum_column_file_set_string (file, 3, dep->epoch);
+        yum_column_file_set_string (file, 4, dep->version);
+        yum_column_file_set_string (file, 5, dep->release);
+        yum_column_file_set_int    (file, 6, dep->pre);
+        yum_column_file_next_row (file, err);
+    }
+}
+
+void
+yum_column_export_package (YumColumnExport *export, Package *p, GError **err)
+{
+    gint64 pkg = export->n_packages;
+    GSList *iter;
+
+    if (export->type == EXPORT_PRIMARY)
+        export_primary_package (export->packages, p);
+    else {
+        yum_column_file_set_string (export->packages, 0, p->pkgId);
+        yum_column_file_set_string (export->packages, 1, p->name);
+        yum_column_file_set_string (export->packages, 2, p->arch);
+        yum_column_file_set_string (export->packages, 3, p->version);
+        yum_column_file_set_string (export->packages, 4, p->epoch);
+        yum_column_file_set_string (export->packages, 5, p->release);
+    }
+    yum_column_file_next_row (export->packages, err);
+    if (*err)
+        return;
+
+    export->n_packages++;
+
+    if (export->type == EXPORT_PRIMARY) {
+        export_deps (export->deps[DEP_REQUIRES], pkg, p->requires, err);
+        export_deps (export->deps[DEP_PROVIDES], pkg, p->provides, err);
+        export_deps (export->deps[DEP_CONFLICTS], pkg, p->conflicts, err);
+        export_deps (export->deps[DEP_OBSOLETES], pkg, p->obsoletes, err);
+        export_deps (export->deps[DEP_SUGGESTS], pkg, p->suggests, err);
+        export_deps (export->deps[DEP_ENHANCES], pkg, p->enhances, err);
+        export_deps (export->deps[DEP_RECOMMENDS], pkg, p->recommends, err);
+        export_deps (export->deps[DEP_SUPPLEMENTS], pkg, p->supplements, err);
+    }
+
+    for (iter = export->files ? p->files : NULL;
+         iter && !*err; iter = iter->next) {
+        PackageFile *file = (PackageFile *) iter->data;
+
+        yum_column_file_set_int    (export->files, 0, pkg);
+        yum_column_file_set_string (export->files, 1, file->name);
+        yum_column_file_set_string (export->files, 2, file->type);
+        yum_column_file_next_row (export->files, err);
+    }
+
+    for (iter = export->changelog ? p->changelogs : NULL;
+         iter && !*err; iter = iter->next) {
+        ChangelogEntry *entry = (ChangelogEntry *) iter->data;
+
+        yum_column_file_set_int    (export->changelog, 0, pkg);
+        yum_column_file_set_string (export->changelog, 1, entry->author);
+        yum_column_file_set_int    (export->changelog, 2, entry->date);
+        yum_column_file_set_string (export->changelog, 3, entry->changelog);
+        yum_column_file_next_row (export->changelog, err);
+    }
+}
+
+guint64
+yum_column_export_count (YumColumnExport *export)
+{
+    return export->n_packages;
+}
+
+static void
+export_file_close (YumColumnFile *file, GError **err)
+{
+    if (!file)
+        return;
+
+    /* After the first error the remaining files are discarded */
+    if (err && *err)
+        yum_column_file_close (file, NULL);
+    else
+        yum_column_file_close (file, err);
+}
+
+/* Finishes and frees the export; with err == NULL the files are
+   discarded instead */
+void
+yum_column_export_close (YumColumnExport *export, GError **err)
+{
+    int i;
+
+    export_file_close (export->packages, err);
+    for (i = 0; i < DEP_LAST; i++)
+        export_file_close (export->deps[i], err);
+    export_file_close (export->files, err);
+    export_file_close (export->changelog, err);
+
+    g_free (export);
+}
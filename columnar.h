@@ -0,0 +1,108 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef __YUM_COLUMNAR_H__
+#define __YUM_COLUMNAR_H__
+
+#include <glib.h>
+#include "package.h"
+
+/* Columnar export of parsed metadata, one file per entity (packages,
+ * requires, files, changelog, ...).  Rows are written in chunks of at
+ * most YUM_COLUMN_CHUNK_ROWS, fewer once the text of a chunk passes
+ * YUM_COLUMN_CHUNK_TEXT bytes; inside a chunk every column is stored
+ * as one contiguous array, so a scan of a column never touches the
+ * others.  Integer columns are arrays of gint64.  String columns of
+ * recurring values (names, versions, licenses, ...) are arrays of
+ * guint32 ids into a per-column dictionary, text columns of mostly
+ * unique values (checksums, descriptions, paths, ...) keep their bytes
+ * in the chunk, behind an array of guint32 offsets; YUM_COLUMN_NULL
+ * stands for NULL in both.  Entity rows refer to their package by its
+ * row number in packages.col.  The on-disk layout is described in
+ * columnar.c. */
+
+#define YUM_COLUMN_VERSION 2
+#define YUM_COLUMN_CHUNK_ROWS 65536
+#define YUM_COLUMN_CHUNK_TEXT (64 * 1024 * 1024)
+#define YUM_COLUMN_NULL G_MAXUINT32
+
+#define YUM_COLUMN_ERROR yum_column_error_quark()
+GQuark yum_column_error_quark (void);
+
+typedef enum {
+    YUM_COLUMN_INT = 1,
+    YUM_COLUMN_STRING = 2,
+    YUM_COLUMN_TEXT = 3
+} YumColumnType;
+
+typedef struct _YumColumnFile YumColumnFile;
+typedef struct _YumColumnReader YumColumnReader;
+typedef struct _YumColumnExport YumColumnExport;
+
+YumColumnFile   *yum_column_file_new        (const char *path,
+                                             const char **names,
+                                             const YumColumnType *types,
+                                             guint n_columns,
+                                             GError **err);
+void             yum_column_file_set_int    (YumColumnFile *file,
+                                             guint column,
+                                             gint64 value);
+void             yum_column_file_set_string (YumColumnFile *file,
+                                             guint column,
+                                             const char *value);
+void             yum_column_file_next_row   (YumColumnFile *file,
+                                             GError **err);
+void             yum_column_file_close      (YumColumnFile *file,
+                                             GError **err);
+
+/* A file written by YumColumnFile, mapped and checked so that no value
+ * is read from outside it.  Strings point into the mapping and stay
+ * valid until yum_column_reader_close(); a value of the other type, or
+ * a bad column or row, reads as 0 or NULL. */
+
+YumColumnReader *yum_column_reader_open      (const char *path,
+                                              GError **err);
+void             yum_column_reader_close     (YumColumnReader *reader);
+guint            yum_column_reader_n_columns (YumColumnReader *reader);
+guint64          yum_column_reader_n_rows    (YumColumnReader *reader);
+const char      *yum_column_reader_name      (YumColumnReader *reader,
+                                              guint column);
+YumColumnType    yum_column_reader_type      (YumColumnReader *reader,
+                                              guint column);
+gint64           yum_column_reader_get_int   (YumColumnReader *reader,
+                                              guint column,
+                                              guint64 row);
+const char      *yum_column_reader_get_string (YumColumnReader *reader,
+                                               guint column,
+                                               guint64 row);
+
+/* Per metadata type exporters; feed them from the parser's PackageFn */
+
+YumColumnExport *yum_column_export_primary_new   (const char *dir,
+                                                  GError **err);
+YumColumnExport *yum_column_export_filelists_new (const char *dir,
+                                                  GError **err);
+YumColumnExport *yum_column_export_other_new     (const char *dir,
+                                                  GError **err);
+void             yum_column_export_package       (YumColumnExport *export,
+                                                  Package *p,
+                                                  GError **err);
+guint64          yum_column_export_count         (YumColumnExport *export);
+void             yum_column_export_close         (YumColumnExport *export,
+                                                  GError **err);
+
+#endif /* __YUM_COLUMNAR_H__ */
@@ -15,15 +15,120 @@
  * 02111-1307, USA.
  */
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include "db.h"
+#include "text-codec.h"
+#include "sql-functions.h"
 
 /*  We have a lot of code so we can "quickly" update the .sqlite file using
  * the old .sqlite data and the new .xml data. However it seems to have weird
  * edge cases where it doesn't work, rhbz 465898 etc. ... so we turn it off. */
 #define YMP_CONFIG_UPDATE_DB 0
 
+/* Fixed page size so that the same metadata always produces the same
+ * database file, whatever the compiled-in sqlite default is. */
+#define YMP_CONFIG_PAGE_SIZE 4096
+
+/* Rows per multi-row INSERT of a YumDbBatch, lowered when the compiled-in
+ * sqlite allows fewer host parameters per statement. */
+#define YMP_CONFIG_BATCH_ROWS 64
+
+/* Upper bound for the sorter threads of the bulk profile */
+#define YMP_CONFIG_SORT_THREADS 4
+
+/* Bytes of text a YUM_DB_COMPRESS_TEXT dictionary is trained on */
+#define YMP_CONFIG_TEXT_SAMPLES (4 * 1024 * 1024)
+
+/* Connection settings while a cache is built (build) and once it is
+ * complete (done).  The bulk profile keeps the rollback journal in
+ * memory: an interrupted or failed build still rolls back, but after a
+ * crash the file may be unusable.  So its builds are not resumable: they
+ * leave no checkpoint, and one they find is ignored and the file rebuilt
+ * from scratch. */
+struct _YumDbProfile {
+    const char *name;
+    const char *build;
+    gboolean sort_threads;
+    gboolean resumable;
+    const char *done;
+};
+
+static const YumDbProfile db_profiles[] = {
+    { "default",
+      "PRAGMA synchronous = 0",
+      FALSE,
+      TRUE,
+      NULL },
+    { "bulk",
+      "PRAGMA synchronous = 0;"
+      "PRAGMA journal_mode = MEMORY;"
+      "PRAGMA cache_size = -131072;"
+      "PRAGMA temp_store = MEMORY;"
+      "PRAGMA mmap_size = 268435456",
+      TRUE,
+      FALSE,
+      "PRAGMA journal_mode = DELETE;"
+      "PRAGMA cache_size = -2000;"
+      "PRAGMA temp_store = DEFAULT;"
+      "PRAGMA mmap_size = 0;"
+      "PRAGMA threads = 0" },
+};
+
+const YumDbProfile *
+yum_db_profile_lookup (const char *name)
+{
+    guint i;
+
+    if (!name)
+        return &db_profiles[0];
+
+    for (i = 0; i < G_N_ELEMENTS (db_profiles); i++) {
+        if (!strcmp (db_profiles[i].name, name))
+            return &db_profiles[i];
+    }
+
+    return NULL;
+}
+
+static void
+db_profile_build (sqlite3 *db, const YumDbProfile *profile)
+{
+    if (!profile)
+        profile = &db_profiles[0];
+
+    sqlite3_exec (db, profile->build, NULL, NULL, NULL);
+
+    /* Used by the sorts of CREATE INDEX */
+    if (profile->sort_threads) {
+        char *sql;
+
+        sql = g_strdup_printf ("PRAGMA threads = %u",
+                               MIN (g_get_num_processors (),
+                                    YMP_CONFIG_SORT_THREADS));
+        sqlite3_exec (db, sql, NULL, NULL, NULL);
+        g_free (sql);
+    }
+}
+
+gboolean
+yum_db_profile_resumable (const YumDbProfile *profile)
+{
+    if (!profile)
+        profile = &db_profiles[0];
+
+    return profile->resumable;
+}
+
+void
+yum_db_profile_done (sqlite3 *db, const YumDbProfile *profile)
+{
+    if (profile && profile->done)
+        sqlite3_exec (db, profile->done, NULL, NULL, NULL);
+}
+
 GQuark
 yum_db_error_quark (void)
 {
@@ -35,75 +140,286 @@ yum_db_error_quark (void)
     return quark;
 }
 
-#define ENCODED_PACKAGE_FILE_FILES 2048
-#define ENCODED_PACKAGE_FILE_TYPES 60
+/* Filelist encoder.  Groups a package's files by directory into the
+ * (dirname, filenames, filetypes) rows of the filelist table.  Paths
+ * are split in place, files are grouped through an open addressing
+ * table and only the distinct directories are sorted.  All buffers are
+ * reused from one package to the next. */
+
+#define FILELIST_ENCODER_FILES 2048
+#define FILELIST_ENCODER_TYPES 64
+#define ENCODER_NONE G_MAXUINT32
 
 typedef struct {
+    const char *base;
+    guint32 next;
+    char type;
+} EncoderEntry;
+
+typedef struct {
+    const char *dir;
+    guint dir_len;
+    guint32 hash;
+    guint32 first;
+    guint32 last;
+} EncoderDir;
+
+struct _YumFilelistEncoder {
+    GArray *entries;
+    GArray *dirs;
+    guint32 *slots;
+    guint n_slots;
+    guint slots_allocated;
+
     GString *files;
     GString *types;
-} EncodedPackageFile;
 
-static EncodedPackageFile *
-encoded_package_file_new (void)
+    /* Only for paths g_path_get_dirname () has to take apart */
+    GStringChunk *odd_paths;
+
+    /* Repository wide directory dictionary, YUM_DB_FILELIST_DIRS only */
+    GHashTable *dir_ids;
+    GStringChunk *dir_names;
+    GString *dir_key;
+    sqlite3_stmt *dirs_handle;
+    gint64 next_dir_id;
+};
+
+YumFilelistEncoder *
+yum_db_filelist_encoder_new (void)
 {
-    EncodedPackageFile *enc;
+    YumFilelistEncoder *enc;
 
-    enc = g_new0 (EncodedPackageFile, 1);
-    enc->files = g_string_sized_new (ENCODED_PACKAGE_FILE_FILES);
-    enc->types = g_string_sized_new (ENCODED_PACKAGE_FILE_TYPES);
+    enc = g_new0 (YumFilelistEncoder, 1);
+    enc->entries = g_array_new (FALSE, FALSE, sizeof (EncoderEntry));
+    enc->dirs = g_array_new (FALSE, FALSE, sizeof (EncoderDir));
+    enc->files = g_string_sized_new (FILELIST_ENCODER_FILES);
+    enc->types = g_string_sized_new (FILELIST_ENCODER_TYPES);
+    enc->odd_paths = g_string_chunk_new (1024);
 
     return enc;
 }
 
+void
+yum_db_filelist_encoder_free (YumFilelistEncoder *enc)
+{
+    g_array_free (enc->entries, TRUE);
+    g_array_free (enc->dirs, TRUE);
+    g_free (enc->slots);
+    g_string_free (enc->files, TRUE);
+    g_string_free (enc->types, TRUE);
+    g_string_chunk_free (enc->odd_paths);
+    if (enc->dir_ids) {
+        g_hash_table_destroy (enc->dir_ids);
+        g_string_chunk_free (enc->dir_names);
+        g_string_free (enc->dir_key, TRUE);
+    }
+    g_free (enc);
+}
+
+/* Write dirIds instead of dirnames from now on, adding new directories
+   to the dirs table through dirs_handle.  Directories already in the
+   database (a resumed build) keep their ids. */
+void
+yum_db_filelist_encoder_use_dirs (YumFilelistEncoder *enc,
+                                  sqlite3 *db,
+                                  sqlite3_stmt *dirs_handle,
+                                  GError **err)
+{
+    const char *query;
+    sqlite3_stmt *handle = NULL;
+    int rc;
+
+    enc->dir_ids = g_hash_table_new (g_str_hash, g_str_equal);
+    enc->dir_names = g_string_chunk_new (64 * 1024);
+    enc->dir_key = g_string_sized_new (256);
+    enc->dirs_handle = dirs_handle;
+    enc->next_dir_id = 1;
+
+    query = "SELECT dirId, dirname FROM dirs";
+    rc = sqlite3_prepare (db, query, -1, &handle, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not read dirs: %s", sqlite3_errmsg (db));
+        goto cleanup;
+    }
+
+    while ((rc = sqlite3_step (handle)) == SQLITE_ROW) {
+        gint64 id = sqlite3_column_int64 (handle, 0);
+        char *name;
+
+        name = g_string_chunk_insert (enc->dir_names,
+                                      (const char *) sqlite3_column_text (handle, 1));
+        g_hash_table_insert (enc->dir_ids, name, GINT_TO_POINTER ((gint) id));
+        enc->next_dir_id = MAX (enc->next_dir_id, id + 1);
+    }
+
+    if (rc != SQLITE_DONE)
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Error reading dirs: %s", sqlite3_errmsg (db));
+
+ cleanup:
+    if (handle)
+        sqlite3_finalize (handle);
+}
+
 static void
-encoded_package_file_free (EncodedPackageFile *file)
+encoder_split_path (YumFilelistEncoder *enc,
+                    const char *path,
+                    const char **dir,
+                    guint *dir_len,
+                    const char **base)
+{
+    const char *slash;
+    const char *dir_end;
+
+    slash = strrchr (path, '/');
+
+    /* No directory part, a trailing slash or an empty name: same result
+       as g_path_get_dirname () and g_path_get_basename () */
+    if (!slash || slash[1] == '\0') {
+        char *d = g_path_get_dirname (path);
+        char *b = g_path_get_basename (path);
+
+        *dir = g_string_chunk_insert (enc->odd_paths, d);
+        *dir_len = strlen (d);
+        *base = g_string_chunk_insert (enc->odd_paths, b);
+
+        g_free (d);
+        g_free (b);
+        return;
+    }
+
+    *base = slash + 1;
+
+    /* Collapse repeated separators, but keep the root */
+    dir_end = slash;
+    while (dir_end > path && dir_end[-1] == '/')
+        dir_end--;
+
+    *dir = path;
+    *dir_len = dir_end > path ? dir_end - path : 1;
+}
+
+static guint32
+encoder_hash (const char *s, guint len)
 {
-    g_string_free (file->files, TRUE);
-    g_string_free (file->types, TRUE);
-    g_free (file);
+    guint32 hash = 2166136261U;
+    guint i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= (guchar) s[i];
+        hash *= 16777619U;
+    }
+
+    return hash;
 }
 
-static GHashTable *
-package_files_to_hash (GSList *files)
+/* Index of the directory in enc->dirs, added if needed */
+static guint32
+encoder_lookup_dir (YumFilelistEncoder *enc, const char *dir, guint dir_len)
 {
-    GHashTable *hash;
-    GSList *iter;
-    PackageFile *file;
-    EncodedPackageFile *enc;
-    char *dir;
-    char *name;
+    guint32 hash = encoder_hash (dir, dir_len);
+    guint mask = enc->n_slots - 1;
+    guint i = hash & mask;
+    EncoderDir new_dir;
 
-    hash = g_hash_table_new_full (g_str_hash, g_str_equal,
-                                  (GDestroyNotify) g_free,
-                                  (GDestroyNotify) encoded_package_file_free);
+    while (enc->slots[i] != ENCODER_NONE) {
+        EncoderDir *d = &g_array_index (enc->dirs, EncoderDir, enc->slots[i]);
 
-    for (iter = files; iter; iter = iter->next) {
-        file = (PackageFile *) iter->data;
+        if (d->hash == hash && d->dir_len == dir_len &&
+            !memcmp (d->dir, dir, dir_len))
+            return enc->slots[i];
 
-        dir = g_path_get_dirname (file->name);
-        name = g_path_get_basename (file->name);
+        i = (i + 1) & mask;
+    }
 
-        enc = (EncodedPackageFile *) g_hash_table_lookup (hash, dir);
-        if (!enc) {
-            enc = encoded_package_file_new ();
-            g_hash_table_insert (hash, dir, enc);
-        } else
-            g_free (dir);
+    new_dir.dir = dir;
+    new_dir.dir_len = dir_len;
+    new_dir.hash = hash;
+    new_dir.first = ENCODER_NONE;
+    new_dir.last = ENCODER_NONE;
 
-        if (enc->files->len)
-            g_string_append_c (enc->files, '/');
-        g_string_append (enc->files, name);
-        g_free (name);
+    enc->slots[i] = enc->dirs->len;
+    g_array_append_val (enc->dirs, new_dir);
+
+    return enc->slots[i];
+}
+
+static int
+encoder_dir_cmp (const void *a, const void *b)
+{
+    const EncoderDir *x = (const EncoderDir *) a;
+    const EncoderDir *y = (const EncoderDir *) b;
+    int cmp;
+
+    cmp = memcmp (x->dir, y->dir, MIN (x->dir_len, y->dir_len));
+    if (cmp == 0 && x->dir_len != y->dir_len)
+        cmp = x->dir_len < y->dir_len ? -1 : 1;
+
+    return cmp;
+}
+
+static void
+encoder_add_files (YumFilelistEncoder *enc, GSList *files)
+{
+    GSList *iter;
+    guint n_files;
+    guint n_slots;
+
+    g_array_set_size (enc->entries, 0);
+    g_array_set_size (enc->dirs, 0);
+    g_string_chunk_clear (enc->odd_paths);
+
+    /* Keep the table at most half full, and only clear as much of it as
+       this package needs */
+    n_files = g_slist_length (files);
+    for (n_slots = 16; n_slots < n_files * 2; n_slots *= 2)
+        ;
+    if (n_slots > enc->slots_allocated) {
+        g_free (enc->slots);
+        enc->slots = g_new (guint32, n_slots);
+        enc->slots_allocated = n_slots;
+    }
+    enc->n_slots = n_slots;
+    memset (enc->slots, 0xff, n_slots * sizeof (guint32));
+
+    for (iter = files; iter; iter = iter->next) {
+        PackageFile *file = (PackageFile *) iter->data;
+        EncoderEntry entry;
+        EncoderDir *dir;
+        const char *dir_name;
+        guint dir_len;
+        guint32 index;
+        guint32 index_dir;
+
+        encoder_split_path (enc, file->name, &dir_name, &dir_len, &entry.base);
+        entry.next = ENCODER_NONE;
 
         if (!strcmp (file->type, "dir"))
-            g_string_append_c (enc->types, 'd');
+            entry.type = 'd';
         else if (!strcmp (file->type, "file"))
-            g_string_append_c (enc->types, 'f');
+            entry.type = 'f';
         else if (!strcmp (file->type, "ghost"))
-            g_string_append_c (enc->types, 'g');
+            entry.type = 'g';
+        else
+            entry.type = '\0';
+
+        index = enc->entries->len;
+        g_array_append_val (enc->entries, entry);
+
+        /* Files of a directory stay in list order */
+        index_dir = encoder_lookup_dir (enc, dir_name, dir_len);
+        dir = &g_array_index (enc->dirs, EncoderDir, index_dir);
+        if (dir->last == ENCODER_NONE)
+            dir->first = index;
+        else
+            g_array_index (enc->entries, EncoderEntry, dir->last).next = index;
+        dir->last = index;
     }
 
-    return hash;
+    qsort (enc->dirs->data, enc->dirs->len, sizeof (EncoderDir),
+           encoder_dir_cmp);
 }
 
 char *
@@ -119,19 +435,61 @@ typedef enum {
     DB_STATUS_OK,
     DB_STATUS_VERSION_MISMATCH,
     DB_STATUS_CHECKSUM_MISMATCH,
+    DB_STATUS_OPTIONS_MISMATCH,
+    DB_STATUS_PARTIAL,
     DB_STATUS_ERROR
 } DBStatus;
 
+/* An interrupted build of the same metadata can be resumed if it left
+   a checkpoint behind */
+static DBStatus
+checkpoint_status (sqlite3 *db, const char *checksum, guint options)
+{
+    const char *query;
+    int rc;
+    sqlite3_stmt *handle = NULL;
+    DBStatus status = DB_STATUS_ERROR;
+
+    query = "SELECT dbversion, checksum, options FROM db_checkpoint";
+    rc = sqlite3_prepare (db, query, -1, &handle, NULL);
+    if (rc != SQLITE_OK)
+        goto cleanup;
+
+    if (sqlite3_step (handle) == SQLITE_ROW) {
+        int dbversion;
+        const char *dbchecksum;
+
+        dbversion  = sqlite3_column_int  (handle, 0);
+        dbchecksum = (const char *) sqlite3_column_text (handle, 1);
+
+        if (dbversion == YUM_SQLITE_CACHE_DBVERSION &&
+            !strcmp (checksum, dbchecksum) &&
+            (guint) sqlite3_column_int (handle, 2) == options)
+            status = DB_STATUS_PARTIAL;
+    }
+
+ cleanup:
+    if (handle)
+        sqlite3_finalize (handle);
+
+    return status;
+}
+
 static DBStatus
-dbinfo_status (sqlite3 *db, const char *checksum)
+dbinfo_status (sqlite3 *db, const char *checksum, guint options)
 {
     const char *query;
     int rc;
     sqlite3_stmt *handle = NULL;
     DBStatus status = DB_STATUS_ERROR;
 
-    query = "SELECT dbversion, checksum FROM db_info";
+    query = "SELECT dbversion, checksum, options FROM db_info";
     rc = sqlite3_prepare (db, query, -1, &handle, NULL);
+    if (rc != SQLITE_OK) {
+        /* Caches from before schema options were added */
+        query = "SELECT dbversion, checksum, 0 FROM db_info";
+        rc = sqlite3_prepare (db, query, -1, &handle, NULL);
+    }
     if (rc != SQLITE_OK)
         goto cleanup;
 
@@ -149,12 +507,19 @@ dbinfo_status (sqlite3 *db, const char *checksum)
         } else if (strcmp (checksum, dbchecksum)) {
             g_message ("sqlite cache needs updating, reading in metadata");
             status = DB_STATUS_CHECKSUM_MISMATCH;
+        } else if ((guint) sqlite3_column_int (handle, 2) != options) {
+            g_message ("sqlite cache was built with other options, will regenerate");
+            status = DB_STATUS_OPTIONS_MISMATCH;
         } else
             status = DB_STATUS_OK;
 
         break;
     }
 
+    /* No db_info row, the last build did not finish */
+    if (rc == SQLITE_DONE && status == DB_STATUS_ERROR)
+        status = checkpoint_status (db, checksum, options);
+
  cleanup:
     if (handle)
         sqlite3_finalize (handle);
@@ -168,7 +533,8 @@ yum_db_create_dbinfo_table (sqlite3 *db, GError **err)
     int rc;
     const char *sql;
 
-    sql = "CREATE TABLE db_info (dbversion INTEGER, checksum TEXT)";
+    sql = "CREATE TABLE db_info (dbversion INTEGER, checksum TEXT,"
+        " options INTEGER)";
     rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
     if (rc != SQLITE_OK) {
         g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
@@ -177,22 +543,47 @@ yum_db_create_dbinfo_table (sqlite3 *db, GError **err)
     }
 }
 
+static void
+yum_db_create_checkpoint_table (sqlite3 *db, GError **err)
+{
+    int rc;
+    const char *sql;
+
+    sql = "CREATE TABLE db_checkpoint (dbversion INTEGER, checksum TEXT,"
+        " options INTEGER, packages INTEGER)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create db_checkpoint table: %s",
+                     sqlite3_errmsg (db));
+    }
+}
+
 sqlite3 *
 yum_db_open (const char *path,
              const char *checksum,
+             guint options,
+             const YumDbProfile *profile,
              CreateTablesFn create_tables,
              GError **err)
 {
     int rc;
     sqlite3 *db = NULL;
     gboolean db_existed;
+    char *sql;
 
     db_existed = g_file_test (path, G_FILE_TEST_EXISTS);
 
     rc = sqlite3_open (path, &db);
     if (rc == SQLITE_OK) {
         if (db_existed) {
-            DBStatus status = dbinfo_status (db, checksum);
+            DBStatus status = dbinfo_status (db, checksum, options);
+
+            /* The interrupted build may have been a bulk one that crashed,
+               or this one may crash and leave the checkpoint behind */
+            if (status == DB_STATUS_PARTIAL &&
+                !yum_db_profile_resumable (profile))
+                status = DB_STATUS_ERROR;
 
             switch (status) {
             case DB_STATUS_OK:
@@ -200,15 +591,21 @@ yum_db_open (const char *path,
                 sqlite3_close (db);
                 return NULL;
                 break;
+            case DB_STATUS_PARTIAL:
+                g_message ("Resuming interrupted sqlite cache build");
+                db_profile_build (db, profile);
+                return db;
+                break;
             case DB_STATUS_CHECKSUM_MISMATCH:
                 if (YMP_CONFIG_UPDATE_DB) {
-                    sqlite3_exec (db, "PRAGMA synchronous = 0", NULL,NULL,NULL);
+                    db_profile_build (db, profile);
                     sqlite3_exec (db, "DELETE FROM db_info", NULL, NULL, NULL);
                     return db;
                     break;
                 }
                 /* FALL THROUGH */
             case DB_STATUS_VERSION_MISMATCH:
+            case DB_STATUS_OPTIONS_MISMATCH:
             case DB_STATUS_ERROR:
                 sqlite3_close (db);
                 db = NULL;
@@ -234,15 +631,32 @@ yum_db_open (const char *path,
         }
     }
 
+    /* Must be set before the first table is created */
+    sql = g_strdup_printf ("PRAGMA page_size = %d", YMP_CONFIG_PAGE_SIZE);
+    sqlite3_exec (db, sql, NULL, NULL, NULL);
+    g_free (sql);
+    sqlite3_exec (db, "PRAGMA auto_vacuum = NONE", NULL, NULL, NULL);
+    sqlite3_exec (db, "PRAGMA encoding = \"UTF-8\"", NULL, NULL, NULL);
+
+    /* Before the schema, which is created in one transaction: a commit
+       per table with a synced journal costs more than building a small
+       repository */
+    db_profile_build (db, profile);
+    sqlite3_exec (db, "BEGIN", NULL, NULL, NULL);
+
     yum_db_create_dbinfo_table (db, err);
     if (*err)
         goto cleanup;
 
+    yum_db_create_checkpoint_table (db, err);
+    if (*err)
+        goto cleanup;
+
     create_tables (db, err);
     if (*err)
         goto cleanup;
 
-    sqlite3_exec (db, "PRAGMA synchronous = 0", NULL, NULL, NULL);
+    sqlite3_exec (db, "COMMIT", NULL, NULL, NULL);
 
  cleanup:
     if (*err && db) {
@@ -254,14 +668,21 @@ yum_db_open (const char *path,
 }
 
 void
-yum_db_dbinfo_update (sqlite3 *db, const char *checksum, GError **err)
+yum_db_dbinfo_update (sqlite3 *db,
+                      const char *checksum,
+                      guint options,
+                      GError **err)
 {
     int rc;
     char *sql;
 
+    /* The build is complete, nothing left to resume */
+    sqlite3_exec (db, "DELETE FROM db_checkpoint", NULL, NULL, NULL);
+
     sql = g_strdup_printf
-        ("INSERT INTO db_info (dbversion, checksum) VALUES (%d, '%s')",
-         YUM_SQLITE_CACHE_DBVERSION, checksum);
+        ("INSERT INTO db_info (dbversion, checksum, options) "
+         "VALUES (%d, '%s', %u)",
+         YUM_SQLITE_CACHE_DBVERSION, checksum, options);
 
     rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
     if (rc != SQLITE_OK)
@@ -272,12 +693,83 @@ yum_db_dbinfo_update (sqlite3 *db, const char *checksum, GError **err)
     g_free (sql);
 }
 
-GHashTable *
-yum_db_read_package_ids (sqlite3 *db, GError **err)
+guint32
+yum_db_checkpoint_packages (sqlite3 *db)
+{
+    const char *query;
+    int rc;
+    sqlite3_stmt *handle = NULL;
+    guint32 packages = 0;
+
+    query = "SELECT packages FROM db_checkpoint";
+    rc = sqlite3_prepare (db, query, -1, &handle, NULL);
+    if (rc != SQLITE_OK)
+        goto cleanup;
+
+    if (sqlite3_step (handle) == SQLITE_ROW)
+        packages = sqlite3_column_int (handle, 0);
+
+ cleanup:
+    if (handle)
+        sqlite3_finalize (handle);
+
+    return packages;
+}
+
+void
+yum_db_checkpoint_update (sqlite3 *db,
+                          const char *checksum,
+                          guint options,
+                          guint32 packages,
+                          GError **err)
+{
+    int rc;
+    char *sql;
+
+    sql = g_strdup_printf
+        ("DELETE FROM db_checkpoint;"
+         "INSERT INTO db_checkpoint (dbversion, checksum, options, packages) "
+         "VALUES (%d, '%s', %u, %u)",
+         YUM_SQLITE_CACHE_DBVERSION, checksum, options, packages);
+
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK)
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not update db_checkpoint table: %s",
+                     sqlite3_errmsg (db));
+
+    g_free (sql);
+}
+
+/* The pkgKey the next package inserted will get */
+gint64
+yum_db_package_next_key (sqlite3 *db)
+{
+    const char *query;
+    int rc;
+    sqlite3_stmt *handle = NULL;
+    gint64 key = 1;
+
+    query = "SELECT MAX(pkgKey) FROM packages";
+    rc = sqlite3_prepare (db, query, -1, &handle, NULL);
+    if (rc != SQLITE_OK)
+        goto cleanup;
+
+    if (sqlite3_step (handle) == SQLITE_ROW)
+        key = sqlite3_column_int64 (handle, 0) + 1;
+
+ cleanup:
+    if (handle)
+        sqlite3_finalize (handle);
+
+    return key;
+}
+
+void
+yum_db_read_package_ids (sqlite3 *db, YumPkgIdSet *set, GError **err)
 {
     const char *query;
     int rc;
-    GHashTable *hash = NULL;
     sqlite3_stmt *handle = NULL;
 
     query = "SELECT pkgId, pkgKey FROM packages";
@@ -289,17 +781,15 @@ yum_db_read_package_ids (sqlite3 *db, GError **err)
         goto cleanup;
     }
 
-    hash = g_hash_table_new_full (g_str_hash, g_str_equal,
-                                  (GDestroyNotify) g_free, NULL);
-
     while ((rc = sqlite3_step (handle)) == SQLITE_ROW) {
-        char *pkgId;
+        const char *pkgId;
         gint pkgKey;
 
-        pkgId  = g_strdup ((char *) sqlite3_column_text  (handle, 0));
+        pkgId  = (const char *) sqlite3_column_text  (handle, 0);
         pkgKey = sqlite3_column_int (handle, 1);
 
-        g_hash_table_insert (hash, pkgId, GINT_TO_POINTER (pkgKey));
+        if (pkgId)
+            yum_pkgid_set_insert (set, pkgId, pkgKey);
     }
 
     if (rc != SQLITE_DONE)
@@ -310,74 +800,326 @@ yum_db_read_package_ids (sqlite3 *db, GError **err)
  cleanup:
     if (handle)
         sqlite3_finalize (handle);
+}
 
-    return hash;
+gboolean
+yum_db_is_database (const char *path)
+{
+    static const char magic[16] = "SQLite format 3";
+    char header[16];
+    FILE *file;
+    gboolean ret;
+
+    file = fopen (path, "rb");
+    if (!file)
+        return FALSE;
+
+    ret = fread (header, 1, sizeof (header), file) == sizeof (header) &&
+        !memcmp (header, magic, sizeof (magic));
+    fclose (file);
+
+    return ret;
 }
 
 void
-yum_db_create_primary_tables (sqlite3 *db, GError **err)
+yum_db_read_packages (const char *path,
+                      PackageFn package_fn,
+                      gpointer user_data,
+                      GError **err)
 {
+    sqlite3 *db = NULL;
+    sqlite3_stmt *handle = NULL;
+    const char *query;
+    Package p;
     int rc;
-    const char *sql;
-
-    sql =
-        "CREATE TABLE packages ("
-        "  pkgKey INTEGER PRIMARY KEY,"
-        "  pkgId TEXT,"
-        "  name TEXT,"
-        "  arch TEXT,"
-        "  version TEXT,"
-        "  epoch TEXT,"
-        "  release TEXT,"
-        "  summary TEXT,"
-        "  description TEXT,"
-        "  url TEXT,"
-        "  time_file INTEGER,"
-        "  time_build INTEGER,"
-        "  rpm_license TEXT,"
-        "  rpm_vendor TEXT,"
-        "  rpm_group TEXT,"
-        "  rpm_buildhost TEXT,"
-        "  rpm_sourcerpm TEXT,"
-        "  rpm_header_start INTEGER,"
-        "  rpm_header_end INTEGER,"
-        "  rpm_packager TEXT,"
-        "  size_package INTEGER,"
-        "  size_installed INTEGER,"
-        "  size_archive INTEGER,"
-        "  location_href TEXT,"
-        "  location_base TEXT,"
-        "  checksum_type TEXT)";
 
-    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    rc = sqlite3_open_v2 (path, &db, SQLITE_OPEN_READONLY, NULL);
     if (rc != SQLITE_OK) {
         g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
-                     "Can not create packages table: %s",
+                     "Can not open SQL database: %s",
                      sqlite3_errmsg (db));
-        return;
+        goto cleanup;
     }
 
-    sql =
-        "CREATE TABLE files ("
-        "  name TEXT,"
-        "  type TEXT,"
-        "  pkgKey INTEGER)";
-    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    /* Half built or interrupted caches lack packages */
+    query = "SELECT dbversion FROM db_info";
+    rc = sqlite3_prepare_v2 (db, query, -1, &handle, NULL);
+    if (rc == SQLITE_OK && sqlite3_step (handle) == SQLITE_ROW &&
+        sqlite3_column_int (handle, 0) == YUM_SQLITE_CACHE_DBVERSION)
+        rc = SQLITE_OK;
+    else
+        rc = SQLITE_ERROR;
+    sqlite3_finalize (handle);
+    handle = NULL;
     if (rc != SQLITE_OK) {
         g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
-                     "Can not create files table: %s",
-                     sqlite3_errmsg (db));
-        return;
+                     "%s is not a complete version %d cache",
+                     path, YUM_SQLITE_CACHE_DBVERSION);
+        goto cleanup;
     }
 
-    sql =
-        "CREATE TABLE %s ("
-        "  name TEXT,"
+    query = "SELECT pkgId, name, arch, epoch, version, release FROM packages";
+    rc = sqlite3_prepare (db, query, -1, &handle, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not prepare SQL clause: %s",
+                     sqlite3_errmsg (db));
+        goto cleanup;
+    }
+
+    memset (&p, 0, sizeof (Package));
+
+    while ((rc = sqlite3_step (handle)) == SQLITE_ROW) {
+        p.pkgId   = (char *) sqlite3_column_text (handle, 0);
+        p.name    = (char *) sqlite3_column_text (handle, 1);
+        p.arch    = (char *) sqlite3_column_text (handle, 2);
+        p.epoch   = (char *) sqlite3_column_text (handle, 3);
+        p.version = (char *) sqlite3_column_text (handle, 4);
+        p.release = (char *) sqlite3_column_text (handle, 5);
+
+        package_fn (&p, user_data);
+
+        /* Set by package_fn to stop */
+        if (*err)
+            goto cleanup;
+    }
+
+    if (rc != SQLITE_DONE)
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Error reading from SQL: %s",
+                     sqlite3_errmsg (db));
+
+ cleanup:
+    if (handle)
+        sqlite3_finalize (handle);
+    sqlite3_close (db);
+}
+
+/* YUM_DB_COMPRESS_TEXT: a long text column holds zstd frames, made with a
+ * dictionary the first build trains on it and keeps in zstd_dicts.  Rows
+ * are written as text like always; the end of every build packs those
+ * that still are, so yum_unpack () takes either. */
+
+static void
+text_dict_train (sqlite3 *db,
+                 const char *table,
+                 const char *column,
+                 GError **err)
+{
+    sqlite3_stmt *handle = NULL;
+    GString *samples;
+    GArray *sizes;
+    char *query;
+    char *dict = NULL;
+    gsize dict_len;
+    int rc;
+
+    samples = g_string_sized_new (YMP_CONFIG_TEXT_SAMPLES);
+    sizes = g_array_new (FALSE, FALSE, sizeof (gsize));
+
+    query = g_strdup_printf ("SELECT %s FROM %s WHERE typeof (%s) = 'text'",
+                             column, table, column);
+    rc = sqlite3_prepare (db, query, -1, &handle, NULL);
+    g_free (query);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not read %s samples: %s", column,
+                     sqlite3_errmsg (db));
+        goto cleanup;
+    }
+
+    while (samples->len < YMP_CONFIG_TEXT_SAMPLES &&
+           sqlite3_step (handle) == SQLITE_ROW) {
+        gsize len = sqlite3_column_bytes (handle, 0);
+
+        g_string_append_len (samples,
+                             (const char *) sqlite3_column_text (handle, 0),
+                             len);
+        g_array_append_val (sizes, len);
+    }
+
+    /* Too little text to learn from, frames go without one */
+    dict = yum_text_dict_train (samples->str, (gsize *) sizes->data,
+                                sizes->len, &dict_len);
+    if (!dict)
+        goto cleanup;
+
+    sqlite3_finalize (handle);
+    rc = sqlite3_prepare (db,
+                          "INSERT INTO zstd_dicts (dictId, dict) VALUES (?, ?)",
+                          -1, &handle, NULL);
+    if (rc == SQLITE_OK) {
+        sqlite3_bind_int64 (handle, 1, yum_text_dict_id (dict, dict_len));
+        sqlite3_bind_blob (handle, 2, dict, dict_len, SQLITE_STATIC);
+        rc = sqlite3_step (handle);
+    }
+    if (rc != SQLITE_DONE)
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not store text dictionary: %s",
+                     sqlite3_errmsg (db));
+
+ cleanup:
+    sqlite3_finalize (handle);
+    g_string_free (samples, TRUE);
+    g_array_free (sizes, TRUE);
+    g_free (dict);
+}
+
+static void
+pack_text (sqlite3 *db, const char *table, const char *column, GError **err)
+{
+    sqlite3_stmt *handle = NULL;
+    gboolean stored;
+    char *query;
+    int rc;
+
+    rc = sqlite3_exec (db,
+                       "CREATE TABLE IF NOT EXISTS zstd_dicts ("
+                       "  dictId INTEGER PRIMARY KEY,"
+                       "  dict BLOB)",
+                       NULL, NULL, NULL);
+    if (rc == SQLITE_OK)
+        rc = sqlite3_prepare_v2 (db, "SELECT 1 FROM zstd_dicts LIMIT 1", -1,
+                                 &handle, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create zstd_dicts table: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+    stored = (sqlite3_step (handle) == SQLITE_ROW);
+    sqlite3_finalize (handle);
+
+    /* Later builds keep the dictionary of the first one */
+    if (!stored) {
+        text_dict_train (db, table, column, err);
+        if (*err)
+            return;
+    }
+
+    query = g_strdup_printf ("UPDATE %s SET %s = yum_pack (%s) "
+                             "WHERE typeof (%s) = 'text'",
+                             table, column, column, column);
+    rc = sqlite3_exec (db, query, NULL, NULL, NULL);
+    g_free (query);
+    if (rc != SQLITE_OK)
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not compress %s: %s", column, sqlite3_errmsg (db));
+}
+
+void
+yum_db_pack_primary_text (sqlite3 *db, GError **err)
+{
+    pack_text (db, "packages", "description", err);
+}
+
+void
+yum_db_pack_other_text (sqlite3 *db, GError **err)
+{
+    pack_text (db, "changelog", "changelog", err);
+}
+
+/* YUM_DB_PRIMARY_CLUSTERED keeps the dependency and files tables in
+   (name, pkgKey) order, seq numbers the rows of a package to make the
+   key unique.  A build writes into <table>_stage heaps first, the index
+   step moves the rows over sorted, so the B-trees are built by
+   appending, and drops the heaps. */
+
+static const char *primary_row_tables[] = {
+    "files", "requires", "provides", "conflicts", "obsoletes", "suggests",
+    "enhances", "recommends", "supplements", NULL
+};
+
+static const char *
+primary_row_columns (const char *table)
+{
+    if (!strcmp (table, "files"))
+        return "name, type, pkgKey, seq";
+    if (!strcmp (table, "requires"))
+        return "name, flags, epoch, version, release, pkgKey, pre, seq";
+
+    return "name, flags, epoch, version, release, pkgKey, seq";
+}
+
+static void
+create_primary_tables (sqlite3 *db, gboolean clustered, GError **err)
+{
+    int rc;
+    const char *sql;
+    const char *not_null;
+    const char *key;
+    char *query;
+
+    sql =
+        "CREATE TABLE packages ("
+        "  pkgKey INTEGER PRIMARY KEY,"
+        "  pkgId TEXT,"
+        "  name TEXT,"
+        "  arch TEXT,"
+        "  version TEXT,"
+        "  epoch TEXT,"
+        "  release TEXT,"
+        "  summary TEXT,"
+        "  description TEXT,"
+        "  url TEXT,"
+        "  time_file INTEGER,"
+        "  time_build INTEGER,"
+        "  rpm_license TEXT,"
+        "  rpm_vendor TEXT,"
+        "  rpm_group TEXT,"
+        "  rpm_buildhost TEXT,"
+        "  rpm_sourcerpm TEXT,"
+        "  rpm_header_start INTEGER,"
+        "  rpm_header_end INTEGER,"
+        "  rpm_packager TEXT,"
+        "  size_package INTEGER,"
+        "  size_installed INTEGER,"
+        "  size_archive INTEGER,"
+        "  location_href TEXT,"
+        "  location_base TEXT,"
+        "  checksum_type TEXT)";
+
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create packages table: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+
+    if (clustered) {
+        not_null = " NOT NULL";
+        key =
+            ", seq INTEGER NOT NULL,"
+            "  PRIMARY KEY (name, pkgKey, seq)) WITHOUT ROWID";
+    } else {
+        not_null = "";
+        key = ")";
+    }
+
+    sql =
+        "CREATE TABLE files ("
+        "  name TEXT%s,"
+        "  type TEXT,"
+        "  pkgKey INTEGER%s%s";
+    query = g_strdup_printf (sql, not_null, not_null, key);
+    rc = sqlite3_exec (db, query, NULL, NULL, NULL);
+    g_free (query);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create files table: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+
+    sql =
+        "CREATE TABLE %s ("
+        "  name TEXT%s,"
         "  flags TEXT,"
         "  epoch TEXT,"
         "  version TEXT,"
         "  release TEXT,"
-        "  pkgKey INTEGER %s)";
+        "  pkgKey INTEGER%s %s%s";
 
     const char *deps[] = { "requires", "provides", "conflicts", "obsoletes",
 			   "suggests", "enhances", "recommends", "supplements", NULL };
@@ -385,14 +1127,14 @@ yum_db_create_primary_tables (sqlite3 *db, GError **err)
 
     for (i = 0; deps[i]; i++) {
         const char *prereq;
-        char *query;
 
         if (!strcmp(deps[i], "requires")) {
             prereq = ", pre BOOLEAN DEFAULT FALSE";
         } else
             prereq = "";
 
-        query = g_strdup_printf (sql, deps[i], prereq);
+        query = g_strdup_printf (sql, deps[i], not_null, not_null, prereq,
+                                 key);
         rc = sqlite3_exec (db, query, NULL, NULL, NULL);
         g_free (query);
 
@@ -428,11 +1170,88 @@ yum_db_create_primary_tables (sqlite3 *db, GError **err)
 }
 
 void
-yum_db_index_primary_tables (sqlite3 *db, GError **err)
+yum_db_create_primary_tables (sqlite3 *db, GError **err)
+{
+    create_primary_tables (db, FALSE, err);
+}
+
+void
+yum_db_create_primary_clustered_tables (sqlite3 *db, GError **err)
+{
+    create_primary_tables (db, TRUE, err);
+}
+
+/* Every build of the clustered layout writes into them, a resumed one
+   finds those of the interrupted build */
+void
+yum_db_stage_primary_tables (sqlite3 *db, GError **err)
+{
+    int rc;
+    int i;
+
+    for (i = 0; primary_row_tables[i]; i++) {
+        char *query;
+
+        /* Same columns, no key */
+        query = g_strdup_printf ("CREATE TABLE IF NOT EXISTS %s_stage AS "
+                                 "SELECT %s FROM %s LIMIT 0",
+                                 primary_row_tables[i],
+                                 primary_row_columns (primary_row_tables[i]),
+                                 primary_row_tables[i]);
+        rc = sqlite3_exec (db, query, NULL, NULL, NULL);
+        g_free (query);
+
+        if (rc != SQLITE_OK) {
+            g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                         "Can not create %s_stage table: %s",
+                         primary_row_tables[i], sqlite3_errmsg (db));
+            return;
+        }
+    }
+}
+
+/* Moves the staged rows in key order.  A row without a name has no place
+   in the key and fails the build. */
+static void
+merge_primary_stage_tables (sqlite3 *db, GError **err)
+{
+    int rc;
+    int i;
+
+    for (i = 0; primary_row_tables[i]; i++) {
+        const char *columns = primary_row_columns (primary_row_tables[i]);
+        char *query;
+
+        query = g_strdup_printf ("INSERT INTO %s (%s) SELECT %s FROM %s_stage "
+                                 "ORDER BY name, pkgKey, seq;"
+                                 "DROP TABLE %s_stage",
+                                 primary_row_tables[i], columns, columns,
+                                 primary_row_tables[i],
+                                 primary_row_tables[i]);
+        rc = sqlite3_exec (db, query, NULL, NULL, NULL);
+        g_free (query);
+
+        if (rc != SQLITE_OK) {
+            g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                         "Can not sort %s rows: %s",
+                         primary_row_tables[i], sqlite3_errmsg (db));
+            return;
+        }
+    }
+}
+
+static void
+index_primary_tables (sqlite3 *db, gboolean clustered, GError **err)
 {
     int rc;
     const char *sql;
 
+    if (clustered) {
+        merge_primary_stage_tables (db, err);
+        if (*err)
+            return;
+    }
+
     sql = "CREATE INDEX IF NOT EXISTS packagename ON packages (name)";
     rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
     if (rc != SQLITE_OK) {
@@ -451,8 +1270,9 @@ yum_db_index_primary_tables (sqlite3 *db, GError **err)
         return;
     }
 
+    /* The key leads with name in the clustered layout */
     sql = "CREATE INDEX IF NOT EXISTS filenames ON files (name)";
-    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    rc = clustered ? SQLITE_OK : sqlite3_exec (db, sql, NULL, NULL, NULL);
     if (rc != SQLITE_OK) {
         g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
                      "Can not create filenames index: %s",
@@ -490,7 +1310,7 @@ yum_db_index_primary_tables (sqlite3 *db, GError **err)
             return;
         }
 
-        if (i < 2) {
+        if (i < 2 && !clustered) {
             query = g_strdup_printf(nameindexsql, deps[i], deps[i]);
             rc = sqlite3_exec (db, query, NULL, NULL, NULL);
             g_free(query);
@@ -504,47 +1324,206 @@ yum_db_index_primary_tables (sqlite3 *db, GError **err)
     }
 }
 
-sqlite3_stmt *
-yum_db_package_prepare (sqlite3 *db, GError **err)
+void
+yum_db_index_primary_tables (sqlite3 *db, GError **err)
+{
+    index_primary_tables (db, FALSE, err);
+}
+
+void
+yum_db_index_primary_clustered_tables (sqlite3 *db, GError **err)
+{
+    index_primary_tables (db, TRUE, err);
+}
+
+/* YUM_DB_SEARCH_INDEX: an FTS5 table over text columns of another table,
+ * under the same rowids.  It keeps no copy of the text (content=''), so a
+ * trigger deletes rows from it with their old values.  Rows are added in
+ * bulk after a build has written its packages: those with a higher rowid
+ * than the index has seen yet, which also covers the packages of an
+ * interrupted build. */
+
+static void
+index_search_table (sqlite3 *db,
+                    const char *search,
+                    const char *table,
+                    const char *rowid,
+                    const char *columns,
+                    const char *old_columns,
+                    GError **err)
 {
+    char *sql;
     int rc;
-    sqlite3_stmt *handle = NULL;
-    const char *query;
 
-    query =
-        "INSERT INTO packages ("
-        "  pkgId, name, arch, version, epoch, release, summary, description,"
-        "  url, time_file, time_build, rpm_license, rpm_vendor, rpm_group,"
-        "  rpm_buildhost, rpm_sourcerpm, rpm_header_start, rpm_header_end,"
-        "  rpm_packager, size_package, size_installed, size_archive,"
-        "  location_href, location_base, checksum_type) "
-        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?,"
-        "  ?, ?, ?, ?, ?, ?, ?)";
+    sql = g_strdup_printf ("CREATE VIRTUAL TABLE IF NOT EXISTS %s "
+                           "USING fts5 (%s, content='', prefix='3')",
+                           search, columns);
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    g_free (sql);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create %s table: %s",
+                     search, sqlite3_errmsg (db));
+        return;
+    }
 
-    rc = sqlite3_prepare (db, query, -1, &handle, NULL);
+    sql = g_strdup_printf ("CREATE TRIGGER IF NOT EXISTS remove_%s "
+                           "AFTER DELETE ON %s"
+                           "  BEGIN"
+                           "    INSERT INTO %s (%s, rowid, %s)"
+                           "      VALUES ('delete', old.%s, %s);"
+                           "  END;",
+                           search, table, search, search, columns, rowid,
+                           old_columns);
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    g_free (sql);
     if (rc != SQLITE_OK) {
         g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
-                     "Can not prepare packages insertion: %s",
-                     sqlite3_errmsg (db));
-        sqlite3_finalize (handle);
-        handle = NULL;
+                     "Can not create remove_%s trigger: %s",
+                     search, sqlite3_errmsg (db));
+        return;
     }
 
-    return handle;
+    sql = g_strdup_printf ("INSERT INTO %s (rowid, %s)"
+                           "  SELECT %s, %s FROM %s WHERE %s > "
+                           "    coalesce ((SELECT rowid FROM %s"
+                           "               ORDER BY rowid DESC LIMIT 1), 0)",
+                           search, columns, rowid, columns, table, rowid,
+                           search);
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    g_free (sql);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not fill %s table: %s",
+                     search, sqlite3_errmsg (db));
+        return;
+    }
 }
 
 void
-yum_db_package_write (sqlite3 *db, sqlite3_stmt *handle, Package *p)
+yum_db_index_primary_search (sqlite3 *db, guint options, GError **err)
+{
+    index_search_table (db, "packages_search", "packages", "pkgKey",
+                        "name, summary, description",
+                        (options & YUM_DB_COMPRESS_TEXT) ?
+                        "old.name, old.summary, yum_unpack (old.description)" :
+                        "old.name, old.summary, old.description", err);
+}
+
+/* YUM_DB_PATH_INDEX: an FTS5 trigram table over the file paths of each
+ * package, one per line, under its pkgKey.  The trigrams of a substring
+ * or GLOB pattern narrow a search down to the packages that have them
+ * all, whose paths are then matched one by one.  Kept up like the tables
+ * above, but its trigger runs before the files of a package are gone, and
+ * it needs yum_path_lines (), and yum_filelist_paths () for the filelist
+ * rows. */
+
+static void
+index_path_table (sqlite3 *db,
+                  const char *table,
+                  const char *path,
+                  GError **err)
 {
+    char *sql;
     int rc;
 
-    sqlite3_bind_text (handle, 1,  p->pkgId, -1, SQLITE_STATIC);
-    sqlite3_bind_text (handle, 2,  p->name, -1, SQLITE_STATIC);
-    sqlite3_bind_text (handle, 3,  p->arch, -1, SQLITE_STATIC);
-    sqlite3_bind_text (handle, 4,  p->version, -1, SQLITE_STATIC);
-    sqlite3_bind_text (handle, 5,  p->epoch, -1, SQLITE_STATIC);
-    sqlite3_bind_text (handle, 6,  p->release, -1, SQLITE_STATIC);
-    sqlite3_bind_text (handle, 7,  p->summary, -1, SQLITE_STATIC);
+    sql = "CREATE VIRTUAL TABLE IF NOT EXISTS file_trigrams "
+        "USING fts5 (paths, content='', detail='none',"
+        "            tokenize='trigram case_sensitive 1')";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create file_trigrams table: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+
+    /* A package has to be deleted with the text it was added with,
+       yum_path_lines () sorts its paths to get the same one again */
+    sql = g_strdup_printf ("CREATE TRIGGER IF NOT EXISTS remove_file_trigrams "
+                           "BEFORE DELETE ON packages"
+                           "  BEGIN"
+                           "    INSERT INTO file_trigrams"
+                           "        (file_trigrams, rowid, paths)"
+                           "      SELECT 'delete', old.pkgKey, paths"
+                           "      FROM (SELECT yum_path_lines (%s) AS paths"
+                           "            FROM %s WHERE pkgKey = old.pkgKey)"
+                           "      WHERE paths IS NOT NULL;"
+                           "  END;",
+                           path, table);
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    g_free (sql);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create remove_file_trigrams trigger: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+
+    sql = g_strdup_printf ("INSERT INTO file_trigrams (rowid, paths)"
+                           "  SELECT pkgKey, yum_path_lines (%s) FROM %s"
+                           "  WHERE pkgKey > "
+                           "    coalesce ((SELECT rowid FROM file_trigrams"
+                           "               ORDER BY rowid DESC LIMIT 1), 0)"
+                           "  GROUP BY pkgKey ORDER BY pkgKey",
+                           path, table);
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    g_free (sql);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not fill file_trigrams table: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+}
+
+void
+yum_db_index_primary_paths (sqlite3 *db, GError **err)
+{
+    index_path_table (db, "files", "name", err);
+}
+
+sqlite3_stmt *
+yum_db_package_prepare (sqlite3 *db, GError **err)
+{
+    int rc;
+    sqlite3_stmt *handle = NULL;
+    const char *query;
+
+    query =
+        "INSERT INTO packages ("
+        "  pkgId, name, arch, version, epoch, release, summary, description,"
+        "  url, time_file, time_build, rpm_license, rpm_vendor, rpm_group,"
+        "  rpm_buildhost, rpm_sourcerpm, rpm_header_start, rpm_header_end,"
+        "  rpm_packager, size_package, size_installed, size_archive,"
+        "  location_href, location_base, checksum_type, pkgKey) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?,"
+        "  ?, ?, ?, ?, ?, ?, ?, ?)";
+
+    rc = sqlite3_prepare (db, query, -1, &handle, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not prepare packages insertion: %s",
+                     sqlite3_errmsg (db));
+        sqlite3_finalize (handle);
+        handle = NULL;
+    }
+
+    return handle;
+}
+
+void
+yum_db_package_write (sqlite3 *db, sqlite3_stmt *handle, Package *p)
+{
+    int rc;
+
+    sqlite3_bind_text (handle, 1,  p->pkgId, -1, SQLITE_STATIC);
+    sqlite3_bind_text (handle, 2,  p->name, -1, SQLITE_STATIC);
+    sqlite3_bind_text (handle, 3,  p->arch, -1, SQLITE_STATIC);
+    sqlite3_bind_text (handle, 4,  p->version, -1, SQLITE_STATIC);
+    sqlite3_bind_text (handle, 5,  p->epoch, -1, SQLITE_STATIC);
+    sqlite3_bind_text (handle, 6,  p->release, -1, SQLITE_STATIC);
+    sqlite3_bind_text (handle, 7,  p->summary, -1, SQLITE_STATIC);
     sqlite3_bind_text (handle, 8,  p->description, -1, SQLITE_STATIC);
     sqlite3_bind_text (handle, 9,  p->url, -1, SQLITE_STATIC);
     sqlite3_bind_int  (handle, 10, p->time_file);
@@ -564,6 +1543,12 @@ yum_db_package_write (sqlite3 *db, sqlite3_stmt *handle, Package *p)
     sqlite3_bind_text (handle, 24, p->location_base, -1, SQLITE_STATIC);
     sqlite3_bind_text (handle, 25, p->checksum_type, -1, SQLITE_STATIC);
 
+    /* Already set if some of the files were written early */
+    if (p->pkgKey)
+        sqlite3_bind_int64 (handle, 26, p->pkgKey);
+    else
+        sqlite3_bind_null (handle, 26);
+
     rc = sqlite3_step (handle);
     sqlite3_reset (handle);
 
@@ -574,34 +1559,74 @@ yum_db_package_write (sqlite3 *db, sqlite3_stmt *handle, Package *p)
         p->pkgKey = sqlite3_last_insert_rowid (db);
 }
 
-sqlite3_stmt *
-yum_db_dependency_prepare (sqlite3 *db,
-                           const char *table,
-                           GError **err)
-{
-    int rc;
-    sqlite3_stmt *handle = NULL;
-    char *query;
+/* Batched inserts.  Values are copied into the batch, so the rows may
+ * outlive the package they came from; yum_db_batch_flush () writes them
+ * with one multi-row INSERT per max_rows rows, the remainder one row at
+ * a time.  The statement texts and buffers outlive the connection, a
+ * batch can be moved to the next database with yum_db_batch_set_db (). */
 
-    const char *pre_name = "";
-    const char *pre_value = "";
+typedef struct {
+    int type;
+    gint64 i;
+    const char *s;
+} BatchValue;
 
-    if (!strcmp (table, "requires")) {
-        pre_name = ", pre";
-        pre_value = ", ?";
+struct _YumDbBatch {
+    sqlite3 *db;
+    const char *what;
+    char *table;
+    char *columns;
+    guint n_columns;
+    guint max_rows;
+
+    char *row_sql;
+    char *rows_sql;
+    guint rows_sql_rows;
+
+    sqlite3_stmt *row_handle;
+    /* Prepared on the first full batch, small repositories never need it */
+    sqlite3_stmt *rows_handle;
+
+    BatchValue *values;
+    guint n_values;
+    GStringChunk *strings;
+
+    /* Rows get a seq column numbering them within their package */
+    gboolean numbered;
+    gint64 seq_pkgKey;
+    gint64 seq;
+};
+
+static char *
+batch_sql (YumDbBatch *batch, guint n_rows)
+{
+    GString *query;
+    guint row, col;
+
+    query = g_string_new (NULL);
+    g_string_printf (query, "INSERT INTO %s (%s) VALUES ",
+                     batch->table, batch->columns);
+    for (row = 0; row < n_rows; row++) {
+        g_string_append (query, row ? ", (" : "(");
+        for (col = 0; col < batch->n_columns; col++)
+            g_string_append (query, col ? ", ?" : "?");
+        g_string_append_c (query, ')');
     }
 
-    query = g_strdup_printf
-        ("INSERT INTO %s (name, flags, epoch, version, release, pkgKey%s) "
-         "VALUES (?, ?, ?, ?, ?, ?%s)", table, pre_name, pre_value);
+    return g_string_free (query, FALSE);
+}
 
-    rc = sqlite3_prepare (db, query, -1, &handle, NULL);
-    g_free (query);
+static sqlite3_stmt *
+batch_prepare (YumDbBatch *batch, const char *sql, GError **err)
+{
+    sqlite3_stmt *handle = NULL;
+    int rc;
 
+    rc = sqlite3_prepare (batch->db, sql, -1, &handle, NULL);
     if (rc != SQLITE_OK) {
         g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
-                     "Can not prepare dependency insertion: %s",
-                     sqlite3_errmsg (db));
+                     "Can not prepare %s insertion: %s", batch->table,
+                     sqlite3_errmsg (batch->db));
         sqlite3_finalize (handle);
         handle = NULL;
     }
@@ -610,347 +1635,1429 @@ yum_db_dependency_prepare (sqlite3 *db,
 }
 
 void
-yum_db_dependency_write (sqlite3 *db,
-                         sqlite3_stmt *handle,
-                         gint64 pkgKey,
-                         Dependency *dep,
-                         gboolean isRequirement)
+yum_db_batch_set_db (YumDbBatch *batch, sqlite3 *db, GError **err)
 {
-    int rc;
+    int max_params;
+
+    if (batch->row_handle)
+        sqlite3_finalize (batch->row_handle);
+    if (batch->rows_handle)
+        sqlite3_finalize (batch->rows_handle);
+    batch->row_handle = NULL;
+    batch->rows_handle = NULL;
+    batch->n_values = 0;
+    g_string_chunk_clear (batch->strings);
+    batch->seq_pkgKey = 0;
+    batch->seq = 0;
+
+    batch->db = db;
+    if (!db)
+        return;
+
+    max_params = sqlite3_limit (db, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+    batch->max_rows = CLAMP (max_params / (int) batch->n_columns, 1,
+                             YMP_CONFIG_BATCH_ROWS);
+
+    batch->row_handle = batch_prepare (batch, batch->row_sql, err);
+}
+
+static YumDbBatch *
+batch_new (sqlite3 *db,
+           const char *table,
+           const char *columns,
+           guint n_columns,
+           const char *what,
+           GError **err)
+{
+    YumDbBatch *batch;
 
-    sqlite3_bind_text (handle, 1, dep->name,    -1, SQLITE_STATIC);
-    sqlite3_bind_text (handle, 2, dep->flags,   -1, SQLITE_STATIC);
-    sqlite3_bind_text (handle, 3, dep->epoch,   -1, SQLITE_STATIC);
-    sqlite3_bind_text (handle, 4, dep->version, -1, SQLITE_STATIC);
-    sqlite3_bind_text (handle, 5, dep->release, -1, SQLITE_STATIC);
-    sqlite3_bind_int  (handle, 6, pkgKey);
+    batch = g_new0 (YumDbBatch, 1);
+    batch->what = what;
+    batch->table = g_strdup (table);
+    batch->columns = g_strdup (columns);
+    batch->n_columns = n_columns;
+    batch->row_sql = batch_sql (batch, 1);
+    batch->values = g_new (BatchValue, n_columns * YMP_CONFIG_BATCH_ROWS);
+    batch->strings = g_string_chunk_new (4096);
 
-    if (isRequirement) {
-        if (dep->pre)
-            sqlite3_bind_text (handle, 7, "TRUE", -1, SQLITE_TRANSIENT);
+    yum_db_batch_set_db (batch, db, err);
+
+    return batch;
+}
+
+static void
+batch_text (YumDbBatch *batch, const char *value)
+{
+    BatchValue *v = &batch->values[batch->n_values++];
+
+    if (value) {
+        v->type = SQLITE_TEXT;
+        v->s = g_string_chunk_insert (batch->strings, value);
+    } else
+        v->type = SQLITE_NULL;
+}
+
+static void
+batch_int (YumDbBatch *batch, gint64 value)
+{
+    BatchValue *v = &batch->values[batch->n_values++];
+
+    v->type = SQLITE_INTEGER;
+    v->i = value;
+}
+
+static void
+batch_step (YumDbBatch *batch,
+            sqlite3_stmt *handle,
+            BatchValue *values,
+            guint n_values)
+{
+    guint i;
+    int rc;
+
+    for (i = 0; i < n_values; i++) {
+        if (values[i].type == SQLITE_TEXT)
+            sqlite3_bind_text (handle, i + 1, values[i].s, -1,
+                               SQLITE_STATIC);
+        else if (values[i].type == SQLITE_INTEGER)
+            sqlite3_bind_int64 (handle, i + 1, values[i].i);
         else
-            sqlite3_bind_text (handle, 7, "FALSE", -1, SQLITE_TRANSIENT);
+            sqlite3_bind_null (handle, i + 1);
     }
 
     rc = sqlite3_step (handle);
     sqlite3_reset (handle);
 
     if (rc != SQLITE_DONE)
-        g_critical ("Error adding dependency to SQL: %s",
-                    sqlite3_errmsg (db));
+        g_critical ("Error adding %s to SQL: %s", batch->what,
+                    sqlite3_errmsg (batch->db));
 }
 
-sqlite3_stmt *
-yum_db_file_prepare (sqlite3 *db, GError **err)
+/* The rows of one package are written one after another */
+static void
+batch_seq (YumDbBatch *batch, gint64 pkgKey)
+{
+    if (pkgKey != batch->seq_pkgKey) {
+        batch->seq_pkgKey = pkgKey;
+        batch->seq = 0;
+    }
+
+    batch_int (batch, batch->seq++);
+}
+
+static void
+batch_row_done (YumDbBatch *batch)
+{
+    if (batch->n_values == batch->n_columns * batch->max_rows)
+        yum_db_batch_flush (batch);
+}
+
+static sqlite3_stmt *
+batch_rows_handle (YumDbBatch *batch)
+{
+    GError *err = NULL;
+
+    if (batch->rows_handle || batch->max_rows < 2)
+        return batch->rows_handle;
+
+    if (batch->rows_sql_rows != batch->max_rows) {
+        g_free (batch->rows_sql);
+        batch->rows_sql = batch_sql (batch, batch->max_rows);
+        batch->rows_sql_rows = batch->max_rows;
+    }
+
+    /* Without it the rows are still written one at a time */
+    batch->rows_handle = batch_prepare (batch, batch->rows_sql, &err);
+    if (err) {
+        g_warning ("%s", err->message);
+        g_error_free (err);
+        batch->max_rows = 1;
+    }
+
+    return batch->rows_handle;
+}
+
+void
+yum_db_batch_flush (YumDbBatch *batch)
+{
+    sqlite3_stmt *rows_handle = NULL;
+    guint i;
+
+    if (batch->n_values == batch->n_columns * batch->max_rows)
+        rows_handle = batch_rows_handle (batch);
+
+    if (rows_handle)
+        batch_step (batch, rows_handle, batch->values, batch->n_values);
+    else {
+        for (i = 0; i < batch->n_values; i += batch->n_columns)
+            batch_step (batch, batch->row_handle, batch->values + i,
+                        batch->n_columns);
+    }
+
+    batch->n_values = 0;
+    g_string_chunk_clear (batch->strings);
+}
+
+void
+yum_db_batch_free (YumDbBatch *batch)
+{
+    yum_db_batch_set_db (batch, NULL, NULL);
+    g_string_chunk_free (batch->strings);
+    g_free (batch->values);
+    g_free (batch->row_sql);
+    g_free (batch->rows_sql);
+    g_free (batch->table);
+    g_free (batch->columns);
+    g_free (batch);
+}
+
+/* The clustered layout is written through the stage tables */
+static YumDbBatch *
+primary_batch_new (sqlite3 *db,
+                   const char *table,
+                   const char *columns,
+                   guint n_columns,
+                   const char *what,
+                   guint options,
+                   GError **err)
+{
+    YumDbBatch *batch;
+    char *stage;
+    char *numbered;
+
+    if (!(options & YUM_DB_PRIMARY_CLUSTERED))
+        return batch_new (db, table, columns, n_columns, what, err);
+
+    stage = g_strconcat (table, "_stage", NULL);
+    numbered = g_strconcat (columns, ", seq", NULL);
+    batch = batch_new (db, stage, numbered, n_columns + 1, what, err);
+    batch->numbered = TRUE;
+    g_free (stage);
+    g_free (numbered);
+
+    return batch;
+}
+
+YumDbBatch *
+yum_db_dependency_prepare (sqlite3 *db,
+                           const char *table,
+                           guint options,
+                           GError **err)
+{
+    if (!strcmp (table, "requires"))
+        return primary_batch_new (db, table,
+                                  "name, flags, epoch, version, release, "
+                                  "pkgKey, pre",
+                                  7, "dependency", options, err);
+
+    return primary_batch_new (db, table,
+                              "name, flags, epoch, version, release, pkgKey",
+                              6, "dependency", options, err);
+}
+
+void
+yum_db_dependency_write (YumDbBatch *batch,
+                         gint64 pkgKey,
+                         Dependency *dep,
+                         gboolean isRequirement)
+{
+    batch_text (batch, dep->name);
+    batch_text (batch, dep->flags);
+    batch_text (batch, dep->epoch);
+    batch_text (batch, dep->version);
+    batch_text (batch, dep->release);
+    batch_int  (batch, pkgKey);
+
+    if (isRequirement)
+        batch_text (batch, dep->pre ? "TRUE" : "FALSE");
+    if (batch->numbered)
+        batch_seq (batch, pkgKey);
+
+    batch_row_done (batch);
+}
+
+YumDbBatch *
+yum_db_file_prepare (sqlite3 *db, guint options, GError **err)
+{
+    return primary_batch_new (db, "files", "name, type, pkgKey", 3,
+                              "package file", options, err);
+}
+
+void
+yum_db_file_write (YumDbBatch *batch,
+                   gint64 pkgKey,
+                   PackageFile *file)
+{
+    batch_text (batch, file->name);
+    batch_text (batch, file->type);
+    batch_int  (batch, pkgKey);
+    if (batch->numbered)
+        batch_seq (batch, pkgKey);
+
+    batch_row_done (batch);
+}
+
+void
+yum_db_create_filelist_tables (sqlite3 *db, GError **err)
 {
     int rc;
-    sqlite3_stmt *handle = NULL;
-    const char *query;
+    const char *sql;
 
-    query = "INSERT INTO files (name, type, pkgKey) VALUES (?, ?, ?)";
+    sql =
+        "CREATE TABLE packages ("
+        "  pkgKey INTEGER PRIMARY KEY,"
+        "  pkgId TEXT)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create packages table: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
 
-    rc = sqlite3_prepare (db, query, -1, &handle, NULL);
+    sql =
+        "CREATE TABLE filelist ("
+        "  pkgKey INTEGER,"
+        "  dirname TEXT,"
+        "  filenames TEXT,"
+        "  filetypes TEXT)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
     if (rc != SQLITE_OK) {
         g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
-                     "Can not prepare file insertion: %s",
+                     "Can not create filelist table: %s",
                      sqlite3_errmsg (db));
-        sqlite3_finalize (handle);
-        handle = NULL;
+        return;
+    }
+
+    sql =
+        "CREATE TRIGGER remove_filelist AFTER DELETE ON packages"
+        "  BEGIN"
+        "    DELETE FROM filelist WHERE pkgKey = old.pkgKey;"
+        "  END;";
+
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create remove_filelist trigger: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+}
+
+void
+yum_db_index_filelist_tables (sqlite3 *db, GError **err)
+{
+    int rc;
+    const char *sql;
+
+    sql = "CREATE INDEX IF NOT EXISTS keyfile ON filelist (pkgKey)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create keyfile index: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+
+    sql = "CREATE INDEX IF NOT EXISTS pkgId ON packages (pkgId)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create pkgId index: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+
+    sql = "CREATE INDEX IF NOT EXISTS dirnames ON filelist (dirname)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create dirnames index: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+}
+
+void
+yum_db_create_filelist_dirs_tables (sqlite3 *db, GError **err)
+{
+    int rc;
+    const char *sql;
+
+    sql =
+        "CREATE TABLE packages ("
+        "  pkgKey INTEGER PRIMARY KEY,"
+        "  pkgId TEXT)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create packages table: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+
+    sql =
+        "CREATE TABLE dirs ("
+        "  dirId INTEGER PRIMARY KEY,"
+        "  dirname TEXT)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create dirs table: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+
+    sql =
+        "CREATE TABLE filelist_packed ("
+        "  pkgKey INTEGER,"
+        "  dirId INTEGER,"
+        "  filenames TEXT,"
+        "  filetypes TEXT)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create filelist_packed table: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+
+    /* What yum queries */
+    sql =
+        "CREATE VIEW filelist AS"
+        "  SELECT filelist_packed.pkgKey AS pkgKey,"
+        "         dirs.dirname AS dirname,"
+        "         filelist_packed.filenames AS filenames,"
+        "         filelist_packed.filetypes AS filetypes"
+        "  FROM filelist_packed JOIN dirs USING (dirId)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create filelist view: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+
+    sql =
+        "CREATE TRIGGER remove_filelist AFTER DELETE ON packages"
+        "  BEGIN"
+        "    DELETE FROM filelist_packed WHERE pkgKey = old.pkgKey;"
+        "  END;";
+
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create remove_filelist trigger: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+}
+
+void
+yum_db_index_filelist_dirs_tables (sqlite3 *db, GError **err)
+{
+    int rc;
+    const char *sql;
+
+    sql = "CREATE INDEX IF NOT EXISTS keyfile ON filelist_packed (pkgKey)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create keyfile index: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+
+    sql = "CREATE INDEX IF NOT EXISTS pkgId ON packages (pkgId)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create pkgId index: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+
+    sql = "CREATE UNIQUE INDEX IF NOT EXISTS dirnames ON dirs (dirname)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create dirnames index: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+
+    sql = "CREATE INDEX IF NOT EXISTS dirfiles ON filelist_packed (dirId)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create dirfiles index: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+}
+
+/* Once per connection, before anything runs the triggers that use them:
+   replacing a function expires the statements prepared so far */
+void
+yum_db_register_functions (sqlite3 *db, GError **err)
+{
+    if (yum_sql_register_text_functions (db) != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not register text functions: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+
+    if (yum_sql_register_filelist_functions (db) != SQLITE_OK)
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not register filelist functions: %s",
+                     sqlite3_errmsg (db));
+}
+
+/* Both layouts, through the filelist view of FILELIST_DIRS */
+void
+yum_db_index_filelist_paths (sqlite3 *db, GError **err)
+{
+    index_path_table (db, "filelist",
+                      "yum_filelist_paths (dirname, filenames)", err);
+}
+
+sqlite3_stmt *
+yum_db_package_ids_prepare (sqlite3 *db, GError **err)
+{
+    int rc;
+    sqlite3_stmt *handle = NULL;
+    const char *query;
+
+    query = "INSERT INTO packages (pkgId, pkgKey) VALUES (?, ?)";
+    rc = sqlite3_prepare (db, query, -1, &handle, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not prepare package ids insertion: %s",
+                     sqlite3_errmsg (db));
+        sqlite3_finalize (handle);
+        handle = NULL;
+    }
+
+    return handle;
+}
+
+void
+yum_db_package_ids_write (sqlite3 *db, sqlite3_stmt *handle, Package *p)
+{
+    int rc;
+
+    sqlite3_bind_text (handle, 1,  p->pkgId, -1, SQLITE_STATIC);
+    if (p->pkgKey)
+        sqlite3_bind_int64 (handle, 2, p->pkgKey);
+    else
+        sqlite3_bind_null (handle, 2);
+
+    rc = sqlite3_step (handle);
+    sqlite3_reset (handle);
+
+    if (rc != SQLITE_DONE) {
+        g_critical ("Error adding package to SQL: %s",
+                    sqlite3_errmsg (db));
+    } else
+        p->pkgKey = sqlite3_last_insert_rowid (db);
+}
+
+sqlite3_stmt *
+yum_db_filelists_prepare (sqlite3 *db, GError **err)
+{
+    int rc;
+    sqlite3_stmt *handle = NULL;
+    const char *query;
+
+    query =
+        "INSERT INTO filelist (pkgKey, dirname, filenames, filetypes) "
+        " VALUES (?, ?, ?, ?)";
+
+    rc = sqlite3_prepare (db, query, -1, &handle, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not prepare filelist insertion: %s",
+                     sqlite3_errmsg (db));
+        sqlite3_finalize (handle);
+        handle = NULL;
+    }
+
+    return handle;
+}
+
+sqlite3_stmt *
+yum_db_filelists_packed_prepare (sqlite3 *db, GError **err)
+{
+    int rc;
+    sqlite3_stmt *handle = NULL;
+    const char *query;
+
+    query =
+        "INSERT INTO filelist_packed (pkgKey, dirId, filenames, filetypes) "
+        " VALUES (?, ?, ?, ?)";
+
+    rc = sqlite3_prepare (db, query, -1, &handle, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not prepare filelist_packed insertion: %s",
+                     sqlite3_errmsg (db));
+        sqlite3_finalize (handle);
+        handle = NULL;
+    }
+
+    return handle;
+}
+
+sqlite3_stmt *
+yum_db_dirs_prepare (sqlite3 *db, GError **err)
+{
+    int rc;
+    sqlite3_stmt *handle = NULL;
+    const char *query;
+
+    query = "INSERT INTO dirs (dirId, dirname) VALUES (?, ?)";
+
+    rc = sqlite3_prepare (db, query, -1, &handle, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not prepare dirs insertion: %s",
+                     sqlite3_errmsg (db));
+        sqlite3_finalize (handle);
+        handle = NULL;
+    }
+
+    return handle;
+}
+
+static gint64
+encoder_dir_id (sqlite3 *db, YumFilelistEncoder *enc, const EncoderDir *dir)
+{
+    gpointer id;
+    char *name;
+    int rc;
+
+    /* dir->dir is not NUL terminated */
+    g_string_truncate (enc->dir_key, 0);
+    g_string_append_len (enc->dir_key, dir->dir, dir->dir_len);
+
+    id = g_hash_table_lookup (enc->dir_ids, enc->dir_key->str);
+    if (id)
+        return GPOINTER_TO_INT (id);
+
+    name = g_string_chunk_insert_len (enc->dir_names, dir->dir, dir->dir_len);
+    g_hash_table_insert (enc->dir_ids, name,
+                         GINT_TO_POINTER ((gint) enc->next_dir_id));
+
+    sqlite3_bind_int64 (enc->dirs_handle, 1, enc->next_dir_id);
+    sqlite3_bind_text (enc->dirs_handle, 2, name, dir->dir_len,
+                       SQLITE_STATIC);
+    rc = sqlite3_step (enc->dirs_handle);
+    sqlite3_reset (enc->dirs_handle);
+
+    if (rc != SQLITE_DONE) {
+        g_critical ("Error adding directory to SQL: %s",
+                    sqlite3_errmsg (db));
+    }
+
+    return enc->next_dir_id++;
+}
+
+static void
+write_filelist_row (sqlite3 *db,
+                    sqlite3_stmt *handle,
+                    gint64 pkgKey,
+                    const EncoderDir *dir,
+                    YumFilelistEncoder *enc)
+{
+    int rc;
+
+    sqlite3_bind_int  (handle, 1, pkgKey);
+    if (enc->dir_ids)
+        sqlite3_bind_int64 (handle, 2, encoder_dir_id (db, enc, dir));
+    else
+        sqlite3_bind_text (handle, 2, dir->dir, dir->dir_len, SQLITE_STATIC);
+    sqlite3_bind_text (handle, 3, enc->files->str, enc->files->len,
+                       SQLITE_STATIC);
+    sqlite3_bind_text (handle, 4, enc->types->str, enc->types->len,
+                       SQLITE_STATIC);
+
+    rc = sqlite3_step (handle);
+    sqlite3_reset (handle);
+
+    if (rc != SQLITE_DONE) {
+        g_critical ("Error adding file to SQL: %s",
+                    sqlite3_errmsg (db));
+    }
+}
+
+void
+yum_db_filelists_write (sqlite3 *db,
+                        sqlite3_stmt *handle,
+                        YumFilelistEncoder *enc,
+                        Package *p)
+{
+    guint i;
+    guint32 j;
+
+    encoder_add_files (enc, p->files);
+
+    /* One row per directory, in dirname order */
+    for (i = 0; i < enc->dirs->len; i++) {
+        EncoderDir *dir = &g_array_index (enc->dirs, EncoderDir, i);
+
+        g_string_truncate (enc->files, 0);
+        g_string_truncate (enc->types, 0);
+
+        for (j = dir->first; j != ENCODER_NONE;
+             j = g_array_index (enc->entries, EncoderEntry, j).next) {
+            EncoderEntry *entry = &g_array_index (enc->entries, EncoderEntry, j);
+
+            if (enc->files->len)
+                g_string_append_c (enc->files, '/');
+            g_string_append (enc->files, entry->base);
+
+            if (entry->type)
+                g_string_append_c (enc->types, entry->type);
+        }
+
+        write_filelist_row (db, handle, p->pkgKey, dir, enc);
+    }
+}
+
+void
+yum_db_create_other_tables (sqlite3 *db, GError **err)
+{
+    int rc;
+    const char *sql;
+
+    sql =
+        "CREATE TABLE packages ("
+        "  pkgKey INTEGER PRIMARY KEY,"
+        "  pkgId TEXT)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create packages table: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+
+    sql =
+        "CREATE TABLE changelog ("
+        "  pkgKey INTEGER,"
+        "  author TEXT,"
+        "  date INTEGER,"
+        "  changelog TEXT)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create changelog table: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+
+    sql =
+        "CREATE TRIGGER remove_changelogs AFTER DELETE ON packages"
+        "  BEGIN"
+        "    DELETE FROM changelog WHERE pkgKey = old.pkgKey;"
+        "  END;";
+
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create remove_changelogs trigger: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+}
+
+void
+yum_db_index_other_tables (sqlite3 *db, GError **err)
+{
+    int rc;
+    const char *sql;
+
+    sql = "CREATE INDEX IF NOT EXISTS keychange ON changelog (pkgKey)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create keychange index: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+
+    sql = "CREATE INDEX IF NOT EXISTS pkgId ON packages (pkgId)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create pkgId index: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+}
+
+void
+yum_db_index_other_search (sqlite3 *db, guint options, GError **err)
+{
+    index_search_table (db, "changelog_search", "changelog", "rowid",
+                        "changelog",
+                        (options & YUM_DB_COMPRESS_TEXT) ?
+                        "yum_unpack (old.changelog)" : "old.changelog", err);
+}
+
+YumDbBatch *
+yum_db_changelog_prepare (sqlite3 *db, GError **err)
+{
+    return batch_new (db, "changelog", "pkgKey, author, date, changelog", 4,
+                      "changelog", err);
+}
+
+void
+yum_db_changelog_write (YumDbBatch *batch, Package *p)
+{
+    GSList *iter;
+    ChangelogEntry *entry;
+
+    for (iter = p->changelogs; iter; iter = iter->next) {
+        entry = (ChangelogEntry *) iter->data;
+
+        batch_int  (batch, p->pkgKey);
+        batch_text (batch, entry->author);
+        batch_int  (batch, entry->date);
+        batch_text (batch, entry->changelog);
+
+        batch_row_done (batch);
+    }
+}
+
+/* Updateinfo */
+
+void
+yum_db_create_updateinfo_tables (sqlite3 *db, GError **err)
+{
+    int rc;
+    const char *sql;
+
+    sql =
+        "CREATE TABLE advisories ("
+        "  advisoryKey INTEGER PRIMARY KEY,"
+        "  id TEXT,"
+        "  type TEXT,"
+        "  status TEXT,"
+        "  version TEXT,"
+        "  issuer TEXT,"
+        "  title TEXT,"
+        "  severity TEXT,"
+        "  release TEXT,"
+        "  rights TEXT,"
+        "  pushcount TEXT,"
+        "  summary TEXT,"
+        "  description TEXT,"
+        "  solution TEXT,"
+        "  issued TEXT,"
+        "  updated TEXT)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create advisories table: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+
+    sql =
+        "CREATE TABLE advisory_references ("
+        "  advisoryKey INTEGER,"
+        "  type TEXT,"
+        "  id TEXT,"
+        "  href TEXT,"
+        "  title TEXT)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create advisory_references table: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+
+    sql =
+        "CREATE TABLE advisory_packages ("
+        "  advisoryKey INTEGER,"
+        "  collection TEXT,"
+        "  name TEXT,"
+        "  epoch TEXT,"
+        "  version TEXT,"
+        "  release TEXT,"
+        "  arch TEXT,"
+        "  src TEXT,"
+        "  filename TEXT,"
+        "  sum_type TEXT,"
+        "  sum TEXT,"
+        "  reboot_suggested BOOLEAN,"
+        "  restart_suggested BOOLEAN,"
+        "  relogin_suggested BOOLEAN)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create advisory_packages table: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+
+    sql =
+        "CREATE TRIGGER remove_advisory AFTER DELETE ON advisories"
+        "  BEGIN"
+        "    DELETE FROM advisory_references"
+        "      WHERE advisoryKey = old.advisoryKey;"
+        "    DELETE FROM advisory_packages"
+        "      WHERE advisoryKey = old.advisoryKey;"
+        "  END;";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create remove_advisory trigger: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+}
+
+void
+yum_db_index_updateinfo_tables (sqlite3 *db, GError **err)
+{
+    int rc;
+    const char *sql;
+
+    sql = "CREATE INDEX IF NOT EXISTS advisoryid ON advisories (id)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create advisoryid index: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+
+    sql = "CREATE INDEX IF NOT EXISTS advisoryrefs "
+        "ON advisory_references (advisoryKey)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create advisoryrefs index: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+
+    /* CVE and bugzilla lookups */
+    sql = "CREATE INDEX IF NOT EXISTS referenceid "
+        "ON advisory_references (id)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create referenceid index: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+
+    sql = "CREATE INDEX IF NOT EXISTS advisorypkgs "
+        "ON advisory_packages (advisoryKey)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create advisorypkgs index: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+
+    /* Which advisories update an installed package */
+    sql = "CREATE INDEX IF NOT EXISTS advisorypkgname "
+        "ON advisory_packages (name, arch)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create advisorypkgname index: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+}
+
+sqlite3_stmt *
+yum_db_advisory_prepare (sqlite3 *db, GError **err)
+{
+    int rc;
+    sqlite3_stmt *handle = NULL;
+    const char *query;
+
+    query =
+        "INSERT INTO advisories ("
+        "  id, type, status, version, issuer, title, severity, release,"
+        "  rights, pushcount, summary, description, solution, issued,"
+        "  updated) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+
+    rc = sqlite3_prepare (db, query, -1, &handle, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not prepare advisories insertion: %s",
+                     sqlite3_errmsg (db));
+        sqlite3_finalize (handle);
+        handle = NULL;
+    }
+
+    return handle;
+}
+
+void
+yum_db_advisory_write (sqlite3 *db, sqlite3_stmt *handle, Advisory *a)
+{
+    int rc;
+
+    sqlite3_bind_text (handle, 1,  a->id, -1, SQLITE_STATIC);
+    sqlite3_bind_text (handle, 2,  a->type, -1, SQLITE_STATIC);
+    sqlite3_bind_text (handle, 3,  a->status, -1, SQLITE_STATIC);
+    sqlite3_bind_text (handle, 4,  a->version, -1, SQLITE_STATIC);
+    sqlite3_bind_text (handle, 5,  a->issuer, -1, SQLITE_STATIC);
+    sqlite3_bind_text (handle, 6,  a->title, -1, SQLITE_STATIC);
+    sqlite3_bind_text (handle, 7,  a->severity, -1, SQLITE_STATIC);
+    sqlite3_bind_text (handle, 8,  a->release, -1, SQLITE_STATIC);
+    sqlite3_bind_text (handle, 9,  a->rights, -1, SQLITE_STATIC);
+    sqlite3_bind_text (handle, 10, a->pushcount, -1, SQLITE_STATIC);
+    sqlite3_bind_text (handle, 11, a->summary, -1, SQLITE_STATIC);
+    sqlite3_bind_text (handle, 12, a->description, -1, SQLITE_STATIC);
+    sqlite3_bind_text (handle, 13, a->solution, -1, SQLITE_STATIC);
+    sqlite3_bind_text (handle, 14, a->issued, -1, SQLITE_STATIC);
+    sqlite3_bind_text (handle, 15, a->updated, -1, SQLITE_STATIC);
+
+    rc = sqlite3_step (handle);
+    sqlite3_reset (handle);
+
+    if (rc != SQLITE_DONE) {
+        g_critical ("Error adding advisory to SQL: %s",
+                    sqlite3_errmsg (db));
+    } else
+        a->advisoryKey = sqlite3_last_insert_rowid (db);
+}
+
+YumDbBatch *
+yum_db_advisory_references_prepare (sqlite3 *db, GError **err)
+{
+    return batch_new (db, "advisory_references",
+                      "advisoryKey, type, id, href, title", 5,
+                      "advisory reference", err);
+}
+
+void
+yum_db_advisory_references_write (YumDbBatch *batch, Advisory *a)
+{
+    GSList *iter;
+    AdvisoryReference *reference;
+
+    for (iter = a->references; iter; iter = iter->next) {
+        reference = (AdvisoryReference *) iter->data;
+
+        batch_int  (batch, a->advisoryKey);
+        batch_text (batch, reference->type);
+        batch_text (batch, reference->id);
+        batch_text (batch, reference->href);
+        batch_text (batch, reference->title);
+
+        batch_row_done (batch);
+    }
+}
+
+YumDbBatch *
+yum_db_advisory_packages_prepare (sqlite3 *db, GError **err)
+{
+    return batch_new (db, "advisory_packages",
+                      "advisoryKey, collection, name, epoch, version, "
+                      "release, arch, src, filename, sum_type, sum, "
+                      "reboot_suggested, restart_suggested, "
+                      "relogin_suggested", 14,
+                      "advisory package", err);
+}
+
+void
+yum_db_advisory_packages_write (YumDbBatch *batch, Advisory *a)
+{
+    GSList *iter;
+    AdvisoryPackage *package;
+
+    for (iter = a->packages; iter; iter = iter->next) {
+        package = (AdvisoryPackage *) iter->data;
+
+        batch_int  (batch, a->advisoryKey);
+        batch_text (batch, package->collection);
+        batch_text (batch, package->name);
+        batch_text (batch, package->epoch);
+        batch_text (batch, package->version);
+        batch_text (batch, package->release);
+        batch_text (batch, package->arch);
+        batch_text (batch, package->src);
+        batch_text (batch, package->filename);
+        batch_text (batch, package->sum_type);
+        batch_text (batch, package->sum);
+        batch_int  (batch, package->reboot_suggested);
+        batch_int  (batch, package->restart_suggested);
+        batch_int  (batch, package->relogin_suggested);
+
+        batch_row_done (batch);
+    }
+}
+
+/* Prestodelta */
+
+void
+yum_db_create_prestodelta_tables (sqlite3 *db, GError **err)
+{
+    int rc;
+    const char *sql;
+
+    sql =
+        "CREATE TABLE deltas ("
+        "  name TEXT,"
+        "  arch TEXT,"
+        "  epoch TEXT,"
+        "  version TEXT,"
+        "  release TEXT,"
+        "  oldepoch TEXT,"
+        "  oldversion TEXT,"
+        "  oldrelease TEXT,"
+        "  filename TEXT,"
+        "  sequence TEXT,"
+        "  size INTEGER,"
+        "  checksum_type TEXT,"
+        "  checksum TEXT)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create deltas table: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+}
+
+void
+yum_db_index_prestodelta_tables (sqlite3 *db, GError **err)
+{
+    int rc;
+    const char *sql;
+
+    /* Finding the delta from an installed to an updated package is one
+       lookup, a package's list of deltas a prefix of it */
+    sql = "CREATE INDEX IF NOT EXISTS deltaevr ON deltas "
+        "(name, arch, epoch, version, release,"
+        " oldepoch, oldversion, oldrelease)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create deltaevr index: %s",
+                     sqlite3_errmsg (db));
+        return;
     }
+}
 
-    return handle;
-
+YumDbBatch *
+yum_db_deltas_prepare (sqlite3 *db, GError **err)
+{
+    return batch_new (db, "deltas",
+                      "name, arch, epoch, version, release, oldepoch, "
+                      "oldversion, oldrelease, filename, sequence, size, "
+                      "checksum_type, checksum", 13,
+                      "delta", err);
 }
 
 void
-yum_db_file_write (sqlite3 *db,
-                   sqlite3_stmt *handle,
-                   gint64 pkgKey,
-                   PackageFile *file)
+yum_db_deltas_write (YumDbBatch *batch, DeltaPackage *p)
 {
-    int rc;
-
-    sqlite3_bind_text (handle, 1, file->name, -1, SQLITE_STATIC);
-    sqlite3_bind_text (handle, 2, file->type, -1, SQLITE_STATIC);
-    sqlite3_bind_int  (handle, 3, pkgKey);
-
-    rc = sqlite3_step (handle);
-    sqlite3_reset (handle);
-
-    if (rc != SQLITE_DONE)
-        g_critical ("Error adding package file to SQL: %s",
-                    sqlite3_errmsg (db));
+    GSList *iter;
+    DeltaRpm *delta;
+
+    for (iter = p->deltas; iter; iter = iter->next) {
+        delta = (DeltaRpm *) iter->data;
+
+        batch_text (batch, p->name);
+        batch_text (batch, p->arch);
+        batch_text (batch, p->epoch);
+        batch_text (batch, p->version);
+        batch_text (batch, p->release);
+        batch_text (batch, delta->oldepoch);
+        batch_text (batch, delta->oldversion);
+        batch_text (batch, delta->oldrelease);
+        batch_text (batch, delta->filename);
+        batch_text (batch, delta->sequence);
+        batch_int  (batch, delta->size);
+        batch_text (batch, delta->checksum_type);
+        batch_text (batch, delta->checksum);
+
+        batch_row_done (batch);
+    }
 }
 
+/* Comps */
+
 void
-yum_db_create_filelist_tables (sqlite3 *db, GError **err)
+yum_db_create_comps_tables (sqlite3 *db, GError **err)
 {
     int rc;
     const char *sql;
 
     sql =
-        "CREATE TABLE packages ("
-        "  pkgKey INTEGER PRIMARY KEY,"
-        "  pkgId TEXT)";
+        "CREATE TABLE groups ("
+        "  groupKey INTEGER PRIMARY KEY,"
+        "  id TEXT,"
+        "  name TEXT,"
+        "  description TEXT,"
+        "  is_default BOOLEAN,"
+        "  uservisible BOOLEAN,"
+        "  display_order INTEGER,"
+        "  langonly TEXT)";
     rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
     if (rc != SQLITE_OK) {
         g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
-                     "Can not create packages table: %s",
+                     "Can not create groups table: %s",
                      sqlite3_errmsg (db));
         return;
     }
 
     sql =
-        "CREATE TABLE filelist ("
-        "  pkgKey INTEGER,"
-        "  dirname TEXT,"
-        "  filenames TEXT,"
-        "  filetypes TEXT)";
+        "CREATE TABLE group_packages ("
+        "  groupKey INTEGER,"
+        "  name TEXT,"
+        "  type TEXT,"
+        "  requires TEXT,"
+        "  basearchonly BOOLEAN)";
     rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
     if (rc != SQLITE_OK) {
         g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
-                     "Can not create filelist table: %s",
+                     "Can not create group_packages table: %s",
                      sqlite3_errmsg (db));
         return;
     }
 
     sql =
-        "CREATE TRIGGER remove_filelist AFTER DELETE ON packages"
-        "  BEGIN"
-        "    DELETE FROM filelist WHERE pkgKey = old.pkgKey;"
-        "  END;";
-
+        "CREATE TABLE categories ("
+        "  categoryKey INTEGER PRIMARY KEY,"
+        "  id TEXT,"
+        "  name TEXT,"
+        "  description TEXT,"
+        "  display_order INTEGER)";
     rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
     if (rc != SQLITE_OK) {
         g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
-                     "Can not create remove_filelist trigger: %s",
+                     "Can not create categories table: %s",
                      sqlite3_errmsg (db));
         return;
     }
-}
-
-void
-yum_db_index_filelist_tables (sqlite3 *db, GError **err)
-{
-    int rc;
-    const char *sql;
 
-    sql = "CREATE INDEX IF NOT EXISTS keyfile ON filelist (pkgKey)";
+    sql =
+        "CREATE TABLE category_groups ("
+        "  categoryKey INTEGER,"
+        "  groupid TEXT)";
     rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
     if (rc != SQLITE_OK) {
         g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
-                     "Can not create keyfile index: %s",
+                     "Can not create category_groups table: %s",
                      sqlite3_errmsg (db));
         return;
     }
 
-    sql = "CREATE INDEX IF NOT EXISTS pkgId ON packages (pkgId)";
+    sql =
+        "CREATE TABLE environments ("
+        "  environmentKey INTEGER PRIMARY KEY,"
+        "  id TEXT,"
+        "  name TEXT,"
+        "  description TEXT,"
+        "  display_order INTEGER)";
     rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
     if (rc != SQLITE_OK) {
         g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
-                     "Can not create pkgId index: %s",
+                     "Can not create environments table: %s",
                      sqlite3_errmsg (db));
         return;
     }
 
-    sql = "CREATE INDEX IF NOT EXISTS dirnames ON filelist (dirname)";
+    sql =
+        "CREATE TABLE environment_groups ("
+        "  environmentKey INTEGER,"
+        "  groupid TEXT,"
+        "  optional BOOLEAN,"
+        "  is_default BOOLEAN)";
     rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
     if (rc != SQLITE_OK) {
         g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
-                     "Can not create dirnames index: %s",
+                     "Can not create environment_groups table: %s",
                      sqlite3_errmsg (db));
         return;
     }
-}
-
-sqlite3_stmt *
-yum_db_package_ids_prepare (sqlite3 *db, GError **err)
-{
-    int rc;
-    sqlite3_stmt *handle = NULL;
-    const char *query;
 
-    query = "INSERT INTO packages (pkgId) VALUES (?)";
-    rc = sqlite3_prepare (db, query, -1, &handle, NULL);
+    /* kind is group, category or environment */
+    sql =
+        "CREATE TABLE comps_translations ("
+        "  kind TEXT,"
+        "  id TEXT,"
+        "  lang TEXT,"
+        "  name TEXT,"
+        "  description TEXT)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
     if (rc != SQLITE_OK) {
         g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
-                     "Can not prepare package ids insertion: %s",
+                     "Can not create comps_translations table: %s",
                      sqlite3_errmsg (db));
-        sqlite3_finalize (handle);
-        handle = NULL;
+        return;
     }
 
-    return handle;
-}
-
-void
-yum_db_package_ids_write (sqlite3 *db, sqlite3_stmt *handle, Package *p)
-{
-    int rc;
-
-    sqlite3_bind_text (handle, 1,  p->pkgId, -1, SQLITE_STATIC);
-    rc = sqlite3_step (handle);
-    sqlite3_reset (handle);
-
-    if (rc != SQLITE_DONE) {
-        g_critical ("Error adding package to SQL: %s",
-                    sqlite3_errmsg (db));
-    } else
-        p->pkgKey = sqlite3_last_insert_rowid (db);
-}
-
-sqlite3_stmt *
-yum_db_filelists_prepare (sqlite3 *db, GError **err)
-{
-    int rc;
-    sqlite3_stmt *handle = NULL;
-    const char *query;
-
-    query =
-        "INSERT INTO filelist (pkgKey, dirname, filenames, filetypes) "
-        " VALUES (?, ?, ?, ?)";
-
-    rc = sqlite3_prepare (db, query, -1, &handle, NULL);
+    sql =
+        "CREATE TRIGGER remove_group AFTER DELETE ON groups"
+        "  BEGIN"
+        "    DELETE FROM group_packages WHERE groupKey = old.groupKey;"
+        "  END;";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
     if (rc != SQLITE_OK) {
         g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
-                     "Can not prepare filelist insertion: %s",
+                     "Can not create remove_group trigger: %s",
                      sqlite3_errmsg (db));
-        sqlite3_finalize (handle);
-        handle = NULL;
+        return;
     }
 
-    return handle;
-}
-
-typedef struct {
-    sqlite3 *db;
-    sqlite3_stmt *handle;
-    gint64 pkgKey;
-} FileWriteInfo;
-
-static void
-write_file (gpointer key, gpointer value, gpointer user_data)
-{
-    EncodedPackageFile *file = (EncodedPackageFile *) value;
-    FileWriteInfo *info = (FileWriteInfo *) user_data;
-    int rc;
-
-    sqlite3_bind_int  (info->handle, 1, info->pkgKey);
-    sqlite3_bind_text (info->handle, 2, (const char *) key, -1, SQLITE_STATIC);
-    sqlite3_bind_text (info->handle, 3, file->files->str, -1, SQLITE_STATIC);
-    sqlite3_bind_text (info->handle, 4, file->types->str, -1, SQLITE_STATIC);
-
-    rc = sqlite3_step (info->handle);
-    sqlite3_reset (info->handle);
-
-    if (rc != SQLITE_DONE) {
-        g_critical ("Error adding file to SQL: %s",
-                    sqlite3_errmsg (info->db));
+    sql =
+        "CREATE TRIGGER remove_category AFTER DELETE ON categories"
+        "  BEGIN"
+        "    DELETE FROM category_groups"
+        "      WHERE categoryKey = old.categoryKey;"
+        "  END;";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create remove_category trigger: %s",
+                     sqlite3_errmsg (db));
+        return;
     }
-}
 
-void
-yum_db_filelists_write (sqlite3 *db, sqlite3_stmt *handle, Package *p)
-{
-    GHashTable *hash;
-    FileWriteInfo info;
-
-    info.db = db;
-    info.handle = handle;
-    info.pkgKey = p->pkgKey;
-
-    hash = package_files_to_hash (p->files);
-    g_hash_table_foreach (hash, write_file, &info);
-    g_hash_table_destroy (hash);
+    sql =
+        "CREATE TRIGGER remove_environment AFTER DELETE ON environments"
+        "  BEGIN"
+        "    DELETE FROM environment_groups"
+        "      WHERE environmentKey = old.environmentKey;"
+        "  END;";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create remove_environment trigger: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
 }
 
 void
-yum_db_create_other_tables (sqlite3 *db, GError **err)
+yum_db_index_comps_tables (sqlite3 *db, GError **err)
 {
     int rc;
     const char *sql;
 
-    sql =
-        "CREATE TABLE packages ("
-        "  pkgKey INTEGER PRIMARY KEY,"
-        "  pkgId TEXT)";
+    sql = "CREATE INDEX IF NOT EXISTS groupid ON groups (id)";
     rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
     if (rc != SQLITE_OK) {
         g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
-                     "Can not create packages table: %s",
+                     "Can not create groupid index: %s",
                      sqlite3_errmsg (db));
         return;
     }
 
-    sql =
-        "CREATE TABLE changelog ("
-        "  pkgKey INTEGER,"
-        "  author TEXT,"
-        "  date INTEGER,"
-        "  changelog TEXT)";
+    sql = "CREATE INDEX IF NOT EXISTS grouppkgs "
+        "ON group_packages (groupKey)";
     rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
     if (rc != SQLITE_OK) {
         g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
-                     "Can not create changelog table: %s",
+                     "Can not create grouppkgs index: %s",
                      sqlite3_errmsg (db));
         return;
     }
 
-    sql =
-        "CREATE TRIGGER remove_changelogs AFTER DELETE ON packages"
-        "  BEGIN"
-        "    DELETE FROM changelog WHERE pkgKey = old.pkgKey;"
-        "  END;";
+    /* Which groups a package is in */
+    sql = "CREATE INDEX IF NOT EXISTS grouppkgname "
+        "ON group_packages (name)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create grouppkgname index: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
 
+    sql = "CREATE INDEX IF NOT EXISTS categoryid ON categories (id)";
     rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
     if (rc != SQLITE_OK) {
         g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
-                     "Can not create remove_changelogs trigger: %s",
+                     "Can not create categoryid index: %s",
                      sqlite3_errmsg (db));
         return;
     }
-}
 
-void
-yum_db_index_other_tables (sqlite3 *db, GError **err)
-{
-    int rc;
-    const char *sql;
+    sql = "CREATE INDEX IF NOT EXISTS categorygroups "
+        "ON category_groups (categoryKey)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create categorygroups index: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
 
-    sql = "CREATE INDEX IF NOT EXISTS keychange ON changelog (pkgKey)";
+    sql = "CREATE INDEX IF NOT EXISTS environmentid ON environments (id)";
     rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
     if (rc != SQLITE_OK) {
         g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
-                     "Can not create keychange index: %s",
+                     "Can not create environmentid index: %s",
                      sqlite3_errmsg (db));
         return;
     }
 
-    sql = "CREATE INDEX IF NOT EXISTS pkgId ON packages (pkgId)";
+    sql = "CREATE INDEX IF NOT EXISTS environmentgroups "
+        "ON environment_groups (environmentKey)";
     rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
     if (rc != SQLITE_OK) {
         g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
-                     "Can not create pkgId index: %s",
+                     "Can not create environmentgroups index: %s",
+                     sqlite3_errmsg (db));
+        return;
+    }
+
+    sql = "CREATE INDEX IF NOT EXISTS compstranslations "
+        "ON comps_translations (kind, id)";
+    rc = sqlite3_exec (db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not create compstranslations index: %s",
                      sqlite3_errmsg (db));
         return;
     }
 }
 
 sqlite3_stmt *
-yum_db_changelog_prepare (sqlite3 *db, GError **err)
+yum_db_comps_entry_prepare (sqlite3 *db, CompsKind kind, GError **err)
 {
     int rc;
     sqlite3_stmt *handle = NULL;
     const char *query;
 
-    query =
-        "INSERT INTO changelog (pkgKey, author, date, changelog) "
-        " VALUES (?, ?, ?, ?)";
+    if (kind == COMPS_GROUP)
+        query =
+            "INSERT INTO groups ("
+            "  id, name, description, display_order, is_default,"
+            "  uservisible, langonly) "
+            "VALUES (?, ?, ?, ?, ?, ?, ?)";
+    else if (kind == COMPS_CATEGORY)
+        query =
+            "INSERT INTO categories (id, name, description, display_order) "
+            "VALUES (?, ?, ?, ?)";
+    else
+        query =
+            "INSERT INTO environments ("
+            "  id, name, description, display_order) "
+            "VALUES (?, ?, ?, ?)";
 
     rc = sqlite3_prepare (db, query, -1, &handle, NULL);
     if (rc != SQLITE_OK) {
         g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
-                     "Can not prepare changelog insertion: %s",
+                     "Can not prepare comps insertion: %s",
                      sqlite3_errmsg (db));
         sqlite3_finalize (handle);
         handle = NULL;
@@ -960,26 +3067,140 @@ yum_db_changelog_prepare (sqlite3 *db, GError **err)
 }
 
 void
-yum_db_changelog_write (sqlite3 *db, sqlite3_stmt *handle, Package *p)
+yum_db_comps_entry_write (sqlite3 *db, sqlite3_stmt *handle, CompsEntry *entry)
 {
-    GSList *iter;
-    ChangelogEntry *entry;
     int rc;
 
-    for (iter = p->changelogs; iter; iter = iter->next) {
-        entry = (ChangelogEntry *) iter->data;
+    sqlite3_bind_text (handle, 1, entry->id, -1, SQLITE_STATIC);
+    sqlite3_bind_text (handle, 2, entry->name, -1, SQLITE_STATIC);
+    sqlite3_bind_text (handle, 3, entry->description, -1, SQLITE_STATIC);
+    /* Column affinity makes it a number */
+    sqlite3_bind_text (handle, 4, entry->display_order, -1, SQLITE_STATIC);
 
-        sqlite3_bind_int  (handle, 1, p->pkgKey);
-        sqlite3_bind_text (handle, 2, entry->author, -1, SQLITE_STATIC);
-        sqlite3_bind_int  (handle, 3, entry->date);
-        sqlite3_bind_text (handle, 4, entry->changelog, -1, SQLITE_STATIC);
+    if (entry->kind == COMPS_GROUP) {
+        sqlite3_bind_int (handle, 5, entry->is_default);
+        sqlite3_bind_int (handle, 6, entry->uservisible);
+        sqlite3_bind_text (handle, 7, entry->langonly, -1, SQLITE_STATIC);
+    }
 
-        rc = sqlite3_step (handle);
-        sqlite3_reset (handle);
+    rc = sqlite3_step (handle);
+    sqlite3_reset (handle);
 
-        if (rc != SQLITE_DONE) {
-            g_critical ("Error adding changelog to SQL: %s",
-                        sqlite3_errmsg (db));
-        }
+    if (rc != SQLITE_DONE) {
+        g_critical ("Error adding comps entry to SQL: %s",
+                    sqlite3_errmsg (db));
+    } else
+        entry->key = sqlite3_last_insert_rowid (db);
+}
+
+YumDbBatch *
+yum_db_group_packages_prepare (sqlite3 *db, GError **err)
+{
+    return batch_new (db, "group_packages",
+                      "groupKey, name, type, requires, basearchonly", 5,
+                      "group package", err);
+}
+
+void
+yum_db_group_packages_write (YumDbBatch *batch, CompsEntry *entry)
+{
+    GSList *iter;
+    CompsPackageReq *req;
+
+    for (iter = entry->packages; iter; iter = iter->next) {
+        req = (CompsPackageReq *) iter->data;
+
+        batch_int  (batch, entry->key);
+        batch_text (batch, req->name);
+        batch_text (batch, req->type);
+        batch_text (batch, req->requires);
+        batch_int  (batch, req->basearchonly);
+
+        batch_row_done (batch);
+    }
+}
+
+YumDbBatch *
+yum_db_category_groups_prepare (sqlite3 *db, GError **err)
+{
+    return batch_new (db, "category_groups",
+                      "categoryKey, groupid", 2,
+                      "category group", err);
+}
+
+void
+yum_db_category_groups_write (YumDbBatch *batch, CompsEntry *entry)
+{
+    GSList *iter;
+    CompsGroupId *group;
+
+    for (iter = entry->groups; iter; iter = iter->next) {
+        group = (CompsGroupId *) iter->data;
+
+        batch_int  (batch, entry->key);
+        batch_text (batch, group->id);
+
+        batch_row_done (batch);
+    }
+}
+
+YumDbBatch *
+yum_db_environment_groups_prepare (sqlite3 *db, GError **err)
+{
+    return batch_new (db, "environment_groups",
+                      "environmentKey, groupid, optional, is_default", 4,
+                      "environment group", err);
+}
+
+void
+yum_db_environment_groups_write (YumDbBatch *batch, CompsEntry *entry)
+{
+    GSList *iter;
+    CompsGroupId *group;
+
+    for (iter = entry->groups; iter; iter = iter->next) {
+        group = (CompsGroupId *) iter->data;
+
+        batch_int  (batch, entry->key);
+        batch_text (batch, group->id);
+        batch_int  (batch, group->optional);
+        batch_int  (batch, group->is_default);
+
+        batch_row_done (batch);
+    }
+}
+
+YumDbBatch *
+yum_db_comps_translations_prepare (sqlite3 *db, GError **err)
+{
+    return batch_new (db, "comps_translations",
+                      "kind, id, lang, name, description", 5,
+                      "comps translation", err);
+}
+
+void
+yum_db_comps_translations_write (YumDbBatch *batch, CompsEntry *entry)
+{
+    GSList *iter;
+    CompsTranslation *translation;
+    const char *kind;
+
+    if (entry->kind == COMPS_CATEGORY)
+        kind = "category";
+    else if (entry->kind == COMPS_ENVIRONMENT)
+        kind = "environment";
+    else
+        kind = "group";
+
+    for (iter = entry->translations; iter; iter = iter->next) {
+        translation = (CompsTranslation *) iter->data;
+
+        batch_text (batch, kind);
+        batch_text (batch, entry->id);
+        batch_text (batch, translation->lang);
+        batch_text (batch, translation->name);
+        batch_text (batch, translation->description);
+
+        batch_row_done (batch);
     }
 }
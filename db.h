@@ -21,47 +21,121 @@
 #include <glib.h>
 #include <sqlite3.h>
 #include "package.h"
+#include "pkgid-set.h"
 
 #define YUM_SQLITE_CACHE_DBVERSION 10
 
+/* Schema options, recorded in db_info */
+#define YUM_DB_FILELIST_DIRS (1 << 0)  /* filelist as a view over a dirs
+                                          dictionary and filelist_packed */
+#define YUM_DB_PRIMARY_CLUSTERED (1 << 1)  /* dependency and files tables
+                                              WITHOUT ROWID, keyed on
+                                              (name, pkgKey, seq) */
+#define YUM_DB_SEARCH_INDEX (1 << 2)  /* FTS5 packages_search table over
+                                         name, summary and description, or
+                                         changelog_search over changelog
+                                         text */
+#define YUM_DB_COMPRESS_TEXT (1 << 3)  /* description or changelog text as
+                                          zstd frames, see yum_unpack () */
+#define YUM_DB_PATH_INDEX (1 << 4)  /* FTS5 trigram table file_trigrams
+                                       over the file paths of each
+                                       package */
+
 #define YUM_DB_ERROR yum_db_error_quark()
 GQuark yum_db_error_quark (void);
 
 typedef void (*CreateTablesFn) (sqlite3 *db, GError **err);
 
+/* Named connection settings for cache builds: "default" or "bulk" */
+typedef struct _YumDbProfile YumDbProfile;
+
+/* Buffered rows of one table, written with multi-row INSERTs.  Flush
+   before every COMMIT.  A batch outlives its connection: moving it to
+   another one keeps the SQL and buffers, only the statements are
+   prepared again. */
+typedef struct _YumDbBatch YumDbBatch;
+
+const YumDbProfile *yum_db_profile_lookup   (const char *name);
+/* Whether its interrupted builds leave a checkpoint to resume from */
+gboolean      yum_db_profile_resumable      (const YumDbProfile *profile);
+void          yum_db_profile_done           (sqlite3 *db,
+                                             const YumDbProfile *profile);
+
 char         *yum_db_filename               (const char *prefix);
 sqlite3      *yum_db_open                   (const char *path,
                                              const char *checksum,
+                                             guint options,
+                                             const YumDbProfile *profile,
                                              CreateTablesFn create_tables,
                                              GError **err);
 
 void          yum_db_dbinfo_update          (sqlite3 *db,
                                              const char *checksum,
+                                             guint options,
                                              GError **err);
 
-GHashTable   *yum_db_read_package_ids       (sqlite3 *db, GError **err);
+guint32       yum_db_checkpoint_packages    (sqlite3 *db);
+void          yum_db_checkpoint_update      (sqlite3 *db,
+                                             const char *checksum,
+                                             guint options,
+                                             guint32 packages,
+                                             GError **err);
+
+void          yum_db_batch_set_db           (YumDbBatch *batch,
+                                             sqlite3 *db,
+                                             GError **err);
+void          yum_db_batch_flush            (YumDbBatch *batch);
+void          yum_db_batch_free             (YumDbBatch *batch);
+
+void          yum_db_read_package_ids       (sqlite3 *db,
+                                             YumPkgIdSet *set,
+                                             GError **err);
+gint64        yum_db_package_next_key       (sqlite3 *db);
+/* yum_pack (text) and yum_unpack (text) of YUM_DB_COMPRESS_TEXT caches,
+   yum_filelist_paths (dirname, filenames), yum_filelist_has (dirname,
+   filenames, path) and yum_filelist_glob (dirname, filenames, pattern) */
+void          yum_db_register_functions     (sqlite3 *db, GError **err);
+/* Whether the file at path is an sqlite database rather than metadata */
+gboolean      yum_db_is_database            (const char *path);
+/* pkgId, name, arch, epoch, version and release of the packages in the
+   primary cache at path, which is only read */
+void          yum_db_read_packages          (const char *path,
+                                             PackageFn package_fn,
+                                             gpointer user_data,
+                                             GError **err);
 
 /* Primary */
 
 void          yum_db_create_primary_tables  (sqlite3 *db, GError **err);
 void          yum_db_index_primary_tables   (sqlite3 *db, GError **err);
+void          yum_db_create_primary_clustered_tables (sqlite3 *db,
+                                                      GError **err);
+void          yum_db_index_primary_clustered_tables  (sqlite3 *db,
+                                                      GError **err);
+void          yum_db_stage_primary_tables   (sqlite3 *db, GError **err);
+void          yum_db_index_primary_search   (sqlite3 *db,
+                                             guint options,
+                                             GError **err);
+void          yum_db_pack_primary_text      (sqlite3 *db, GError **err);
+void          yum_db_index_primary_paths    (sqlite3 *db, GError **err);
 sqlite3_stmt *yum_db_package_prepare        (sqlite3 *db, GError **err);
 void          yum_db_package_write          (sqlite3 *db,
                                              sqlite3_stmt *handle,
                                              Package *p);
 
-sqlite3_stmt *yum_db_dependency_prepare     (sqlite3 *db,
+YumDbBatch   *yum_db_dependency_prepare     (sqlite3 *db,
                                              const char *table,
+                                             guint options,
                                              GError **err);
-void          yum_db_dependency_write       (sqlite3 *db,
-                                             sqlite3_stmt *handle,
+void          yum_db_dependency_write       (YumDbBatch *batch,
                                              gint64 pkgKey,
                                              Dependency *dep,
                                              gboolean isRequirement);
 
-sqlite3_stmt *yum_db_file_prepare           (sqlite3 *db, GError **err);
-void          yum_db_file_write             (sqlite3 *db,
-                                             sqlite3_stmt *handle,
+YumDbBatch   *yum_db_file_prepare           (sqlite3 *db,
+                                             guint options,
+                                             GError **err);
+void          yum_db_file_write             (YumDbBatch *batch,
                                              gint64 pkgKey,
                                              PackageFile *file);
 
@@ -69,23 +143,83 @@ void          yum_db_file_write             (sqlite3 *db,
 
 void          yum_db_create_filelist_tables (sqlite3 *db, GError **err);
 void          yum_db_index_filelist_tables  (sqlite3 *db, GError **err);
+void          yum_db_create_filelist_dirs_tables (sqlite3 *db, GError **err);
+void          yum_db_index_filelist_dirs_tables  (sqlite3 *db, GError **err);
+void          yum_db_index_filelist_paths   (sqlite3 *db, GError **err);
 sqlite3_stmt *yum_db_package_ids_prepare    (sqlite3 *db, GError **err);
 void          yum_db_package_ids_write      (sqlite3 *db,
                                              sqlite3_stmt *handle,
                                              Package *p);
 
+typedef struct _YumFilelistEncoder YumFilelistEncoder;
+
+YumFilelistEncoder *yum_db_filelist_encoder_new  (void);
+void          yum_db_filelist_encoder_free  (YumFilelistEncoder *enc);
+void          yum_db_filelist_encoder_use_dirs (YumFilelistEncoder *enc,
+                                                sqlite3 *db,
+                                                sqlite3_stmt *dirs_handle,
+                                                GError **err);
+
 sqlite3_stmt *yum_db_filelists_prepare      (sqlite3 *db, GError **err);
+sqlite3_stmt *yum_db_filelists_packed_prepare (sqlite3 *db, GError **err);
+sqlite3_stmt *yum_db_dirs_prepare           (sqlite3 *db, GError **err);
 void          yum_db_filelists_write        (sqlite3 *db,
                                              sqlite3_stmt *handle,
+                                             YumFilelistEncoder *enc,
                                              Package *p);
 
 /* Other */
 void          yum_db_create_other_tables    (sqlite3 *db, GError **err);
 void          yum_db_index_other_tables     (sqlite3 *db, GError **err);
-sqlite3_stmt *yum_db_changelog_prepare      (sqlite3 *db, GError **err);
-void          yum_db_changelog_write        (sqlite3 *db,
+void          yum_db_index_other_search     (sqlite3 *db,
+                                             guint options,
+                                             GError **err);
+void          yum_db_pack_other_text        (sqlite3 *db, GError **err);
+YumDbBatch   *yum_db_changelog_prepare      (sqlite3 *db, GError **err);
+void          yum_db_changelog_write        (YumDbBatch *batch, Package *p);
+
+/* Updateinfo */
+void          yum_db_create_updateinfo_tables (sqlite3 *db, GError **err);
+void          yum_db_index_updateinfo_tables  (sqlite3 *db, GError **err);
+sqlite3_stmt *yum_db_advisory_prepare       (sqlite3 *db, GError **err);
+void          yum_db_advisory_write         (sqlite3 *db,
                                              sqlite3_stmt *handle,
-                                             Package *p);
+                                             Advisory *a);
+YumDbBatch   *yum_db_advisory_references_prepare (sqlite3 *db, GError **err);
+void          yum_db_advisory_references_write   (YumDbBatch *batch,
+                                                  Advisory *a);
+YumDbBatch   *yum_db_advisory_packages_prepare   (sqlite3 *db, GError **err);
+void          yum_db_advisory_packages_write     (YumDbBatch *batch,
+                                                  Advisory *a);
+
+/* Prestodelta */
+void          yum_db_create_prestodelta_tables (sqlite3 *db, GError **err);
+void          yum_db_index_prestodelta_tables  (sqlite3 *db, GError **err);
+YumDbBatch   *yum_db_deltas_prepare         (sqlite3 *db, GError **err);
+void          yum_db_deltas_write           (YumDbBatch *batch,
+                                             DeltaPackage *p);
+
+/* Comps */
+void          yum_db_create_comps_tables    (sqlite3 *db, GError **err);
+void          yum_db_index_comps_tables     (sqlite3 *db, GError **err);
+sqlite3_stmt *yum_db_comps_entry_prepare    (sqlite3 *db,
+                                             CompsKind kind,
+                                             GError **err);
+void          yum_db_comps_entry_write      (sqlite3 *db,
+                                             sqlite3_stmt *handle,
+                                             CompsEntry *entry);
+YumDbBatch   *yum_db_group_packages_prepare (sqlite3 *db, GError **err);
+void          yum_db_group_packages_write   (YumDbBatch *batch,
+                                             CompsEntry *entry);
+YumDbBatch   *yum_db_category_groups_prepare (sqlite3 *db, GError **err);
+void          yum_db_category_groups_write   (YumDbBatch *batch,
+                                              CompsEntry *entry);
+YumDbBatch   *yum_db_environment_groups_prepare (sqlite3 *db, GError **err);
+void          yum_db_environment_groups_write   (YumDbBatch *batch,
+                                                 CompsEntry *entry);
+YumDbBatch   *yum_db_comps_translations_prepare (sqlite3 *db, GError **err);
+void          yum_db_comps_translations_write   (YumDbBatch *batch,
+                                                 CompsEntry *entry);
 
 
 #endif /* __YUM_DB_H__ */
@@ -0,0 +1,149 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <string.h>
+#include "sqlite-api.h"
+#include "filelist-row.h"
+
+/* Length of the part of a path that comes before the names of the row */
+static gsize
+row_prefix (const char *dirname)
+{
+    return strcmp (dirname, "/") ? strlen (dirname) + 1 : 1;
+}
+
+void
+yum_filelist_row_foreach (const char *dirname,
+                          const char *filenames,
+                          const char *filetypes,
+                          YumFilelistRowFn fn,
+                          gpointer user_data)
+{
+    GString *path;
+    gsize prefix;
+    const char *end;
+
+    path = g_string_new (dirname);
+    if (strcmp (dirname, "/"))
+        g_string_append_c (path, '/');
+    prefix = path->len;
+
+    for (;;) {
+        char type = '\0';
+
+        end = strchr (filenames, '/');
+        g_string_truncate (path, prefix);
+        if (end)
+            g_string_append_len (path, filenames, end - filenames);
+        else
+            g_string_append (path, filenames);
+
+        if (filetypes && *filetypes)
+            type = *filetypes++;
+
+        if (!fn (path->str, type, user_data) || !end)
+            break;
+        filenames = end + 1;
+    }
+
+    g_string_free (path, TRUE);
+}
+
+gboolean
+yum_filelist_row_has (const char *dirname,
+                      const char *filenames,
+                      const char *path)
+{
+    gsize prefix = row_prefix (dirname);
+    const char *name;
+    gsize name_len;
+    const char *end;
+
+    /* Into the directory of the row, then one of its names */
+    if (strncmp (path, dirname, prefix - 1) || path[prefix - 1] != '/')
+        return FALSE;
+
+    name = path + prefix;
+    name_len = strlen (name);
+    if (memchr (name, '/', name_len))
+        return FALSE;
+
+    for (;;) {
+        end = strchr (filenames, '/');
+        if (!end)
+            end = filenames + strlen (filenames);
+
+        if ((gsize) (end - filenames) == name_len &&
+            !memcmp (filenames, name, name_len))
+            return TRUE;
+
+        if (!*end)
+            return FALSE;
+        filenames = end + 1;
+    }
+}
+
+void
+yum_filelist_row_paths (const char *dirname,
+                        const char *filenames,
+                        GString *paths)
+{
+    gboolean root = strcmp (dirname, "/") == 0;
+    const char *end;
+
+    for (;;) {
+        end = strchr (filenames, '/');
+
+        if (paths->len)
+            g_string_append_c (paths, '\n');
+        g_string_append (paths, dirname);
+        if (!root)
+            g_string_append_c (paths, '/');
+        if (end)
+            g_string_append_len (paths, filenames, end - filenames);
+        else
+            g_string_append (paths, filenames);
+
+        if (!end)
+            break;
+        filenames = end + 1;
+    }
+}
+
+static gboolean
+row_glob_path (const char *path, char type, gpointer user_data)
+{
+    const char **pattern = (const char **) user_data;
+
+    /* Found, stop */
+    if (sqlite3_strglob (*pattern, path) == 0) {
+        *pattern = NULL;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+gboolean
+yum_filelist_row_glob (const char *dirname,
+                       const char *filenames,
+                       const char *pattern)
+{
+    yum_filelist_row_foreach (dirname, filenames, NULL, row_glob_path,
+                              &pattern);
+    return pattern == NULL;
+}
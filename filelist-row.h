@@ -0,0 +1,56 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef __YUM_FILELIST_ROW_H__
+#define __YUM_FILELIST_ROW_H__
+
+#include <glib.h>
+
+/* The (dirname, filenames, filetypes) rows of the filelist table, as
+ * yum_db_filelists_write () encodes them: the names of the files in one
+ * directory joined with '/', and a type letter ('f', 'd' or 'g') for each.
+ * A path is the dirname, a '/' unless the dirname is the root, and a
+ * name. */
+
+/* Called with each path of a row and its type, '\0' if there is none.
+   Returning FALSE stops. */
+typedef gboolean (*YumFilelistRowFn) (const char *path,
+                                      char type,
+                                      gpointer user_data);
+
+void      yum_filelist_row_foreach  (const char *dirname,
+                                     const char *filenames,
+                                     const char *filetypes,
+                                     YumFilelistRowFn fn,
+                                     gpointer user_data);
+
+/* Whether path is one of the paths of the row */
+gboolean  yum_filelist_row_has      (const char *dirname,
+                                     const char *filenames,
+                                     const char *path);
+
+/* Appends the paths of the row to paths, each on a line of its own */
+void      yum_filelist_row_paths    (const char *dirname,
+                                     const char *filenames,
+                                     GString *paths);
+
+/* Whether one of the paths of the row matches the GLOB pattern */
+gboolean  yum_filelist_row_glob     (const char *dirname,
+                                     const char *filenames,
+                                     const char *pattern);
+
+#endif /* __YUM_FILELIST_ROW_H__ */
@@ -0,0 +1,408 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <zlib.h>
+#include "gzip-reader.h"
+
+/* Output is inflated into a ring of the last YUM_GZIP_WINDOW_SIZE bytes,
+ * which is what a deflate block may refer back to.  inflate () is run with
+ * Z_BLOCK so it stops at every block boundary; a boundary, the input
+ * position and the ring make an access point.  Resuming at one is a raw
+ * inflate primed with the bits of the partial byte and the ring as its
+ * dictionary.  Gzip members that follow each other are read as one
+ * stream. */
+
+#define GZIP_INPUT_SIZE 65536
+
+struct _YumGzipReader {
+    char *path;
+    FILE *file;
+    gboolean plain;
+
+    z_stream strm;
+    gboolean strm_init;
+    /* Resumed at an access point, the gzip header of the member has been
+       read by someone else */
+    gboolean raw;
+    gboolean done;
+
+    guchar input[GZIP_INPUT_SIZE];
+    guint64 in_read;
+
+    guchar window[YUM_GZIP_WINDOW_SIZE];
+    guint window_pos;
+    guint pending;
+    guint64 produced;
+    guint64 out;
+
+    guint64 span;
+    YumGzipPointFn point_fn;
+    gpointer point_data;
+    guint64 last_point;
+    gboolean have_point;
+    guchar *point_window;
+};
+
+GQuark
+yum_gzip_error_quark (void)
+{
+    static GQuark quark;
+
+    if (!quark)
+        quark = g_quark_from_static_string ("yum_gzip_error");
+
+    return quark;
+}
+
+static YumGzipReader *
+reader_new (const char *path, GError **err)
+{
+    YumGzipReader *reader;
+    guchar magic[2];
+    size_t n;
+
+    reader = g_new0 (YumGzipReader, 1);
+    reader->path = g_strdup (path);
+    reader->file = fopen (path, "rb");
+    if (!reader->file) {
+        g_set_error (err, YUM_GZIP_ERROR, YUM_GZIP_ERROR,
+                     "Can not open %s: %s", path, g_strerror (errno));
+        yum_gzip_reader_close (reader);
+        return NULL;
+    }
+
+    n = fread (magic, 1, 2, reader->file);
+    reader->plain = n < 2 || magic[0] != 0x1f || magic[1] != 0x8b;
+    rewind (reader->file);
+
+    return reader;
+}
+
+YumGzipReader *
+yum_gzip_reader_open (const char *path, GError **err)
+{
+    YumGzipReader *reader;
+
+    reader = reader_new (path, err);
+    if (!reader || reader->plain)
+        return reader;
+
+    /* 16: gzip header and trailer */
+    if (inflateInit2 (&reader->strm, 15 + 16) != Z_OK) {
+        g_set_error (err, YUM_GZIP_ERROR, YUM_GZIP_ERROR,
+                     "Can not decompress %s: out of memory", path);
+        yum_gzip_reader_close (reader);
+        return NULL;
+    }
+    reader->strm_init = TRUE;
+
+    return reader;
+}
+
+YumGzipReader *
+yum_gzip_reader_open_at (const char *path,
+                         const YumGzipPoint *point,
+                         const guchar *window,
+                         GError **err)
+{
+    YumGzipReader *reader;
+    int c = 0;
+
+    reader = reader_new (path, err);
+    if (!reader)
+        return NULL;
+
+    reader->out = reader->produced = point->out;
+    reader->in_read = point->in;
+
+    if (fseeko (reader->file, point->in - (point->bits ? 1 : 0),
+                SEEK_SET) != 0 ||
+        (point->bits && (c = getc (reader->file)) == EOF)) {
+        g_set_error (err, YUM_GZIP_ERROR, YUM_GZIP_ERROR,
+                     "Can not seek in %s, has it changed?", path);
+        yum_gzip_reader_close (reader);
+        return NULL;
+    }
+
+    if (reader->plain)
+        return reader;
+
+    if (inflateInit2 (&reader->strm, -15) != Z_OK) {
+        g_set_error (err, YUM_GZIP_ERROR, YUM_GZIP_ERROR,
+                     "Can not decompress %s: out of memory", path);
+        yum_gzip_reader_close (reader);
+        return NULL;
+    }
+    reader->strm_init = TRUE;
+    reader->raw = TRUE;
+
+    if (point->bits)
+        inflatePrime (&reader->strm, point->bits, c >> (8 - point->bits));
+    if (point->window_len)
+        inflateSetDictionary (&reader->strm, window, point->window_len);
+
+    return reader;
+}
+
+void
+yum_gzip_reader_close (YumGzipReader *reader)
+{
+    if (reader->strm_init)
+        inflateEnd (&reader->strm);
+    if (reader->file)
+        fclose (reader->file);
+
+    g_free (reader->point_window);
+    g_free (reader->path);
+    g_free (reader);
+}
+
+void
+yum_gzip_reader_set_points (YumGzipReader *reader,
+                            guint64 span,
+                            YumGzipPointFn point_fn,
+                            gpointer user_data)
+{
+    reader->span = span;
+    reader->point_fn = point_fn;
+    reader->point_data = user_data;
+}
+
+guint64
+yum_gzip_reader_offset (YumGzipReader *reader)
+{
+    return reader->out;
+}
+
+static gboolean
+point_due (YumGzipReader *reader)
+{
+    return reader->point_fn &&
+        (!reader->have_point ||
+         reader->produced - reader->last_point >= reader->span);
+}
+
+static void
+emit_point (YumGzipReader *reader, guint64 in, guint bits)
+{
+    YumGzipPoint point;
+    guint len = 0;
+
+    point.out = reader->produced;
+    point.in = in;
+    point.bits = bits;
+
+    if (!reader->plain) {
+        if (!reader->point_window)
+            reader->point_window = g_malloc (YUM_GZIP_WINDOW_SIZE);
+
+        /* Oldest byte first */
+        if (reader->produced < YUM_GZIP_WINDOW_SIZE) {
+            len = reader->window_pos;
+            memcpy (reader->point_window, reader->window, len);
+        } else {
+            len = YUM_GZIP_WINDOW_SIZE - reader->window_pos;
+            memcpy (reader->point_window, reader->window + reader->window_pos,
+                    len);
+            memcpy (reader->point_window + len, reader->window,
+                    reader->window_pos);
+            len = YUM_GZIP_WINDOW_SIZE;
+        }
+    }
+    point.window_len = len;
+
+    reader->point_fn (&point, reader->point_window, reader->point_data);
+    reader->last_point = reader->produced;
+    reader->have_point = TRUE;
+}
+
+static gboolean
+fill_input (YumGzipReader *reader, GError **err)
+{
+    size_t n;
+
+    n = fread (reader->input, 1, GZIP_INPUT_SIZE, reader->file);
+    if (n == 0 && ferror (reader->file)) {
+        g_set_error (err, YUM_GZIP_ERROR, YUM_GZIP_ERROR,
+                     "Can not read %s: %s", reader->path, g_strerror (errno));
+        return FALSE;
+    }
+
+    reader->strm.next_in = reader->input;
+    reader->strm.avail_in = n;
+    reader->in_read += n;
+
+    return TRUE;
+}
+
+/* After a member: its trailer, unless inflate read it, and maybe another
+   member */
+static gboolean
+next_member (YumGzipReader *reader, GError **err)
+{
+    guint trailer = reader->raw ? 8 : 0;
+
+    while (TRUE) {
+        guint n;
+
+        if (reader->strm.avail_in == 0 && !fill_input (reader, err))
+            return FALSE;
+        if (reader->strm.avail_in == 0) {
+            reader->done = TRUE;
+            return TRUE;
+        }
+
+        n = MIN (trailer, reader->strm.avail_in);
+        reader->strm.next_in += n;
+        reader->strm.avail_in -= n;
+        trailer -= n;
+
+        if (trailer == 0 && reader->strm.avail_in > 0)
+            break;
+    }
+
+    reader->raw = FALSE;
+    inflateReset2 (&reader->strm, 15 + 16);
+
+    return TRUE;
+}
+
+/* Inflates into the ring, which has nothing pending */
+static gboolean
+fill_window (YumGzipReader *reader, GError **err)
+{
+    z_stream *strm = &reader->strm;
+    guint space;
+    guint n;
+    int ret;
+
+    if (reader->window_pos == YUM_GZIP_WINDOW_SIZE)
+        reader->window_pos = 0;
+
+    if (strm->avail_in == 0) {
+        if (!fill_input (reader, err))
+            return FALSE;
+        if (strm->avail_in == 0) {
+            g_set_error (err, YUM_GZIP_ERROR, YUM_GZIP_ERROR,
+                         "%s is truncated", reader->path);
+            return FALSE;
+        }
+    }
+
+    space = YUM_GZIP_WINDOW_SIZE - reader->window_pos;
+    strm->next_out = reader->window + reader->window_pos;
+    strm->avail_out = space;
+
+    ret = inflate (strm, Z_BLOCK);
+    if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+        g_set_error (err, YUM_GZIP_ERROR, YUM_GZIP_ERROR,
+                     "Can not decompress %s: %s", reader->path,
+                     strm->msg ? strm->msg : "invalid data");
+        return FALSE;
+    }
+
+    n = space - strm->avail_out;
+    reader->window_pos += n;
+    reader->pending = n;
+    reader->produced += n;
+
+    if (ret == Z_STREAM_END)
+        return next_member (reader, err);
+
+    /* At a block boundary that is not the end of the member */
+    if ((strm->data_type & 128) && !(strm->data_type & 64) &&
+        point_due (reader))
+        emit_point (reader, reader->in_read - strm->avail_in,
+                    strm->data_type & 7);
+
+    return TRUE;
+}
+
+gssize
+yum_gzip_reader_read (YumGzipReader *reader,
+                      char *buf,
+                      gsize len,
+                      GError **err)
+{
+    gsize got = 0;
+
+    if (reader->plain) {
+        size_t n;
+
+        if (point_due (reader))
+            emit_point (reader, reader->produced, 0);
+
+        n = fread (buf, 1, len, reader->file);
+        if (n == 0 && ferror (reader->file)) {
+            g_set_error (err, YUM_GZIP_ERROR, YUM_GZIP_ERROR,
+                         "Can not read %s: %s", reader->path,
+                         g_strerror (errno));
+            return -1;
+        }
+
+        reader->produced += n;
+        reader->out += n;
+        return n;
+    }
+
+    while (got < len) {
+        guint n;
+
+        if (reader->pending == 0) {
+            if (reader->done)
+                break;
+            if (!fill_window (reader, err))
+                return -1;
+            continue;
+        }
+
+        n = MIN (reader->pending, len - got);
+        memcpy (buf + got, reader->window + reader->window_pos -
+                reader->pending, n);
+        reader->pending -= n;
+        reader->out += n;
+        got += n;
+    }
+
+    return got;
+}
+
+gboolean
+yum_gzip_reader_skip (YumGzipReader *reader, guint64 len, GError **err)
+{
+    char buf[8192];
+
+    while (len > 0) {
+        gssize n;
+
+        n = yum_gzip_reader_read (reader, buf, MIN (len, sizeof (buf)), err);
+        if (n < 0)
+            return FALSE;
+        if (n == 0) {
+            g_set_error (err, YUM_GZIP_ERROR, YUM_GZIP_ERROR,
+                         "%s is shorter than expected", reader->path);
+            return FALSE;
+        }
+
+        len -= n;
+    }
+
+    return TRUE;
+}
@@ -0,0 +1,77 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef __YUM_GZIP_READER_H__
+#define __YUM_GZIP_READER_H__
+
+#include <glib.h>
+
+/* Sequential reader for gzip compressed (or plain) metadata that can note
+ * access points on the way and later start decompressing at one of them
+ * instead of at the beginning of the file. */
+
+#define YUM_GZIP_WINDOW_SIZE 32768
+
+#define YUM_GZIP_ERROR yum_gzip_error_quark()
+GQuark yum_gzip_error_quark (void);
+
+/* Where decompression can resume: the first byte of a deflate block.  The
+ * block starts bits bits before the byte at offset in of the file; the
+ * window is the output that preceded it, window_len bytes. */
+typedef struct {
+    guint64 out;
+    guint64 in;
+    guint32 bits;
+    guint32 window_len;
+} YumGzipPoint;
+
+typedef void (*YumGzipPointFn) (const YumGzipPoint *point,
+                                const guchar *window,
+                                gpointer user_data);
+
+typedef struct _YumGzipReader YumGzipReader;
+
+YumGzipReader *yum_gzip_reader_open         (const char *path,
+                                             GError **err);
+YumGzipReader *yum_gzip_reader_open_at      (const char *path,
+                                             const YumGzipPoint *point,
+                                             const guchar *window,
+                                             GError **err);
+void           yum_gzip_reader_close        (YumGzipReader *reader);
+
+/* Calls point_fn at the first block boundary after every span bytes of
+   output, starting with the beginning of the data.  Plain files need no
+   window and get a point every span bytes. */
+void           yum_gzip_reader_set_points   (YumGzipReader *reader,
+                                             guint64 span,
+                                             YumGzipPointFn point_fn,
+                                             gpointer user_data);
+
+/* Returns the number of bytes read, 0 at the end of the data and -1 on
+   errors */
+gssize         yum_gzip_reader_read         (YumGzipReader *reader,
+                                             char *buf,
+                                             gsize len,
+                                             GError **err);
+gboolean       yum_gzip_reader_skip         (YumGzipReader *reader,
+                                             guint64 len,
+                                             GError **err);
+
+/* Uncompressed offset of the next byte read */
+guint64        yum_gzip_reader_offset       (YumGzipReader *reader);
+
+#endif /* __YUM_GZIP_READER_H__ */
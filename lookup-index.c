@@ -0,0 +1,911 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "lookup-index.h"
+
+/*
+ * File layout:
+ *
+ *   IndexHeader
+ *   guint32         string offsets, n_strings + 1 entries
+ *   char            string data, NUL terminated, sorted by strcmp()
+ *   YumIndexPackage packages, n_packages entries
+ *   guint32         provides ranges, n_packages + 1 entries
+ *   YumIndexProvide provides, n_provides entries
+ *   guint32         files ranges, n_packages + 1 entries
+ *   guint32         files (string ids), n_files entries
+ *   IndexBucket     provides hash, provides_buckets entries
+ *   guint32         provides postings (package numbers)
+ *   IndexBucket     files hash, files_buckets entries
+ *   guint32         files postings (package numbers)
+ *
+ * Strings are referred to by their position in the sorted string table,
+ * packages by their position in the package array.  The hash tables use
+ * open addressing with linear probing over a power of two number of
+ * buckets; every bucket points at a sorted run of package numbers.
+ */
+
+#define INDEX_MAGIC "YUMINDEX"
+#define INDEX_BYTE_ORDER 0x01020304
+#define INDEX_ALIGN 8
+
+typedef struct {
+    char magic[8];
+    guint32 version;
+    guint32 byte_order;
+    guint32 checksum;
+    guint32 n_strings;
+    guint32 n_packages;
+    guint32 n_provides;
+    guint32 n_files;
+    guint32 provides_buckets;
+    guint32 files_buckets;
+    guint32 reserved;
+    guint64 strings_offset;
+    guint64 string_data_offset;
+    guint64 packages_offset;
+    guint64 provides_ranges_offset;
+    guint64 provides_offset;
+    guint64 files_ranges_offset;
+    guint64 files_offset;
+    guint64 provides_hash_offset;
+    guint64 provides_postings_offset;
+    guint64 files_hash_offset;
+    guint64 files_postings_offset;
+    guint64 size;
+} IndexHeader;
+
+typedef struct {
+    guint32 key;
+    guint32 hash;
+    guint32 start;
+    guint32 count;
+} IndexBucket;
+
+GQuark
+yum_index_error_quark (void)
+{
+    static GQuark quark;
+
+    if (!quark)
+        quark = g_quark_from_static_string ("yum_index_error");
+
+    return quark;
+}
+
+/* FNV-1a, part of the file format; do not change without bumping
+   YUM_INDEX_VERSION. */
+static guint32
+index_hash (const char *s)
+{
+    guint32 h = 2166136261U;
+
+    for (; *s; s++) {
+        h ^= (guchar) *s;
+        h *= 16777619U;
+    }
+
+    return h;
+}
+
+char *
+yum_index_filename (const char *prefix)
+{
+    return g_strconcat (prefix, ".idx", NULL);
+}
+
+/*****************************************************************************/
+
+struct _YumIndexWriter {
+    GHashTable *strings;
+    GPtrArray *string_list;
+    GStringChunk *chunk;
+
+    GArray *packages;
+    GArray *provides;
+    GArray *provides_ranges;
+    GArray *files;
+    GArray *files_ranges;
+};
+
+/* A (key, package) pair, sorted to build the hash postings */
+typedef struct {
+    guint32 key;
+    guint32 pkg;
+} IndexPair;
+
+YumIndexWriter *
+yum_index_writer_new (void)
+{
+    YumIndexWriter *writer;
+    guint32 zero = 0;
+
+    writer = g_new0 (YumIndexWriter, 1);
+    writer->strings = g_hash_table_new (g_str_hash, g_str_equal);
+    writer->string_list = g_ptr_array_new ();
+    writer->chunk = g_string_chunk_new (64 * 1024);
+
+    writer->packages = g_array_new (FALSE, FALSE, sizeof (YumIndexPackage));
+    writer->provides = g_array_new (FALSE, FALSE, sizeof (YumIndexProvide));
+    writer->provides_ranges = g_array_new (FALSE, FALSE, sizeof (guint32));
+    writer->files = g_array_new (FALSE, FALSE, sizeof (guint32));
+    writer->files_ranges = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+    g_array_append_val (writer->provides_ranges, zero);
+    g_array_append_val (writer->files_ranges, zero);
+
+    return writer;
+}
+
+void
+yum_index_writer_free (YumIndexWriter *writer)
+{
+    g_hash_table_destroy (writer->strings);
+    g_ptr_array_free (writer->string_list, TRUE);
+    g_string_chunk_free (writer->chunk);
+
+    g_array_free (writer->packages, TRUE);
+    g_array_free (writer->provides, TRUE);
+    g_array_free (writer->provides_ranges, TRUE);
+    g_array_free (writer->files, TRUE);
+    g_array_free (writer->files_ranges, TRUE);
+
+    g_free (writer);
+}
+
+/* Returns a temporary string id, remapped to the sorted order on write */
+static guint32
+writer_intern (YumIndexWriter *writer, const char *s)
+{
+    gpointer value;
+    char *copy;
+
+    if (!s)
+        return YUM_INDEX_NONE;
+
+    value = g_hash_table_lookup (writer->strings, s);
+    if (value)
+        return GPOINTER_TO_UINT (value) - 1;
+
+    copy = g_string_chunk_insert (writer->chunk, s);
+    g_ptr_array_add (writer->string_list, copy);
+    g_hash_table_insert (writer->strings, copy,
+                         GUINT_TO_POINTER (writer->string_list->len));
+
+    return writer->string_list->len - 1;
+}
+
+void
+yum_index_writer_add (YumIndexWriter *writer, Package *p)
+{
+    YumIndexPackage pkg;
+    GSList *iter;
+    guint32 end;
+
+    memset (&pkg, 0, sizeof (YumIndexPackage));
+    pkg.pkgId = writer_intern (writer, p->pkgId);
+    pkg.name = writer_intern (writer, p->name);
+    pkg.arch = writer_intern (writer, p->arch);
+    pkg.epoch = writer_intern (writer, p->epoch);
+    pkg.version = writer_intern (writer, p->version);
+    pkg.release = writer_intern (writer, p->release);
+    pkg.location_href = writer_intern (writer, p->location_href);
+    g_array_append_val (writer->packages, pkg);
+
+    for (iter = p->provides; iter; iter = iter->next) {
+        Dependency *dep = (Dependency *) iter->data;
+        YumIndexProvide provide;
+
+        provide.name = writer_intern (writer, dep->name);
+        provide.flags = writer_intern (writer, dep->flags);
+        provide.epoch = writer_intern (writer, dep->epoch);
+        provide.version = writer_intern (writer, dep->version);
+        provide.release = writer_intern (writer, dep->release);
+        g_array_append_val (writer->provides, provide);
+    }
+    end = writer->provides->len;
+    g_array_append_val (writer->provides_ranges, end);
+
+    for (iter = p->files; iter; iter = iter->next) {
+        PackageFile *file = (PackageFile *) iter->data;
+        guint32 id;
+
+        id = writer_intern (writer, file->name);
+        g_array_append_val (writer->files, id);
+    }
+    end = writer->files->len;
+    g_array_append_val (writer->files_ranges, end);
+}
+
+static gint
+string_ptr_cmp (gconstpointer a, gconstpointer b)
+{
+    return strcmp (*(const char **) a, *(const char **) b);
+}
+
+static gint
+index_pair_cmp (gconstpointer a, gconstpointer b)
+{
+    const IndexPair *pa = (const IndexPair *) a;
+    const IndexPair *pb = (const IndexPair *) b;
+
+    if (pa->key != pb->key)
+        return pa->key < pb->key ? -1 : 1;
+    if (pa->pkg != pb->pkg)
+        return pa->pkg < pb->pkg ? -1 : 1;
+    return 0;
+}
+
+/* Turns a list of (key, package) pairs into a hash table and its
+   postings.  Keys must already be final string ids. */
+static void
+build_hash (GArray *pairs,
+            GPtrArray *sorted_strings,
+            GArray *buckets,
+            GArray *postings)
+{
+    guint32 n_keys = 0;
+    guint32 n_buckets = 8;
+    guint32 mask;
+    guint i;
+
+    g_array_sort (pairs, index_pair_cmp);
+
+    for (i = 0; i < pairs->len; i++) {
+        IndexPair *pair = &g_array_index (pairs, IndexPair, i);
+
+        if (i == 0 || pair->key != g_array_index (pairs, IndexPair, i - 1).key)
+            n_keys++;
+    }
+
+    /* Keep the load factor under one half */
+    while (n_buckets < n_keys * 2)
+        n_buckets <<= 1;
+    mask = n_buckets - 1;
+
+    g_array_set_size (buckets, n_buckets);
+    for (i = 0; i < n_buckets; i++) {
+        IndexBucket *bucket = &g_array_index (buckets, IndexBucket, i);
+
+        bucket->key = YUM_INDEX_NONE;
+        bucket->hash = 0;
+        bucket->start = 0;
+        bucket->count = 0;
+    }
+
+    i = 0;
+    while (i < pairs->len) {
+        guint32 key = g_array_index (pairs, IndexPair, i).key;
+        guint32 hash;
+        guint32 slot;
+        IndexBucket *bucket;
+
+        hash = index_hash (g_ptr_array_index (sorted_strings, key));
+        for (slot = hash & mask;
+             g_array_index (buckets, IndexBucket, slot).key != YUM_INDEX_NONE;
+             slot = (slot + 1) & mask)
+            ;
+
+        bucket = &g_array_index (buckets, IndexBucket, slot);
+        bucket->key = key;
+        bucket->hash = hash;
+        bucket->start = postings->len;
+
+        for (; i < pairs->len &&
+                 g_array_index (pairs, IndexPair, i).key == key; i++) {
+            guint32 pkg = g_array_index (pairs, IndexPair, i).pkg;
+
+            /* Pairs are sorted, so duplicates are adjacent */
+            if (postings->len > bucket->start &&
+                g_array_index (postings, guint32, postings->len - 1) == pkg)
+                continue;
+
+            g_array_append_val (postings, pkg);
+        }
+
+        bucket->count = postings->len - bucket->start;
+    }
+}
+
+static guint32
+remap_id (const guint32 *remap, guint32 id)
+{
+    return id == YUM_INDEX_NONE ? id : remap[id];
+}
+
+static gboolean
+write_section (FILE *f, guint64 *offset, gconstpointer data, gsize len)
+{
+    static const char padding[INDEX_ALIGN] = { 0 };
+    gsize pad;
+
+    if (len && fwrite (data, 1, len, f) != len)
+        return FALSE;
+    *offset += len;
+
+    pad = (INDEX_ALIGN - (*offset % INDEX_ALIGN)) % INDEX_ALIGN;
+    if (pad && fwrite (padding, 1, pad, f) != pad)
+        return FALSE;
+    *offset += pad;
+
+    return TRUE;
+}
+
+void
+yum_index_writer_write (YumIndexWriter *writer,
+                        const char *path,
+                        const char *checksum,
+                        GError **err)
+{
+    IndexHeader header;
+    GPtrArray *sorted;
+    guint32 *remap = NULL;
+    GArray *string_offsets;
+    GString *string_data;
+    GArray *provide_pairs;
+    GArray *file_pairs;
+    GArray *provides_hash;
+    GArray *provides_postings;
+    GArray *files_hash;
+    GArray *files_postings;
+    char *tmp_path;
+    FILE *f = NULL;
+    guint64 offset;
+    guint32 checksum_id;
+    guint32 data_len;
+    gboolean written = FALSE;
+    guint i, j;
+
+    checksum_id = writer_intern (writer, checksum);
+
+    /* Sort the string table and map temporary ids to their final
+       position */
+    sorted = g_ptr_array_sized_new (writer->string_list->len);
+    for (i = 0; i < writer->string_list->len; i++)
+        g_ptr_array_add (sorted, g_ptr_array_index (writer->string_list, i));
+    g_ptr_array_sort (sorted, string_ptr_cmp);
+
+    remap = g_new (guint32, writer->string_list->len + 1);
+    string_offsets = g_array_sized_new (FALSE, FALSE, sizeof (guint32),
+                                        sorted->len + 1);
+    string_data = g_string_sized_new (64 * 1024);
+
+    for (i = 0; i < sorted->len; i++) {
+        const char *s = g_ptr_array_index (sorted, i);
+        guint32 tmp_id;
+        guint32 off = string_data->len;
+
+        tmp_id = GPOINTER_TO_UINT (g_hash_table_lookup (writer->strings, s)) - 1;
+        remap[tmp_id] = i;
+
+        g_array_append_val (string_offsets, off);
+        g_string_append_len (string_data, s, strlen (s) + 1);
+    }
+    data_len = string_data->len;
+    g_array_append_val (string_offsets, data_len);
+
+    for (i = 0; i < writer->packages->len; i++) {
+        YumIndexPackage *pkg = &g_array_index (writer->packages,
+                                               YumIndexPackage, i);
+
+        pkg->pkgId = remap_id (remap, pkg->pkgId);
+        pkg->name = remap_id (remap, pkg->name);
+        pkg->arch = remap_id (remap, pkg->arch);
+        pkg->epoch = remap_id (remap, pkg->epoch);
+        pkg->version = remap_id (remap, pkg->version);
+        pkg->release = remap_id (remap, pkg->release);
+        pkg->location_href = remap_id (remap, pkg->location_href);
+    }
+
+    provide_pairs = g_array_sized_new (FALSE, FALSE, sizeof (IndexPair),
+                                       writer->provides->len);
+    for (i = 0; i < writer->packages->len; i++) {
+        guint32 start = g_array_index (writer->provides_ranges, guint32, i);
+        guint32 end = g_array_index (writer->provides_ranges, guint32, i + 1);
+
+        for (j = start; j < end; j++) {
+            YumIndexProvide *provide = &g_array_index (writer->provides,
+                                                       YumIndexProvide, j);
+            IndexPair pair;
+
+            provide->name = remap_id (remap, provide->name);
+            provide->flags = remap_id (remap, provide->flags);
+            provide->epoch = remap_id (remap, provide->epoch);
+            provide->version = remap_id (remap, provide->version);
+            provide->release = remap_id (remap, provide->release);
+
+            pair.key = provide->name;
+            pair.pkg = i;
+            g_array_append_val (provide_pairs, pair);
+        }
+    }
+
+    file_pairs = g_array_sized_new (FALSE, FALSE, sizeof (IndexPair),
+                                    writer->files->len);
+    for (i = 0; i < writer->packages->len; i++) {
+        guint32 start = g_array_index (writer->files_ranges, guint32, i);
+        guint32 end = g_array_index (writer->files_ranges, guint32, i + 1);
+
+        for (j = start; j < end; j++) {
+            guint32 *file = &g_array_index (writer->files, guint32, j);
+            IndexPair pair;
+
+            *file = remap_id (remap, *file);
+
+            pair.key = *file;
+            pair.pkg = i;
+            g_array_append_val (file_pairs, pair);
+        }
+    }
+
+    provides_hash = g_array_new (FALSE, FALSE, sizeof (IndexBucket));
+    provides_postings = g_array_new (FALSE, FALSE, sizeof (guint32));
+    build_hash (provide_pairs, sorted, provides_hash, provides_postings);
+
+    files_hash = g_array_new (FALSE, FALSE, sizeof (IndexBucket));
+    files_postings = g_array_new (FALSE, FALSE, sizeof (guint32));
+    build_hash (file_pairs, sorted, files_hash, files_postings);
+
+    /* Lay out the sections */
+    memset (&header, 0, sizeof (IndexHeader));
+    memcpy (header.magic, INDEX_MAGIC, sizeof (header.magic));
+    header.version = YUM_INDEX_VERSION;
+    header.byte_order = INDEX_BYTE_ORDER;
+    header.checksum = remap[checksum_id];
+    header.n_strings = sorted->len;
+    header.n_packages = writer->packages->len;
+    header.n_provides = writer->provides->len;
+    header.n_files = writer->files->len;
+    header.provides_buckets = provides_hash->len;
+    header.files_buckets = files_hash->len;
+
+#define ALIGNED(n) (((n) + INDEX_ALIGN - 1) & ~((guint64) INDEX_ALIGN - 1))
+    offset = ALIGNED (sizeof (IndexHeader));
+    header.strings_offset = offset;
+    offset += ALIGNED ((guint64) string_offsets->len * sizeof (guint32));
+    header.string_data_offset = offset;
+    offset += ALIGNED ((guint64) string_data->len);
+    header.packages_offset = offset;
+    offset += ALIGNED ((guint64) writer->packages->len *
+                       sizeof (YumIndexPackage));
+    header.provides_ranges_offset = offset;
+    offset += ALIGNED ((guint64) writer->provides_ranges->len *
+                       sizeof (guint32));
+    header.provides_offset = offset;
+    offset += ALIGNED ((guint64) writer->provides->len *
+                       sizeof (YumIndexProvide));
+    header.files_ranges_offset = offset;
+    offset += ALIGNED ((guint64) writer->files_ranges->len * sizeof (guint32));
+    header.files_offset = offset;
+    offset += ALIGNED ((guint64) writer->files->len * sizeof (guint32));
+    header.provides_hash_offset = offset;
+    offset += ALIGNED ((guint64) provides_hash->len * sizeof (IndexBucket));
+    header.provides_postings_offset = offset;
+    offset += ALIGNED ((guint64) provides_postings->len * sizeof (guint32));
+    header.files_hash_offset = offset;
+    offset += ALIGNED ((guint64) files_hash->len * sizeof (IndexBucket));
+    header.files_postings_offset = offset;
+    offset += ALIGNED ((guint64) files_postings->len * sizeof (guint32));
+    header.size = offset;
+#undef ALIGNED
+
+    /* Write to a temporary file and move it into place, so readers
+       never map a half written index */
+    tmp_path = g_strconcat (path, ".tmp", NULL);
+    f = fopen (tmp_path, "wb");
+    if (!f) {
+        g_set_error (err, YUM_INDEX_ERROR, YUM_INDEX_ERROR,
+                     "Can not create index file %s: %s",
+                     tmp_path, g_strerror (errno));
+        goto cleanup;
+    }
+
+    offset = 0;
+    if (!write_section (f, &offset, &header, sizeof (IndexHeader)) ||
+        !write_section (f, &offset, string_offsets->data,
+                        string_offsets->len * sizeof (guint32)) ||
+        !write_section (f, &offset, string_data->str, string_data->len) ||
+        !write_section (f, &offset, writer->packages->data,
+                        writer->packages->len * sizeof (YumIndexPackage)) ||
+        !write_section (f, &offset, writer->provides_ranges->data,
+                        writer->provides_ranges->len * sizeof (guint32)) ||
+        !write_section (f, &offset, writer->provides->data,
+                        writer->provides->len * sizeof (YumIndexProvide)) ||
+        !write_section (f, &offset, writer->files_ranges->data,
+                        writer->files_ranges->len * sizeof (guint32)) ||
+        !write_section (f, &offset, writer->files->data,
+                        writer->files->len * sizeof (guint32)) ||
+        !write_section (f, &offset, provides_hash->data,
+                        provides_hash->len * sizeof (IndexBucket)) ||
+        !write_section (f, &offset, provides_postings->data,
+                        provides_postings->len * sizeof (guint32)) ||
+        !write_section (f, &offset, files_hash->data,
+                        files_hash->len * sizeof (IndexBucket)) ||
+        !write_section (f, &offset, files_postings->data,
+                        files_postings->len * sizeof (guint32))) {
+        g_set_error (err, YUM_INDEX_ERROR, YUM_INDEX_ERROR,
+                     "Can not write index file %s: %s",
+                     tmp_path, g_strerror (errno));
+        goto cleanup;
+    }
+
+    if (fclose (f) != 0) {
+        f = NULL;
+        g_set_error (err, YUM_INDEX_ERROR, YUM_INDEX_ERROR,
+                     "Can not write index file %s: %s",
+                     tmp_path, g_strerror (errno));
+        goto cleanup;
+    }
+    f = NULL;
+
+    if (rename (tmp_path, path) != 0)
+        g_set_error (err, YUM_INDEX_ERROR, YUM_INDEX_ERROR,
+                     "Can not rename index file to %s: %s",
+                     path, g_strerror (errno));
+    else
+        written = TRUE;
+
+ cleanup:
+    if (f)
+        fclose (f);
+    if (!written)
+        unlink (tmp_path);
+    g_free (tmp_path);
+
+    g_free (remap);
+    g_ptr_array_free (sorted, TRUE);
+    g_array_free (string_offsets, TRUE);
+    g_string_free (string_data, TRUE);
+    g_array_free (provide_pairs, TRUE);
+    g_array_free (file_pairs, TRUE);
+    g_array_free (provides_hash, TRUE);
+    g_array_free (provides_postings, TRUE);
+    g_array_free (files_hash, TRUE);
+    g_array_free (files_postings, TRUE);
+}
+
+/*****************************************************************************/
+
+struct _YumIndex {
+    gpointer map;
+    gsize size;
+
+    const IndexHeader *header;
+    const guint32 *string_offsets;
+    const char *string_data;
+    const YumIndexPackage *packages;
+    const guint32 *provides_ranges;
+    const YumIndexProvide *provides;
+    const guint32 *files_ranges;
+    const guint32 *files;
+    const IndexBucket *provides_hash;
+    const guint32 *provides_postings;
+    const IndexBucket *files_hash;
+    const guint32 *files_postings;
+};
+
+/* Sections have to follow each other in the order of the layout, so
+   one that ends at *end may not overlap the next */
+static gboolean
+section_ok (const IndexHeader *header,
+            guint64 *end,
+            guint64 offset,
+            guint64 len)
+{
+    if (offset % INDEX_ALIGN != 0 || offset < *end ||
+        offset > header->size || len > header->size - offset)
+        return FALSE;
+
+    *end = offset + len;
+    return TRUE;
+}
+
+static gboolean
+ranges_ok (const guint32 *ranges, guint32 n_packages, guint32 n_items)
+{
+    guint32 i;
+
+    if (ranges[0] != 0)
+        return FALSE;
+
+    for (i = 0; i < n_packages; i++) {
+        if (ranges[i + 1] < ranges[i])
+            return FALSE;
+    }
+
+    return ranges[n_packages] <= n_items;
+}
+
+static gboolean
+hash_ok (const IndexBucket *buckets,
+         guint32 n_buckets,
+         guint32 n_strings,
+         guint64 n_postings)
+{
+    guint32 i;
+
+    /* Probing masks the hash */
+    if (n_buckets == 0 || (n_buckets & (n_buckets - 1)) != 0)
+        return FALSE;
+
+    for (i = 0; i < n_buckets; i++) {
+        const IndexBucket *bucket = &buckets[i];
+
+        if (bucket->key == YUM_INDEX_NONE)
+            continue;
+        if (bucket->key >= n_strings ||
+            (guint64) bucket->start + bucket->count > n_postings)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* The tables the lookups walk, so that they never read outside the
+   mapping.  String ids in packages, provides and files are checked by
+   yum_index_string () and package numbers by yum_index_package (),
+   which return NULL for bad ones. */
+static gboolean
+index_ok (YumIndex *index)
+{
+    const IndexHeader *header = index->header;
+    guint64 data_len;
+    guint32 i;
+
+    data_len = header->packages_offset - header->string_data_offset;
+    for (i = 0; i < header->n_strings; i++) {
+        guint32 end = index->string_offsets[i + 1];
+
+        /* Every string ends with its NUL */
+        if (end <= index->string_offsets[i] || end > data_len ||
+            index->string_data[end - 1] != '\0')
+            return FALSE;
+    }
+
+    return ranges_ok (index->provides_ranges, header->n_packages,
+                      header->n_provides) &&
+        ranges_ok (index->files_ranges, header->n_packages,
+                   header->n_files) &&
+        hash_ok (index->provides_hash, header->provides_buckets,
+                 header->n_strings,
+                 (header->files_hash_offset -
+                  header->provides_postings_offset) / sizeof (guint32)) &&
+        hash_ok (index->files_hash, header->files_buckets,
+                 header->n_strings,
+                 (header->size - header->files_postings_offset) /
+                 sizeof (guint32));
+}
+
+YumIndex *
+yum_index_open (const char *path, GError **err)
+{
+    YumIndex *index = NULL;
+    const IndexHeader *header;
+    struct stat st;
+    gpointer map;
+    guint64 end;
+    int fd;
+
+    fd = open (path, O_RDONLY);
+    if (fd < 0) {
+        g_set_error (err, YUM_INDEX_ERROR, YUM_INDEX_ERROR,
+                     "Can not open index file %s: %s",
+                     path, g_strerror (errno));
+        return NULL;
+    }
+
+    if (fstat (fd, &st) != 0 || st.st_size < (off_t) sizeof (IndexHeader)) {
+        g_set_error (err, YUM_INDEX_ERROR, YUM_INDEX_ERROR,
+                     "Index file %s is truncated", path);
+        close (fd);
+        return NULL;
+    }
+
+    map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED) {
+        g_set_error (err, YUM_INDEX_ERROR, YUM_INDEX_ERROR,
+                     "Can not map index file %s: %s",
+                     path, g_strerror (errno));
+        return NULL;
+    }
+
+    header = (const IndexHeader *) map;
+    if (memcmp (header->magic, INDEX_MAGIC, sizeof (header->magic)) ||
+        header->byte_order != INDEX_BYTE_ORDER ||
+        header->version != YUM_INDEX_VERSION) {
+        g_set_error (err, YUM_INDEX_ERROR, YUM_INDEX_ERROR,
+                     "%s is not a version %d index for this host",
+                     path, YUM_INDEX_VERSION);
+        goto error;
+    }
+
+    /* Postings and string data have no count in the header, they end
+       where the next section starts */
+    end = sizeof (IndexHeader);
+    if (header->size != (guint64) st.st_size ||
+        header->checksum >= header->n_strings ||
+        !section_ok (header, &end, header->strings_offset,
+                     ((guint64) header->n_strings + 1) * sizeof (guint32)) ||
+        !section_ok (header, &end, header->string_data_offset, 0) ||
+        !section_ok (header, &end, header->packages_offset,
+                     (guint64) header->n_packages * sizeof (YumIndexPackage)) ||
+        !section_ok (header, &end, header->provides_ranges_offset,
+                     ((guint64) header->n_packages + 1) * sizeof (guint32)) ||
+        !section_ok (header, &end, header->provides_offset,
+                     (guint64) header->n_provides * sizeof (YumIndexProvide)) ||
+        !section_ok (header, &end, header->files_ranges_offset,
+                     ((guint64) header->n_packages + 1) * sizeof (guint32)) ||
+        !section_ok (header, &end, header->files_offset,
+                     (guint64) header->n_files * sizeof (guint32)) ||
+        !section_ok (header, &end, header->provides_hash_offset,
+                     (guint64) header->provides_buckets * sizeof (IndexBucket)) ||
+        !section_ok (header, &end, header->provides_postings_offset, 0) ||
+        !section_ok (header, &end, header->files_hash_offset,
+                     (guint64) header->files_buckets * sizeof (IndexBucket)) ||
+        !section_ok (header, &end, header->files_postings_offset, 0)) {
+        g_set_error (err, YUM_INDEX_ERROR, YUM_INDEX_ERROR,
+                     "Index file %s is corrupt", path);
+        goto error;
+    }
+
+    index = g_new0 (YumIndex, 1);
+    index->map = map;
+    index->size = st.st_size;
+    index->header = header;
+
+#define SECTION(type, field) \
+    (const type *) ((const char *) map + header->field)
+    index->string_offsets = SECTION (guint32, strings_offset);
+    index->string_data = SECTION (char, string_data_offset);
+    index->packages = SECTION (YumIndexPackage, packages_offset);
+    index->provides_ranges = SECTION (guint32, provides_ranges_offset);
+    index->provides = SECTION (YumIndexProvide, provides_offset);
+    index->files_ranges = SECTION (guint32, files_ranges_offset);
+    index->files = SECTION (guint32, files_offset);
+    index->provides_hash = SECTION (IndexBucket, provides_hash_offset);
+    index->provides_postings = SECTION (guint32, provides_postings_offset);
+    index->files_hash = SECTION (IndexBucket, files_hash_offset);
+    index->files_postings = SECTION (guint32, files_postings_offset);
+#undef SECTION
+
+    if (!index_ok (index)) {
+        g_set_error (err, YUM_INDEX_ERROR, YUM_INDEX_ERROR,
+                     "Index file %s is corrupt", path);
+        g_free (index);
+        goto error;
+    }
+
+    return index;
+
+ error:
+    munmap (map, st.st_size);
+    return NULL;
+}
+
+void
+yum_index_close (YumIndex *index)
+{
+    munmap (index->map, index->size);
+    g_free (index);
+}
+
+const char *
+yum_index_string (YumIndex *index, guint32 id)
+{
+    if (id >= index->header->n_strings)
+        return NULL;
+
+    return index->string_data + index->string_offsets[id];
+}
+
+const char *
+yum_index_checksum (YumIndex *index)
+{
+    return yum_index_string (index, index->header->checksum);
+}
+
+guint32
+yum_index_package_count (YumIndex *index)
+{
+    return index->header->n_packages;
+}
+
+const YumIndexPackage *
+yum_index_package (YumIndex *index, guint32 pkg)
+{
+    if (pkg >= index->header->n_packages)
+        return NULL;
+
+    return &index->packages[pkg];
+}
+
+const YumIndexProvide *
+yum_index_package_provides (YumIndex *index, guint32 pkg, guint32 *count)
+{
+    if (pkg >= index->header->n_packages) {
+        *count = 0;
+        return NULL;
+    }
+
+    *count = index->provides_ranges[pkg + 1] - index->provides_ranges[pkg];
+    return &index->provides[index->provides_ranges[pkg]];
+}
+
+const guint32 *
+yum_index_package_files (YumIndex *index, guint32 pkg, guint32 *count)
+{
+    if (pkg >= index->header->n_packages) {
+        *count = 0;
+        return NULL;
+    }
+
+    *count = index->files_ranges[pkg + 1] - index->files_ranges[pkg];
+    return &index->files[index->files_ranges[pkg]];
+}
+
+static const guint32 *
+hash_lookup (YumIndex *index,
+             const IndexBucket *buckets,
+             guint32 n_buckets,
+             const guint32 *postings,
+             const char *key,
+             guint32 *count)
+{
+    guint32 hash = index_hash (key);
+    guint32 mask = n_buckets - 1;
+    guint32 slot;
+    guint32 probes;
+
+    for (slot = hash & mask, probes = 0;
+         buckets[slot].key != YUM_INDEX_NONE && probes < n_buckets;
+         slot = (slot + 1) & mask, probes++) {
+        const IndexBucket *bucket = &buckets[slot];
+
+        if (bucket->hash == hash &&
+            !strcmp (yum_index_string (index, bucket->key), key)) {
+            *count = bucket->count;
+            return &postings[bucket->start];
+        }
+    }
+
+    *count = 0;
+    return NULL;
+}
+
+const guint32 *
+yum_index_lookup_provides (YumIndex *index, const char *name, guint32 *count)
+{
+    return hash_lookup (index, index->provides_hash,
+                        index->header->provides_buckets,
+                        index->provides_postings, name, count);
+}
+
+const guint32 *
+yum_index_lookup_file (YumIndex *index, const char *path, guint32 *count)
+{
+    return hash_lookup (index, index->files_hash,
+                        index->header->files_buckets,
+                        index->files_postings, path, count);
+}
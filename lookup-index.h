@@ -0,0 +1,96 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef __YUM_LOOKUP_INDEX_H__
+#define __YUM_LOOKUP_INDEX_H__
+
+#include <glib.h>
+#include "package.h"
+
+/* A compact, memory-mappable alternative to primary.sqlite for
+ * provides and file lookups.  The file is written in host byte order
+ * (the header records which) and every section starts on an 8 byte
+ * boundary; see lookup-index.c for the layout. */
+
+#define YUM_INDEX_VERSION 1
+
+#define YUM_INDEX_ERROR yum_index_error_quark()
+GQuark yum_index_error_quark (void);
+
+#define YUM_INDEX_NONE G_MAXUINT32
+
+typedef struct {
+    guint32 pkgId;
+    guint32 name;
+    guint32 arch;
+    guint32 epoch;
+    guint32 version;
+    guint32 release;
+    guint32 location_href;
+    guint32 reserved;
+} YumIndexPackage;
+
+typedef struct {
+    guint32 name;
+    guint32 flags;
+    guint32 epoch;
+    guint32 version;
+    guint32 release;
+} YumIndexProvide;
+
+typedef struct _YumIndex YumIndex;
+typedef struct _YumIndexWriter YumIndexWriter;
+
+char           *yum_index_filename          (const char *prefix);
+
+/* Writer */
+
+YumIndexWriter *yum_index_writer_new        (void);
+void            yum_index_writer_add        (YumIndexWriter *writer,
+                                             Package *p);
+void            yum_index_writer_write      (YumIndexWriter *writer,
+                                             const char *path,
+                                             const char *checksum,
+                                             GError **err);
+void            yum_index_writer_free       (YumIndexWriter *writer);
+
+/* Reader.  Nothing returned here is allocated; all pointers point into
+ * the mapping and stay valid until yum_index_close(). */
+
+YumIndex       *yum_index_open              (const char *path, GError **err);
+void            yum_index_close             (YumIndex *index);
+
+const char     *yum_index_checksum          (YumIndex *index);
+guint32         yum_index_package_count     (YumIndex *index);
+const YumIndexPackage *yum_index_package    (YumIndex *index, guint32 pkg);
+const char     *yum_index_string            (YumIndex *index, guint32 id);
+
+const YumIndexProvide *yum_index_package_provides (YumIndex *index,
+                                                   guint32 pkg,
+                                                   guint32 *count);
+const guint32  *yum_index_package_files     (YumIndex *index,
+                                             guint32 pkg,
+                                             guint32 *count);
+
+const guint32  *yum_index_lookup_provides   (YumIndex *index,
+                                             const char *name,
+                                             guint32 *count);
+const guint32  *yum_index_lookup_file       (YumIndex *index,
+                                             const char *path,
+                                             guint32 *count);
+
+#endif /* __YUM_LOOKUP_INDEX_H__ */
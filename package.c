@@ -117,3 +117,152 @@ package_free (Package *package)
 
     g_free (package);
 }
+
+AdvisoryReference *
+advisory_reference_new (void)
+{
+    AdvisoryReference *reference;
+
+    reference = g_new0 (AdvisoryReference, 1);
+
+    return reference;
+}
+
+AdvisoryPackage *
+advisory_package_new (void)
+{
+    AdvisoryPackage *package;
+
+    package = g_new0 (AdvisoryPackage, 1);
+
+    return package;
+}
+
+Advisory *
+advisory_new (void)
+{
+    Advisory *advisory;
+
+    advisory = g_new0 (Advisory, 1);
+    advisory->chunk = g_string_chunk_new (PACKAGE_CHUNK_SIZE);
+
+    return advisory;
+}
+
+void
+advisory_free (Advisory *advisory)
+{
+    g_string_chunk_free (advisory->chunk);
+
+    if (advisory->references) {
+        g_slist_foreach (advisory->references, (GFunc) g_free, NULL);
+        g_slist_free (advisory->references);
+    }
+
+    if (advisory->packages) {
+        g_slist_foreach (advisory->packages, (GFunc) g_free, NULL);
+        g_slist_free (advisory->packages);
+    }
+
+    g_free (advisory);
+}
+
+DeltaRpm *
+delta_rpm_new (void)
+{
+    DeltaRpm *delta;
+
+    delta = g_new0 (DeltaRpm, 1);
+
+    return delta;
+}
+
+DeltaPackage *
+delta_package_new (void)
+{
+    DeltaPackage *package;
+
+    package = g_new0 (DeltaPackage, 1);
+    package->chunk = g_string_chunk_new (PACKAGE_CHUNK_SIZE);
+
+    return package;
+}
+
+void
+delta_package_free (DeltaPackage *package)
+{
+    g_string_chunk_free (package->chunk);
+
+    if (package->deltas) {
+        g_slist_foreach (package->deltas, (GFunc) g_free, NULL);
+        g_slist_free (package->deltas);
+    }
+
+    g_free (package);
+}
+
+CompsTranslation *
+comps_translation_new (void)
+{
+    CompsTranslation *translation;
+
+    translation = g_new0 (CompsTranslation, 1);
+
+    return translation;
+}
+
+CompsPackageReq *
+comps_package_req_new (void)
+{
+    CompsPackageReq *req;
+
+    req = g_new0 (CompsPackageReq, 1);
+
+    return req;
+}
+
+CompsGroupId *
+comps_group_id_new (void)
+{
+    CompsGroupId *group_id;
+
+    group_id = g_new0 (CompsGroupId, 1);
+
+    return group_id;
+}
+
+CompsEntry *
+comps_entry_new (CompsKind kind)
+{
+    CompsEntry *entry;
+
+    entry = g_new0 (CompsEntry, 1);
+    entry->kind = kind;
+    entry->uservisible = TRUE;
+    entry->chunk = g_string_chunk_new (PACKAGE_CHUNK_SIZE);
+
+    return entry;
+}
+
+void
+comps_entry_free (CompsEntry *entry)
+{
+    g_string_chunk_free (entry->chunk);
+
+    if (entry->translations) {
+        g_slist_foreach (entry->translations, (GFunc) g_free, NULL);
+        g_slist_free (entry->translations);
+    }
+
+    if (entry->packages) {
+        g_slist_foreach (entry->packages, (GFunc) g_free, NULL);
+        g_slist_free (entry->packages);
+    }
+
+    if (entry->groups) {
+        g_slist_foreach (entry->groups, (GFunc) g_free, NULL);
+        g_slist_free (entry->groups);
+    }
+
+    g_free (entry);
+}
@@ -80,15 +80,164 @@ typedef struct {
     GSList *files;
     GSList *changelogs;
 
+    /* Per-package strings.  Values that recur across packages (arch,
+       vendor, license, packager, group, buildhost, dependencies but
+       provide names, file types, changelog authors) come from the parser's
+       pool instead: equal values share one pointer, valid until the parse
+       ends.  Packages pulled with yum_xml_parser_next () have them here as
+       well. */
     GStringChunk *chunk;
 } Package;
 
 typedef void (*PackageFn) (Package *pkg, gpointer data);
 
+/* updateinfo.xml */
+
+typedef struct {
+    char *type;
+    char *id;
+    char *href;
+    char *title;
+} AdvisoryReference;
+
+typedef struct {
+    char *collection;
+    char *name;
+    char *epoch;
+    char *version;
+    char *release;
+    char *arch;
+    char *src;
+    char *filename;
+    char *sum_type;
+    char *sum;
+    gboolean reboot_suggested;
+    gboolean restart_suggested;
+    gboolean relogin_suggested;
+} AdvisoryPackage;
+
+typedef struct {
+    gint64 advisoryKey;
+    char *id;
+    char *type;
+    char *status;
+    char *version;
+    char *issuer;
+    char *title;
+    char *severity;
+    char *release;
+    char *rights;
+    char *pushcount;
+    char *summary;
+    char *description;
+    char *solution;
+    char *issued;
+    char *updated;
+
+    GSList *references;
+    GSList *packages;
+
+    GStringChunk *chunk;
+} Advisory;
+
+typedef void (*AdvisoryFn) (Advisory *advisory, gpointer data);
+
+/* prestodelta.xml, deltainfo.xml */
+
+typedef struct {
+    char *oldepoch;
+    char *oldversion;
+    char *oldrelease;
+    char *filename;
+    char *sequence;
+    gint64 size;
+    char *checksum_type;
+    char *checksum;
+} DeltaRpm;
+
+typedef struct {
+    char *name;
+    char *arch;
+    char *epoch;
+    char *version;
+    char *release;
+
+    GSList *deltas;
+
+    GStringChunk *chunk;
+} DeltaPackage;
+
+typedef void (*DeltaPackageFn) (DeltaPackage *package, gpointer data);
+
+/* comps.xml */
+
+typedef enum {
+    COMPS_GROUP = 0,
+    COMPS_CATEGORY,
+    COMPS_ENVIRONMENT,
+} CompsKind;
+
+typedef struct {
+    char *lang;
+    char *name;
+    char *description;
+} CompsTranslation;
+
+typedef struct {
+    char *name;
+    char *type;
+    char *requires;
+    gboolean basearchonly;
+} CompsPackageReq;
+
+/* Member of a category or environment; an environment's optional groups
+   come from its optionlist */
+typedef struct {
+    char *id;
+    gboolean optional;
+    gboolean is_default;
+} CompsGroupId;
+
+typedef struct {
+    CompsKind kind;
+    gint64 key;
+    char *id;
+    char *name;
+    char *description;
+    char *display_order;
+    /* Groups only */
+    gboolean is_default;
+    gboolean uservisible;
+    char *langonly;
+
+    GSList *translations;
+    GSList *packages;
+    GSList *groups;
+
+    GStringChunk *chunk;
+} CompsEntry;
+
+typedef void (*CompsEntryFn) (CompsEntry *entry, gpointer data);
+
 Dependency     *dependency_new      (void);
 PackageFile    *package_file_new    (void);
 ChangelogEntry *changelog_entry_new (void);
 Package        *package_new         (void);
 void            package_free        (Package *package);
 
+AdvisoryReference *advisory_reference_new (void);
+AdvisoryPackage *advisory_package_new (void);
+Advisory       *advisory_new        (void);
+void            advisory_free       (Advisory *advisory);
+
+DeltaRpm       *delta_rpm_new       (void);
+DeltaPackage   *delta_package_new   (void);
+void            delta_package_free  (DeltaPackage *package);
+
+CompsTranslation *comps_translation_new (void);
+CompsPackageReq *comps_package_req_new (void);
+CompsGroupId   *comps_group_id_new  (void);
+CompsEntry     *comps_entry_new     (CompsKind kind);
+void            comps_entry_free    (CompsEntry *entry);
+
 #endif /* __YUM_PACKAGE_H__ */
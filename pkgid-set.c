@@ -0,0 +1,297 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <string.h>
+#include "pkgid-set.h"
+
+/* pkgIds are lower case hex checksums (sha256 today, sha1 or md5 in
+ * older repositories).  They are decoded to YUM_PKGID_DIGEST_SIZE byte
+ * digests, zero padded, and appended to a dense array of entries.  A
+ * linear probing table of entry numbers, a power of two in size and at
+ * most half full, finds them again; the digests are random already, so
+ * their first bytes serve as the hash.  Upper case, odd length and
+ * longer ids are rare, they go to a plain string hash table so that
+ * lookups stay exact. */
+
+#define PKGID_SET_MIN_SLOTS 64
+
+typedef struct {
+    guint8 digest[YUM_PKGID_DIGEST_SIZE];
+    gint32 value;
+    guint32 len;
+} PkgIdEntry;
+
+struct _YumPkgIdSet {
+    PkgIdEntry *entries;
+    guint n_entries;
+    guint entries_allocated;
+
+    /* Entry number + 1, 0 for an empty slot */
+    guint32 *slots;
+    guint n_slots;
+
+    GHashTable *others;
+};
+
+/* Nibble value of a lower case hex digit, 0x10 for anything else */
+static const guint8 hex_values[256] = {
+#define X 0x10
+#define ROW X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X
+    ROW, ROW, ROW,
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, X, X, X, X, X, X,
+    ROW, ROW,
+    X, 10, 11, 12, 13, 14, 15, X, X, X, X, X, X, X, X, X,
+    ROW,
+    ROW, ROW, ROW, ROW, ROW, ROW, ROW, ROW
+#undef ROW
+#undef X
+};
+
+/* Returns the digest length, 0 if pkgId can not be stored as a digest */
+static guint
+pkgid_decode (const char *pkgId, guint8 *digest)
+{
+    const guchar *p = (const guchar *) pkgId;
+    guint i;
+
+    for (i = 0; p[2 * i]; i++) {
+        guint8 hi, lo;
+
+        if (i == YUM_PKGID_DIGEST_SIZE)
+            return 0;
+
+        hi = hex_values[p[2 * i]];
+        lo = hex_values[p[2 * i + 1]];
+        if ((hi | lo) & 0x10)
+            return 0;
+
+        digest[i] = (hi << 4) | lo;
+    }
+
+    if (i < YUM_PKGID_DIGEST_SIZE)
+        memset (digest + i, 0, YUM_PKGID_DIGEST_SIZE - i);
+
+    return i;
+}
+
+static void
+pkgid_encode (const PkgIdEntry *entry, char *pkgId)
+{
+    static const char hex[] = "0123456789abcdef";
+    guint i;
+
+    for (i = 0; i < entry->len; i++) {
+        pkgId[2 * i] = hex[entry->digest[i] >> 4];
+        pkgId[2 * i + 1] = hex[entry->digest[i] & 0xf];
+    }
+    pkgId[2 * i] = '\0';
+}
+
+static inline guint
+pkgid_hash (const guint8 *digest, guint len)
+{
+    guint32 h;
+
+    memcpy (&h, digest, sizeof (h));
+    return h ^ len;
+}
+
+static guint32 *
+pkgid_set_find (YumPkgIdSet *set, const guint8 *digest, guint len)
+{
+    guint mask = set->n_slots - 1;
+    guint i = pkgid_hash (digest, len) & mask;
+
+    while (set->slots[i]) {
+        PkgIdEntry *entry = &set->entries[set->slots[i] - 1];
+
+        if (entry->len == len && !memcmp (entry->digest, digest, len))
+            break;
+        i = (i + 1) & mask;
+    }
+
+    return &set->slots[i];
+}
+
+static void
+pkgid_set_resize (YumPkgIdSet *set, guint n_slots)
+{
+    guint i;
+
+    g_free (set->slots);
+    set->slots = g_new0 (guint32, n_slots);
+    set->n_slots = n_slots;
+
+    for (i = 0; i < set->n_entries; i++)
+        *pkgid_set_find (set, set->entries[i].digest,
+                         set->entries[i].len) = i + 1;
+}
+
+/* Slots for expected entries at a load factor of at most 1/2 */
+static guint
+pkgid_set_slots_for (guint expected)
+{
+    guint n = PKGID_SET_MIN_SLOTS;
+
+    while (n / 2 < expected)
+        n <<= 1;
+
+    return n;
+}
+
+YumPkgIdSet *
+yum_pkgid_set_new (guint expected)
+{
+    YumPkgIdSet *set = g_new0 (YumPkgIdSet, 1);
+
+    set->n_slots = pkgid_set_slots_for (expected);
+    set->slots = g_new0 (guint32, set->n_slots);
+    set->entries_allocated = MAX (expected, PKGID_SET_MIN_SLOTS / 2);
+    set->entries = g_new (PkgIdEntry, set->entries_allocated);
+    set->others = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                         (GDestroyNotify) g_free, NULL);
+
+    return set;
+}
+
+void
+yum_pkgid_set_free (YumPkgIdSet *set)
+{
+    g_free (set->entries);
+    g_free (set->slots);
+    g_hash_table_destroy (set->others);
+    g_free (set);
+}
+
+void
+yum_pkgid_set_reserve (YumPkgIdSet *set, guint expected)
+{
+    guint n_slots = pkgid_set_slots_for (expected);
+
+    if (expected > set->entries_allocated) {
+        set->entries_allocated = expected;
+        set->entries = g_renew (PkgIdEntry, set->entries, expected);
+    }
+
+    if (n_slots > set->n_slots)
+        pkgid_set_resize (set, n_slots);
+}
+
+void
+yum_pkgid_set_clear (YumPkgIdSet *set)
+{
+    memset (set->slots, 0, set->n_slots * sizeof (guint32));
+    set->n_entries = 0;
+    g_hash_table_remove_all (set->others);
+}
+
+void
+yum_pkgid_set_insert (YumPkgIdSet *set, const char *pkgId, gint value)
+{
+    guint8 digest[YUM_PKGID_DIGEST_SIZE];
+    PkgIdEntry *entry;
+    guint32 *slot;
+    guint len;
+
+    len = pkgid_decode (pkgId, digest);
+    if (len == 0) {
+        g_hash_table_insert (set->others, g_strdup (pkgId),
+                             GINT_TO_POINTER (value));
+        return;
+    }
+
+    slot = pkgid_set_find (set, digest, len);
+    if (*slot) {
+        set->entries[*slot - 1].value = value;
+        return;
+    }
+
+    if (set->n_entries == set->entries_allocated) {
+        set->entries_allocated *= 2;
+        set->entries = g_renew (PkgIdEntry, set->entries,
+                                set->entries_allocated);
+    }
+
+    entry = &set->entries[set->n_entries++];
+    memcpy (entry->digest, digest, sizeof (digest));
+    entry->value = value;
+    entry->len = len;
+    *slot = set->n_entries;
+
+    if (set->n_entries > set->n_slots / 2)
+        pkgid_set_resize (set, set->n_slots * 2);
+}
+
+gboolean
+yum_pkgid_set_lookup (YumPkgIdSet *set, const char *pkgId, gint *value)
+{
+    guint8 digest[YUM_PKGID_DIGEST_SIZE];
+    gpointer orig_key, orig_value;
+    guint32 *slot;
+    guint len;
+
+    len = pkgid_decode (pkgId, digest);
+    if (len == 0) {
+        if (!g_hash_table_lookup_extended (set->others, pkgId,
+                                           &orig_key, &orig_value))
+            return FALSE;
+        if (value)
+            *value = GPOINTER_TO_INT (orig_value);
+        return TRUE;
+    }
+
+    slot = pkgid_set_find (set, digest, len);
+    if (!*slot)
+        return FALSE;
+
+    if (value)
+        *value = set->entries[*slot - 1].value;
+    return TRUE;
+}
+
+typedef struct {
+    YumPkgIdSetFunc func;
+    gpointer user_data;
+} ForeachInfo;
+
+static void
+foreach_other (gpointer key, gpointer value, gpointer user_data)
+{
+    ForeachInfo *info = (ForeachInfo *) user_data;
+
+    info->func ((const char *) key, GPOINTER_TO_INT (value),
+                info->user_data);
+}
+
+void
+yum_pkgid_set_foreach (YumPkgIdSet *set,
+                       YumPkgIdSetFunc func,
+                       gpointer user_data)
+{
+    char pkgId[2 * YUM_PKGID_DIGEST_SIZE + 1];
+    ForeachInfo info;
+    guint i;
+
+    for (i = 0; i < set->n_entries; i++) {
+        pkgid_encode (&set->entries[i], pkgId);
+        func (pkgId, set->entries[i].value, user_data);
+    }
+
+    info.func = func;
+    info.user_data = user_data;
+    g_hash_table_foreach (set->others, foreach_other, &info);
+}
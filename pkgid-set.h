@@ -0,0 +1,51 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef __YUM_PKGID_SET_H__
+#define __YUM_PKGID_SET_H__
+
+#include <glib.h>
+
+/* A map from pkgId to an integer (the pkgKey), for the sets of packages
+ * compared while updating a cache.  Hex checksums of up to
+ * YUM_PKGID_DIGEST_SIZE bytes are stored as binary digests in an open
+ * addressing table; anything else falls back to a string hash table. */
+
+#define YUM_PKGID_DIGEST_SIZE 32
+
+typedef struct _YumPkgIdSet YumPkgIdSet;
+
+typedef void (*YumPkgIdSetFunc) (const char *pkgId,
+                                 gint value,
+                                 gpointer user_data);
+
+YumPkgIdSet *yum_pkgid_set_new     (guint expected);
+void         yum_pkgid_set_free    (YumPkgIdSet *set);
+void         yum_pkgid_set_reserve (YumPkgIdSet *set, guint expected);
+void         yum_pkgid_set_clear   (YumPkgIdSet *set);
+
+void         yum_pkgid_set_insert  (YumPkgIdSet *set,
+                                    const char *pkgId,
+                                    gint value);
+gboolean     yum_pkgid_set_lookup  (YumPkgIdSet *set,
+                                    const char *pkgId,
+                                    gint *value);
+void         yum_pkgid_set_foreach (YumPkgIdSet *set,
+                                    YumPkgIdSetFunc func,
+                                    gpointer user_data);
+
+#endif /* __YUM_PKGID_SET_H__ */
@@ -0,0 +1,357 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <string.h>
+#include "repo-diff.h"
+#include "pkgid-set.h"
+
+#define DIFF_CHUNK_SIZE 64 * 1024
+
+struct _YumDiffSide {
+    GArray *packages;
+    /* pkgId to the package's position in packages */
+    YumPkgIdSet *ids;
+    GStringChunk *chunk;
+};
+
+YumDiffSide *
+yum_diff_side_new (void)
+{
+    YumDiffSide *side;
+
+    side = g_new0 (YumDiffSide, 1);
+    side->packages = g_array_new (FALSE, FALSE, sizeof (YumDiffPackage));
+    side->ids = yum_pkgid_set_new (0);
+    side->chunk = g_string_chunk_new (DIFF_CHUNK_SIZE);
+
+    return side;
+}
+
+void
+yum_diff_side_free (YumDiffSide *side)
+{
+    g_array_free (side->packages, TRUE);
+    yum_pkgid_set_free (side->ids);
+    g_string_chunk_free (side->chunk);
+    g_free (side);
+}
+
+void
+yum_diff_side_reserve (YumDiffSide *side, guint expected)
+{
+    yum_pkgid_set_reserve (side->ids, expected);
+}
+
+static char *
+diff_side_insert (YumDiffSide *side, const char *str)
+{
+    return str ? g_string_chunk_insert_const (side->chunk, str) : NULL;
+}
+
+void
+yum_diff_side_add (YumDiffSide *side, Package *p)
+{
+    YumDiffPackage dp;
+
+    if (p->pkgId == NULL ||
+        yum_pkgid_set_lookup (side->ids, p->pkgId, NULL))
+        return;
+
+    dp.pkgId = g_string_chunk_insert (side->chunk, p->pkgId);
+    dp.name = diff_side_insert (side, p->name);
+    dp.arch = diff_side_insert (side, p->arch);
+    dp.epoch = diff_side_insert (side, p->epoch);
+    dp.version = diff_side_insert (side, p->version);
+    dp.release = diff_side_insert (side, p->release);
+
+    yum_pkgid_set_insert (side->ids, dp.pkgId, side->packages->len);
+    g_array_append_val (side->packages, dp);
+}
+
+guint
+yum_diff_side_size (YumDiffSide *side)
+{
+    return side->packages->len;
+}
+
+/* Version comparison */
+
+/* rpmvercmp (): the strings are split into runs of digits and runs of
+   letters, anything else only separates them.  Digit runs compare as
+   numbers and are newer than letter runs; '~' sorts before everything,
+   even the end of the string, '^' after the end but before anything
+   else. */
+static int
+vercmp (const char *a, const char *b)
+{
+    const char *one = a ? a : "";
+    const char *two = b ? b : "";
+
+    if (!strcmp (one, two))
+        return 0;
+
+    while (*one || *two) {
+        const char *end1;
+        const char *end2;
+        gboolean isnum;
+        gsize len1;
+        gsize len2;
+        int rc;
+
+        while (*one && !g_ascii_isalnum (*one) && *one != '~' && *one != '^')
+            one++;
+        while (*two && !g_ascii_isalnum (*two) && *two != '~' && *two != '^')
+            two++;
+
+        if (*one == '~' || *two == '~') {
+            if (*one != '~')
+                return 1;
+            if (*two != '~')
+                return -1;
+            one++;
+            two++;
+            continue;
+        }
+
+        if (*one == '^' || *two == '^') {
+            if (!*one)
+                return -1;
+            if (!*two)
+                return 1;
+            if (*one != '^')
+                return 1;
+            if (*two != '^')
+                return -1;
+            one++;
+            two++;
+            continue;
+        }
+
+        if (!*one || !*two)
+            break;
+
+        end1 = one;
+        end2 = two;
+        isnum = g_ascii_isdigit (*one);
+        if (isnum) {
+            while (g_ascii_isdigit (*end1))
+                end1++;
+            while (g_ascii_isdigit (*end2))
+                end2++;
+        } else {
+            while (g_ascii_isalpha (*end1))
+                end1++;
+            while (g_ascii_isalpha (*end2))
+                end2++;
+        }
+
+        /* The other one is a run of the other kind */
+        if (end2 == two)
+            return isnum ? 1 : -1;
+
+        if (isnum) {
+            while (*one == '0' && one < end1 - 1)
+                one++;
+            while (*two == '0' && two < end2 - 1)
+                two++;
+
+            len1 = end1 - one;
+            len2 = end2 - two;
+            if (len1 != len2)
+                return len1 > len2 ? 1 : -1;
+        }
+
+        len1 = end1 - one;
+        len2 = end2 - two;
+        rc = strncmp (one, two, MIN (len1, len2));
+        if (rc)
+            return rc > 0 ? 1 : -1;
+        if (len1 != len2)
+            return len1 > len2 ? 1 : -1;
+
+        one = end1;
+        two = end2;
+    }
+
+    if (!*one && !*two)
+        return 0;
+
+    return *one ? 1 : -1;
+}
+
+static guint64
+epoch_value (const char *epoch)
+{
+    return epoch ? g_ascii_strtoull (epoch, NULL, 10) : 0;
+}
+
+int
+yum_diff_evr_compare (const YumDiffPackage *a, const YumDiffPackage *b)
+{
+    guint64 epoch_a = epoch_value (a->epoch);
+    guint64 epoch_b = epoch_value (b->epoch);
+    int rc;
+
+    if (epoch_a != epoch_b)
+        return epoch_a > epoch_b ? 1 : -1;
+
+    rc = vercmp (a->version, b->version);
+    if (rc)
+        return rc;
+
+    return vercmp (a->release, b->release);
+}
+
+/* Diff */
+
+static char *
+diff_key (const YumDiffPackage *p)
+{
+    return g_strconcat (p->name ? p->name : "", ".",
+                        p->arch ? p->arch : "", NULL);
+}
+
+static void
+ptr_array_free (gpointer array)
+{
+    g_ptr_array_free ((GPtrArray *) array, TRUE);
+}
+
+/* Packages whose pkgId is not in other, by name.arch.  keys, if given,
+   gets the keys in the order they first appear. */
+static GHashTable *
+diff_only_in (YumDiffSide *side, YumDiffSide *other, GPtrArray *keys)
+{
+    GHashTable *only;
+    guint i;
+
+    only = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                  g_free, ptr_array_free);
+
+    for (i = 0; i < side->packages->len; i++) {
+        YumDiffPackage *p = &g_array_index (side->packages, YumDiffPackage, i);
+        GPtrArray *group;
+        char *key;
+
+        if (yum_pkgid_set_lookup (other->ids, p->pkgId, NULL))
+            continue;
+
+        key = diff_key (p);
+        group = g_hash_table_lookup (only, key);
+        if (group) {
+            g_free (key);
+        } else {
+            group = g_ptr_array_new ();
+            g_hash_table_insert (only, key, group);
+            if (keys)
+                g_ptr_array_add (keys, key);
+        }
+
+        g_ptr_array_add (group, p);
+    }
+
+    return only;
+}
+
+/* Newest first */
+static gint
+diff_evr_sort (gconstpointer a, gconstpointer b)
+{
+    const YumDiffPackage *pa = *(const YumDiffPackage **) a;
+    const YumDiffPackage *pb = *(const YumDiffPackage **) b;
+
+    return yum_diff_evr_compare (pb, pa);
+}
+
+static void
+diff_group (GPtrArray *olds,
+            GPtrArray *news,
+            YumDiffFn diff_fn,
+            gpointer user_data)
+{
+    guint n_olds = olds ? olds->len : 0;
+    guint i;
+
+    if (n_olds > 1)
+        g_ptr_array_sort (olds, diff_evr_sort);
+    if (news->len > 1)
+        g_ptr_array_sort (news, diff_evr_sort);
+
+    for (i = 0; i < news->len; i++) {
+        YumDiffPackage *new_pkg = g_ptr_array_index (news, i);
+        YumDiffPackage *old_pkg;
+
+        if (i >= n_olds) {
+            diff_fn (YUM_DIFF_ADDED, NULL, new_pkg, user_data);
+            continue;
+        }
+
+        old_pkg = g_ptr_array_index (olds, i);
+        if (yum_diff_evr_compare (new_pkg, old_pkg) > 0)
+            diff_fn (YUM_DIFF_UPGRADED, old_pkg, new_pkg, user_data);
+        else
+            diff_fn (YUM_DIFF_CHANGED, old_pkg, new_pkg, user_data);
+    }
+
+    for (; i < n_olds; i++)
+        diff_fn (YUM_DIFF_REMOVED, g_ptr_array_index (olds, i), NULL,
+                 user_data);
+}
+
+void
+yum_diff (YumDiffSide *old_side,
+          YumDiffSide *new_side,
+          YumDiffFn diff_fn,
+          gpointer user_data)
+{
+    GHashTable *old_only;
+    GHashTable *new_only;
+    GPtrArray *keys;
+    guint i;
+
+    keys = g_ptr_array_new ();
+    old_only = diff_only_in (old_side, new_side, NULL);
+    new_only = diff_only_in (new_side, old_side, keys);
+
+    for (i = 0; i < keys->len; i++) {
+        const char *key = g_ptr_array_index (keys, i);
+
+        diff_group (g_hash_table_lookup (old_only, key),
+                    g_hash_table_lookup (new_only, key),
+                    diff_fn, user_data);
+        g_hash_table_remove (old_only, key);
+    }
+
+    /* Names that are gone altogether */
+    for (i = 0; i < old_side->packages->len; i++) {
+        YumDiffPackage *p = &g_array_index (old_side->packages,
+                                            YumDiffPackage, i);
+        char *key;
+
+        if (yum_pkgid_set_lookup (new_side->ids, p->pkgId, NULL))
+            continue;
+
+        key = diff_key (p);
+        if (g_hash_table_lookup (old_only, key))
+            diff_fn (YUM_DIFF_REMOVED, p, NULL, user_data);
+        g_free (key);
+    }
+
+    g_ptr_array_free (keys, TRUE);
+    g_hash_table_destroy (old_only);
+    g_hash_table_destroy (new_only);
+}
@@ -0,0 +1,75 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef __YUM_REPO_DIFF_H__
+#define __YUM_REPO_DIFF_H__
+
+#include <glib.h>
+#include "package.h"
+
+/* What changed between two revisions of a repository's packages.  Each
+ * revision is collected as the pkgId and NEVRA of its packages, nothing
+ * else.  Packages whose pkgId is in both are unchanged; of the rest,
+ * those with the same name and arch are paired up newest with newest,
+ * and whatever is left over was added or removed. */
+
+typedef struct {
+    char *pkgId;
+    char *name;
+    char *arch;
+    char *epoch;
+    char *version;
+    char *release;
+} YumDiffPackage;
+
+typedef enum {
+    YUM_DIFF_ADDED = 0,
+    YUM_DIFF_REMOVED,
+    /* The new package of a pair has the higher EVR */
+    YUM_DIFF_UPGRADED,
+    /* Same or lower EVR: a rebuild or a downgrade */
+    YUM_DIFF_CHANGED,
+} YumDiffKind;
+
+/* old_pkg is NULL for added packages, new_pkg for removed ones */
+typedef void (*YumDiffFn) (YumDiffKind kind,
+                           const YumDiffPackage *old_pkg,
+                           const YumDiffPackage *new_pkg,
+                           gpointer user_data);
+
+typedef struct _YumDiffSide YumDiffSide;
+
+YumDiffSide *yum_diff_side_new      (void);
+void         yum_diff_side_free     (YumDiffSide *side);
+void         yum_diff_side_reserve  (YumDiffSide *side, guint expected);
+/* Copies what it needs, p can go away afterwards */
+void         yum_diff_side_add      (YumDiffSide *side, Package *p);
+guint        yum_diff_side_size     (YumDiffSide *side);
+
+/* Changes come by name and arch, in the order these first appear among
+   the new packages, newest EVR first; then the removals of names and
+   arches that are gone, in the order of old_side */
+void         yum_diff               (YumDiffSide *old_side,
+                                     YumDiffSide *new_side,
+                                     YumDiffFn diff_fn,
+                                     gpointer user_data);
+
+/* rpm's ordering of epoch (NULL is 0), version and release */
+int          yum_diff_evr_compare   (const YumDiffPackage *a,
+                                     const YumDiffPackage *b);
+
+#endif /* __YUM_REPO_DIFF_H__ */
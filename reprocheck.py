@@ -0,0 +1,127 @@
+#!/usr/bin/python -tt
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+"""Check that cache builds are byte-reproducible.
+
+usage: reprocheck.py [-r] [-o OPTIONS] METADATA...
+
+Builds the cache of each primary, filelists or other metadata file twice,
+each in a directory of its own, and compares the database files byte by
+byte.  OPTIONS are the schema flags (FILELIST_DIRS, ...) as a number.
+Exits with 1 if any differ.
+
+A build cancelled halfway and resumed holds the same rows, but not the
+same bytes: it commits at other points, so the header change counters
+and the order of interleaved pages differ.  Pass -r to compare those
+with a fresh build row by row instead."""
+
+import os
+import sys
+import shutil
+import getopt
+import filecmp
+import sqlite3
+import tempfile
+import sqlitecachec
+
+BUILDERS = (('primary', 'getPrimary'),
+            ('filelists', 'getFilelists'),
+            ('other', 'getOtherdata'))
+
+class Callback:
+    def __init__(self):
+        self.parser = None
+        self.halfway = False
+
+    def log(self, level, msg):
+        pass
+
+    def progressbar(self, current, total, name):
+        if self.halfway and current == total // 2:
+            self.parser.cancel()
+
+def build(metadata, workdir, builder, options, halfway=False):
+    os.makedirs(workdir)
+    location = os.path.join(workdir, os.path.basename(metadata))
+    shutil.copy(metadata, location)
+
+    callback = Callback()
+    parser = sqlitecachec.RepodataParserSqlite(workdir, 'reprocheck',
+                                               callback)
+    callback.parser = parser
+    callback.halfway = halfway
+    if halfway:
+        try:
+            getattr(parser, builder)(location, 'reprocheck', options).close()
+        except TypeError:
+            pass
+        callback.halfway = False
+
+    getattr(parser, builder)(location, 'reprocheck', options).close()
+    return location + '.sqlite'
+
+def dump(filename):
+    db = sqlite3.connect(filename)
+    try:
+        return list(db.iterdump())
+    finally:
+        db.close()
+
+def check(metadata, tmpdir, options, resume=False):
+    name = os.path.basename(metadata)
+    for kind, builder in BUILDERS:
+        if name.find(kind) >= 0:
+            break
+    else:
+        print '%s: not primary, filelists or other metadata' % metadata
+        return False
+
+    workdir = os.path.join(tmpdir, kind)
+    first = build(metadata, workdir + '.1', builder, options)
+    other = build(metadata, workdir + '.2', builder, options)
+    ok = filecmp.cmp(first, other, shallow=False)
+    print '%s: rebuilt %s' % (metadata, ok and 'identical' or 'DIFFERS')
+
+    if resume:
+        other = build(metadata, workdir + '.resumed', builder, options, True)
+        same = dump(first) == dump(other)
+        print '%s: resumed %s' % (metadata, same and 'same rows' or 'DIFFERS')
+        ok = ok and same
+
+    return ok
+
+def main(args):
+    opts, files = getopt.getopt(args, 'ro:')
+    options = 0
+    resume = False
+    for opt, value in opts:
+        if opt == '-r':
+            resume = True
+        else:
+            options = int(value, 0)
+    if not files:
+        print __doc__
+        return 2
+
+    tmpdir = tempfile.mkdtemp(prefix='reprocheck')
+    try:
+        results = [check(f, tmpdir, options, resume) for f in files]
+    finally:
+        shutil.rmtree(tmpdir)
+
+    return not all(results) and 1 or 0
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -2,15 +2,15 @@
 import os
 from distutils.core import setup, Extension
 
-pc = os.popen("pkg-config --cflags-only-I glib-2.0 libxml-2.0 sqlite3", "r")
+pc = os.popen("pkg-config --cflags-only-I glib-2.0 libxml-2.0 sqlite3 zlib libzstd", "r")
 includes = list(map(lambda x:x[2:], pc.readline().split()))
 pc.close()
 
-pc = os.popen("pkg-config --libs-only-l glib-2.0 libxml-2.0 sqlite3", "r")
+pc = os.popen("pkg-config --libs-only-l glib-2.0 libxml-2.0 sqlite3 zlib libzstd", "r")
 libs = list(map(lambda x:x[2:], pc.readline().split()))
 pc.close()
 
-pc = os.popen("pkg-config --libs-only-L glib-2.0 libxml-2.0 sqlite3", "r")
+pc = os.popen("pkg-config --libs-only-L glib-2.0 libxml-2.0 sqlite3 zlib libzstd", "r")
 libdirs = list(map(lambda x:x[2:], pc.readline().split()))
 pc.close()
 
@@ -20,11 +20,35 @@ module = Extension('_sqlitecache',
                    library_dirs = libdirs,
                    sources = ['package.c',
                               'xml-parser.c',
+                              'pkgid-set.c',
                               'db.c',
+                              'lookup-index.c',
+                              'columnar.c',
+                              'gzip-reader.c',
+                              'changelog-index.c',
+                              'repo-diff.c',
+                              'text-codec.c',
+                              'filelist-row.c',
+                              'sql-functions.c',
                               'sqlitecache.c'])
 
+# Not a Python module: a loadable SQLite extension with virtual tables over
+# the metadata files, see xml-vtab.c
+vtab = Extension('yumxml',
+                 include_dirs = includes,
+                 libraries = libs,
+                 library_dirs = libdirs,
+                 define_macros = [('YUM_SQLITE_EXTENSION', None)],
+                 sources = ['package.c',
+                            'xml-parser.c',
+                            'gzip-reader.c',
+                            'text-codec.c',
+                            'filelist-row.c',
+                            'sql-functions.c',
+                            'xml-vtab.c'])
+
 setup (name = 'yum-metadata-parser',
        version = '1.1.4',
        description = 'A fast YUM meta-data parser',
 	   py_modules = ['sqlitecachec'],
-       ext_modules = [module])
+       ext_modules = [module, vtab])
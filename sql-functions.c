@@ -0,0 +1,322 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <string.h>
+#include "text-codec.h"
+#include "filelist-row.h"
+#include "sql-functions.h"
+
+/* yum_pack () and yum_unpack () of a connection share a codec, which has
+   all the dictionaries once yum_pack () ran.  Each function holds a
+   reference: either can be replaced on its own. */
+typedef struct {
+    YumTextCodec *codec;
+    gboolean dicts_loaded;
+    guint refs;
+} TextFunctions;
+
+static void
+text_functions_unref (void *data)
+{
+    TextFunctions *funcs = (TextFunctions *) data;
+
+    if (--funcs->refs)
+        return;
+
+    yum_text_codec_free (funcs->codec);
+    g_free (funcs);
+}
+
+static void
+text_dict_load (sqlite3 *db, YumTextCodec *codec, guint32 id, GError **err)
+{
+    sqlite3_stmt *handle = NULL;
+    const char *query;
+    int rc;
+
+    /* All of them, the first one compresses */
+    if (id)
+        query = "SELECT dict FROM zstd_dicts WHERE dictId = ?";
+    else
+        query = "SELECT dict FROM zstd_dicts ORDER BY rowid";
+
+    rc = sqlite3_prepare_v2 (db, query, -1, &handle, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error (err, YUM_TEXT_ERROR, YUM_TEXT_ERROR,
+                     "Can not read text dictionaries: %s",
+                     sqlite3_errmsg (db));
+        goto cleanup;
+    }
+
+    if (id)
+        sqlite3_bind_int64 (handle, 1, id);
+
+    while (sqlite3_step (handle) == SQLITE_ROW) {
+        guint32 row_id = yum_text_dict_id (sqlite3_column_blob (handle, 0),
+                                           sqlite3_column_bytes (handle, 0));
+
+        if (yum_text_codec_has_dict (codec, row_id))
+            continue;
+        if (!yum_text_codec_add_dict (codec,
+                                      sqlite3_column_blob (handle, 0),
+                                      sqlite3_column_bytes (handle, 0),
+                                      err))
+            goto cleanup;
+    }
+
+    if (id && !yum_text_codec_has_dict (codec, id))
+        g_set_error (err, YUM_TEXT_ERROR, YUM_TEXT_ERROR,
+                     "No text dictionary %u", id);
+
+ cleanup:
+    sqlite3_finalize (handle);
+}
+
+static void
+text_pack_func (sqlite3_context *ctx, int argc, sqlite3_value **argv)
+{
+    TextFunctions *funcs = (TextFunctions *) sqlite3_user_data (ctx);
+    const char *text;
+    char *packed;
+    gsize len;
+    GError *err = NULL;
+
+    if (sqlite3_value_type (argv[0]) != SQLITE_TEXT) {
+        sqlite3_result_value (ctx, argv[0]);
+        return;
+    }
+
+    /* The one the build stored before packing */
+    if (!funcs->dicts_loaded) {
+        text_dict_load (sqlite3_context_db_handle (ctx), funcs->codec, 0,
+                        &err);
+        funcs->dicts_loaded = (err == NULL);
+    }
+
+    if (!err) {
+        text = (const char *) sqlite3_value_text (argv[0]);
+        packed = yum_text_codec_pack (funcs->codec, text,
+                                      sqlite3_value_bytes (argv[0]),
+                                      &len, &err);
+    }
+    if (err) {
+        sqlite3_result_error (ctx, err->message, -1);
+        g_error_free (err);
+        return;
+    }
+
+    sqlite3_result_blob (ctx, packed, len, g_free);
+}
+
+static void
+text_unpack_func (sqlite3_context *ctx, int argc, sqlite3_value **argv)
+{
+    TextFunctions *funcs = (TextFunctions *) sqlite3_user_data (ctx);
+    const char *packed;
+    gsize packed_len;
+    guint32 id;
+    char *text = NULL;
+    gsize len;
+    GError *err = NULL;
+
+    /* Not packed (yet) */
+    if (sqlite3_value_type (argv[0]) != SQLITE_BLOB) {
+        sqlite3_result_value (ctx, argv[0]);
+        return;
+    }
+
+    packed = sqlite3_value_blob (argv[0]);
+    packed_len = sqlite3_value_bytes (argv[0]);
+
+    id = yum_text_packed_dict_id (packed, packed_len);
+    if (id && !yum_text_codec_has_dict (funcs->codec, id))
+        text_dict_load (sqlite3_context_db_handle (ctx), funcs->codec, id,
+                        &err);
+    if (!err)
+        text = yum_text_codec_unpack (funcs->codec, packed, packed_len,
+                                      &len, &err);
+
+    if (err) {
+        sqlite3_result_error (ctx, err->message, -1);
+        g_error_free (err);
+        return;
+    }
+
+    sqlite3_result_text (ctx, text, len, g_free);
+}
+
+int
+yum_sql_register_text_functions (sqlite3 *db)
+{
+    TextFunctions *funcs;
+    int rc;
+
+    funcs = g_new0 (TextFunctions, 1);
+    funcs->codec = yum_text_codec_new ();
+
+    /* SQLite drops the reference of a function when it is replaced or the
+       connection closes, or right away when registering it fails */
+    funcs->refs = 1;
+    rc = sqlite3_create_function_v2 (db, "yum_unpack", 1,
+                                     SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+                                     funcs, text_unpack_func, NULL, NULL,
+                                     text_functions_unref);
+    if (rc != SQLITE_OK)
+        return rc;
+
+    funcs->refs++;
+    return sqlite3_create_function_v2 (db, "yum_pack", 1, SQLITE_UTF8, funcs,
+                                       text_pack_func, NULL, NULL,
+                                       text_functions_unref);
+}
+
+/* The filelist rows, see filelist-row.h.  NULL in, NULL out. */
+
+static void
+filelist_paths_func (sqlite3_context *ctx, int argc, sqlite3_value **argv)
+{
+    const char *dirname = (const char *) sqlite3_value_text (argv[0]);
+    const char *filenames = (const char *) sqlite3_value_text (argv[1]);
+    GString *paths;
+
+    if (!dirname || !filenames) {
+        sqlite3_result_null (ctx);
+        return;
+    }
+
+    paths = g_string_sized_new (256);
+    yum_filelist_row_paths (dirname, filenames, paths);
+    sqlite3_result_text (ctx, paths->str, paths->len, g_free);
+    g_string_free (paths, FALSE);
+}
+
+static void
+filelist_has_func (sqlite3_context *ctx, int argc, sqlite3_value **argv)
+{
+    const char *dirname = (const char *) sqlite3_value_text (argv[0]);
+    const char *filenames = (const char *) sqlite3_value_text (argv[1]);
+    const char *path = (const char *) sqlite3_value_text (argv[2]);
+
+    if (!dirname || !filenames || !path) {
+        sqlite3_result_null (ctx);
+        return;
+    }
+
+    sqlite3_result_int (ctx, yum_filelist_row_has (dirname, filenames, path));
+}
+
+static void
+filelist_glob_func (sqlite3_context *ctx, int argc, sqlite3_value **argv)
+{
+    const char *dirname = (const char *) sqlite3_value_text (argv[0]);
+    const char *filenames = (const char *) sqlite3_value_text (argv[1]);
+    const char *pattern = (const char *) sqlite3_value_text (argv[2]);
+
+    if (!dirname || !filenames || !pattern) {
+        sqlite3_result_null (ctx);
+        return;
+    }
+
+    sqlite3_result_int (ctx, yum_filelist_row_glob (dirname, filenames,
+                                                    pattern));
+}
+
+static gint
+path_lines_cmp (gconstpointer a, gconstpointer b)
+{
+    return strcmp (*(const char **) a, *(const char **) b);
+}
+
+static void
+path_lines_step (sqlite3_context *ctx, int argc, sqlite3_value **argv)
+{
+    const char *path = (const char *) sqlite3_value_text (argv[0]);
+    GPtrArray **lines;
+
+    if (!path)
+        return;
+
+    lines = sqlite3_aggregate_context (ctx, sizeof (GPtrArray *));
+    if (!lines) {
+        sqlite3_result_error_nomem (ctx);
+        return;
+    }
+
+    if (!*lines)
+        *lines = g_ptr_array_new ();
+    g_ptr_array_add (*lines, g_strdup (path));
+}
+
+/* Sorted, whatever order the rows came in: the paths of a package have to
+   come out the same when they are deleted as when they were added */
+static void
+path_lines_final (sqlite3_context *ctx)
+{
+    GPtrArray **lines = sqlite3_aggregate_context (ctx, 0);
+    GString *text;
+    guint i;
+
+    if (!lines || !*lines) {
+        sqlite3_result_null (ctx);
+        return;
+    }
+
+    g_ptr_array_sort (*lines, path_lines_cmp);
+
+    text = g_string_sized_new (1024);
+    for (i = 0; i < (*lines)->len; i++) {
+        if (i)
+            g_string_append_c (text, '\n');
+        g_string_append (text, g_ptr_array_index (*lines, i));
+        g_free (g_ptr_array_index (*lines, i));
+    }
+    g_ptr_array_free (*lines, TRUE);
+
+    sqlite3_result_text (ctx, text->str, text->len, g_free);
+    g_string_free (text, FALSE);
+}
+
+int
+yum_sql_register_filelist_functions (sqlite3 *db)
+{
+    const struct {
+        const char *name;
+        int n_args;
+        void (*func) (sqlite3_context *, int, sqlite3_value **);
+    } functions[] = {
+        { "yum_filelist_paths", 2, filelist_paths_func },
+        { "yum_filelist_has", 3, filelist_has_func },
+        { "yum_filelist_glob", 3, filelist_glob_func },
+        { NULL, 0, NULL }
+    };
+    int i;
+    int rc = SQLITE_OK;
+
+    for (i = 0; rc == SQLITE_OK && functions[i].name; i++)
+        rc = sqlite3_create_function (db, functions[i].name,
+                                      functions[i].n_args,
+                                      SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+                                      NULL, functions[i].func, NULL, NULL);
+
+    if (rc == SQLITE_OK)
+        rc = sqlite3_create_function (db, "yum_path_lines", 1,
+                                      SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+                                      NULL, NULL, path_lines_step,
+                                      path_lines_final);
+
+    return rc;
+}
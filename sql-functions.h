@@ -0,0 +1,40 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef __YUM_SQL_FUNCTIONS_H__
+#define __YUM_SQL_FUNCTIONS_H__
+
+#include "sqlite-api.h"
+
+/* SQL functions over the columns of the caches, which db.c registers for
+ * its builds and the yumxml extension for other programs.  Both return an
+ * SQLite result code. */
+
+/* yum_pack (text) and yum_unpack (text) of YUM_DB_COMPRESS_TEXT caches,
+   with the dictionaries of the zstd_dicts table.  Anything but text
+   (blobs) goes through yum_pack () (yum_unpack ()) unchanged. */
+int           yum_sql_register_text_functions (sqlite3 *db);
+
+/* yum_filelist_paths (dirname, filenames),
+   yum_filelist_has (dirname, filenames, path) and
+   yum_filelist_glob (dirname, filenames, pattern) over the rows of the
+   filelist table, see filelist-row.h, and the aggregate
+   yum_path_lines (paths) that joins its arguments with newlines, sorted
+   with strcmp () */
+int           yum_sql_register_filelist_functions (sqlite3 *db);
+
+#endif /* __YUM_SQL_FUNCTIONS_H__ */
@@ -17,28 +17,55 @@
 
 #include <Python.h>
 
+#include <errno.h>
+#include <sys/stat.h>
+
 #include "xml-parser.h"
 #include "db.h"
+#include "lookup-index.h"
+#include "changelog-index.h"
+#include "columnar.h"
+#include "repo-diff.h"
 #include "package.h"
+#include "text-codec.h"
+#include "filelist-row.h"
+
+/* Commit and record a resumable checkpoint every this many packages */
+#define CHECKPOINT_PACKAGES 1000
 
-/* Make room for 2500 package ids, 40 bytes + '\0' each */
-#define PACKAGE_IDS_CHUNK 41 * 2500
+/* Set by cancel (), checked between packages of the builds that are not
+   in a Session.  A build clears it when it ends, not when it starts, so
+   that a cancel () that comes before the first package still stops it. */
+static volatile gboolean cancel_requested = FALSE;
 
 typedef struct _UpdateInfo UpdateInfo;
 
 typedef void (*InfoInitFn) (UpdateInfo *update_info, sqlite3 *db, GError **err);
 typedef void (*InfoCleanFn) (UpdateInfo *update_info);
+typedef void (*InfoOptionsFn) (UpdateInfo *update_info);
+typedef void (*InfoFlushFn) (UpdateInfo *update_info);
+typedef void (*InfoFreeFn) (UpdateInfo *update_info);
 
 typedef void (*XmlParseFn)  (const char *filename,
                              CountFn count_callback,
                              PackageFn package_callback,
+                             PackageFn files_callback,
                              gpointer user_data,
                              GError **err);
 
+/* The same, fed in pieces */
+typedef YumXmlParser *(*XmlParserNewFn) (CountFn count_callback,
+                                         PackageFn package_callback,
+                                         PackageFn files_callback,
+                                         gpointer user_data,
+                                         GError **err);
+
 typedef void (*WriteDbPackageFn) (UpdateInfo *update_info, Package *package);
 
 typedef void (*IndexTablesFn) (sqlite3 *db, GError **err);
 
+typedef void (*SearchTablesFn) (sqlite3 *db, guint options, GError **err);
+
 struct _UpdateInfo {
     sqlite3 *db;
     sqlite3_stmt *remove_handle;
@@ -46,18 +73,40 @@ struct _UpdateInfo {
     guint32 packages_seen;
     guint32 add_count;
     guint32 del_count;
-    GHashTable *current_packages;
-    GHashTable *all_packages;
-    GStringChunk *package_ids_chunk;
-    GTimer *timer;
     gpointer python_callback;
+
+    /* Kept between the builds of a Session, freed by update_info_free () */
+    YumPkgIdSet *current_packages;
+    YumPkgIdSet *all_packages;
+    GTimer *timer;
+    gboolean busy;
+    /* The flag of the Session, NULL for cancel_requested */
+    volatile gboolean *cancel;
+
+    const char *checksum;
+    guint options;
+    const YumDbProfile *profile;
+    guint32 packages_parsed;
+    guint32 resume_count;
+    GError **error;
     
     InfoInitFn info_init;
     InfoCleanFn info_clean;
+    InfoOptionsFn info_options;
+    InfoFlushFn info_flush;
+    InfoFreeFn info_free;
     CreateTablesFn create_tables;
     WriteDbPackageFn write_package;
+    WriteDbPackageFn write_files;
     XmlParseFn xml_parse;
+    XmlParserNewFn xml_parser_new;
     IndexTablesFn index_tables;
+    /* YUM_DB_SEARCH_INDEX, filled after the other indexes */
+    SearchTablesFn search_tables;
+    /* YUM_DB_PATH_INDEX, once the files are in place */
+    IndexTablesFn path_tables;
+    /* YUM_DB_COMPRESS_TEXT, once the search index has the text */
+    IndexTablesFn pack_tables;
 
     gpointer user_data;
 };
@@ -68,8 +117,12 @@ update_info_init (UpdateInfo *info, GError **err)
     const char *sql;
     int rc;
 
+    if (!info->timer)
+        info->timer = g_timer_new ();
+    g_timer_start (info->timer);
+
     sql = "DELETE FROM packages WHERE pkgKey = ?";
-    rc = sqlite3_prepare (info->db, sql, -1, &info->remove_handle, NULL);
+    rc = sqlite3_prepare_v2 (info->db, sql, -1, &info->remove_handle, NULL);
     if (rc != SQLITE_OK) {
         g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
                      "Can not prepare package removal: %s",
@@ -82,37 +135,52 @@ update_info_init (UpdateInfo *info, GError **err)
     info->packages_seen = 0;
     info->add_count = 0;
     info->del_count = 0;
-    info->all_packages = g_hash_table_new (g_str_hash, g_str_equal);
-    info->package_ids_chunk = g_string_chunk_new (PACKAGE_IDS_CHUNK);
-    info->timer = g_timer_new ();
-    g_timer_start (info->timer);
-    info->current_packages = yum_db_read_package_ids (info->db, err);
+
+    if (info->all_packages)
+        yum_pkgid_set_clear (info->all_packages);
+    else
+        info->all_packages = yum_pkgid_set_new (0);
+
+    if (info->current_packages)
+        yum_pkgid_set_clear (info->current_packages);
+    else
+        info->current_packages = yum_pkgid_set_new (0);
+
+    yum_db_read_package_ids (info->db, info->current_packages, err);
 }
 
 static void
-remove_entry (gpointer key, gpointer value, gpointer user_data)
+remove_entry (const char *pkgId, gint pkgKey, gpointer user_data)
 {
     UpdateInfo *info = (UpdateInfo *) user_data;
 
-    if (g_hash_table_lookup (info->all_packages, key) == NULL) {
+    /* The first failure stops the build */
+    if (*info->error)
+        return;
+
+    if (!yum_pkgid_set_lookup (info->all_packages, pkgId, NULL)) {
         int rc;
 
-        sqlite3_bind_int (info->remove_handle, 1, GPOINTER_TO_INT (value));
+        sqlite3_bind_int (info->remove_handle, 1, pkgKey);
         rc = sqlite3_step (info->remove_handle);
         sqlite3_reset (info->remove_handle);
 
-        if (rc != SQLITE_DONE)
-            g_warning ("Error removing package from SQL: %s",
-                       sqlite3_errmsg (info->db));
+        if (rc != SQLITE_DONE) {
+            g_set_error (info->error, YUM_DB_ERROR, YUM_DB_ERROR,
+                         "Error removing package from SQL: %s",
+                         sqlite3_errmsg (info->db));
+            return;
+        }
 
         info->del_count++;
     }
 }
 
 static void
-update_info_remove_old_entries (UpdateInfo *info)
+update_info_remove_old_entries (UpdateInfo *info, GError **err)
 {
-    g_hash_table_foreach (info->current_packages, remove_entry, info);
+    info->error = err;
+    yum_pkgid_set_foreach (info->current_packages, remove_entry, info);
 }
 
 static void
@@ -121,6 +189,7 @@ count_cb (guint32 count, gpointer user_data)
     UpdateInfo *info = (UpdateInfo *) user_data;
 
     info->count_from_md = count;
+    yum_pkgid_set_reserve (info->all_packages, count);
 }
 
 static void
@@ -128,12 +197,11 @@ update_info_done (UpdateInfo *info, GError **err)
 {
     if (info->remove_handle)
         sqlite3_finalize (info->remove_handle);
-    if (info->current_packages)
-        g_hash_table_destroy (info->current_packages);
-    if (info->all_packages)
-        g_hash_table_destroy (info->all_packages);
-    if (info->package_ids_chunk)
-        g_string_chunk_free (info->package_ids_chunk);
+    info->remove_handle = NULL;
+
+    /* Not started when the database could not be opened */
+    if (!info->timer)
+        return;
 
     g_timer_stop (info->timer);
     if (!*err) {
@@ -141,8 +209,19 @@ update_info_done (UpdateInfo *info, GError **err)
                    info->add_count, info->del_count,
                    g_timer_elapsed (info->timer, NULL));
     }
+}
 
-    g_timer_destroy (info->timer);
+static void
+update_info_free (UpdateInfo *info)
+{
+    if (info->info_free)
+        info->info_free (info);
+    if (info->current_packages)
+        yum_pkgid_set_free (info->current_packages);
+    if (info->all_packages)
+        yum_pkgid_set_free (info->all_packages);
+    if (info->timer)
+        g_timer_destroy (info->timer);
 }
 
 
@@ -151,83 +230,174 @@ update_info_done (UpdateInfo *info, GError **err)
 typedef struct {
     UpdateInfo update_info;
     sqlite3_stmt *pkg_handle;
-    sqlite3_stmt *requires_handle;
-    sqlite3_stmt *provides_handle;
-    sqlite3_stmt *conflicts_handle;
-    sqlite3_stmt *obsoletes_handle;
-    sqlite3_stmt *suggests_handle;
-    sqlite3_stmt *enhances_handle;
-    sqlite3_stmt *recommends_handle;
-    sqlite3_stmt *supplements_handle;
-    sqlite3_stmt *files_handle;
+    YumDbBatch *requires_batch;
+    YumDbBatch *provides_batch;
+    YumDbBatch *conflicts_batch;
+    YumDbBatch *obsoletes_batch;
+    YumDbBatch *suggests_batch;
+    YumDbBatch *enhances_batch;
+    YumDbBatch *recommends_batch;
+    YumDbBatch *supplements_batch;
+    YumDbBatch *files_batch;
+    guint batch_options;
 } PackageWriterInfo;
 
+/* The batches of a session's previous build move to the new database */
+static gboolean
+batch_reuse (YumDbBatch *batch, sqlite3 *db, GError **err)
+{
+    if (!batch)
+        return FALSE;
+
+    yum_db_batch_set_db (batch, db, err);
+    return TRUE;
+}
+
+static void
+batch_free (YumDbBatch **batch)
+{
+    if (*batch)
+        yum_db_batch_free (*batch);
+    *batch = NULL;
+}
+
+static void
+package_writer_info_free (UpdateInfo *update_info)
+{
+    PackageWriterInfo *info = (PackageWriterInfo *) update_info;
+
+    batch_free (&info->requires_batch);
+    batch_free (&info->provides_batch);
+    batch_free (&info->conflicts_batch);
+    batch_free (&info->obsoletes_batch);
+    batch_free (&info->suggests_batch);
+    batch_free (&info->enhances_batch);
+    batch_free (&info->recommends_batch);
+    batch_free (&info->supplements_batch);
+    batch_free (&info->files_batch);
+}
+
+static void
+package_writer_info_options (UpdateInfo *update_info)
+{
+    if (update_info->options & YUM_DB_PRIMARY_CLUSTERED) {
+        update_info->create_tables = yum_db_create_primary_clustered_tables;
+        update_info->index_tables = yum_db_index_primary_clustered_tables;
+    } else {
+        update_info->create_tables = yum_db_create_primary_tables;
+        update_info->index_tables = yum_db_index_primary_tables;
+    }
+
+    if (update_info->options & YUM_DB_SEARCH_INDEX)
+        update_info->search_tables = yum_db_index_primary_search;
+    else
+        update_info->search_tables = NULL;
+
+    if (update_info->options & YUM_DB_PATH_INDEX)
+        update_info->path_tables = yum_db_index_primary_paths;
+    else
+        update_info->path_tables = NULL;
+
+    if (update_info->options & YUM_DB_COMPRESS_TEXT)
+        update_info->pack_tables = yum_db_pack_primary_text;
+    else
+        update_info->pack_tables = NULL;
+}
+
 static void
 package_writer_info_init (UpdateInfo *update_info, sqlite3 *db, GError **err)
 {
     PackageWriterInfo *info = (PackageWriterInfo *) update_info;
+    guint options = update_info->options;
+
+    /* Before any statement is prepared, a new table expires them */
+    if (options & YUM_DB_PRIMARY_CLUSTERED) {
+        yum_db_stage_primary_tables (db, err);
+        if (*err)
+            return;
+    }
 
     info->pkg_handle = yum_db_package_prepare (db, err);
     if (*err)
         return;
-    info->requires_handle = yum_db_dependency_prepare (db, "requires", err);
+
+    /* The layout decides which tables the batches write */
+    if (info->batch_options != options)
+        package_writer_info_free (update_info);
+    info->batch_options = options;
+
+    if (!batch_reuse (info->requires_batch, db, err))
+        info->requires_batch =
+            yum_db_dependency_prepare (db, "requires", options, err);
     if (*err)
         return;
-    info->provides_handle = yum_db_dependency_prepare (db, "provides", err);
+    if (!batch_reuse (info->provides_batch, db, err))
+        info->provides_batch =
+            yum_db_dependency_prepare (db, "provides", options, err);
     if (*err)
         return;
-    info->conflicts_handle = yum_db_dependency_prepare (db, "conflicts", err);
+    if (!batch_reuse (info->conflicts_batch, db, err))
+        info->conflicts_batch =
+            yum_db_dependency_prepare (db, "conflicts", options, err);
     if (*err)
         return;
-    info->obsoletes_handle = yum_db_dependency_prepare (db, "obsoletes", err);
+    if (!batch_reuse (info->obsoletes_batch, db, err))
+        info->obsoletes_batch =
+            yum_db_dependency_prepare (db, "obsoletes", options, err);
     if (*err)
         return;
-    info->suggests_handle = yum_db_dependency_prepare (db, "suggests", err);
+    if (!batch_reuse (info->suggests_batch, db, err))
+        info->suggests_batch =
+            yum_db_dependency_prepare (db, "suggests", options, err);
     if (*err)
         return;
-    info->enhances_handle = yum_db_dependency_prepare (db, "enhances", err);
+    if (!batch_reuse (info->enhances_batch, db, err))
+        info->enhances_batch =
+            yum_db_dependency_prepare (db, "enhances", options, err);
     if (*err)
         return;
-    info->recommends_handle = yum_db_dependency_prepare (db, "recommends", err);
+    if (!batch_reuse (info->recommends_batch, db, err))
+        info->recommends_batch =
+            yum_db_dependency_prepare (db, "recommends", options, err);
     if (*err)
         return;
-    info->supplements_handle = yum_db_dependency_prepare (db, "supplements", err);
+    if (!batch_reuse (info->supplements_batch, db, err))
+        info->supplements_batch =
+            yum_db_dependency_prepare (db, "supplements", options, err);
     if (*err)
         return;
-    info->files_handle = yum_db_file_prepare (db, err);
+    if (!batch_reuse (info->files_batch, db, err))
+        info->files_batch = yum_db_file_prepare (db, options, err);
 }
 
 static void
-write_deps (sqlite3 *db, sqlite3_stmt *handle, gint64 pkgKey, 
-            GSList *deps)
+write_deps (YumDbBatch *batch, gint64 pkgKey, GSList *deps)
 {
     GSList *iter;
 
     for (iter = deps; iter; iter = iter->next)
-        yum_db_dependency_write (db, handle, pkgKey, (Dependency *) iter->data,
+        yum_db_dependency_write (batch, pkgKey, (Dependency *) iter->data,
                                  FALSE);
 }
 
 static void
-write_requirements (sqlite3 *db, sqlite3_stmt *handle, gint64 pkgKey,
-            GSList *deps)
+write_requirements (YumDbBatch *batch, gint64 pkgKey, GSList *deps)
 {
     GSList *iter;
 
     for (iter = deps; iter; iter = iter->next)
-        yum_db_dependency_write (db, handle, pkgKey, (Dependency *) iter->data,
+        yum_db_dependency_write (batch, pkgKey, (Dependency *) iter->data,
                                  TRUE);
 }
 
 
 static void
-write_files (sqlite3 *db, sqlite3_stmt *handle, Package *pkg)
+write_files (YumDbBatch *batch, Package *pkg)
 {
     GSList *iter;
 
     for (iter = pkg->files; iter; iter = iter->next)
-        yum_db_file_write (db, handle, pkg->pkgKey,
-                           (PackageFile *) iter->data);
+        yum_db_file_write (batch, pkg->pkgKey, (PackageFile *) iter->data);
 }
 
 static void
@@ -237,24 +407,41 @@ write_package_to_db (UpdateInfo *update_info, Package *package)
 
     yum_db_package_write (update_info->db, info->pkg_handle, package);
 
-    write_requirements (update_info->db, info->requires_handle,
-                    package->pkgKey, package->requires);
-    write_deps (update_info->db, info->provides_handle,
-                package->pkgKey, package->provides);
-    write_deps (update_info->db, info->conflicts_handle,
-                package->pkgKey, package->conflicts);
-    write_deps (update_info->db, info->obsoletes_handle,
-                package->pkgKey, package->obsoletes);
-    write_deps (update_info->db, info->suggests_handle,
-                package->pkgKey, package->suggests);
-    write_deps (update_info->db, info->enhances_handle,
-                package->pkgKey, package->enhances);
-    write_deps (update_info->db, info->recommends_handle,
-                package->pkgKey, package->recommends);
-    write_deps (update_info->db, info->supplements_handle,
-                package->pkgKey, package->supplements);
+    write_requirements (info->requires_batch,
+                        package->pkgKey, package->requires);
+    write_deps (info->provides_batch, package->pkgKey, package->provides);
+    write_deps (info->conflicts_batch, package->pkgKey, package->conflicts);
+    write_deps (info->obsoletes_batch, package->pkgKey, package->obsoletes);
+    write_deps (info->suggests_batch, package->pkgKey, package->suggests);
+    write_deps (info->enhances_batch, package->pkgKey, package->enhances);
+    write_deps (info->recommends_batch, package->pkgKey, package->recommends);
+    write_deps (info->supplements_batch, package->pkgKey, package->supplements);
+
+    write_files (info->files_batch, package);
+}
+
+static void
+write_package_files_to_db (UpdateInfo *update_info, Package *package)
+{
+    PackageWriterInfo *info = (PackageWriterInfo *) update_info;
+
+    write_files (info->files_batch, package);
+}
+
+static void
+package_writer_info_flush (UpdateInfo *update_info)
+{
+    PackageWriterInfo *info = (PackageWriterInfo *) update_info;
 
-    write_files (update_info->db, info->files_handle, package);
+    yum_db_batch_flush (info->requires_batch);
+    yum_db_batch_flush (info->provides_batch);
+    yum_db_batch_flush (info->conflicts_batch);
+    yum_db_batch_flush (info->obsoletes_batch);
+    yum_db_batch_flush (info->suggests_batch);
+    yum_db_batch_flush (info->enhances_batch);
+    yum_db_batch_flush (info->recommends_batch);
+    yum_db_batch_flush (info->supplements_batch);
+    yum_db_batch_flush (info->files_batch);
 }
 
 static void
@@ -264,24 +451,43 @@ package_writer_info_clean (UpdateInfo *update_info)
     
     if (info->pkg_handle)
         sqlite3_finalize (info->pkg_handle);
-    if (info->requires_handle)
-        sqlite3_finalize (info->requires_handle);
-    if (info->provides_handle)
-        sqlite3_finalize (info->provides_handle);
-    if (info->conflicts_handle)
-        sqlite3_finalize (info->conflicts_handle);
-    if (info->obsoletes_handle)
-        sqlite3_finalize (info->obsoletes_handle);
-    if (info->suggests_handle)
-        sqlite3_finalize (info->suggests_handle);
-    if (info->enhances_handle)
-        sqlite3_finalize (info->enhances_handle);
-    if (info->recommends_handle)
-        sqlite3_finalize (info->recommends_handle);
-    if (info->supplements_handle)
-        sqlite3_finalize (info->supplements_handle);
-    if (info->files_handle)
-        sqlite3_finalize (info->files_handle);
+    info->pkg_handle = NULL;
+    if (info->requires_batch)
+        yum_db_batch_set_db (info->requires_batch, NULL, NULL);
+    if (info->provides_batch)
+        yum_db_batch_set_db (info->provides_batch, NULL, NULL);
+    if (info->conflicts_batch)
+        yum_db_batch_set_db (info->conflicts_batch, NULL, NULL);
+    if (info->obsoletes_batch)
+        yum_db_batch_set_db (info->obsoletes_batch, NULL, NULL);
+    if (info->suggests_batch)
+        yum_db_batch_set_db (info->suggests_batch, NULL, NULL);
+    if (info->enhances_batch)
+        yum_db_batch_set_db (info->enhances_batch, NULL, NULL);
+    if (info->recommends_batch)
+        yum_db_batch_set_db (info->recommends_batch, NULL, NULL);
+    if (info->supplements_batch)
+        yum_db_batch_set_db (info->supplements_batch, NULL, NULL);
+    if (info->files_batch)
+        yum_db_batch_set_db (info->files_batch, NULL, NULL);
+}
+
+static void
+package_writer_info_setup (PackageWriterInfo *info)
+{
+    memset (info, 0, sizeof (PackageWriterInfo));
+
+    info->update_info.info_init = package_writer_info_init;
+    info->update_info.info_clean = package_writer_info_clean;
+    info->update_info.info_flush = package_writer_info_flush;
+    info->update_info.info_free = package_writer_info_free;
+    info->update_info.info_options = package_writer_info_options;
+    info->update_info.create_tables = yum_db_create_primary_tables;
+    info->update_info.write_package = write_package_to_db;
+    info->update_info.write_files = write_package_files_to_db;
+    info->update_info.xml_parse = yum_xml_parse_primary;
+    info->update_info.xml_parser_new = yum_xml_parser_new_primary;
+    info->update_info.index_tables = yum_db_index_primary_tables;
 }
 
 
@@ -291,8 +497,27 @@ typedef struct {
     UpdateInfo update_info;
     sqlite3_stmt *pkg_handle;
     sqlite3_stmt *file_handle;
+    sqlite3_stmt *dirs_handle;
+    YumFilelistEncoder *encoder;
 } FileListInfo;
 
+static void
+update_filelist_info_options (UpdateInfo *update_info)
+{
+    if (update_info->options & YUM_DB_FILELIST_DIRS) {
+        update_info->create_tables = yum_db_create_filelist_dirs_tables;
+        update_info->index_tables = yum_db_index_filelist_dirs_tables;
+    } else {
+        update_info->create_tables = yum_db_create_filelist_tables;
+        update_info->index_tables = yum_db_index_filelist_tables;
+    }
+
+    if (update_info->options & YUM_DB_PATH_INDEX)
+        update_info->path_tables = yum_db_index_filelist_paths;
+    else
+        update_info->path_tables = NULL;
+}
+
 static void
 update_filelist_info_init (UpdateInfo *update_info, sqlite3 *db, GError **err)
 {
@@ -302,7 +527,23 @@ update_filelist_info_init (UpdateInfo *update_info, sqlite3 *db, GError **err)
     if (*err)
         return;
 
-    info->file_handle = yum_db_filelists_prepare (db, err);
+    if (update_info->options & YUM_DB_FILELIST_DIRS)
+        info->file_handle = yum_db_filelists_packed_prepare (db, err);
+    else
+        info->file_handle = yum_db_filelists_prepare (db, err);
+    if (*err)
+        return;
+
+    info->encoder = yum_db_filelist_encoder_new ();
+
+    if (update_info->options & YUM_DB_FILELIST_DIRS) {
+        info->dirs_handle = yum_db_dirs_prepare (db, err);
+        if (*err)
+            return;
+
+        yum_db_filelist_encoder_use_dirs (info->encoder, db,
+                                          info->dirs_handle, err);
+    }
 }
 
 static void
@@ -314,6 +555,15 @@ update_filelist_info_clean (UpdateInfo *update_info)
         sqlite3_finalize (info->pkg_handle);
     if (info->file_handle)
         sqlite3_finalize (info->file_handle);
+    if (info->dirs_handle)
+        sqlite3_finalize (info->dirs_handle);
+    if (info->encoder)
+        yum_db_filelist_encoder_free (info->encoder);
+
+    info->pkg_handle = NULL;
+    info->file_handle = NULL;
+    info->dirs_handle = NULL;
+    info->encoder = NULL;
 }
 
 static void
@@ -322,16 +572,43 @@ write_filelist_package_to_db (UpdateInfo *update_info, Package *package)
     FileListInfo *info = (FileListInfo *) update_info;
 
     yum_db_package_ids_write (update_info->db, info->pkg_handle, package);
-    yum_db_filelists_write (update_info->db, info->file_handle, package);
+    yum_db_filelists_write (update_info->db, info->file_handle, info->encoder,
+                            package);
+}
+
+static void
+write_filelist_files_to_db (UpdateInfo *update_info, Package *package)
+{
+    FileListInfo *info = (FileListInfo *) update_info;
+
+    yum_db_filelists_write (update_info->db, info->file_handle, info->encoder,
+                            package);
+}
+
+static void
+update_filelist_info_setup (FileListInfo *info)
+{
+    memset (info, 0, sizeof (FileListInfo));
+
+    info->update_info.info_init = update_filelist_info_init;
+    info->update_info.info_clean = update_filelist_info_clean;
+    info->update_info.info_options = update_filelist_info_options;
+    info->update_info.create_tables = yum_db_create_filelist_tables;
+    info->update_info.write_package = write_filelist_package_to_db;
+    info->update_info.write_files = write_filelist_files_to_db;
+    info->update_info.xml_parse = yum_xml_parse_filelists;
+    info->update_info.xml_parser_new = yum_xml_parser_new_filelists;
+    info->update_info.index_tables = yum_db_index_filelist_tables;
 }
 
 
+
 /* Other */
 
 typedef struct {
     UpdateInfo update_info;
     sqlite3_stmt *pkg_handle;
-    sqlite3_stmt *changelog_handle;
+    YumDbBatch *changelog_batch;
 } UpdateOtherInfo;
 
 static void
@@ -342,7 +619,8 @@ update_other_info_init (UpdateInfo *update_info, sqlite3 *db, GError **err)
     if (*err)
         return;
 
-    info->changelog_handle = yum_db_changelog_prepare (db, err);
+    if (!batch_reuse (info->changelog_batch, db, err))
+        info->changelog_batch = yum_db_changelog_prepare (db, err);
 }
 
 static void
@@ -352,8 +630,25 @@ update_other_info_clean (UpdateInfo *update_info)
 
     if (info->pkg_handle)
         sqlite3_finalize (info->pkg_handle);
-    if (info->changelog_handle)
-        sqlite3_finalize (info->changelog_handle);
+    info->pkg_handle = NULL;
+    if (info->changelog_batch)
+        yum_db_batch_set_db (info->changelog_batch, NULL, NULL);
+}
+
+static void
+update_other_info_free (UpdateInfo *update_info)
+{
+    UpdateOtherInfo *info = (UpdateOtherInfo *) update_info;
+
+    batch_free (&info->changelog_batch);
+}
+
+static void
+update_other_info_flush (UpdateInfo *update_info)
+{
+    UpdateOtherInfo *info = (UpdateOtherInfo *) update_info;
+
+    yum_db_batch_flush (info->changelog_batch);
 }
 
 static void
@@ -362,25 +657,74 @@ write_other_package_to_db (UpdateInfo *update_info, Package *package)
     UpdateOtherInfo *info = (UpdateOtherInfo *) update_info;
 
     yum_db_package_ids_write (update_info->db, info->pkg_handle, package);
-    yum_db_changelog_write (update_info->db, info->changelog_handle, package);
+    yum_db_changelog_write (info->changelog_batch, package);
+}
+
+static void
+update_other_info_options (UpdateInfo *update_info)
+{
+    /* The only ones it takes, others were always ignored */
+    update_info->options &= YUM_DB_SEARCH_INDEX | YUM_DB_COMPRESS_TEXT;
+
+    if (update_info->options & YUM_DB_SEARCH_INDEX)
+        update_info->search_tables = yum_db_index_other_search;
+    else
+        update_info->search_tables = NULL;
+
+    if (update_info->options & YUM_DB_COMPRESS_TEXT)
+        update_info->pack_tables = yum_db_pack_other_text;
+    else
+        update_info->pack_tables = NULL;
+}
+
+/* other.xml has no file lists */
+static YumXmlParser *
+other_xml_parser_new (CountFn count_callback,
+                      PackageFn package_callback,
+                      PackageFn files_callback,
+                      gpointer user_data,
+                      GError **err)
+{
+    return yum_xml_parser_new_other (count_callback, package_callback,
+                                     user_data, err);
+}
+
+static void
+update_other_info_setup (UpdateOtherInfo *info)
+{
+    memset (info, 0, sizeof (UpdateOtherInfo));
+
+    info->update_info.info_init = update_other_info_init;
+    info->update_info.info_clean = update_other_info_clean;
+    info->update_info.info_flush = update_other_info_flush;
+    info->update_info.info_free = update_other_info_free;
+    info->update_info.info_options = update_other_info_options;
+    info->update_info.create_tables = yum_db_create_other_tables;
+    info->update_info.write_package = write_other_package_to_db;
+    info->update_info.xml_parse = yum_xml_parse_other;
+    info->update_info.xml_parser_new = other_xml_parser_new;
+    info->update_info.index_tables = yum_db_index_other_tables;
 }
 
 
 /*****************************************************************************/
 
 static void
-progress_cb (UpdateInfo *update_info)
+report_progress (gpointer python_callback,
+                 gpointer user_data,
+                 guint32 packages_seen,
+                 guint32 count_from_md)
 {
-    PyObject *progress = (PyObject *) update_info->python_callback;
-    PyObject *repoid = (PyObject *) update_info->user_data;
+    PyObject *progress = (PyObject *) python_callback;
+    PyObject *repoid = (PyObject *) user_data;
     PyObject *args;
     PyObject *result;
 
     Py_INCREF(repoid);
    
     args = PyTuple_New (3);
-    PyTuple_SET_ITEM (args, 0, PyInt_FromLong (update_info->packages_seen));
-    PyTuple_SET_ITEM (args, 1, PyInt_FromLong (update_info->count_from_md));
+    PyTuple_SET_ITEM (args, 0, PyInt_FromLong (packages_seen));
+    PyTuple_SET_ITEM (args, 1, PyInt_FromLong (count_from_md));
     PyTuple_SET_ITEM (args, 2, repoid);
 
     result = PyEval_CallObject (progress, args);
@@ -388,23 +732,111 @@ progress_cb (UpdateInfo *update_info)
     Py_XDECREF (result);
 }
 
+static void
+progress_cb (UpdateInfo *update_info)
+{
+    report_progress (update_info->python_callback, update_info->user_data,
+                     update_info->packages_seen, update_info->count_from_md);
+}
+
+/* Write out rows the writer still buffers, before every COMMIT */
+static void
+update_info_flush (UpdateInfo *update_info)
+{
+    if (update_info->info_flush)
+        update_info->info_flush (update_info);
+}
+
+static void
+update_info_checkpoint (UpdateInfo *update_info, GError **err)
+{
+    update_info_flush (update_info);
+
+    /* Still committed, only not resumed */
+    if (yum_db_profile_resumable (update_info->profile)) {
+        yum_db_checkpoint_update (update_info->db, update_info->checksum,
+                                  update_info->options,
+                                  update_info->packages_parsed, err);
+        if (*err)
+            return;
+    }
+
+    sqlite3_exec (update_info->db, "COMMIT", NULL, NULL, NULL);
+    sqlite3_exec (update_info->db, "BEGIN", NULL, NULL, NULL);
+}
+
+static volatile gboolean *
+update_info_cancel_flag (UpdateInfo *update_info)
+{
+    return update_info->cancel ? update_info->cancel : &cancel_requested;
+}
+
+/* Ctrl-C, or an exception raised by the progress callback, which the
+   caller then returns instead of err */
+static gboolean
+python_interrupted (GError **err)
+{
+    if (PyErr_CheckSignals () < 0 || PyErr_Occurred ()) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR, "Interrupted");
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static gboolean
+build_cancelled (volatile gboolean *cancel, GError **err)
+{
+    if (python_interrupted (err))
+        return TRUE;
+
+    if (*cancel) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR, "Cancelled");
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* A batch of files of a package that is still being parsed */
+static void
+update_files_cb (Package *p, gpointer user_data)
+{
+    UpdateInfo *update_info = (UpdateInfo *) user_data;
+
+    /* Same checks as update_package_cb (), the package being parsed is
+       not counted yet */
+    if (p->pkgId == NULL ||
+        update_info->packages_parsed < update_info->resume_count ||
+        yum_pkgid_set_lookup (update_info->current_packages, p->pkgId, NULL))
+        return;
+
+    /* The package row is written last, reserve its key now */
+    if (!p->pkgKey)
+        p->pkgKey = yum_db_package_next_key (update_info->db);
+
+    update_info->write_files (update_info, p);
+}
+
 static void
 update_package_cb (Package *p, gpointer user_data)
 {
     UpdateInfo *update_info = (UpdateInfo *) user_data;
 
+    update_info->packages_parsed++;
+
     /* TODO: Wire in logging of skipped packages */
     if (p->pkgId == NULL) {
         return;
     }
 
-    g_hash_table_insert (update_info->all_packages,
-                         g_string_chunk_insert (update_info->package_ids_chunk,
-                                                p->pkgId),
-                         GINT_TO_POINTER (1));
+    yum_pkgid_set_insert (update_info->all_packages, p->pkgId, 1);
 
-    if (g_hash_table_lookup (update_info->current_packages,
-                             p->pkgId) == NULL) {
+    /* Already committed by the interrupted build we resume */
+    if (update_info->packages_parsed <= update_info->resume_count)
+        ;
+    else if (!yum_pkgid_set_lookup (update_info->current_packages,
+                                    p->pkgId, NULL)) {
         
         update_info->write_package (update_info, p);
         update_info->add_count++;
@@ -414,56 +846,84 @@ update_package_cb (Package *p, gpointer user_data)
         update_info->packages_seen++;
         progress_cb (update_info);
     }
-}
 
-static char *
-update_packages (UpdateInfo *update_info,
-                 const char *md_filename,
-                 const char *checksum,
-                 gpointer python_callback,
-                 gpointer user_data,
-                 GError **err)
-{
-    char *db_filename;
+    if (update_info->packages_parsed <= update_info->resume_count) {
+        build_cancelled (update_info_cancel_flag (update_info),
+                         update_info->error);
+        return;
+    }
 
-    db_filename = yum_db_filename (md_filename);
-    update_info->db = yum_db_open (db_filename, checksum,
-                                   update_info->create_tables,
-                                   err);
+    if (build_cancelled (update_info_cancel_flag (update_info),
+                         update_info->error)) {
+        /* Everything up to this package is written, keep it */
+        GError *tmp_err = NULL;
 
+        update_info_checkpoint (update_info, &tmp_err);
+        if (tmp_err)
+            g_error_free (tmp_err);
+    } else if (update_info->packages_parsed % CHECKPOINT_PACKAGES == 0)
+        update_info_checkpoint (update_info, update_info->error);
+}
+
+/* Commits what the parser wrote, or only closes the database when it
+   failed */
+static void
+update_packages_finish (UpdateInfo *update_info, GError **err)
+{
     if (*err)
         goto cleanup;
+    update_info_flush (update_info);
+    sqlite3_exec (update_info->db, "COMMIT", NULL, NULL, NULL);
 
-    if (!update_info->db)
-        return db_filename;
-
-    update_info_init (update_info, err);
+    /* One transaction, not one per index */
+    sqlite3_exec (update_info->db, "BEGIN", NULL, NULL, NULL);
+    update_info->index_tables (update_info->db, err);
     if (*err)
         goto cleanup;
-    
-    update_info->python_callback = python_callback;
-    update_info->user_data = user_data;
 
-    update_info->info_init (update_info, update_info->db, err);
+    /* Before the indexes below, whose triggers then have less to do */
+    update_info_remove_old_entries (update_info, err);
     if (*err)
         goto cleanup;
 
-    sqlite3_exec (update_info->db, "BEGIN", NULL, NULL, NULL);
-    update_info->xml_parse (md_filename,
-                            count_cb,
-                            update_package_cb,
-                            update_info,
-                            err);
+    if (update_info->search_tables) {
+        update_info->search_tables (update_info->db, update_info->options,
+                                    err);
+        if (*err)
+            goto cleanup;
+    }
+
+    if (update_info->path_tables) {
+        update_info->path_tables (update_info->db, err);
+        if (*err)
+            goto cleanup;
+    }
+
+    if (update_info->pack_tables) {
+        update_info->pack_tables (update_info->db, err);
+        if (*err)
+            goto cleanup;
+    }
+
+    yum_db_dbinfo_update (update_info->db, update_info->checksum,
+                          update_info->options, err);
     if (*err)
         goto cleanup;
     sqlite3_exec (update_info->db, "COMMIT", NULL, NULL, NULL);
 
-    update_info->index_tables (update_info->db, err);
-    if (*err)
+    /* Packed rows keep the pages they had as text, give that space back
+       after every build.  The cache is complete already, a crash here
+       leaves nothing to resume. */
+    if (update_info->pack_tables &&
+        sqlite3_exec (update_info->db, "VACUUM",
+                      NULL, NULL, NULL) != SQLITE_OK) {
+        g_set_error (err, YUM_DB_ERROR, YUM_DB_ERROR,
+                     "Can not vacuum database: %s",
+                     sqlite3_errmsg (update_info->db));
         goto cleanup;
+    }
 
-    update_info_remove_old_entries (update_info);
-    yum_db_dbinfo_update (update_info->db, checksum, err);
+    yum_db_profile_done (update_info->db, update_info->profile);
 
  cleanup:
     update_info->info_clean (update_info);
@@ -471,184 +931,2889 @@ update_packages (UpdateInfo *update_info,
 
     if (update_info->db)
         sqlite3_close (update_info->db);
-
-    if (*err) {
-        g_free (db_filename);
-        db_filename = NULL;
-    }
-
-    return db_filename;
+    update_info->db = NULL;
 }
 
-/*********************************************************************/
-
+/* Opens the database and starts writing to it.  FALSE when it is up to
+   date already, or on errors, which also close it again. */
 static gboolean
-py_parse_args (PyObject *args,
-               const char **md_filename,
-               const char **checksum,
-               PyObject **log,
-               PyObject **progress,
-               PyObject **repoid)
+update_packages_start (UpdateInfo *update_info,
+                       const char *db_filename,
+                       const char *checksum,
+                       gpointer python_callback,
+                       gpointer user_data,
+                       GError **err)
 {
-    PyObject *callback;
+    update_info->db = yum_db_open (db_filename, checksum,
+                                   update_info->options,
+                                   update_info->profile,
+                                   update_info->create_tables,
+                                   err);
 
-    if (!PyArg_ParseTuple (args, "ssOO", md_filename, checksum, &callback,
-                           repoid))
+    if (*err)
+        goto cleanup;
+
+    if (!update_info->db)
         return FALSE;
 
-    if (PyObject_HasAttrString (callback, "log")) {
-        *log = PyObject_GetAttrString (callback, "log");
+    yum_db_register_functions (update_info->db, err);
+    if (*err)
+        goto cleanup;
 
-        if (!PyCallable_Check (*log)) {
-            PyErr_SetString (PyExc_TypeError, "parameter must be callable");
-            return FALSE;
-        }
+    update_info_init (update_info, err);
+    if (*err)
+        goto cleanup;
+    
+    update_info->python_callback = python_callback;
+    update_info->user_data = user_data;
+    update_info->checksum = checksum;
+    update_info->error = err;
+
+    update_info->resume_count = yum_db_checkpoint_packages (update_info->db);
+    if (update_info->resume_count > 0) {
+        /* The packages in the database are the ones we are skipping,
+           not leftovers of an older repository */
+        yum_pkgid_set_clear (update_info->current_packages);
+        g_message ("Skipping %d packages written before the interruption",
+                   update_info->resume_count);
     }
 
-    if (PyObject_HasAttrString (callback, "progressbar")) {
-        *progress = PyObject_GetAttrString (callback, "progressbar");
-
-        if (!PyCallable_Check (*progress)) {
-            PyErr_SetString (PyExc_TypeError, "parameter must be callable");
-            return FALSE;
-        }
-    }
+    update_info->info_init (update_info, update_info->db, err);
+    if (*err)
+        goto cleanup;
 
+    sqlite3_exec (update_info->db, "BEGIN", NULL, NULL, NULL);
     return TRUE;
+
+ cleanup:
+    update_packages_finish (update_info, err);
+    return FALSE;
+}
+
+static char *
+update_packages (UpdateInfo *update_info,
+                 const char *md_filename,
+                 const char *checksum,
+                 gpointer python_callback,
+                 gpointer user_data,
+                 GError **err)
+{
+    char *db_filename;
+
+    db_filename = yum_db_filename (md_filename);
+    if (update_packages_start (update_info, db_filename, checksum,
+                               python_callback, user_data, err)) {
+        update_info->xml_parse (md_filename,
+                                count_cb,
+                                update_package_cb,
+                                update_info->write_files ?
+                                update_files_cb : NULL,
+                                update_info,
+                                err);
+        update_packages_finish (update_info, err);
+    }
+
+    if (*err) {
+        g_free (db_filename);
+        db_filename = NULL;
+    }
+
+    return db_filename;
+}
+
+/* Metadata other than package lists: small, so it is written in one
+   transaction and rebuilt as a whole when its checksum changes */
+
+typedef struct _RecordInfo RecordInfo;
+
+typedef void (*RecordInitFn) (RecordInfo *record_info, GError **err);
+typedef void (*RecordCleanFn) (RecordInfo *record_info);
+typedef void (*RecordFlushFn) (RecordInfo *record_info);
+typedef void (*RecordParseFn) (RecordInfo *record_info,
+                               const char *filename,
+                               GError **err);
+
+struct _RecordInfo {
+    sqlite3 *db;
+    const char *what;
+    guint32 count_from_md;
+    guint32 records_seen;
+    guint32 add_count;
+    const YumDbProfile *profile;
+    GError **error;
+
+    RecordInitFn info_init;
+    RecordCleanFn info_clean;
+    RecordFlushFn info_flush;
+    RecordParseFn xml_parse;
+    CreateTablesFn create_tables;
+    IndexTablesFn index_tables;
+
+    gpointer python_callback;
+    gpointer user_data;
+};
+
+static void
+record_count_cb (guint32 count, gpointer user_data)
+{
+    RecordInfo *info = (RecordInfo *) user_data;
+
+    info->count_from_md = count;
+}
+
+/* Called by the writers after every record; a cancelled build sets the
+   error, which stops the parse */
+static void
+record_done (RecordInfo *info)
+{
+    info->add_count++;
+
+    if (info->count_from_md > 0 && info->python_callback) {
+        info->records_seen++;
+        report_progress (info->python_callback, info->user_data,
+                         info->records_seen, info->count_from_md);
+    }
+
+    build_cancelled (&cancel_requested, info->error);
+}
+
+static char *
+update_records (RecordInfo *info,
+                const char *md_filename,
+                const char *checksum,
+                gpointer python_callback,
+                gpointer user_data,
+                GError **err)
+{
+    char *db_filename;
+    GTimer *timer = NULL;
+
+    db_filename = yum_db_filename (md_filename);
+    info->db = yum_db_open (db_filename, checksum, 0, info->profile,
+                            info->create_tables, err);
+    if (*err)
+        goto cleanup;
+
+    if (!info->db)
+        return db_filename;
+
+    info->python_callback = python_callback;
+    info->user_data = user_data;
+    info->error = err;
+
+    timer = g_timer_new ();
+    g_timer_start (timer);
+
+    info->info_init (info, err);
+    if (*err)
+        goto cleanup;
+
+    sqlite3_exec (info->db, "BEGIN", NULL, NULL, NULL);
+    info->xml_parse (info, md_filename, err);
+    if (*err)
+        goto cleanup;
+    info->info_flush (info);
+
+    info->index_tables (info->db, err);
+    if (*err)
+        goto cleanup;
+
+    yum_db_dbinfo_update (info->db, checksum, 0, err);
+    if (*err)
+        goto cleanup;
+    sqlite3_exec (info->db, "COMMIT", NULL, NULL, NULL);
+
+    yum_db_profile_done (info->db, info->profile);
+
+    g_timer_stop (timer);
+    g_message ("Added %d %s in %.2f seconds", info->add_count, info->what,
+               g_timer_elapsed (timer, NULL));
+
+ cleanup:
+    if (timer)
+        g_timer_destroy (timer);
+
+    /* An unfinished build is rolled back, without a db_info row the next
+       one starts over */
+    if (info->db) {
+        info->info_clean (info);
+        sqlite3_close (info->db);
+    }
+
+    if (*err) {
+        g_free (db_filename);
+        db_filename = NULL;
+    }
+
+    return db_filename;
+}
+
+/* Updateinfo */
+
+typedef struct {
+    RecordInfo record_info;
+    sqlite3_stmt *advisory_handle;
+    YumDbBatch *references_batch;
+    YumDbBatch *packages_batch;
+} UpdateinfoInfo;
+
+static void
+updateinfo_info_init (RecordInfo *record_info, GError **err)
+{
+    UpdateinfoInfo *info = (UpdateinfoInfo *) record_info;
+    sqlite3 *db = record_info->db;
+
+    info->advisory_handle = yum_db_advisory_prepare (db, err);
+    if (*err)
+        return;
+
+    info->references_batch = yum_db_advisory_references_prepare (db, err);
+    if (*err)
+        return;
+
+    info->packages_batch = yum_db_advisory_packages_prepare (db, err);
+}
+
+static void
+updateinfo_info_clean (RecordInfo *record_info)
+{
+    UpdateinfoInfo *info = (UpdateinfoInfo *) record_info;
+
+    if (info->advisory_handle)
+        sqlite3_finalize (info->advisory_handle);
+    info->advisory_handle = NULL;
+    batch_free (&info->references_batch);
+    batch_free (&info->packages_batch);
+}
+
+static void
+updateinfo_info_flush (RecordInfo *record_info)
+{
+    UpdateinfoInfo *info = (UpdateinfoInfo *) record_info;
+
+    yum_db_batch_flush (info->references_batch);
+    yum_db_batch_flush (info->packages_batch);
+}
+
+static void
+updateinfo_advisory_cb (Advisory *advisory, gpointer user_data)
+{
+    UpdateinfoInfo *info = (UpdateinfoInfo *) user_data;
+    RecordInfo *record_info = &info->record_info;
+
+    if (advisory->id == NULL)
+        return;
+
+    yum_db_advisory_write (record_info->db, info->advisory_handle, advisory);
+    yum_db_advisory_references_write (info->references_batch, advisory);
+    yum_db_advisory_packages_write (info->packages_batch, advisory);
+
+    record_done (record_info);
+}
+
+static void
+updateinfo_info_parse (RecordInfo *record_info,
+                       const char *filename,
+                       GError **err)
+{
+    yum_xml_parse_updateinfo (filename, record_count_cb,
+                              updateinfo_advisory_cb, record_info, err);
+}
+
+static void
+updateinfo_info_setup (UpdateinfoInfo *info)
+{
+    memset (info, 0, sizeof (UpdateinfoInfo));
+
+    info->record_info.what = "advisories";
+    info->record_info.info_init = updateinfo_info_init;
+    info->record_info.info_clean = updateinfo_info_clean;
+    info->record_info.info_flush = updateinfo_info_flush;
+    info->record_info.xml_parse = updateinfo_info_parse;
+    info->record_info.create_tables = yum_db_create_updateinfo_tables;
+    info->record_info.index_tables = yum_db_index_updateinfo_tables;
+}
+
+/* Prestodelta */
+
+typedef struct {
+    RecordInfo record_info;
+    YumDbBatch *deltas_batch;
+} PrestodeltaInfo;
+
+static void
+prestodelta_info_init (RecordInfo *record_info, GError **err)
+{
+    PrestodeltaInfo *info = (PrestodeltaInfo *) record_info;
+
+    info->deltas_batch = yum_db_deltas_prepare (record_info->db, err);
+}
+
+static void
+prestodelta_info_clean (RecordInfo *record_info)
+{
+    PrestodeltaInfo *info = (PrestodeltaInfo *) record_info;
+
+    batch_free (&info->deltas_batch);
+}
+
+static void
+prestodelta_info_flush (RecordInfo *record_info)
+{
+    PrestodeltaInfo *info = (PrestodeltaInfo *) record_info;
+
+    yum_db_batch_flush (info->deltas_batch);
+}
+
+static void
+prestodelta_package_cb (DeltaPackage *package, gpointer user_data)
+{
+    PrestodeltaInfo *info = (PrestodeltaInfo *) user_data;
+
+    if (package->name == NULL)
+        return;
+
+    yum_db_deltas_write (info->deltas_batch, package);
+
+    record_done (&info->record_info);
+}
+
+static void
+prestodelta_info_parse (RecordInfo *record_info,
+                        const char *filename,
+                        GError **err)
+{
+    yum_xml_parse_prestodelta (filename, record_count_cb,
+                               prestodelta_package_cb, record_info, err);
+}
+
+static void
+prestodelta_info_setup (PrestodeltaInfo *info)
+{
+    memset (info, 0, sizeof (PrestodeltaInfo));
+
+    info->record_info.what = "packages with deltas";
+    info->record_info.info_init = prestodelta_info_init;
+    info->record_info.info_clean = prestodelta_info_clean;
+    info->record_info.info_flush = prestodelta_info_flush;
+    info->record_info.xml_parse = prestodelta_info_parse;
+    info->record_info.create_tables = yum_db_create_prestodelta_tables;
+    info->record_info.index_tables = yum_db_index_prestodelta_tables;
+}
+
+/* Comps */
+
+typedef struct {
+    RecordInfo record_info;
+    sqlite3_stmt *entry_handles[3];
+    YumDbBatch *packages_batch;
+    YumDbBatch *category_groups_batch;
+    YumDbBatch *environment_groups_batch;
+    YumDbBatch *translations_batch;
+} CompsInfo;
+
+static void
+comps_info_init (RecordInfo *record_info, GError **err)
+{
+    CompsInfo *info = (CompsInfo *) record_info;
+    sqlite3 *db = record_info->db;
+    int i;
+
+    for (i = COMPS_GROUP; i <= COMPS_ENVIRONMENT; i++) {
+        info->entry_handles[i] = yum_db_comps_entry_prepare (db, i, err);
+        if (*err)
+            return;
+    }
+
+    info->packages_batch = yum_db_group_packages_prepare (db, err);
+    if (*err)
+        return;
+
+    info->category_groups_batch = yum_db_category_groups_prepare (db, err);
+    if (*err)
+        return;
+
+    info->environment_groups_batch =
+        yum_db_environment_groups_prepare (db, err);
+    if (*err)
+        return;
+
+    info->translations_batch = yum_db_comps_translations_prepare (db, err);
+}
+
+static void
+comps_info_clean (RecordInfo *record_info)
+{
+    CompsInfo *info = (CompsInfo *) record_info;
+    int i;
+
+    for (i = COMPS_GROUP; i <= COMPS_ENVIRONMENT; i++) {
+        if (info->entry_handles[i])
+            sqlite3_finalize (info->entry_handles[i]);
+        info->entry_handles[i] = NULL;
+    }
+    batch_free (&info->packages_batch);
+    batch_free (&info->category_groups_batch);
+    batch_free (&info->environment_groups_batch);
+    batch_free (&info->translations_batch);
+}
+
+static void
+comps_info_flush (RecordInfo *record_info)
+{
+    CompsInfo *info = (CompsInfo *) record_info;
+
+    yum_db_batch_flush (info->packages_batch);
+    yum_db_batch_flush (info->category_groups_batch);
+    yum_db_batch_flush (info->environment_groups_batch);
+    yum_db_batch_flush (info->translations_batch);
+}
+
+static void
+comps_entry_cb (CompsEntry *entry, gpointer user_data)
+{
+    CompsInfo *info = (CompsInfo *) user_data;
+    RecordInfo *record_info = &info->record_info;
+
+    if (entry->id == NULL)
+        return;
+
+    yum_db_comps_entry_write (record_info->db,
+                              info->entry_handles[entry->kind], entry);
+
+    if (entry->kind == COMPS_GROUP)
+        yum_db_group_packages_write (info->packages_batch, entry);
+    else if (entry->kind == COMPS_CATEGORY)
+        yum_db_category_groups_write (info->category_groups_batch, entry);
+    else
+        yum_db_environment_groups_write (info->environment_groups_batch,
+                                         entry);
+
+    yum_db_comps_translations_write (info->translations_batch, entry);
+
+    record_done (record_info);
+}
+
+static void
+comps_info_parse (RecordInfo *record_info,
+                  const char *filename,
+                  GError **err)
+{
+    yum_xml_parse_comps (filename, record_count_cb,
+                         comps_entry_cb, record_info, err);
+}
+
+static void
+comps_info_setup (CompsInfo *info)
+{
+    memset (info, 0, sizeof (CompsInfo));
+
+    info->record_info.what = "groups, categories and environments";
+    info->record_info.info_init = comps_info_init;
+    info->record_info.info_clean = comps_info_clean;
+    info->record_info.info_flush = comps_info_flush;
+    info->record_info.xml_parse = comps_info_parse;
+    info->record_info.create_tables = yum_db_create_comps_tables;
+    info->record_info.index_tables = yum_db_index_comps_tables;
+}
+
+/* Lookup index */
+
+typedef struct {
+    YumIndexWriter *writer;
+    guint32 count_from_md;
+    guint32 packages_seen;
+    guint32 add_count;
+    gpointer python_callback;
+    gpointer user_data;
+    GError **error;
+} IndexInfo;
+
+static void
+index_count_cb (guint32 count, gpointer user_data)
+{
+    IndexInfo *info = (IndexInfo *) user_data;
+
+    info->count_from_md = count;
+}
+
+static void
+index_package_cb (Package *p, gpointer user_data)
+{
+    IndexInfo *info = (IndexInfo *) user_data;
+
+    if (p->pkgId == NULL || *info->error)
+        return;
+
+    yum_index_writer_add (info->writer, p);
+    info->add_count++;
+
+    if (info->count_from_md > 0 && info->python_callback) {
+        info->packages_seen++;
+        report_progress (info->python_callback, info->user_data,
+                         info->packages_seen, info->count_from_md);
+    }
+
+    python_interrupted (info->error);
+}
+
+static gboolean
+index_is_fresh (const char *idx_filename, const char *checksum)
+{
+    YumIndex *index;
+    GError *err = NULL;
+    gboolean fresh;
+
+    if (!g_file_test (idx_filename, G_FILE_TEST_EXISTS))
+        return FALSE;
+
+    index = yum_index_open (idx_filename, &err);
+    if (!index) {
+        g_message ("Warning: %s, will regenerate", err->message);
+        g_error_free (err);
+        return FALSE;
+    }
+
+    fresh = !strcmp (yum_index_checksum (index), checksum);
+    if (!fresh)
+        g_message ("lookup index needs updating, reading in metadata");
+
+    yum_index_close (index);
+
+    return fresh;
+}
+
+static char *
+update_index (const char *md_filename,
+              const char *checksum,
+              gpointer python_callback,
+              gpointer user_data,
+              GError **err)
+{
+    IndexInfo info;
+    char *idx_filename;
+    GTimer *timer;
+
+    idx_filename = yum_index_filename (md_filename);
+    if (index_is_fresh (idx_filename, checksum))
+        return idx_filename;
+
+    memset (&info, 0, sizeof (IndexInfo));
+    info.writer = yum_index_writer_new ();
+    info.python_callback = python_callback;
+    info.user_data = user_data;
+    info.error = err;
+
+    timer = g_timer_new ();
+    g_timer_start (timer);
+
+    yum_xml_parse_primary (md_filename,
+                           index_count_cb,
+                           index_package_cb,
+                           NULL,
+                           &info,
+                           err);
+    if (!*err)
+        yum_index_writer_write (info.writer, idx_filename, checksum, err);
+
+    g_timer_stop (timer);
+    if (!*err) {
+        g_message ("Indexed %d packages in %.2f seconds",
+                   info.add_count,
+                   g_timer_elapsed (timer, NULL));
+    }
+
+    g_timer_destroy (timer);
+    yum_index_writer_free (info.writer);
+
+    if (*err) {
+        g_free (idx_filename);
+        idx_filename = NULL;
+    }
+
+    return idx_filename;
+}
+
+/* Changelog index */
+
+typedef struct {
+    YumChangelogIndexWriter *writer;
+    YumXmlParser *parser;
+    guint64 last_end;
+    guint32 count_from_md;
+    guint32 packages_seen;
+    guint32 add_count;
+    gpointer python_callback;
+    gpointer user_data;
+    GError **error;
+} OtherIndexInfo;
+
+static void
+other_index_count_cb (guint32 count, gpointer user_data)
+{
+    OtherIndexInfo *info = (OtherIndexInfo *) user_data;
+
+    info->count_from_md = count;
+}
+
+/* A package's range starts where the previous one ended */
+static void
+other_index_package_cb (Package *p, gpointer user_data)
+{
+    OtherIndexInfo *info = (OtherIndexInfo *) user_data;
+    guint64 end;
+
+    if (*info->error)
+        return;
+
+    end = yum_xml_parser_position (info->parser);
+
+    if (p->pkgId != NULL) {
+        yum_changelog_index_writer_add (info->writer, p->pkgId,
+                                        info->last_end,
+                                        end - info->last_end);
+        info->add_count++;
+    }
+    info->last_end = end;
+
+    if (info->count_from_md > 0 && info->python_callback) {
+        info->packages_seen++;
+        report_progress (info->python_callback, info->user_data,
+                         info->packages_seen, info->count_from_md);
+    }
+
+    /* Stops the parser, and the read loop in update_other_index () */
+    python_interrupted (info->error);
+}
+
+static void
+other_index_point_cb (const YumGzipPoint *point,
+                      const guchar *window,
+                      gpointer user_data)
+{
+    OtherIndexInfo *info = (OtherIndexInfo *) user_data;
+
+    yum_changelog_index_writer_add_point (info->writer, point, window);
+}
+
+static gboolean
+other_index_is_fresh (const char *idx_filename, const char *checksum)
+{
+    YumChangelogIndex *index;
+    GError *err = NULL;
+    gboolean fresh;
+
+    if (!g_file_test (idx_filename, G_FILE_TEST_EXISTS))
+        return FALSE;
+
+    index = yum_changelog_index_open (idx_filename, &err);
+    if (!index) {
+        g_message ("Warning: %s, will regenerate", err->message);
+        g_error_free (err);
+        return FALSE;
+    }
+
+    fresh = !strcmp (yum_changelog_index_checksum (index), checksum);
+    if (!fresh)
+        g_message ("changelog index needs updating, reading in metadata");
+
+    yum_changelog_index_close (index);
+
+    return fresh;
+}
+
+static char *
+update_other_index (const char *md_filename,
+                    const char *checksum,
+                    gpointer python_callback,
+                    gpointer user_data,
+                    GError **err)
+{
+    OtherIndexInfo info;
+    YumGzipReader *reader;
+    char *idx_filename;
+    char buf[64 * 1024];
+    struct stat st;
+    GTimer *timer;
+
+    idx_filename = yum_changelog_index_filename (md_filename);
+    if (other_index_is_fresh (idx_filename, checksum))
+        return idx_filename;
+
+    if (stat (md_filename, &st) != 0) {
+        g_set_error (err, YUM_CHANGELOG_INDEX_ERROR,
+                     YUM_CHANGELOG_INDEX_ERROR,
+                     "Can not open %s: %s", md_filename, g_strerror (errno));
+        g_free (idx_filename);
+        return NULL;
+    }
+
+    reader = yum_gzip_reader_open (md_filename, err);
+    if (!reader) {
+        g_free (idx_filename);
+        return NULL;
+    }
+
+    memset (&info, 0, sizeof (OtherIndexInfo));
+    info.writer = yum_changelog_index_writer_new ();
+    info.python_callback = python_callback;
+    info.user_data = user_data;
+    info.error = err;
+    info.parser = yum_xml_parser_new_other (other_index_count_cb,
+                                            other_index_package_cb,
+                                            &info, err);
+
+    yum_gzip_reader_set_points (reader, YUM_CHANGELOG_INDEX_SPAN,
+                                other_index_point_cb, &info);
+
+    timer = g_timer_new ();
+    g_timer_start (timer);
+
+    while (!*err) {
+        gssize n;
+
+        n = yum_gzip_reader_read (reader, buf, sizeof (buf), err);
+        if (n <= 0)
+            break;
+
+        yum_xml_parser_feed (info.parser, buf, n);
+    }
+
+    if (!*err)
+        yum_xml_parser_finish (info.parser);
+    if (!*err)
+        yum_changelog_index_writer_write (info.writer, idx_filename,
+                                          checksum, st.st_size, err);
+
+    g_timer_stop (timer);
+    if (!*err) {
+        g_message ("Indexed changelogs of %d packages in %.2f seconds",
+                   info.add_count,
+                   g_timer_elapsed (timer, NULL));
+    }
+
+    g_timer_destroy (timer);
+    if (info.parser)
+        yum_xml_parser_free (info.parser);
+    yum_changelog_index_writer_free (info.writer);
+    yum_gzip_reader_close (reader);
+
+    if (*err) {
+        g_free (idx_filename);
+        idx_filename = NULL;
+    }
+
+    return idx_filename;
+}
+
+/* Columnar export */
+
+typedef YumColumnExport *(*ExportNewFn) (const char *dir, GError **err);
+
+typedef struct {
+    YumColumnExport *export;
+    guint32 count_from_md;
+    guint32 packages_seen;
+    gpointer python_callback;
+    gpointer user_data;
+    GError **error;
+} ExportInfo;
+
+static void
+export_count_cb (guint32 count, gpointer user_data)
+{
+    ExportInfo *info = (ExportInfo *) user_data;
+
+    info->count_from_md = count;
+}
+
+static void
+export_package_cb (Package *p, gpointer user_data)
+{
+    ExportInfo *info = (ExportInfo *) user_data;
+
+    if (p->pkgId == NULL || *info->error)
+        return;
+
+    yum_column_export_package (info->export, p, info->error);
+    if (*info->error)
+        return;
+
+    if (info->count_from_md > 0 && info->python_callback) {
+        info->packages_seen++;
+        report_progress (info->python_callback, info->user_data,
+                         info->packages_seen, info->count_from_md);
+    }
+
+    python_interrupted (info->error);
+}
+
+static void
+export_metadata (const char *md_filename,
+                 const char *outdir,
+                 ExportNewFn export_new,
+                 XmlParseFn xml_parse,
+                 gpointer python_callback,
+                 gpointer user_data,
+                 GError **err)
+{
+    ExportInfo info;
+    GTimer *timer;
+
+    if (g_mkdir_with_parents (outdir, 0755) != 0) {
+        g_set_error (err, YUM_COLUMN_ERROR, YUM_COLUMN_ERROR,
+                     "Can not create %s: %s", outdir, g_strerror (errno));
+        return;
+    }
+
+    memset (&info, 0, sizeof (ExportInfo));
+    info.python_callback = python_callback;
+    info.user_data = user_data;
+    info.error = err;
+
+    info.export = export_new (outdir, err);
+    if (*err)
+        return;
+
+    timer = g_timer_new ();
+    g_timer_start (timer);
+
+    xml_parse (md_filename, export_count_cb, export_package_cb, NULL, &info,
+               err);
+
+    if (*err) {
+        yum_column_export_close (info.export, NULL);
+    } else {
+        guint64 count = yum_column_export_count (info.export);
+
+        yum_column_export_close (info.export, err);
+        g_timer_stop (timer);
+        if (!*err)
+            g_message ("Exported %d packages in %.2f seconds", (int) count,
+                       g_timer_elapsed (timer, NULL));
+    }
+
+    g_timer_destroy (timer);
+}
+
+/* Repository diff */
+
+typedef struct {
+    YumDiffSide *side;
+    guint32 count_from_md;
+    guint32 packages_seen;
+    gpointer python_callback;
+    gpointer user_data;
+    GError **error;
+} DiffInfo;
+
+static void
+diff_count_cb (guint32 count, gpointer user_data)
+{
+    DiffInfo *info = (DiffInfo *) user_data;
+
+    info->count_from_md = count;
+    yum_diff_side_reserve (info->side, count);
+}
+
+static void
+diff_package_cb (Package *p, gpointer user_data)
+{
+    DiffInfo *info = (DiffInfo *) user_data;
+
+    if (*info->error)
+        return;
+
+    yum_diff_side_add (info->side, p);
+
+    if (info->count_from_md > 0 && info->python_callback) {
+        info->packages_seen++;
+        report_progress (info->python_callback, info->user_data,
+                         info->packages_seen, info->count_from_md);
+    }
+
+    python_interrupted (info->error);
+}
+
+/* A primary cache is only read, primary.xml is parsed without writing
+   anything */
+static YumDiffSide *
+diff_side_load (const char *filename,
+                gpointer python_callback,
+                gpointer user_data,
+                GError **err)
+{
+    DiffInfo info;
+    struct stat st;
+
+    /* A missing file would parse as an empty repository */
+    if (stat (filename, &st) != 0) {
+        g_set_error (err, YUM_PARSER_ERROR, YUM_PARSER_ERROR,
+                     "Can not open %s: %s", filename, g_strerror (errno));
+        return NULL;
+    }
+
+    memset (&info, 0, sizeof (DiffInfo));
+    info.side = yum_diff_side_new ();
+    info.python_callback = python_callback;
+    info.user_data = user_data;
+    info.error = err;
+
+    if (yum_db_is_database (filename))
+        yum_db_read_packages (filename, diff_package_cb, &info, err);
+    else
+        yum_xml_parse_primary (filename, diff_count_cb, diff_package_cb,
+                               NULL, &info, err);
+
+    if (*err) {
+        yum_diff_side_free (info.side);
+        return NULL;
+    }
+
+    return info.side;
+}
+
+static void
+diff_metadata (const char *old_filename,
+               const char *new_filename,
+               YumDiffFn diff_fn,
+               gpointer diff_data,
+               gpointer python_callback,
+               gpointer user_data,
+               GError **err)
+{
+    YumDiffSide *old_side;
+    YumDiffSide *new_side = NULL;
+    GTimer *timer;
+
+    timer = g_timer_new ();
+    g_timer_start (timer);
+
+    old_side = diff_side_load (old_filename, python_callback, user_data, err);
+    if (!*err)
+        new_side = diff_side_load (new_filename, python_callback, user_data,
+                                   err);
+
+    if (!*err) {
+        yum_diff (old_side, new_side, diff_fn, diff_data);
+
+        g_timer_stop (timer);
+        g_message ("Compared %d and %d packages in %.2f seconds",
+                   yum_diff_side_size (old_side),
+                   yum_diff_side_size (new_side),
+                   g_timer_elapsed (timer, NULL));
+    }
+
+    g_timer_destroy (timer);
+    if (old_side)
+        yum_diff_side_free (old_side);
+    if (new_side)
+        yum_diff_side_free (new_side);
+}
+
+/*********************************************************************/
+
+static gboolean
+py_parse_callback (PyObject *callback, PyObject **log, PyObject **progress)
+{
+    if (PyObject_HasAttrString (callback, "log")) {
+        *log = PyObject_GetAttrString (callback, "log");
+
+        if (!PyCallable_Check (*log)) {
+            PyErr_SetString (PyExc_TypeError, "parameter must be callable");
+            return FALSE;
+        }
+    }
+
+    if (PyObject_HasAttrString (callback, "progressbar")) {
+        *progress = PyObject_GetAttrString (callback, "progressbar");
+
+        if (!PyCallable_Check (*progress)) {
+            PyErr_SetString (PyExc_TypeError, "parameter must be callable");
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static gboolean
+py_parse_args (PyObject *args,
+               const char **md_filename,
+               const char **checksum,
+               PyObject **log,
+               PyObject **progress,
+               PyObject **repoid,
+               guint *options,
+               const char **profile)
+{
+    PyObject *callback;
+
+    /* Optional trailing schema flags and build profile name */
+    if (options) {
+        if (!PyArg_ParseTuple (args, "ssOO|Iz", md_filename, checksum,
+                               &callback, repoid, options, profile))
+            return FALSE;
+    } else if (!PyArg_ParseTuple (args, "ssOO", md_filename, checksum,
+                                  &callback, repoid))
+        return FALSE;
+
+    return py_parse_callback (callback, log, progress);
+}
+
+static void
+log_cb (const gchar *log_domain,
+        GLogLevelFlags log_level,
+        const gchar *message,
+        gpointer user_data)
+{
+    PyObject *callback = (PyObject *) user_data;
+    int level;
+    PyObject *args;
+    PyObject *result;
+
+    if (!callback)
+        return;
+
+    args = PyTuple_New (2);
+
+    switch (log_level) {
+    case G_LOG_LEVEL_DEBUG:
+        level = 2;
+        break;
+    case G_LOG_LEVEL_MESSAGE:
+        level = 1;
+        break;
+    case G_LOG_LEVEL_WARNING:
+        level = 0;
+        break;
+    case G_LOG_LEVEL_CRITICAL:
+    default:
+        level = -1;
+        break;
+    }
+
+    PyTuple_SET_ITEM (args, 0, PyInt_FromLong (level));
+    PyTuple_SET_ITEM (args, 1, PyString_FromString (message));
+
+    result = PyEval_CallObject (callback, args);
+    Py_DECREF (args);
+    Py_XDECREF (result);
+}
+
+static PyObject *
+py_update (PyObject *self, PyObject *args, UpdateInfo *update_info)
+{
+    const char *md_filename = NULL;
+    const char *checksum = NULL;
+    PyObject *log = NULL;
+    PyObject *progress = NULL;
+    PyObject *repoid = NULL;
+    guint options = 0;
+    const char *profile = NULL;
+    guint log_id = 0;
+    char *db_filename;
+    PyObject *ret = NULL;
+    GError *err = NULL;
+
+    if (!py_parse_args (args, &md_filename, &checksum, &log, &progress,
+                        &repoid, &options, &profile))
+        return NULL;
+
+    /* A progress callback may call back into its session */
+    if (update_info->busy) {
+        PyErr_SetString (PyExc_RuntimeError, "Session is already building");
+        return NULL;
+    }
+
+    update_info->profile = yum_db_profile_lookup (profile);
+    if (!update_info->profile) {
+        PyErr_Format (PyExc_ValueError, "Unknown profile: %s", profile);
+        return NULL;
+    }
+
+    /* Types without options ignore them */
+    if (update_info->info_options) {
+        update_info->options = options;
+        update_info->info_options (update_info);
+    }
+
+    GLogLevelFlags level = G_LOG_LEVEL_MESSAGE | G_LOG_LEVEL_WARNING |
+        G_LOG_LEVEL_CRITICAL | G_LOG_LEVEL_DEBUG;
+    log_id = g_log_set_handler (NULL, level, log_cb, log);
+
+    update_info->busy = TRUE;
+    db_filename = update_packages (update_info, md_filename, checksum,
+                                   progress, repoid, &err);
+    update_info->busy = FALSE;
+    *update_info_cancel_flag (update_info) = FALSE;
+
+    g_log_remove_handler (NULL, log_id);
+
+    if (db_filename) {
+        ret = PyString_FromString (db_filename);
+        g_free (db_filename);
+    } else {
+        /* Don't mask KeyboardInterrupt or a callback's exception */
+        if (!PyErr_Occurred ())
+            PyErr_SetString (PyExc_TypeError, err->message);
+        g_error_free (err);
+    }
+
+    return ret;
+}
+
+static PyObject *
+py_update_records (PyObject *args, RecordInfo *record_info)
+{
+    const char *md_filename = NULL;
+    const char *checksum = NULL;
+    PyObject *log = NULL;
+    PyObject *progress = NULL;
+    PyObject *repoid = NULL;
+    guint options = 0;
+    const char *profile = NULL;
+    guint log_id = 0;
+    char *db_filename;
+    PyObject *ret = NULL;
+    GError *err = NULL;
+
+    /* Takes the arguments of update_primary, options are ignored */
+    if (!py_parse_args (args, &md_filename, &checksum, &log, &progress,
+                        &repoid, &options, &profile))
+        return NULL;
+
+    record_info->profile = yum_db_profile_lookup (profile);
+    if (!record_info->profile) {
+        PyErr_Format (PyExc_ValueError, "Unknown profile: %s", profile);
+        return NULL;
+    }
+
+    GLogLevelFlags level = G_LOG_LEVEL_MESSAGE | G_LOG_LEVEL_WARNING |
+        G_LOG_LEVEL_CRITICAL | G_LOG_LEVEL_DEBUG;
+    log_id = g_log_set_handler (NULL, level, log_cb, log);
+
+    db_filename = update_records (record_info, md_filename, checksum,
+                                  progress, repoid, &err);
+    cancel_requested = FALSE;
+
+    g_log_remove_handler (NULL, log_id);
+
+    if (db_filename) {
+        ret = PyString_FromString (db_filename);
+        g_free (db_filename);
+    } else {
+        /* Don't mask KeyboardInterrupt or a callback's exception */
+        if (!PyErr_Occurred ())
+            PyErr_SetString (PyExc_TypeError, err->message);
+        g_error_free (err);
+    }
+
+    return ret;
+}
+
+static PyObject *
+py_update_updateinfo (PyObject *self, PyObject *args)
+{
+    UpdateinfoInfo info;
+
+    updateinfo_info_setup (&info);
+    return py_update_records (args, (RecordInfo *) &info);
+}
+
+static PyObject *
+py_update_prestodelta (PyObject *self, PyObject *args)
+{
+    PrestodeltaInfo info;
+
+    prestodelta_info_setup (&info);
+    return py_update_records (args, (RecordInfo *) &info);
+}
+
+static PyObject *
+py_update_comps (PyObject *self, PyObject *args)
+{
+    CompsInfo info;
+
+    comps_info_setup (&info);
+    return py_update_records (args, (RecordInfo *) &info);
+}
+
+static PyObject *
+py_update_primary (PyObject *self, PyObject *args)
+{
+    PackageWriterInfo info;
+    PyObject *ret;
+
+    package_writer_info_setup (&info);
+    ret = py_update (self, args, (UpdateInfo *) &info);
+    update_info_free ((UpdateInfo *) &info);
+
+    return ret;
+}
+
+static PyObject *
+py_update_filelist (PyObject *self, PyObject *args)
+{
+    FileListInfo info;
+    PyObject *ret;
+
+    update_filelist_info_setup (&info);
+    ret = py_update (self, args, (UpdateInfo *) &info);
+    update_info_free ((UpdateInfo *) &info);
+
+    return ret;
+}
+
+static PyObject *
+py_update_other (PyObject *self, PyObject *args)
+{
+    UpdateOtherInfo info;
+    PyObject *ret;
+
+    update_other_info_setup (&info);
+    ret = py_update (self, args, (UpdateInfo *) &info);
+    update_info_free ((UpdateInfo *) &info);
+
+    return ret;
+}
+
+/* A Session keeps what the update_* functions would set up again for
+   every database: the batches with their SQL and buffers, the pkgId sets
+   and the timer.  Statements belong to a connection and are prepared
+   again on each build.  Its builds are stopped by its own cancel (), not
+   the module's. */
+
+typedef struct {
+    PyObject_HEAD
+    PackageWriterInfo primary;
+    FileListInfo filelists;
+    UpdateOtherInfo other;
+    volatile gboolean cancel_requested;
+} SessionObject;
+
+static PyObject *
+session_new (PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    SessionObject *self;
+
+    self = (SessionObject *) type->tp_alloc (type, 0);
+    if (!self)
+        return NULL;
+
+    package_writer_info_setup (&self->primary);
+    update_filelist_info_setup (&self->filelists);
+    update_other_info_setup (&self->other);
+
+    self->primary.update_info.cancel = &self->cancel_requested;
+    self->filelists.update_info.cancel = &self->cancel_requested;
+    self->other.update_info.cancel = &self->cancel_requested;
+
+    return (PyObject *) self;
+}
+
+static void
+session_dealloc (SessionObject *self)
+{
+    update_info_free ((UpdateInfo *) &self->primary);
+    update_info_free ((UpdateInfo *) &self->filelists);
+    update_info_free ((UpdateInfo *) &self->other);
+
+    self->ob_type->tp_free ((PyObject *) self);
+}
+
+static PyObject *
+session_update_primary (SessionObject *self, PyObject *args)
+{
+    return py_update ((PyObject *) self, args, (UpdateInfo *) &self->primary);
+}
+
+static PyObject *
+session_update_filelist (SessionObject *self, PyObject *args)
+{
+    return py_update ((PyObject *) self, args,
+                      (UpdateInfo *) &self->filelists);
+}
+
+static PyObject *
+session_update_other (SessionObject *self, PyObject *args)
+{
+    return py_update ((PyObject *) self, args, (UpdateInfo *) &self->other);
+}
+
+static PyObject *
+session_cancel (SessionObject *self, PyObject *args)
+{
+    if (!PyArg_ParseTuple (args, ""))
+        return NULL;
+
+    self->cancel_requested = TRUE;
+
+    Py_INCREF (Py_None);
+    return Py_None;
+}
+
+static PyMethodDef SessionMethods[] = {
+    {"update_primary", (PyCFunction) session_update_primary, METH_VARARGS,
+     "Same as the module's update_primary ()."},
+    {"update_filelist", (PyCFunction) session_update_filelist, METH_VARARGS,
+     "Same as the module's update_filelist ()."},
+    {"update_other", (PyCFunction) session_update_other, METH_VARARGS,
+     "Same as the module's update_other ()."},
+    {"cancel", (PyCFunction) session_cancel, METH_VARARGS,
+     "Stop the running build of this session after the current package, "
+     "or the next one when none runs."},
+
+    {NULL, NULL, 0, NULL}
+};
+
+static PyTypeObject SessionType = {
+    PyObject_HEAD_INIT (NULL)
+    0,                                  /* ob_size */
+    "_sqlitecache.Session",             /* tp_name */
+    sizeof (SessionObject),             /* tp_basicsize */
+    0,                                  /* tp_itemsize */
+    (destructor) session_dealloc,       /* tp_dealloc */
+    0,                                  /* tp_print */
+    0,                                  /* tp_getattr */
+    0,                                  /* tp_setattr */
+    0,                                  /* tp_compare */
+    0,                                  /* tp_repr */
+    0,                                  /* tp_as_number */
+    0,                                  /* tp_as_sequence */
+    0,                                  /* tp_as_mapping */
+    0,                                  /* tp_hash */
+    0,                                  /* tp_call */
+    0,                                  /* tp_str */
+    0,                                  /* tp_getattro */
+    0,                                  /* tp_setattro */
+    0,                                  /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                 /* tp_flags */
+    "Builds cache databases one after another, keeping buffers and "
+    "lookup tables between them.",      /* tp_doc */
+    0,                                  /* tp_traverse */
+    0,                                  /* tp_clear */
+    0,                                  /* tp_richcompare */
+    0,                                  /* tp_weaklistoffset */
+    0,                                  /* tp_iter */
+    0,                                  /* tp_iternext */
+    SessionMethods,                     /* tp_methods */
+    0,                                  /* tp_members */
+    0,                                  /* tp_getset */
+    0,                                  /* tp_base */
+    0,                                  /* tp_dict */
+    0,                                  /* tp_descr_get */
+    0,                                  /* tp_descr_set */
+    0,                                  /* tp_dictoffset */
+    0,                                  /* tp_init */
+    0,                                  /* tp_alloc */
+    session_new,                        /* tp_new */
+};
+
+/* A Feed builds the same cache as update_primary () and friends from
+   metadata handed to it in pieces, e.g. while it is downloaded, so that
+   parsing is done when the download is.  The cache is named after the
+   location just the same; the data may be gzip compressed or not. */
+
+typedef struct {
+    PyObject_HEAD
+    union {
+        UpdateInfo update_info;
+        PackageWriterInfo primary;
+        FileListInfo filelists;
+        UpdateOtherInfo other;
+    } info;
+    YumXmlParser *parser;
+    char *db_filename;
+    char *checksum;
+    PyObject *log;
+    PyObject *progress;
+    PyObject *repoid;
+    gboolean fresh;
+    GError *error;
+} FeedObject;
+
+static guint
+feed_log_handler (FeedObject *self)
+{
+    GLogLevelFlags level = G_LOG_LEVEL_MESSAGE | G_LOG_LEVEL_WARNING |
+        G_LOG_LEVEL_CRITICAL | G_LOG_LEVEL_DEBUG;
+
+    return g_log_set_handler (NULL, level, log_cb, self->log);
+}
+
+/* Ends the build, committing it unless there was an error */
+static void
+feed_stop (FeedObject *self)
+{
+    yum_xml_parser_free (self->parser);
+    self->parser = NULL;
+
+    update_packages_finish (&self->info.update_info, &self->error);
+    *update_info_cancel_flag (&self->info.update_info) = FALSE;
+}
+
+static PyObject *
+feed_error (FeedObject *self)
+{
+    /* Don't mask KeyboardInterrupt or a callback's exception */
+    if (!PyErr_Occurred ())
+        PyErr_SetString (PyExc_TypeError, self->error->message);
+    return NULL;
+}
+
+static void
+feed_dealloc (FeedObject *self)
+{
+    if (self->parser) {
+        /* Dropped before finish (): what was committed is resumed by the
+           next build, like after cancel () */
+        g_set_error (&self->error, YUM_DB_ERROR, YUM_DB_ERROR, "Abandoned");
+        feed_stop (self);
+    }
+
+    update_info_free (&self->info.update_info);
+    g_free (self->db_filename);
+    g_free (self->checksum);
+    Py_XDECREF (self->log);
+    Py_XDECREF (self->progress);
+    Py_XDECREF (self->repoid);
+    g_clear_error (&self->error);
+
+    self->ob_type->tp_free ((PyObject *) self);
+}
+
+static PyObject *
+feed_feed (FeedObject *self, PyObject *args)
+{
+    Py_buffer data;
+    const char *buf;
+    Py_ssize_t left;
+    guint log_id;
+
+    /* Strings and anything else with the buffer interface */
+    if (!PyArg_ParseTuple (args, "s*", &data))
+        return NULL;
+
+    if (self->error || self->fresh || !self->parser) {
+        PyBuffer_Release (&data);
+
+        if (self->error)
+            return feed_error (self);
+        if (!self->fresh) {
+            PyErr_SetString (PyExc_RuntimeError, "Feed is finished");
+            return NULL;
+        }
+
+        Py_INCREF (Py_None);
+        return Py_None;
+    }
+
+    log_id = feed_log_handler (self);
+    buf = data.buf;
+    left = data.len;
+    while (left > 0 && !self->error) {
+        int len = MIN (left, G_MAXINT);
+
+        yum_xml_parser_feed (self->parser, buf, len);
+        buf += len;
+        left -= len;
+    }
+    if (self->error)
+        feed_stop (self);
+    g_log_remove_handler (NULL, log_id);
+
+    PyBuffer_Release (&data);
+
+    if (self->error)
+        return feed_error (self);
+
+    Py_INCREF (Py_None);
+    return Py_None;
+}
+
+static PyObject *
+feed_finish (FeedObject *self, PyObject *args)
+{
+    guint log_id;
+
+    if (!PyArg_ParseTuple (args, ""))
+        return NULL;
+
+    if (self->error)
+        return feed_error (self);
+
+    if (self->parser) {
+        log_id = feed_log_handler (self);
+        yum_xml_parser_finish (self->parser);
+        feed_stop (self);
+        g_log_remove_handler (NULL, log_id);
+
+        if (self->error)
+            return feed_error (self);
+    }
+
+    return PyString_FromString (self->db_filename);
+}
+
+static PyObject *
+feed_get_fresh (FeedObject *self, void *closure)
+{
+    return PyBool_FromLong (self->fresh);
+}
+
+static PyMethodDef FeedMethods[] = {
+    {"feed", (PyCFunction) feed_feed, METH_VARARGS,
+     "Parse the next piece of metadata, of any size."},
+    {"finish", (PyCFunction) feed_finish, METH_VARARGS,
+     "Finish the cache after the last piece and return its filename."},
+
+    {NULL, NULL, 0, NULL}
+};
+
+static PyGetSetDef FeedGetSet[] = {
+    {"fresh", (getter) feed_get_fresh, NULL,
+     "True when the cache was up to date and data is not needed.", NULL},
+
+    {NULL, NULL, NULL, NULL, NULL}
+};
+
+static PyTypeObject FeedType = {
+    PyObject_HEAD_INIT (NULL)
+    0,                                  /* ob_size */
+    "_sqlitecache.Feed",                /* tp_name */
+    sizeof (FeedObject),                /* tp_basicsize */
+    0,                                  /* tp_itemsize */
+    (destructor) feed_dealloc,          /* tp_dealloc */
+    0,                                  /* tp_print */
+    0,                                  /* tp_getattr */
+    0,                                  /* tp_setattr */
+    0,                                  /* tp_compare */
+    0,                                  /* tp_repr */
+    0,                                  /* tp_as_number */
+    0,                                  /* tp_as_sequence */
+    0,                                  /* tp_as_mapping */
+    0,                                  /* tp_hash */
+    0,                                  /* tp_call */
+    0,                                  /* tp_str */
+    0,                                  /* tp_getattro */
+    0,                                  /* tp_setattro */
+    0,                                  /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                 /* tp_flags */
+    "Builds a cache database from metadata fed in pieces.", /* tp_doc */
+    0,                                  /* tp_traverse */
+    0,                                  /* tp_clear */
+    0,                                  /* tp_richcompare */
+    0,                                  /* tp_weaklistoffset */
+    0,                                  /* tp_iter */
+    0,                                  /* tp_iternext */
+    FeedMethods,                        /* tp_methods */
+    0,                                  /* tp_members */
+    FeedGetSet,                         /* tp_getset */
+};
+
+/* Takes the arguments of update_primary () */
+static PyObject *
+feed_start (FeedObject *self, PyObject *args)
+{
+    UpdateInfo *update_info = &self->info.update_info;
+    const char *md_filename = NULL;
+    const char *checksum = NULL;
+    PyObject *repoid = NULL;
+    guint options = 0;
+    const char *profile = NULL;
+    guint log_id;
+
+    if (!py_parse_args (args, &md_filename, &checksum, &self->log,
+                        &self->progress, &repoid, &options, &profile))
+        goto error;
+    Py_INCREF (repoid);
+    self->repoid = repoid;
+
+    update_info->profile = yum_db_profile_lookup (profile);
+    if (!update_info->profile) {
+        PyErr_Format (PyExc_ValueError, "Unknown profile: %s", profile);
+        goto error;
+    }
+
+    if (update_info->info_options) {
+        update_info->options = options;
+        update_info->info_options (update_info);
+    }
+
+    self->db_filename = yum_db_filename (md_filename);
+    self->checksum = g_strdup (checksum);
+
+    log_id = feed_log_handler (self);
+    if (update_packages_start (update_info, self->db_filename,
+                               self->checksum, self->progress, self->repoid,
+                               &self->error)) {
+        self->parser = update_info->xml_parser_new (count_cb,
+                                                    update_package_cb,
+                                                    update_info->write_files ?
+                                                    update_files_cb : NULL,
+                                                    update_info,
+                                                    &self->error);
+        if (!self->parser)
+            update_packages_finish (update_info, &self->error);
+    } else if (!self->error)
+        self->fresh = TRUE;
+    g_log_remove_handler (NULL, log_id);
+
+    /* Nothing left to build */
+    if (!self->parser)
+        *update_info_cancel_flag (update_info) = FALSE;
+
+    if (self->error) {
+        feed_error (self);
+        goto error;
+    }
+
+    return (PyObject *) self;
+
+ error:
+    Py_DECREF (self);
+    return NULL;
+}
+
+static FeedObject *
+feed_new (void)
+{
+    return (FeedObject *) FeedType.tp_alloc (&FeedType, 0);
+}
+
+static PyObject *
+py_feed_primary (PyObject *self, PyObject *args)
+{
+    FeedObject *feed = feed_new ();
+
+    if (!feed)
+        return NULL;
+
+    package_writer_info_setup (&feed->info.primary);
+    return feed_start (feed, args);
+}
+
+static PyObject *
+py_feed_filelist (PyObject *self, PyObject *args)
+{
+    FeedObject *feed = feed_new ();
+
+    if (!feed)
+        return NULL;
+
+    update_filelist_info_setup (&feed->info.filelists);
+    return feed_start (feed, args);
+}
+
+static PyObject *
+py_feed_other (PyObject *self, PyObject *args)
+{
+    FeedObject *feed = feed_new ();
+
+    if (!feed)
+        return NULL;
+
+    update_other_info_setup (&feed->info.other);
+    return feed_start (feed, args);
+}
+
+static PyObject *
+py_cancel (PyObject *self, PyObject *args)
+{
+    if (!PyArg_ParseTuple (args, ""))
+        return NULL;
+
+    cancel_requested = TRUE;
+
+    Py_INCREF (Py_None);
+    return Py_None;
+}
+
+static PyObject *
+py_update_primary_index (PyObject *self, PyObject *args)
+{
+    const char *md_filename = NULL;
+    const char *checksum = NULL;
+    PyObject *log = NULL;
+    PyObject *progress = NULL;
+    PyObject *repoid = NULL;
+    guint log_id = 0;
+    char *idx_filename;
+    PyObject *ret = NULL;
+    GError *err = NULL;
+
+    if (!py_parse_args (args, &md_filename, &checksum, &log, &progress,
+                        &repoid, NULL, NULL))
+        return NULL;
+
+    GLogLevelFlags level = G_LOG_LEVEL_MESSAGE | G_LOG_LEVEL_WARNING |
+        G_LOG_LEVEL_CRITICAL | G_LOG_LEVEL_DEBUG;
+    log_id = g_log_set_handler (NULL, level, log_cb, log);
+
+    idx_filename = update_index (md_filename, checksum, progress, repoid, &err);
+
+    g_log_remove_handler (NULL, log_id);
+
+    if (idx_filename) {
+        ret = PyString_FromString (idx_filename);
+        g_free (idx_filename);
+    } else {
+        /* Don't mask KeyboardInterrupt or a callback's exception */
+        if (!PyErr_Occurred ())
+            PyErr_SetString (PyExc_TypeError, err->message);
+        g_error_free (err);
+    }
+
+    return ret;
+}
+
+static PyObject *
+py_update_other_index (PyObject *self, PyObject *args)
+{
+    const char *md_filename = NULL;
+    const char *checksum = NULL;
+    PyObject *log = NULL;
+    PyObject *progress = NULL;
+    PyObject *repoid = NULL;
+    guint log_id = 0;
+    char *idx_filename;
+    PyObject *ret = NULL;
+    GError *err = NULL;
+
+    if (!py_parse_args (args, &md_filename, &checksum, &log, &progress,
+                        &repoid, NULL, NULL))
+        return NULL;
+
+    GLogLevelFlags level = G_LOG_LEVEL_MESSAGE | G_LOG_LEVEL_WARNING |
+        G_LOG_LEVEL_CRITICAL | G_LOG_LEVEL_DEBUG;
+    log_id = g_log_set_handler (NULL, level, log_cb, log);
+
+    idx_filename = update_other_index (md_filename, checksum, progress,
+                                       repoid, &err);
+
+    g_log_remove_handler (NULL, log_id);
+
+    if (idx_filename) {
+        ret = PyString_FromString (idx_filename);
+        g_free (idx_filename);
+    } else {
+        /* Don't mask KeyboardInterrupt or a callback's exception */
+        if (!PyErr_Occurred ())
+            PyErr_SetString (PyExc_TypeError, err->message);
+        g_error_free (err);
+    }
+
+    return ret;
+}
+
+static PyObject *
+py_export (PyObject *self, PyObject *args,
+           ExportNewFn export_new, XmlParseFn xml_parse)
+{
+    const char *md_filename = NULL;
+    const char *outdir = NULL;
+    PyObject *callback;
+    PyObject *log = NULL;
+    PyObject *progress = NULL;
+    PyObject *repoid = NULL;
+    guint log_id = 0;
+    GError *err = NULL;
+
+    if (!PyArg_ParseTuple (args, "ssOO", &md_filename, &outdir, &callback,
+                           &repoid))
+        return NULL;
+
+    if (!py_parse_callback (callback, &log, &progress))
+        return NULL;
+
+    GLogLevelFlags level = G_LOG_LEVEL_MESSAGE | G_LOG_LEVEL_WARNING |
+        G_LOG_LEVEL_CRITICAL | G_LOG_LEVEL_DEBUG;
+    log_id = g_log_set_handler (NULL, level, log_cb, log);
+
+    export_metadata (md_filename, outdir, export_new, xml_parse,
+                     progress, repoid, &err);
+
+    g_log_remove_handler (NULL, log_id);
+
+    if (err) {
+        /* Don't mask KeyboardInterrupt or a callback's exception */
+        if (!PyErr_Occurred ())
+            PyErr_SetString (PyExc_TypeError, err->message);
+        g_error_free (err);
+        return NULL;
+    }
+
+    return PyString_FromString (outdir);
+}
+
+static PyObject *
+py_export_primary (PyObject *self, PyObject *args)
+{
+    return py_export (self, args, yum_column_export_primary_new,
+                      yum_xml_parse_primary);
+}
+
+static PyObject *
+py_export_filelist (PyObject *self, PyObject *args)
+{
+    return py_export (self, args, yum_column_export_filelists_new,
+                      yum_xml_parse_filelists);
+}
+
+static PyObject *
+py_export_other (PyObject *self, PyObject *args)
+{
+    return py_export (self, args, yum_column_export_other_new,
+                      yum_xml_parse_other);
+}
+
+static PyObject *
+column_to_py (YumColumnReader *reader, guint column)
+{
+    guint64 n_rows = yum_column_reader_n_rows (reader);
+    gboolean is_int = yum_column_reader_type (reader, column) == YUM_COLUMN_INT;
+    PyObject *ret;
+    guint64 row;
+
+    ret = PyList_New (n_rows);
+    if (!ret)
+        return NULL;
+
+    for (row = 0; row < n_rows; row++) {
+        PyObject *item;
+
+        if (is_int)
+            item = PyLong_FromLongLong
+                (yum_column_reader_get_int (reader, column, row));
+        else {
+            const char *value;
+
+            value = yum_column_reader_get_string (reader, column, row);
+            if (value)
+                item = PyString_FromString (value);
+            else {
+                Py_INCREF (Py_None);
+                item = Py_None;
+            }
+        }
+
+        if (!item) {
+            Py_DECREF (ret);
+            return NULL;
+        }
+        PyList_SET_ITEM (ret, row, item);
+    }
+
+    return ret;
+}
+
+static PyObject *
+py_read_columns (PyObject *self, PyObject *args)
+{
+    const char *filename;
+    YumColumnReader *reader;
+    PyObject *ret;
+    GError *err = NULL;
+    guint i;
+
+    if (!PyArg_ParseTuple (args, "s", &filename))
+        return NULL;
+
+    reader = yum_column_reader_open (filename, &err);
+    if (!reader) {
+        PyErr_SetString (PyExc_TypeError, err->message);
+        g_error_free (err);
+        return NULL;
+    }
+
+    ret = PyDict_New ();
+    for (i = 0; ret && i < yum_column_reader_n_columns (reader); i++) {
+        PyObject *column = column_to_py (reader, i);
+
+        if (!column ||
+            PyDict_SetItemString (ret, yum_column_reader_name (reader, i),
+                                  column) < 0) {
+            Py_XDECREF (column);
+            Py_CLEAR (ret);
+            break;
+        }
+        Py_DECREF (column);
+    }
+
+    yum_column_reader_close (reader);
+
+    return ret;
+}
+
+static PyObject *
+index_lookup (YumIndex *index, const char *key, gboolean files)
+{
+    const guint32 *pkgs;
+    guint32 count;
+    guint32 i;
+    PyObject *ret;
+
+    if (files)
+        pkgs = yum_index_lookup_file (index, key, &count);
+    else
+        pkgs = yum_index_lookup_provides (index, key, &count);
+
+    ret = PyTuple_New (count);
+    if (!ret)
+        return NULL;
+
+    for (i = 0; i < count; i++) {
+        const YumIndexPackage *pkg = yum_index_package (index, pkgs[i]);
+        const char *pkgId = pkg ? yum_index_string (index, pkg->pkgId) : NULL;
+        PyObject *item;
+
+        if (!pkgId) {
+            PyErr_SetString (PyExc_TypeError, "Index file is corrupt");
+            Py_DECREF (ret);
+            return NULL;
+        }
+
+        item = PyString_FromString (pkgId);
+        if (!item) {
+            Py_DECREF (ret);
+            return NULL;
+        }
+        PyTuple_SET_ITEM (ret, i, item);
+    }
+
+    return ret;
+}
+
+static PyObject *
+py_index_lookup (PyObject *args, gboolean files)
+{
+    const char *idx_filename;
+    const char *key;
+    YumIndex *index;
+    PyObject *ret;
+    GError *err = NULL;
+
+    if (!PyArg_ParseTuple (args, "ss", &idx_filename, &key))
+        return NULL;
+
+    index = yum_index_open (idx_filename, &err);
+    if (!index) {
+        PyErr_SetString (PyExc_TypeError, err->message);
+        g_error_free (err);
+        return NULL;
+    }
+
+    ret = index_lookup (index, key, files);
+    yum_index_close (index);
+
+    return ret;
+}
+
+static PyObject *
+py_index_provides (PyObject *self, PyObject *args)
+{
+    return py_index_lookup (args, FALSE);
+}
+
+static PyObject *
+py_index_files (PyObject *self, PyObject *args)
+{
+    return py_index_lookup (args, TRUE);
+}
+
+/* A lookup index that stays mapped for all the lookups made through it,
+   where index_provides () and index_files () map it for one */
+
+typedef struct {
+    PyObject_HEAD
+    YumIndex *index;
+} LookupIndexObject;
+
+static PyObject *
+lookup_index_new (PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    LookupIndexObject *self;
+    const char *idx_filename;
+    GError *err = NULL;
+
+    if (!PyArg_ParseTuple (args, "s", &idx_filename))
+        return NULL;
+
+    self = (LookupIndexObject *) type->tp_alloc (type, 0);
+    if (!self)
+        return NULL;
+
+    self->index = yum_index_open (idx_filename, &err);
+    if (!self->index) {
+        PyErr_SetString (PyExc_TypeError, err->message);
+        g_error_free (err);
+        Py_DECREF (self);
+        return NULL;
+    }
+
+    return (PyObject *) self;
 }
 
 static void
-log_cb (const gchar *log_domain,
-        GLogLevelFlags log_level,
-        const gchar *message,
-        gpointer user_data)
+lookup_index_dealloc (LookupIndexObject *self)
 {
-    PyObject *callback = (PyObject *) user_data;
-    int level;
-    PyObject *args;
-    PyObject *result;
+    if (self->index)
+        yum_index_close (self->index);
+
+    self->ob_type->tp_free ((PyObject *) self);
+}
+
+static PyObject *
+lookup_index_provides (LookupIndexObject *self, PyObject *args)
+{
+    const char *name;
+
+    if (!PyArg_ParseTuple (args, "s", &name))
+        return NULL;
+
+    return index_lookup (self->index, name, FALSE);
+}
+
+static PyObject *
+lookup_index_files (LookupIndexObject *self, PyObject *args)
+{
+    const char *path;
+
+    if (!PyArg_ParseTuple (args, "s", &path))
+        return NULL;
+
+    return index_lookup (self->index, path, TRUE);
+}
+
+static PyObject *
+lookup_index_checksum (LookupIndexObject *self, PyObject *args)
+{
+    return PyString_FromString (yum_index_checksum (self->index));
+}
+
+static PyMethodDef lookup_index_methods[] = {
+    {"provides", (PyCFunction) lookup_index_provides, METH_VARARGS,
+     "Look up the pkgIds providing a name."},
+    {"files", (PyCFunction) lookup_index_files, METH_VARARGS,
+     "Look up the pkgIds owning a file."},
+    {"checksum", (PyCFunction) lookup_index_checksum, METH_NOARGS,
+     "The checksum of the metadata the index was built from."},
+    {NULL}
+};
+
+static PyTypeObject LookupIndexType = {
+    PyObject_HEAD_INIT (NULL)
+    0,                                  /* ob_size */
+    "_sqlitecache.LookupIndex",         /* tp_name */
+    sizeof (LookupIndexObject),         /* tp_basicsize */
+    0,                                  /* tp_itemsize */
+    (destructor) lookup_index_dealloc,  /* tp_dealloc */
+    0,                                  /* tp_print */
+    0,                                  /* tp_getattr */
+    0,                                  /* tp_setattr */
+    0,                                  /* tp_compare */
+    0,                                  /* tp_repr */
+    0,                                  /* tp_as_number */
+    0,                                  /* tp_as_sequence */
+    0,                                  /* tp_as_mapping */
+    0,                                  /* tp_hash */
+    0,                                  /* tp_call */
+    0,                                  /* tp_str */
+    0,                                  /* tp_getattro */
+    0,                                  /* tp_setattro */
+    0,                                  /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                 /* tp_flags */
+    "LookupIndex(filename): a lookup index made by update_primary_index, "
+    "mapped until the object goes away.",  /* tp_doc */
+    0,                                  /* tp_traverse */
+    0,                                  /* tp_clear */
+    0,                                  /* tp_richcompare */
+    0,                                  /* tp_weaklistoffset */
+    0,                                  /* tp_iter */
+    0,                                  /* tp_iternext */
+    lookup_index_methods,               /* tp_methods */
+    0,                                  /* tp_members */
+    0,                                  /* tp_getset */
+    0,                                  /* tp_base */
+    0,                                  /* tp_dict */
+    0,                                  /* tp_descr_get */
+    0,                                  /* tp_descr_set */
+    0,                                  /* tp_dictoffset */
+    0,                                  /* tp_init */
+    0,                                  /* tp_alloc */
+    lookup_index_new,                   /* tp_new */
+};
+
+/* Package strings live only as long as the parse, so the list is built
+   from the callback */
+static void
+changelog_package_cb (Package *p, gpointer user_data)
+{
+    PyObject *list = (PyObject *) user_data;
+    GSList *iter;
+
+    for (iter = p->changelogs; iter; iter = iter->next) {
+        ChangelogEntry *entry = (ChangelogEntry *) iter->data;
+        PyObject *item;
+
+        item = Py_BuildValue ("(zLz)", entry->author,
+                              (PY_LONG_LONG) entry->date,
+                              entry->changelog);
+        PyList_Append (list, item);
+        Py_DECREF (item);
+    }
+}
+
+static PyObject *
+py_changelog (PyObject *self, PyObject *args)
+{
+    const char *md_filename;
+    const char *pkgId;
+    char *idx_filename;
+    YumChangelogIndex *index;
+    PyObject *ret;
+    GError *err = NULL;
+
+    if (!PyArg_ParseTuple (args, "ss", &md_filename, &pkgId))
+        return NULL;
+
+    idx_filename = yum_changelog_index_filename (md_filename);
+    index = yum_changelog_index_open (idx_filename, &err);
+    g_free (idx_filename);
+    if (!index) {
+        PyErr_SetString (PyExc_TypeError, err->message);
+        g_error_free (err);
+        return NULL;
+    }
 
-    if (!callback)
-        return;
+    ret = PyList_New (0);
+    yum_changelog_index_lookup (index, md_filename, pkgId,
+                                changelog_package_cb, ret, &err);
 
-    args = PyTuple_New (2);
+    yum_changelog_index_close (index);
 
-    switch (log_level) {
-    case G_LOG_LEVEL_DEBUG:
-        level = 2;
-        break;
-    case G_LOG_LEVEL_MESSAGE:
-        level = 1;
-        break;
-    case G_LOG_LEVEL_WARNING:
-        level = 0;
-        break;
-    case G_LOG_LEVEL_CRITICAL:
-    default:
-        level = -1;
-        break;
+    if (err) {
+        Py_DECREF (ret);
+        PyErr_SetString (PyExc_TypeError, err->message);
+        g_error_free (err);
+        return NULL;
     }
 
-    PyTuple_SET_ITEM (args, 0, PyInt_FromLong (level));
-    PyTuple_SET_ITEM (args, 1, PyString_FromString (message));
+    return ret;
+}
 
-    result = PyEval_CallObject (callback, args);
-    Py_DECREF (args);
-    Py_XDECREF (result);
+static PyObject *
+diff_package_tuple (const YumDiffPackage *p)
+{
+    return Py_BuildValue ("(zzzzzz)", p->pkgId, p->name, p->arch, p->epoch,
+                          p->version, p->release);
+}
+
+static void
+diff_cb (YumDiffKind kind,
+         const YumDiffPackage *old_pkg,
+         const YumDiffPackage *new_pkg,
+         gpointer user_data)
+{
+    PyObject **lists = (PyObject **) user_data;
+    PyObject *item;
+
+    if (kind == YUM_DIFF_ADDED)
+        item = diff_package_tuple (new_pkg);
+    else if (kind == YUM_DIFF_REMOVED)
+        item = diff_package_tuple (old_pkg);
+    else
+        item = Py_BuildValue ("(NN)", diff_package_tuple (old_pkg),
+                              diff_package_tuple (new_pkg));
+
+    PyList_Append (lists[kind], item);
+    Py_DECREF (item);
 }
 
 static PyObject *
-py_update (PyObject *self, PyObject *args, UpdateInfo *update_info)
+py_diff_primary (PyObject *self, PyObject *args)
 {
-    const char *md_filename = NULL;
-    const char *checksum = NULL;
+    static const char *keys[] = { "added", "removed", "upgraded", "changed" };
+    const char *old_filename = NULL;
+    const char *new_filename = NULL;
+    PyObject *callback;
     PyObject *log = NULL;
     PyObject *progress = NULL;
     PyObject *repoid = NULL;
-    guint log_id = 0;
-    char *db_filename;
+    PyObject *lists[4];
     PyObject *ret = NULL;
+    guint log_id = 0;
     GError *err = NULL;
+    int i;
 
-    if (!py_parse_args (args, &md_filename, &checksum, &log, &progress,
-                        &repoid))
+    if (!PyArg_ParseTuple (args, "ssOO", &old_filename, &new_filename,
+                           &callback, &repoid))
+        return NULL;
+
+    if (!py_parse_callback (callback, &log, &progress))
         return NULL;
 
+    for (i = 0; i < 4; i++)
+        lists[i] = PyList_New (0);
+
     GLogLevelFlags level = G_LOG_LEVEL_MESSAGE | G_LOG_LEVEL_WARNING |
         G_LOG_LEVEL_CRITICAL | G_LOG_LEVEL_DEBUG;
     log_id = g_log_set_handler (NULL, level, log_cb, log);
 
-    db_filename = update_packages (update_info, md_filename, checksum,
-                                   progress, repoid, &err);
+    diff_metadata (old_filename, new_filename, diff_cb, lists,
+                   progress, repoid, &err);
 
     g_log_remove_handler (NULL, log_id);
 
-    if (db_filename) {
-        ret = PyString_FromString (db_filename);
-        g_free (db_filename);
-    } else {
-        PyErr_SetString (PyExc_TypeError, err->message);
+    if (err) {
+        /* Keep the exception of the callback that stopped it */
+        if (!PyErr_Occurred ())
+            PyErr_SetString (PyExc_TypeError, err->message);
         g_error_free (err);
+    } else {
+        ret = PyDict_New ();
+        for (i = 0; i < 4; i++)
+            PyDict_SetItemString (ret, keys[i], lists[i]);
     }
 
+    for (i = 0; i < 4; i++)
+        Py_DECREF (lists[i]);
+
     return ret;
 }
 
+/* Iterators over the packages of a metadata file, each parsed when it is
+   asked for.  Packages come out as dicts keyed like the columns of the
+   cache tables. */
+
+typedef PyObject *(*PackageToPyFn) (Package *p);
+
+typedef struct {
+    PyObject_HEAD
+    YumXmlParser *parser;
+    PackageToPyFn to_py;
+    GError *error;
+} PackageIterObject;
+
 static PyObject *
-py_update_primary (PyObject *self, PyObject *args)
+dependencies_to_py (GSList *list, gboolean with_pre)
 {
-    PackageWriterInfo info;
-    memset (&info, 0, sizeof (PackageWriterInfo));
+    PyObject *ret = PyList_New (0);
+    GSList *iter;
 
-    info.update_info.info_init = package_writer_info_init;
-    info.update_info.info_clean = package_writer_info_clean;
-    info.update_info.create_tables = yum_db_create_primary_tables;
-    info.update_info.write_package = write_package_to_db;
-    info.update_info.xml_parse = yum_xml_parse_primary;
-    info.update_info.index_tables = yum_db_index_primary_tables;
+    for (iter = list; iter; iter = iter->next) {
+        Dependency *dep = (Dependency *) iter->data;
+        PyObject *item;
+
+        if (with_pre)
+            item = Py_BuildValue ("(zzzzzi)", dep->name, dep->flags,
+                                  dep->epoch, dep->version, dep->release,
+                                  dep->pre);
+        else
+            item = Py_BuildValue ("(zzzzz)", dep->name, dep->flags,
+                                  dep->epoch, dep->version, dep->release);
+        PyList_Append (ret, item);
+        Py_DECREF (item);
+    }
 
-    return py_update (self, args, (UpdateInfo *) &info);
+    return ret;
 }
 
 static PyObject *
-py_update_filelist (PyObject *self, PyObject *args)
+files_to_py (GSList *list)
 {
-    FileListInfo info;
-    memset (&info, 0, sizeof (FileListInfo));
+    PyObject *ret = PyList_New (0);
+    GSList *iter;
 
-    info.update_info.info_init = update_filelist_info_init;
-    info.update_info.info_clean = update_filelist_info_clean;
-    info.update_info.create_tables = yum_db_create_filelist_tables;
-    info.update_info.write_package = write_filelist_package_to_db;
-    info.update_info.xml_parse = yum_xml_parse_filelists;
-    info.update_info.index_tables = yum_db_index_filelist_tables;
+    for (iter = list; iter; iter = iter->next) {
+        PackageFile *file = (PackageFile *) iter->data;
+        PyObject *item;
+
+        item = Py_BuildValue ("(zz)", file->name, file->type);
+        PyList_Append (ret, item);
+        Py_DECREF (item);
+    }
 
-    return py_update (self, args, (UpdateInfo *) &info);
+    return ret;
 }
 
 static PyObject *
-py_update_other (PyObject *self, PyObject *args)
+primary_package_to_py (Package *p)
 {
-    UpdateOtherInfo info;
-    memset (&info, 0, sizeof (UpdateOtherInfo));
+    return Py_BuildValue ("{s:z,s:z,s:z,s:z,s:z,s:z,s:z,s:z,s:z,s:L,s:L,"
+                          "s:z,s:z,s:z,s:z,s:z,s:L,s:L,s:z,s:L,s:L,s:L,"
+                          "s:z,s:z,s:z,"
+                          "s:N,s:N,s:N,s:N,s:N,s:N,s:N,s:N,s:N}",
+                          "pkgId", p->pkgId,
+                          "name", p->name,
+                          "arch", p->arch,
+                          "version", p->version,
+                          "epoch", p->epoch,
+                          "release", p->release,
+                          "summary", p->summary,
+                          "description", p->description,
+                          "url", p->url,
+                          "time_file", (PY_LONG_LONG) p->time_file,
+                          "time_build", (PY_LONG_LONG) p->time_build,
+                          "rpm_license", p->rpm_license,
+                          "rpm_vendor", p->rpm_vendor,
+                          "rpm_group", p->rpm_group,
+                          "rpm_buildhost", p->rpm_buildhost,
+                          "rpm_sourcerpm", p->rpm_sourcerpm,
+                          "rpm_header_start",
+                          (PY_LONG_LONG) p->rpm_header_start,
+                          "rpm_header_end", (PY_LONG_LONG) p->rpm_header_end,
+                          "rpm_packager", p->rpm_packager,
+                          "size_package", (PY_LONG_LONG) p->size_package,
+                          "size_installed", (PY_LONG_LONG) p->size_installed,
+                          "size_archive", (PY_LONG_LONG) p->size_archive,
+                          "location_href", p->location_href,
+                          "location_base", p->location_base,
+                          "checksum_type", p->checksum_type,
+                          "requires", dependencies_to_py (p->requires, TRUE),
+                          "provides", dependencies_to_py (p->provides, FALSE),
+                          "conflicts",
+                          dependencies_to_py (p->conflicts, FALSE),
+                          "obsoletes",
+                          dependencies_to_py (p->obsoletes, FALSE),
+                          "suggests", dependencies_to_py (p->suggests, FALSE),
+                          "enhances", dependencies_to_py (p->enhances, FALSE),
+                          "recommends",
+                          dependencies_to_py (p->recommends, FALSE),
+                          "supplements",
+                          dependencies_to_py (p->supplements, FALSE),
+                          "files", files_to_py (p->files));
+}
+
+static PyObject *
+filelists_package_to_py (Package *p)
+{
+    return Py_BuildValue ("{s:z,s:z,s:z,s:z,s:z,s:z,s:N}",
+                          "pkgId", p->pkgId,
+                          "name", p->name,
+                          "arch", p->arch,
+                          "version", p->version,
+                          "epoch", p->epoch,
+                          "release", p->release,
+                          "files", files_to_py (p->files));
+}
+
+static PyObject *
+other_package_to_py (Package *p)
+{
+    PyObject *changelogs = PyList_New (0);
+
+    changelog_package_cb (p, changelogs);
+
+    return Py_BuildValue ("{s:z,s:z,s:z,s:z,s:z,s:z,s:N}",
+                          "pkgId", p->pkgId,
+                          "name", p->name,
+                          "arch", p->arch,
+                          "version", p->version,
+                          "epoch", p->epoch,
+                          "release", p->release,
+                          "changelogs", changelogs);
+}
+
+static void
+package_iter_dealloc (PackageIterObject *self)
+{
+    if (self->parser)
+        yum_xml_parser_free (self->parser);
+    g_clear_error (&self->error);
+
+    self->ob_type->tp_free ((PyObject *) self);
+}
+
+static PyObject *
+package_iter_next (PackageIterObject *self)
+{
+    Package *p;
+    PyObject *ret;
+
+    if (!self->parser)
+        return NULL;
+
+    p = yum_xml_parser_next (self->parser);
+    if (!p) {
+        /* Done with the file, an exhausted iterator stays so */
+        yum_xml_parser_free (self->parser);
+        self->parser = NULL;
+
+        if (self->error) {
+            PyErr_SetString (PyExc_TypeError, self->error->message);
+            g_clear_error (&self->error);
+        }
+        return NULL;
+    }
+
+    ret = self->to_py (p);
+    package_free (p);
+
+    return ret;
+}
+
+static PyTypeObject PackageIterType = {
+    PyObject_HEAD_INIT (NULL)
+    0,                                  /* ob_size */
+    "_sqlitecache.PackageIterator",     /* tp_name */
+    sizeof (PackageIterObject),         /* tp_basicsize */
+    0,                                  /* tp_itemsize */
+    (destructor) package_iter_dealloc,  /* tp_dealloc */
+    0,                                  /* tp_print */
+    0,                                  /* tp_getattr */
+    0,                                  /* tp_setattr */
+    0,                                  /* tp_compare */
+    0,                                  /* tp_repr */
+    0,                                  /* tp_as_number */
+    0,                                  /* tp_as_sequence */
+    0,                                  /* tp_as_mapping */
+    0,                                  /* tp_hash */
+    0,                                  /* tp_call */
+    0,                                  /* tp_str */
+    0,                                  /* tp_getattro */
+    0,                                  /* tp_setattro */
+    0,                                  /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                 /* tp_flags */
+    "Packages of a metadata file, parsed one at a time.", /* tp_doc */
+    0,                                  /* tp_traverse */
+    0,                                  /* tp_clear */
+    0,                                  /* tp_richcompare */
+    0,                                  /* tp_weaklistoffset */
+    PyObject_SelfIter,                  /* tp_iter */
+    (iternextfunc) package_iter_next,   /* tp_iternext */
+};
+
+static PyObject *
+py_iter_packages (PyObject *args,
+                  YumXmlParser *(*open_fn) (const char *, GError **),
+                  PackageToPyFn to_py)
+{
+    const char *md_filename;
+    PackageIterObject *self;
+
+    if (!PyArg_ParseTuple (args, "s", &md_filename))
+        return NULL;
+
+    self = PyObject_New (PackageIterObject, &PackageIterType);
+    if (!self)
+        return NULL;
+
+    self->to_py = to_py;
+    self->error = NULL;
+    self->parser = open_fn (md_filename, &self->error);
+    if (!self->parser) {
+        PyErr_SetString (PyExc_TypeError, self->error->message);
+        Py_DECREF (self);
+        return NULL;
+    }
+
+    return (PyObject *) self;
+}
+
+static PyObject *
+py_iter_primary (PyObject *self, PyObject *args)
+{
+    return py_iter_packages (args, yum_xml_parser_open_primary,
+                             primary_package_to_py);
+}
+
+static PyObject *
+py_iter_filelist (PyObject *self, PyObject *args)
+{
+    return py_iter_packages (args, yum_xml_parser_open_filelists,
+                             filelists_package_to_py);
+}
+
+static PyObject *
+py_iter_other (PyObject *self, PyObject *args)
+{
+    return py_iter_packages (args, yum_xml_parser_open_other,
+                             other_package_to_py);
+}
+
+/* The SQL functions over encoded filelist rows of yum_db_register_
+   functions (), for connections that can not load the yumxml extension.
+   sqlite3 hands them text as unicode. */
+
+#define FILELIST_ARGS 3
+
+typedef struct {
+    const char *text[FILELIST_ARGS];
+    PyObject *utf8[FILELIST_ARGS];
+} FilelistArgs;
+
+static void
+filelist_args_free (FilelistArgs *args)
+{
+    int i;
+
+    for (i = 0; i < FILELIST_ARGS; i++)
+        Py_XDECREF (args->utf8[i]);
+}
+
+/* FALSE with an exception set, or when an argument is None */
+static gboolean
+filelist_args_parse (PyObject *py_args, int n_args, FilelistArgs *args)
+{
+    PyObject *items[FILELIST_ARGS] = { NULL, NULL, NULL };
+    int i;
+
+    memset (args, 0, sizeof (FilelistArgs));
+    if (!PyArg_UnpackTuple (py_args, "filelist", n_args, n_args,
+                            &items[0], &items[1], &items[2]))
+        return FALSE;
+
+    for (i = 0; i < n_args; i++) {
+        PyObject *item = items[i];
+
+        if (item == Py_None)
+            return FALSE;
+
+        if (PyUnicode_Check (item)) {
+            args->utf8[i] = PyUnicode_AsUTF8String (item);
+            if (!args->utf8[i])
+                return FALSE;
+            item = args->utf8[i];
+        }
+
+        args->text[i] = PyString_AsString (item);
+        if (!args->text[i])
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static PyObject *
+py_filelist_paths (PyObject *self, PyObject *py_args)
+{
+    FilelistArgs args;
+    GString *paths;
+    PyObject *ret = NULL;
+
+    if (filelist_args_parse (py_args, 2, &args)) {
+        paths = g_string_sized_new (256);
+        yum_filelist_row_paths (args.text[0], args.text[1], paths);
+        ret = PyString_FromStringAndSize (paths->str, paths->len);
+        g_string_free (paths, TRUE);
+    } else if (!PyErr_Occurred ()) {
+        Py_INCREF (Py_None);
+        ret = Py_None;
+    }
+
+    filelist_args_free (&args);
+    return ret;
+}
+
+static PyObject *
+py_filelist_has (PyObject *self, PyObject *py_args)
+{
+    FilelistArgs args;
+    PyObject *ret = NULL;
+
+    if (filelist_args_parse (py_args, 3, &args))
+        ret = PyInt_FromLong (yum_filelist_row_has (args.text[0],
+                                                    args.text[1],
+                                                    args.text[2]));
+    else if (!PyErr_Occurred ()) {
+        Py_INCREF (Py_None);
+        ret = Py_None;
+    }
+
+    filelist_args_free (&args);
+    return ret;
+}
+
+static PyObject *
+py_filelist_glob (PyObject *self, PyObject *py_args)
+{
+    FilelistArgs args;
+    PyObject *ret = NULL;
+
+    if (filelist_args_parse (py_args, 3, &args))
+        ret = PyInt_FromLong (yum_filelist_row_glob (args.text[0],
+                                                     args.text[1],
+                                                     args.text[2]));
+    else if (!PyErr_Occurred ()) {
+        Py_INCREF (Py_None);
+        ret = Py_None;
+    }
+
+    filelist_args_free (&args);
+    return ret;
+}
+
+static gboolean
+filelist_file_to_py (const char *path, char type, gpointer user_data)
+{
+    PyObject **list = (PyObject **) user_data;
+    PyObject *item;
+    int rc;
+
+    if (type)
+        item = Py_BuildValue ("(sc)", path, type);
+    else
+        item = Py_BuildValue ("(sO)", path, Py_None);
+    if (!item) {
+        Py_CLEAR (*list);
+        return FALSE;
+    }
+
+    rc = PyList_Append (*list, item);
+    Py_DECREF (item);
+    if (rc < 0) {
+        Py_CLEAR (*list);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static PyObject *
+py_filelist_files (PyObject *self, PyObject *args)
+{
+    const char *dirname;
+    const char *filenames;
+    const char *filetypes;
+    PyObject *ret;
+
+    if (!PyArg_ParseTuple (args, "ssz", &dirname, &filenames, &filetypes))
+        return NULL;
+
+    ret = PyList_New (0);
+    if (!ret)
+        return NULL;
+
+    /* Cleared when an item fails */
+    yum_filelist_row_foreach (dirname, filenames, filetypes,
+                              filelist_file_to_py, &ret);
+
+    return ret;
+}
+
+/* Turns YUM_DB_COMPRESS_TEXT columns back into text, as the yum_unpack ()
+   SQL function that sqlitecachec registers on the caches it opens */
+
+typedef struct {
+    PyObject_HEAD
+    YumTextCodec *codec;
+} TextUnpackerObject;
+
+static PyObject *
+text_unpacker_new (PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    TextUnpackerObject *self;
+    PyObject *dicts;
+    PyObject *iter;
+    PyObject *dict;
+    GError *err = NULL;
+
+    if (!PyArg_ParseTuple (args, "O", &dicts))
+        return NULL;
+
+    iter = PyObject_GetIter (dicts);
+    if (!iter)
+        return NULL;
+
+    self = (TextUnpackerObject *) type->tp_alloc (type, 0);
+    if (!self) {
+        Py_DECREF (iter);
+        return NULL;
+    }
+    self->codec = yum_text_codec_new ();
+
+    while ((dict = PyIter_Next (iter))) {
+        const void *data;
+        Py_ssize_t len;
+
+        if (PyObject_AsReadBuffer (dict, &data, &len) == 0)
+            yum_text_codec_add_dict (self->codec, data, len, &err);
+        Py_DECREF (dict);
+
+        if (PyErr_Occurred () || err)
+            break;
+    }
+    Py_DECREF (iter);
+
+    if (err) {
+        PyErr_SetString (PyExc_TypeError, err->message);
+        g_error_free (err);
+    }
+    if (PyErr_Occurred ()) {
+        Py_DECREF (self);
+        return NULL;
+    }
+
+    return (PyObject *) self;
+}
+
+static void
+text_unpacker_dealloc (TextUnpackerObject *self)
+{
+    if (self->codec)
+        yum_text_codec_free (self->codec);
+
+    self->ob_type->tp_free ((PyObject *) self);
+}
+
+static PyObject *
+text_unpacker_call (TextUnpackerObject *self, PyObject *args, PyObject *kwds)
+{
+    PyObject *value;
+    const void *packed;
+    Py_ssize_t packed_len;
+    char *text;
+    gsize len;
+    PyObject *ret;
+    GError *err = NULL;
+
+    if (!PyArg_ParseTuple (args, "O", &value))
+        return NULL;
+
+    /* Not packed (yet) */
+    if (value == Py_None || PyString_Check (value) || PyUnicode_Check (value) ||
+        PyObject_AsReadBuffer (value, &packed, &packed_len) < 0) {
+        PyErr_Clear ();
+        Py_INCREF (value);
+        return value;
+    }
 
-    info.update_info.info_init = update_other_info_init;
-    info.update_info.info_clean = update_other_info_clean;
-    info.update_info.create_tables = yum_db_create_other_tables;
-    info.update_info.write_package = write_other_package_to_db;
-    info.update_info.xml_parse = yum_xml_parse_other;
-    info.update_info.index_tables = yum_db_index_other_tables;
+    text = yum_text_codec_unpack (self->codec, packed, packed_len, &len, &err);
+    if (err) {
+        PyErr_SetString (PyExc_TypeError, err->message);
+        g_error_free (err);
+        return NULL;
+    }
 
-    return py_update (self, args, (UpdateInfo *) &info);
+    ret = PyString_FromStringAndSize (text, len);
+    g_free (text);
+
+    return ret;
 }
 
+static PyTypeObject TextUnpackerType = {
+    PyObject_HEAD_INIT (NULL)
+    0,                                  /* ob_size */
+    "_sqlitecache.TextUnpacker",        /* tp_name */
+    sizeof (TextUnpackerObject),        /* tp_basicsize */
+    0,                                  /* tp_itemsize */
+    (destructor) text_unpacker_dealloc, /* tp_dealloc */
+    0,                                  /* tp_print */
+    0,                                  /* tp_getattr */
+    0,                                  /* tp_setattr */
+    0,                                  /* tp_compare */
+    0,                                  /* tp_repr */
+    0,                                  /* tp_as_number */
+    0,                                  /* tp_as_sequence */
+    0,                                  /* tp_as_mapping */
+    0,                                  /* tp_hash */
+    (ternaryfunc) text_unpacker_call,   /* tp_call */
+    0,                                  /* tp_str */
+    0,                                  /* tp_getattro */
+    0,                                  /* tp_setattro */
+    0,                                  /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                 /* tp_flags */
+    "TextUnpacker(dicts): call with a column of a cache built with "
+    "COMPRESS_TEXT to get its text; dicts are the zstd_dicts of the "
+    "cache.",                           /* tp_doc */
+    0,                                  /* tp_traverse */
+    0,                                  /* tp_clear */
+    0,                                  /* tp_richcompare */
+    0,                                  /* tp_weaklistoffset */
+    0,                                  /* tp_iter */
+    0,                                  /* tp_iternext */
+    0,                                  /* tp_methods */
+    0,                                  /* tp_members */
+    0,                                  /* tp_getset */
+    0,                                  /* tp_base */
+    0,                                  /* tp_dict */
+    0,                                  /* tp_descr_get */
+    0,                                  /* tp_descr_set */
+    0,                                  /* tp_dictoffset */
+    0,                                  /* tp_init */
+    0,                                  /* tp_alloc */
+    text_unpacker_new,                  /* tp_new */
+};
+
 static PyMethodDef SqliteMethods[] = {
     {"update_primary", py_update_primary, METH_VARARGS,
-     "Parse YUM primary.xml metadata."},
+     "Parse YUM primary.xml metadata.  An optional fifth argument takes "
+     "schema flags (PRIMARY_CLUSTERED, SEARCH_INDEX, COMPRESS_TEXT, "
+     "PATH_INDEX), a sixth names the build profile (\"default\" or "
+     "\"bulk\")."},
     {"update_filelist", py_update_filelist, METH_VARARGS,
-     "Parse YUM filelists.xml metadata."},
+     "Parse YUM filelists.xml metadata.  An optional fifth argument takes "
+     "schema flags (FILELIST_DIRS, PATH_INDEX), a sixth names the build "
+     "profile."},
     {"update_other", py_update_other, METH_VARARGS,
-     "Parse YUM other.xml metadata."},
+     "Parse YUM other.xml metadata.  An optional fifth argument takes "
+     "schema flags (SEARCH_INDEX, COMPRESS_TEXT), a sixth names the build "
+     "profile."},
+    {"update_updateinfo", py_update_updateinfo, METH_VARARGS,
+     "Parse YUM updateinfo.xml metadata.  An optional sixth argument names "
+     "the build profile."},
+    {"update_prestodelta", py_update_prestodelta, METH_VARARGS,
+     "Parse YUM prestodelta.xml or deltainfo.xml metadata.  An optional "
+     "sixth argument names the build profile."},
+    {"update_comps", py_update_comps, METH_VARARGS,
+     "Parse comps.xml group metadata.  An optional sixth argument names "
+     "the build profile."},
+    {"feed_primary", py_feed_primary, METH_VARARGS,
+     "Start building a primary cache from data fed to the returned Feed; "
+     "takes the arguments of update_primary ()."},
+    {"feed_filelist", py_feed_filelist, METH_VARARGS,
+     "Start building a filelists cache from data fed to the returned Feed; "
+     "takes the arguments of update_filelist ()."},
+    {"feed_other", py_feed_other, METH_VARARGS,
+     "Start building an other cache from data fed to the returned Feed; "
+     "takes the arguments of update_other ()."},
+    {"cancel", py_cancel, METH_VARARGS,
+     "Stop a running update_* call, or feed, after the current package, "
+     "or the next one when none runs.  Builds of a Session have their own "
+     "cancel ()."},
+    {"update_primary_index", py_update_primary_index, METH_VARARGS,
+     "Build a memory-mappable lookup index from YUM primary.xml metadata."},
+    {"index_provides", py_index_provides, METH_VARARGS,
+     "Look up the pkgIds providing a name in a lookup index, which is "
+     "mapped for this lookup only; see LookupIndex."},
+    {"index_files", py_index_files, METH_VARARGS,
+     "Look up the pkgIds owning a file in a lookup index, which is "
+     "mapped for this lookup only; see LookupIndex."},
+    {"update_other_index", py_update_other_index, METH_VARARGS,
+     "Build a changelog index from YUM other.xml metadata."},
+    {"changelog", py_changelog, METH_VARARGS,
+     "Look up the changelog of a pkgId through the changelog index of "
+     "other.xml metadata, as (author, date, text) tuples."},
+    {"diff_primary", py_diff_primary, METH_VARARGS,
+     "Compare the packages of two revisions of YUM primary.xml metadata, "
+     "each given as metadata or a primary cache, without writing a cache."},
+    {"iter_primary", py_iter_primary, METH_VARARGS,
+     "Iterate over the packages of YUM primary.xml metadata, as dicts."},
+    {"iter_filelist", py_iter_filelist, METH_VARARGS,
+     "Iterate over the packages of YUM filelists.xml metadata, as dicts."},
+    {"iter_other", py_iter_other, METH_VARARGS,
+     "Iterate over the packages of YUM other.xml metadata, as dicts."},
+    {"export_primary", py_export_primary, METH_VARARGS,
+     "Export YUM primary.xml metadata to columnar files."},
+    {"export_filelist", py_export_filelist, METH_VARARGS,
+     "Export YUM filelists.xml metadata to columnar files."},
+    {"export_other", py_export_other, METH_VARARGS,
+     "Export YUM other.xml metadata to columnar files."},
+    {"read_columns", py_read_columns, METH_VARARGS,
+     "Read an exported columnar file, as a dict of column name to list "
+     "of values."},
+    {"filelist_paths", py_filelist_paths, METH_VARARGS,
+     "The paths of a (dirname, filenames) filelist row, one per line."},
+    {"filelist_has", py_filelist_has, METH_VARARGS,
+     "Whether a (dirname, filenames) filelist row has a path, as 1 or 0."},
+    {"filelist_glob", py_filelist_glob, METH_VARARGS,
+     "Whether a path of a (dirname, filenames) filelist row matches an "
+     "sqlite GLOB pattern, as 1 or 0."},
+    {"filelist_files", py_filelist_files, METH_VARARGS,
+     "The (path, type) tuples of a (dirname, filenames, filetypes) filelist "
+     "row."},
 
     {NULL, NULL, 0, NULL}
 };
@@ -658,8 +3823,36 @@ init_sqlitecache (void)
 {
     PyObject * m, * d;
 
+    if (PyType_Ready (&SessionType) < 0)
+        return;
+    if (PyType_Ready (&PackageIterType) < 0)
+        return;
+    if (PyType_Ready (&FeedType) < 0)
+        return;
+    if (PyType_Ready (&TextUnpackerType) < 0)
+        return;
+    if (PyType_Ready (&LookupIndexType) < 0)
+        return;
+
     m = Py_InitModule ("_sqlitecache", SqliteMethods);
+    if (!m)
+        return;
+
+    Py_INCREF (&SessionType);
+    PyModule_AddObject (m, "Session", (PyObject *) &SessionType);
+    Py_INCREF (&TextUnpackerType);
+    PyModule_AddObject (m, "TextUnpacker", (PyObject *) &TextUnpackerType);
+    Py_INCREF (&LookupIndexType);
+    PyModule_AddObject (m, "LookupIndex", (PyObject *) &LookupIndexType);
 
     d = PyModule_GetDict(m);
     PyDict_SetItemString(d, "DBVERSION", PyInt_FromLong(YUM_SQLITE_CACHE_DBVERSION));
+    PyDict_SetItemString(d, "INDEXVERSION", PyInt_FromLong(YUM_INDEX_VERSION));
+    PyDict_SetItemString(d, "CHANGELOGINDEXVERSION", PyInt_FromLong(YUM_CHANGELOG_INDEX_VERSION));
+    PyDict_SetItemString(d, "COLUMNVERSION", PyInt_FromLong(YUM_COLUMN_VERSION));
+    PyDict_SetItemString(d, "FILELIST_DIRS", PyInt_FromLong(YUM_DB_FILELIST_DIRS));
+    PyDict_SetItemString(d, "PRIMARY_CLUSTERED", PyInt_FromLong(YUM_DB_PRIMARY_CLUSTERED));
+    PyDict_SetItemString(d, "SEARCH_INDEX", PyInt_FromLong(YUM_DB_SEARCH_INDEX));
+    PyDict_SetItemString(d, "COMPRESS_TEXT", PyInt_FromLong(YUM_DB_COMPRESS_TEXT));
+    PyDict_SetItemString(d, "PATH_INDEX", PyInt_FromLong(YUM_DB_PATH_INDEX));
 }
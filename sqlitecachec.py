@@ -12,6 +12,8 @@
 # along with this program; if not, write to the Free Software
 # Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 
+import os
+import re
 try:
     import sqlite3 as sqlite
 except ImportError:
@@ -19,13 +21,145 @@ except ImportError:
 import _sqlitecache
 
 DBVERSION = _sqlitecache.DBVERSION
+FILELIST_DIRS = _sqlitecache.FILELIST_DIRS
+PRIMARY_CLUSTERED = _sqlitecache.PRIMARY_CLUSTERED
+SEARCH_INDEX = _sqlitecache.SEARCH_INDEX
+COMPRESS_TEXT = _sqlitecache.COMPRESS_TEXT
+PATH_INDEX = _sqlitecache.PATH_INDEX
+Session = _sqlitecache.Session
+
+# Loadable SQLite extension with the yum_primary, yum_filelists and
+# yum_other virtual tables over metadata files, for load_extension()
+XML_EXTENSION = os.path.join(os.path.dirname(_sqlitecache.__file__), 'yumxml')
+
+def _searchMatch(terms):
+    # Any of the terms, each as a word prefix; quoted so that FTS5 query
+    # syntax in them is taken literally
+    return ' OR '.join(['"%s"*' % t.replace('"', '""')
+                        for t in terms if t.strip()])
+
+def _globParse(pattern):
+    # An sqlite GLOB pattern as a regular expression and the runs of
+    # plain characters in it, or None when it can not match anything
+    pattern = pattern.decode('utf-8', 'replace')
+    regex = []
+    literals = [u'']
+    i = 0
+    while i < len(pattern):
+        c = pattern[i]
+        if c == '*' or c == '?':
+            regex.append(c == '*' and '.*' or '.')
+            literals.append(u'')
+        elif c == '[':
+            j = i + 1
+            negate = j < len(pattern) and pattern[j] == '^'
+            if negate:
+                j += 1
+            end = pattern.find(']', j + 1)
+            if j >= len(pattern) or end < 0:
+                return None
+            chars = re.sub(r'([\\\[\]^])', r'\\\1', pattern[j:end])
+            regex.append('[%s%s]' % (negate and '^' or '', chars))
+            literals.append(u'')
+            i = end
+        else:
+            regex.append(re.escape(c))
+            literals[-1] += c
+        i += 1
+    try:
+        return re.compile(''.join(regex) + r'\Z', re.S | re.U), literals
+    except re.error:
+        return None
+
+def _trigramMatch(literals):
+    # All the trigrams of the pattern, quoted for FTS5
+    trigrams = set()
+    for literal in literals:
+        for i in range(len(literal) - 2):
+            trigrams.add(literal[i:i + 3])
+    return ' AND '.join(['"%s"' % t.replace('"', '""').encode('utf-8')
+                         for t in sorted(trigrams)])
+
+def _filelistFunctions(con):
+    # yum_filelist_paths(dirname, filenames), yum_filelist_has(dirname,
+    # filenames, path) and yum_filelist_glob(dirname, filenames, pattern),
+    # and yum_path_lines(path) for the PATH_INDEX trigger: native through
+    # the extension where the sqlite module can load it, else the same C
+    # code called through Python, and a Python yum_path_lines.  Returns
+    # whether the extension is loaded.
+    try:
+        con.enable_load_extension(True)
+        try:
+            con.load_extension(XML_EXTENSION)
+            return True
+        finally:
+            con.enable_load_extension(False)
+    except (AttributeError, sqlite.Error):
+        pass
+    con.create_function('yum_filelist_paths', 2, _sqlitecache.filelist_paths)
+    con.create_function('yum_filelist_has', 3, _sqlitecache.filelist_has)
+    con.create_function('yum_filelist_glob', 3, _sqlitecache.filelist_glob)
+    con.create_aggregate('yum_path_lines', 1, _PathLines)
+    return False
+
+class _PathLines:
+    # The paths joined with newlines, sorted like strcmp() would
+    def __init__(self):
+        self.paths = []
+
+    def step(self, path):
+        if path is not None:
+            self.paths.append(path)
+
+    def finalize(self):
+        if not self.paths:
+            return None
+        self.paths.sort(key=lambda path: isinstance(path, unicode) and
+                                         path.encode('utf-8') or path)
+        return '\n'.join(self.paths)
+
+def _unpackText(con, native):
+    # Caches built with COMPRESS_TEXT: temporary views over their packed
+    # tables, named like them, give yum the text as always.  yum_unpack()
+    # comes with the extension when it is loaded (native).
+    cur = con.execute("SELECT name FROM sqlite_master"
+                      " WHERE type = 'table' AND name = 'zstd_dicts'")
+    if not cur.fetchall():
+        return
+    if not native:
+        dicts = [row[0] for row in con.execute("SELECT dict FROM zstd_dicts"
+                                               " ORDER BY rowid")]
+        con.create_function('yum_unpack', 1,
+                            _sqlitecache.TextUnpacker(dicts))
+    for table, packed in (('packages', 'description'),
+                          ('changelog', 'changelog')):
+        columns = [row[1] for row in
+                   con.execute("PRAGMA main.table_info(%s)" % table)]
+        if packed not in columns:
+            continue
+        columns = [c == packed and 'yum_unpack(%s) AS %s' % (c, c) or c
+                   for c in columns]
+        con.execute("CREATE TEMP VIEW %s AS SELECT %s FROM main.%s"
+                    % (table, ', '.join(columns), table))
 
 class RepodataParserSqlite:
-    def __init__(self, storedir, repoid, callback=None):
+    def __init__(self, storedir, repoid, callback=None, profile=None,
+                 session=None):
+        """profile selects the connection settings used while building a
+           cache: "default", or "bulk" for faster builds that are not
+           resumed after an interruption, but started over.  Parsers of
+           many repositories can share one Session to skip per-build
+           setup; cancel () then stops only the builds of that Session."""
         self.callback = callback
         self.repoid = repoid
+        self.profile = profile
+        self.builder = session or _sqlitecache
 
     def open_database(self, filename):
+        """Open a cache built by one of the get* methods.  Its filelist
+           rows can be queried with the yum_filelist_paths(dirname,
+           filenames), yum_filelist_has(dirname, filenames, path) and
+           yum_filelist_glob(dirname, filenames, pattern) functions."""
         if not filename:
             return None
         con = sqlite.connect(filename)
@@ -35,28 +169,254 @@ class RepodataParserSqlite:
         cur = con.cursor()
         cur.execute("pragma locking_mode = EXCLUSIVE")
         del cur
+        _unpackText(con, _filelistFunctions(con))
         return con
 
-    def getPrimary(self, location, checksum):
+    def getPrimary(self, location, checksum, options=0):
         """Load primary.xml.gz from an sqlite cache and update it 
-           if required"""
-        return self.open_database(_sqlitecache.update_primary(location,
+           if required.  Pass PRIMARY_CLUSTERED in options to keep the
+           dependency and files tables sorted by name, without rowids,
+           SEARCH_INDEX for searchPackages, COMPRESS_TEXT to store
+           descriptions compressed, which open_database unpacks, and
+           PATH_INDEX for searchFiles."""
+        return self.open_database(self.builder.update_primary(location,
                                                               checksum,
                                                               self.callback,
-                                                              self.repoid))
+                                                              self.repoid,
+                                                              options,
+                                                              self.profile))
 
-    def getFilelists(self, location, checksum):
+    def getFilelists(self, location, checksum, options=0):
         """Load filelist.xml.gz from an sqlite cache and update it if 
-           required"""
-        return self.open_database(_sqlitecache.update_filelist(location,
+           required.  Pass FILELIST_DIRS in options to store each directory
+           name once in a dirs table, and PATH_INDEX for searchFiles."""
+        return self.open_database(self.builder.update_filelist(location,
                                                                checksum,
                                                                self.callback,
-                                                               self.repoid))
+                                                               self.repoid,
+                                                               options,
+                                                               self.profile))
 
-    def getOtherdata(self, location, checksum):
-        """Load other.xml.gz from an sqlite cache and update it if required"""
-        return self.open_database(_sqlitecache.update_other(location,
+    def getOtherdata(self, location, checksum, options=0):
+        """Load other.xml.gz from an sqlite cache and update it if required.
+           Pass SEARCH_INDEX in options for searchChangelogs and
+           COMPRESS_TEXT to store changelog text compressed."""
+        return self.open_database(self.builder.update_other(location,
                                                             checksum,
                                                             self.callback,
-                                                            self.repoid))
+                                                            self.repoid,
+                                                            options,
+                                                            self.profile))
+
+    def getUpdateinfo(self, location, checksum):
+        """Load updateinfo.xml.gz from an sqlite cache and update it if
+           required"""
+        return self.open_database(_sqlitecache.update_updateinfo(location,
+                                                                 checksum,
+                                                                 self.callback,
+                                                                 self.repoid,
+                                                                 0,
+                                                                 self.profile))
+
+    def getPrestodelta(self, location, checksum):
+        """Load prestodelta.xml.gz (or deltainfo.xml.gz) from an sqlite
+           cache and update it if required.  The deltas table is indexed
+           on (name, arch, epoch, version, release, oldepoch, oldversion,
+           oldrelease)."""
+        return self.open_database(_sqlitecache.update_prestodelta(location,
+                                                                  checksum,
+                                                                  self.callback,
+                                                                  self.repoid,
+                                                                  0,
+                                                                  self.profile))
+
+    def getComps(self, location, checksum):
+        """Load comps.xml(.gz) from an sqlite cache and update it if
+           required.  Groups, categories and environments have their own
+           tables; translated names and descriptions are in
+           comps_translations."""
+        return self.open_database(_sqlitecache.update_comps(location,
+                                                            checksum,
+                                                            self.callback,
+                                                            self.repoid,
+                                                            0,
+                                                            self.profile))
+
+    def feedPrimary(self, location, checksum, options=0):
+        """Start building the cache of getPrimary from data that is still
+           arriving, e.g. while primary.xml.gz is downloaded to location.
+           Pass each piece (a string or buffer, gzip compressed or not) to
+           the returned feed's feed() and call open_database(feed.finish())
+           at the end.  When feed.fresh is true the cache is up to date and
+           the data is not needed."""
+        return _sqlitecache.feed_primary(location, checksum, self.callback,
+                                         self.repoid, options, self.profile)
+
+    def feedFilelists(self, location, checksum, options=0):
+        """Like feedPrimary, for the cache of getFilelists"""
+        return _sqlitecache.feed_filelist(location, checksum, self.callback,
+                                          self.repoid, options, self.profile)
+
+    def feedOtherdata(self, location, checksum, options=0):
+        """Like feedPrimary, for the cache of getOtherdata"""
+        return _sqlitecache.feed_other(location, checksum, self.callback,
+                                       self.repoid, options, self.profile)
+
+    def searchPackages(self, con, terms):
+        """Return the pkgKeys of the packages that have a word starting
+           with any of terms in their name, summary or description, best
+           matches first.  con is a primary cache built with
+           SEARCH_INDEX."""
+        match = _searchMatch(terms)
+        if not match:
+            return []
+        cur = con.execute("SELECT rowid FROM packages_search"
+                          " WHERE packages_search MATCH ? ORDER BY rank",
+                          (match,))
+        return [row[0] for row in cur]
+
+    def searchChangelogs(self, con, terms):
+        """Like searchPackages, over the changelog text of an other cache
+           built with SEARCH_INDEX"""
+        match = _searchMatch(terms)
+        if not match:
+            return []
+        cur = con.execute("SELECT changelog.pkgKey FROM main.changelog JOIN"
+                          " (SELECT rowid, rank FROM changelog_search"
+                          "  WHERE changelog_search MATCH ?) AS found"
+                          " ON changelog.rowid = found.rowid"
+                          " GROUP BY changelog.pkgKey ORDER BY min(found.rank)",
+                          (match,))
+        return [row[0] for row in cur]
+
+    def searchFiles(self, con, pattern):
+        """Return (pkgKey, path) tuples for the file paths that match the
+           sqlite GLOB pattern, e.g. '*/bin/foo' or '*.so.1'.  con is a
+           primary or filelists cache built with PATH_INDEX; packages that
+           lack a trigram of the pattern are never looked at, unless it has
+           no three plain characters in a row."""
+        parsed = _globParse(pattern)
+        if not parsed:
+            return []
+        regex, literals = parsed
+        match = _trigramMatch(literals)
+
+        cur = con.execute("SELECT name FROM sqlite_master"
+                          " WHERE name = 'filelist'")
+        if not cur.fetchall():
+            if match:
+                cur = con.execute("SELECT files.pkgKey, files.name"
+                                  " FROM file_trigrams JOIN files"
+                                  " ON files.pkgKey = file_trigrams.rowid"
+                                  " WHERE file_trigrams MATCH ?"
+                                  " AND files.name GLOB ?", (match, pattern))
+            else:
+                cur = con.execute("SELECT pkgKey, name FROM files"
+                                  " WHERE name GLOB ?", (pattern,))
+            return [(row[0], row[1]) for row in cur]
+
+        # Only the rows with a match are taken apart here
+        if match:
+            cur = con.execute("SELECT filelist.pkgKey, dirname, filenames"
+                              " FROM file_trigrams JOIN filelist"
+                              " ON filelist.pkgKey = file_trigrams.rowid"
+                              " WHERE file_trigrams MATCH ?"
+                              " AND yum_filelist_glob(dirname, filenames, ?)",
+                              (match, pattern))
+        else:
+            cur = con.execute("SELECT pkgKey, dirname, filenames"
+                              " FROM filelist"
+                              " WHERE yum_filelist_glob(dirname, filenames, ?)",
+                              (pattern,))
+        found = []
+        for pkgKey, dirname, filenames in cur:
+            for path, type in _sqlitecache.filelist_files(dirname, filenames,
+                                                          None):
+                if regex.match(path.decode('utf-8', 'replace')):
+                    found.append((pkgKey, path))
+        return found
+
+    def cancel(self):
+        """Stop a running getPrimary/getFilelists/getOtherdata call, from
+           the progress callback or a signal handler: builds hold the GIL,
+           other threads do not run until they end.  Called between
+           builds, it stops the next one.  The interrupted build is
+           resumed by the next call with the same checksum, unless the
+           profile is "bulk"."""
+        self.builder.cancel()
+
+    def getPrimaryIndex(self, location, checksum):
+        """Build the memory-mappable lookup index for primary.xml.gz if
+           required and return its filename"""
+        return _sqlitecache.update_primary_index(location,
+                                                 checksum,
+                                                 self.callback,
+                                                 self.repoid)
+
+    def openPrimaryIndex(self, location, checksum):
+        """Like getPrimaryIndex, but return the index as a LookupIndex,
+           whose provides() and files() lookups share one mapping"""
+        return _sqlitecache.LookupIndex(self.getPrimaryIndex(location,
+                                                             checksum))
     
+
+    def getOtherIndex(self, location, checksum):
+        """Build the changelog index for other.xml.gz if required and
+           return its filename.  It takes the place of getOtherdata when
+           changelogs are only looked up now and then."""
+        return _sqlitecache.update_other_index(location,
+                                               checksum,
+                                               self.callback,
+                                               self.repoid)
+
+    def getChangelog(self, location, pkgId):
+        """Return the changelog of pkgId as (author, date, text) tuples,
+           read from other.xml.gz through its changelog index"""
+        return _sqlitecache.changelog(location, pkgId)
+
+    def iterPrimary(self, location):
+        """Iterate over the packages of primary.xml.gz without building a
+           cache.  Each package is a dict keyed like the columns of the
+           packages table, with lists of dependency tuples and (name,
+           type) files."""
+        return _sqlitecache.iter_primary(location)
+
+    def iterFilelists(self, location):
+        """Iterate over the packages of filelists.xml.gz, as dicts with
+           the package's NEVRA, pkgId and (name, type) files"""
+        return _sqlitecache.iter_filelist(location)
+
+    def iterOtherdata(self, location):
+        """Iterate over the packages of other.xml.gz, as dicts with the
+           package's NEVRA, pkgId and (author, date, text) changelogs"""
+        return _sqlitecache.iter_other(location)
+
+    def diffPrimary(self, old_location, new_location):
+        """Compare two revisions of primary.xml.gz, each given as the
+           metadata or its sqlite cache, without building a cache.
+           Returns a dict of 'added' and 'removed' lists of (pkgId, name,
+           arch, epoch, version, release) tuples and 'upgraded' and
+           'changed' lists of (old, new) pairs of them; 'changed' pairs
+           are rebuilds and downgrades."""
+        return _sqlitecache.diff_primary(old_location, new_location,
+                                         self.callback, self.repoid)
+
+    def exportPrimary(self, location, outdir):
+        """Export primary.xml.gz to columnar files in outdir"""
+        return _sqlitecache.export_primary(location, outdir, self.callback,
+                                           self.repoid)
+
+    def exportFilelists(self, location, outdir):
+        """Export filelists.xml.gz to columnar files in outdir"""
+        return _sqlitecache.export_filelist(location, outdir, self.callback,
+                                            self.repoid)
+
+    def exportOtherdata(self, location, outdir):
+        """Export other.xml.gz to columnar files in outdir"""
+        return _sqlitecache.export_other(location, outdir, self.callback,
+                                         self.repoid)
+
+    def readColumns(self, filename):
+        """Read one of the .col files an export wrote, as a dict of column
+           name to the list of its values"""
+        return _sqlitecache.read_columns(filename)
@@ -0,0 +1,245 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <string.h>
+#include <zstd.h>
+#include <zdict.h>
+#include "text-codec.h"
+
+/* Big enough for the boilerplate that descriptions and changelogs
+   repeat, small next to the texts of a repository */
+#define TEXT_DICT_SIZE (64 * 1024)
+
+#define TEXT_LEVEL 3
+
+struct _YumTextCodec {
+    ZSTD_CCtx *cctx;
+    ZSTD_DCtx *dctx;
+    ZSTD_CDict *cdict;
+    /* dictID -> ZSTD_DDict */
+    GHashTable *ddicts;
+};
+
+GQuark
+yum_text_error_quark (void)
+{
+    static GQuark quark;
+
+    if (!quark)
+        quark = g_quark_from_static_string ("yum_text_error");
+
+    return quark;
+}
+
+char *
+yum_text_dict_train (const char *samples,
+                     const gsize *sizes,
+                     guint n_samples,
+                     gsize *dict_len)
+{
+    char *dict;
+    size_t *sample_sizes;
+    size_t ret;
+    guint i;
+
+    sample_sizes = g_new (size_t, n_samples);
+    for (i = 0; i < n_samples; i++)
+        sample_sizes[i] = sizes[i];
+
+    dict = g_malloc (TEXT_DICT_SIZE);
+    ret = ZDICT_trainFromBuffer (dict, TEXT_DICT_SIZE, samples, sample_sizes,
+                                 n_samples);
+    g_free (sample_sizes);
+
+    if (ZDICT_isError (ret)) {
+        g_free (dict);
+        return NULL;
+    }
+
+    *dict_len = ret;
+    return dict;
+}
+
+guint32
+yum_text_dict_id (const char *dict, gsize dict_len)
+{
+    return ZDICT_getDictID (dict, dict_len);
+}
+
+static void
+ddict_free (gpointer ddict)
+{
+    ZSTD_freeDDict ((ZSTD_DDict *) ddict);
+}
+
+YumTextCodec *
+yum_text_codec_new (void)
+{
+    YumTextCodec *codec = g_new0 (YumTextCodec, 1);
+
+    codec->cctx = ZSTD_createCCtx ();
+    codec->dctx = ZSTD_createDCtx ();
+    codec->ddicts = g_hash_table_new_full (NULL, NULL, NULL, ddict_free);
+
+    return codec;
+}
+
+void
+yum_text_codec_free (YumTextCodec *codec)
+{
+    ZSTD_freeCCtx (codec->cctx);
+    ZSTD_freeDCtx (codec->dctx);
+    if (codec->cdict)
+        ZSTD_freeCDict (codec->cdict);
+    g_hash_table_destroy (codec->ddicts);
+    g_free (codec);
+}
+
+gboolean
+yum_text_codec_add_dict (YumTextCodec *codec,
+                         const char *dict,
+                         gsize dict_len,
+                         GError **err)
+{
+    guint32 id = ZDICT_getDictID (dict, dict_len);
+    ZSTD_DDict *ddict;
+
+    if (id == 0) {
+        g_set_error (err, YUM_TEXT_ERROR, YUM_TEXT_ERROR,
+                     "Not a text dictionary");
+        return FALSE;
+    }
+
+    if (yum_text_codec_has_dict (codec, id))
+        return TRUE;
+
+    ddict = ZSTD_createDDict (dict, dict_len);
+    if (!codec->cdict)
+        codec->cdict = ZSTD_createCDict (dict, dict_len, TEXT_LEVEL);
+    if (!ddict || !codec->cdict) {
+        if (ddict)
+            ZSTD_freeDDict (ddict);
+        g_set_error (err, YUM_TEXT_ERROR, YUM_TEXT_ERROR,
+                     "Can not load text dictionary %u", id);
+        return FALSE;
+    }
+
+    g_hash_table_insert (codec->ddicts, GUINT_TO_POINTER (id), ddict);
+    return TRUE;
+}
+
+gboolean
+yum_text_codec_has_dict (YumTextCodec *codec, guint32 dict_id)
+{
+    return g_hash_table_lookup (codec->ddicts,
+                                GUINT_TO_POINTER (dict_id)) != NULL;
+}
+
+gboolean
+yum_text_codec_has_any_dict (YumTextCodec *codec)
+{
+    return codec->cdict != NULL;
+}
+
+char *
+yum_text_codec_pack (YumTextCodec *codec,
+                     const char *text,
+                     gsize len,
+                     gsize *packed_len,
+                     GError **err)
+{
+    size_t bound = ZSTD_compressBound (len);
+    char *packed = g_malloc (bound);
+    size_t ret;
+
+    if (codec->cdict)
+        ret = ZSTD_compress_usingCDict (codec->cctx, packed, bound, text, len,
+                                        codec->cdict);
+    else
+        ret = ZSTD_compressCCtx (codec->cctx, packed, bound, text, len,
+                                 TEXT_LEVEL);
+
+    if (ZSTD_isError (ret)) {
+        g_set_error (err, YUM_TEXT_ERROR, YUM_TEXT_ERROR,
+                     "Can not compress text: %s", ZSTD_getErrorName (ret));
+        g_free (packed);
+        return NULL;
+    }
+
+    *packed_len = ret;
+    return packed;
+}
+
+guint32
+yum_text_packed_dict_id (const char *packed, gsize packed_len)
+{
+    return ZSTD_getDictID_fromFrame (packed, packed_len);
+}
+
+char *
+yum_text_codec_unpack (YumTextCodec *codec,
+                       const char *packed,
+                       gsize packed_len,
+                       gsize *len,
+                       GError **err)
+{
+    unsigned long long size;
+    guint32 id;
+    ZSTD_DDict *ddict = NULL;
+    char *text;
+    size_t ret;
+
+    /* Written by yum_text_codec_pack (), which always records the size */
+    size = ZSTD_getFrameContentSize (packed, packed_len);
+    if (size == ZSTD_CONTENTSIZE_ERROR || size == ZSTD_CONTENTSIZE_UNKNOWN ||
+        size >= G_MAXSIZE) {
+        g_set_error (err, YUM_TEXT_ERROR, YUM_TEXT_ERROR,
+                     "Not a packed text");
+        return NULL;
+    }
+
+    id = ZSTD_getDictID_fromFrame (packed, packed_len);
+    if (id) {
+        ddict = g_hash_table_lookup (codec->ddicts, GUINT_TO_POINTER (id));
+        if (!ddict) {
+            g_set_error (err, YUM_TEXT_ERROR, YUM_TEXT_ERROR,
+                         "Unknown text dictionary %u", id);
+            return NULL;
+        }
+    }
+
+    text = g_malloc (size + 1);
+    if (ddict)
+        ret = ZSTD_decompress_usingDDict (codec->dctx, text, size, packed,
+                                          packed_len, ddict);
+    else
+        ret = ZSTD_decompressDCtx (codec->dctx, text, size, packed,
+                                   packed_len);
+
+    if (ZSTD_isError (ret) || ret != size) {
+        g_set_error (err, YUM_TEXT_ERROR, YUM_TEXT_ERROR,
+                     "Can not decompress text: %s",
+                     ZSTD_isError (ret) ? ZSTD_getErrorName (ret)
+                                        : "wrong size");
+        g_free (text);
+        return NULL;
+    }
+
+    text[size] = '\0';
+    *len = size;
+    return text;
+}
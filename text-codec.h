@@ -0,0 +1,68 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef __YUM_TEXT_CODEC_H__
+#define __YUM_TEXT_CODEC_H__
+
+#include <glib.h>
+
+/* zstd compression of short texts such as descriptions and changelog
+ * entries, with a dictionary trained on the texts of a repository.  Every
+ * frame names the dictionary it needs (0 for none), so a codec can hold
+ * all the dictionaries of a database; the one added first compresses. */
+
+#define YUM_TEXT_ERROR yum_text_error_quark()
+GQuark yum_text_error_quark (void);
+
+/* Samples are the concatenated texts, sizes the length of each.  Returns
+   NULL when there are too few of them to train on. */
+char         *yum_text_dict_train           (const char *samples,
+                                             const gsize *sizes,
+                                             guint n_samples,
+                                             gsize *dict_len);
+guint32       yum_text_dict_id              (const char *dict,
+                                             gsize dict_len);
+
+typedef struct _YumTextCodec YumTextCodec;
+
+YumTextCodec *yum_text_codec_new            (void);
+void          yum_text_codec_free           (YumTextCodec *codec);
+gboolean      yum_text_codec_add_dict       (YumTextCodec *codec,
+                                             const char *dict,
+                                             gsize dict_len,
+                                             GError **err);
+gboolean      yum_text_codec_has_dict       (YumTextCodec *codec,
+                                             guint32 dict_id);
+gboolean      yum_text_codec_has_any_dict   (YumTextCodec *codec);
+
+/* Both return g_malloc ()ed data, the text NUL terminated */
+char         *yum_text_codec_pack           (YumTextCodec *codec,
+                                             const char *text,
+                                             gsize len,
+                                             gsize *packed_len,
+                                             GError **err);
+char         *yum_text_codec_unpack         (YumTextCodec *codec,
+                                             const char *packed,
+                                             gsize packed_len,
+                                             gsize *len,
+                                             GError **err);
+
+/* The dictionary a packed text needs, 0 for none */
+guint32       yum_text_packed_dict_id       (const char *packed,
+                                             gsize packed_len);
+
+#endif /* __YUM_TEXT_CODEC_H__ */
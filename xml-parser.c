@@ -17,15 +17,25 @@
 
 #include <string.h>
 #include <glib.h>
+#include <zlib.h>
 #include <sqlite3.h>
 
 #include <libxml/parser.h>
+#include <libxml/parserInternals.h>
 #include <libxml/tree.h>
 
 #include "xml-parser.h"
+#include "gzip-reader.h"
 
 #define PACKAGE_FIELD_SIZE 1024
 
+/* Hand a package's files to the files callback in batches of this size
+   instead of keeping the whole list in memory */
+#define PACKAGE_FILES_FLUSH 8192
+#define PACKAGE_FILES_CHUNK_SIZE 64 * 1024
+#define PARSE_STRINGS_CHUNK_SIZE 64 * 1024
+#define XML_PARSER_READ_SIZE 32 * 1024
+
 GQuark
 yum_parser_error_quark (void)
 {
@@ -56,14 +66,92 @@ typedef struct {
     GError **error;
     CountFn count_fn;
     PackageFn package_fn;
+    PackageFn files_fn;
     gpointer user_data;
 
     Package *current_package;
+    /* package_fn keeps the packages it gets, with their files */
+    gboolean keep_packages;
+
+    /* YumXmlSkip flags */
+    guint skip;
+
+    /* File names of current_package, cleared on every flush */
+    GStringChunk *files_chunk;
+    guint n_files;
+
+    /* Values that recur across packages (dependencies, arch, vendor, ...),
+       stored once for the whole parse */
+    GStringChunk *strings;
 
     gboolean want_text;
     GString *text_buffer;
 } SAXContext;
 
+/* Equal strings get the same pointer, valid until the parse ends.
+   Packages that package_fn keeps can outlive the parse, they get theirs in
+   their own chunk instead. */
+static inline char *
+sax_context_intern (SAXContext *sctx, const char *str)
+{
+    if (sctx->keep_packages)
+        return g_string_chunk_insert_const (sctx->current_package->chunk,
+                                            str);
+
+    return g_string_chunk_insert_const (sctx->strings, str);
+}
+
+static void
+sax_context_flush_files (SAXContext *sctx)
+{
+    Package *p = sctx->current_package;
+
+    if (!*sctx->error)
+        sctx->files_fn (p, sctx->user_data);
+
+    if (*sctx->error)
+        xmlStopParser (sctx->xml_context);
+
+    g_slist_foreach (p->files, (GFunc) g_free, NULL);
+    g_slist_free (p->files);
+    p->files = NULL;
+
+    g_string_chunk_clear (sctx->files_chunk);
+    sctx->n_files = 0;
+}
+
+/* Takes the file name from the text buffer */
+static void
+sax_context_add_file (SAXContext *sctx, PackageFile *file)
+{
+    Package *p = sctx->current_package;
+
+    file->name = g_string_chunk_insert_len (sctx->keep_packages ?
+                                            p->chunk : sctx->files_chunk,
+                                            sctx->text_buffer->str,
+                                            sctx->text_buffer->len);
+    if (!file->type)
+        file->type = sax_context_intern (sctx, "file");
+
+    p->files = g_slist_prepend (p->files, file);
+
+    if (++sctx->n_files >= PACKAGE_FILES_FLUSH && sctx->files_fn)
+        sax_context_flush_files (sctx);
+}
+
+static void
+sax_context_package_done (SAXContext *sctx)
+{
+    /* A package_fn that keeps packages never fails: if there is an error,
+       it did not get this one */
+    if (!sctx->keep_packages || *sctx->error)
+        package_free (sctx->current_package);
+    sctx->current_package = NULL;
+
+    g_string_chunk_clear (sctx->files_chunk);
+    sctx->n_files = 0;
+}
+
 typedef enum {
     PRIMARY_PARSER_TOPLEVEL = 0,
     PRIMARY_PARSER_PACKAGE,
@@ -153,6 +241,11 @@ primary_parser_package_start (PrimarySAXContext *ctx,
         ctx->state = PRIMARY_PARSER_FORMAT;
     }
 
+    else if (!strcmp (name, "description")) {
+        if (sctx->skip & YUM_XML_SKIP_DESCRIPTION)
+            sctx->want_text = FALSE;
+    }
+
     else if (!strcmp (name, "version")) {
         parse_version_info(attrs, p);
     }
@@ -220,6 +313,8 @@ primary_parser_format_start (PrimarySAXContext *ctx,
 
     g_assert (p != NULL);
 
+    sctx->want_text = TRUE;
+
     if (!strcmp (name, "rpm:header-range")) {
         for (i = 0; attrs && attrs[i]; i++) {
             attr = attrs[i];
@@ -259,6 +354,11 @@ primary_parser_format_start (PrimarySAXContext *ctx,
     }
 
     else if (!strcmp (name, "file")) {
+        if (sctx->skip & YUM_XML_SKIP_FILES) {
+            sctx->want_text = FALSE;
+            return;
+        }
+
         for (i = 0; attrs && attrs[i]; i++) {
             attr = attrs[i];
             value = attrs[++i];
@@ -266,10 +366,14 @@ primary_parser_format_start (PrimarySAXContext *ctx,
             if (!strcmp (attr, "type")) {
                 ctx->current_file = package_file_new ();
                 ctx->current_file->type =
-                    g_string_chunk_insert_const (p->chunk, value);
+                    sax_context_intern (sctx, value);
             }
         }
     }
+
+    /* The entries of a skipped list are passed over */
+    if (ctx->state == PRIMARY_PARSER_DEP && (sctx->skip & YUM_XML_SKIP_DEPS))
+        ctx->current_dep_list = NULL;
 }
 
 static void
@@ -291,6 +395,10 @@ primary_parser_dep_start (PrimarySAXContext *ctx,
     const char *attr;
     const char *value;
 
+    /* Dependencies are skipped */
+    if (!ctx->current_dep_list)
+        return;
+
     if (!strcmp (name, "rpm:entry")) {
         for (i = 0; attrs && attrs[i]; i++) {
             attr = attrs[i];
@@ -315,18 +423,22 @@ primary_parser_dep_start (PrimarySAXContext *ctx,
         }
 
         if (!ignore) {
-            GStringChunk *chunk = sctx->current_package->chunk;
-
             dep = dependency_new ();
-            dep->name = g_string_chunk_insert (chunk, tmp_name);
+            /* Provides are mostly unique to their package, keeping them
+               out of the pool bounds its size */
+            if (ctx->current_dep_list == &sctx->current_package->provides)
+                dep->name = g_string_chunk_insert (sctx->current_package->chunk,
+                                                   tmp_name);
+            else
+                dep->name = sax_context_intern (sctx, tmp_name);
             if (tmp_flags)
-                dep->flags = g_string_chunk_insert (chunk, tmp_flags);
+                dep->flags = sax_context_intern (sctx, tmp_flags);
             if (tmp_epoch)
-                dep->epoch = g_string_chunk_insert (chunk, tmp_epoch);
+                dep->epoch = sax_context_intern (sctx, tmp_epoch);
             if (tmp_version)
-                dep->version = g_string_chunk_insert (chunk, tmp_version);
+                dep->version = sax_context_intern (sctx, tmp_version);
             if (tmp_release)
-                dep->release = g_string_chunk_insert (chunk, tmp_release);
+                dep->release = sax_context_intern (sctx, tmp_release);
             dep->pre = tmp_pre;
 
             *ctx->current_dep_list = g_slist_prepend (*ctx->current_dep_list,
@@ -376,8 +488,11 @@ primary_parser_package_end (PrimarySAXContext *ctx, const char *name)
         if (sctx->package_fn && !*sctx->error)
             sctx->package_fn (p, sctx->user_data);
 
-        package_free (p);
-        sctx->current_package = NULL;
+        /* The package callback stops the parse by setting an error */
+        if (*sctx->error)
+            xmlStopParser (sctx->xml_context);
+
+        sax_context_package_done (sctx);
 
         sctx->want_text = FALSE;
         ctx->state = PRIMARY_PARSER_TOPLEVEL;
@@ -392,9 +507,7 @@ primary_parser_package_end (PrimarySAXContext *ctx, const char *name)
                                              sctx->text_buffer->str,
                                              sctx->text_buffer->len);
     else if (!strcmp (name, "arch"))
-        p->arch = g_string_chunk_insert_len (p->chunk,
-                                             sctx->text_buffer->str,
-                                             sctx->text_buffer->len);
+        p->arch = sax_context_intern (sctx, sctx->text_buffer->str);
     else if (!strcmp (name, "checksum"))
         p->pkgId = g_string_chunk_insert_len (p->chunk,
                                               sctx->text_buffer->str,
@@ -408,9 +521,7 @@ primary_parser_package_end (PrimarySAXContext *ctx, const char *name)
                                                     sctx->text_buffer->str,
                                                     sctx->text_buffer->len);
     else if (!strcmp (name, "packager"))
-        p->rpm_packager = g_string_chunk_insert_len (p->chunk,
-                                                     sctx->text_buffer->str,
-                                                     sctx->text_buffer->len);
+        p->rpm_packager = sax_context_intern (sctx, sctx->text_buffer->str);
     else if (!strcmp (name, "url"))
         p->url = g_string_chunk_insert_len (p->chunk,
                                             sctx->text_buffer->str,
@@ -427,37 +538,26 @@ primary_parser_format_end (PrimarySAXContext *ctx, const char *name)
     g_assert (p != NULL);
 
     if (!strcmp (name, "rpm:license"))
-        p->rpm_license = g_string_chunk_insert_len (p->chunk,
-                                                    sctx->text_buffer->str,
-                                                    sctx->text_buffer->len);
+        p->rpm_license = sax_context_intern (sctx, sctx->text_buffer->str);
     if (!strcmp (name, "rpm:vendor"))
-        p->rpm_vendor = g_string_chunk_insert_len (p->chunk,
-                                                   sctx->text_buffer->str,
-                                                   sctx->text_buffer->len);
+        p->rpm_vendor = sax_context_intern (sctx, sctx->text_buffer->str);
     if (!strcmp (name, "rpm:group"))
-        p->rpm_group = g_string_chunk_insert_len (p->chunk,
-                                                  sctx->text_buffer->str,
-                                                  sctx->text_buffer->len);
+        p->rpm_group = sax_context_intern (sctx, sctx->text_buffer->str);
     if (!strcmp (name, "rpm:buildhost"))
-        p->rpm_buildhost = g_string_chunk_insert_len (p->chunk,
-                                                      sctx->text_buffer->str,
-                                                      sctx->text_buffer->len);
+        p->rpm_buildhost = sax_context_intern (sctx, sctx->text_buffer->str);
     if (!strcmp (name, "rpm:sourcerpm"))
         p->rpm_sourcerpm = g_string_chunk_insert_len (p->chunk,
                                                       sctx->text_buffer->str,
                                                       sctx->text_buffer->len);
     else if (!strcmp (name, "file")) {
-        PackageFile *file = ctx->current_file != NULL ?
-            ctx->current_file : package_file_new ();
-
-        file->name = g_string_chunk_insert_len (p->chunk,
-                                                sctx->text_buffer->str,
-                                                sctx->text_buffer->len);
+        PackageFile *file;
 
-        if (!file->type)
-            file->type = g_string_chunk_insert_const (p->chunk, "file");
+        if (sctx->skip & YUM_XML_SKIP_FILES)
+            return;
 
-        p->files = g_slist_prepend (p->files, file);
+        file = ctx->current_file != NULL ?
+            ctx->current_file : package_file_new ();
+        sax_context_add_file (sctx, file);
         ctx->current_file = NULL;
     } else if (!strcmp (name, "format"))
         ctx->state = PRIMARY_PARSER_PACKAGE;
@@ -528,6 +628,10 @@ sax_error (void *data, const char *msg, ...)
     va_list args;
     char *tmp;
 
+    /* Keep the first error, it is the interesting one */
+    if (*sctx->error)
+        return;
+
     va_start (args, msg);
 
     tmp = g_strdup_vprintf (msg, args);
@@ -570,23 +674,52 @@ sax_context_init (SAXContext *sctx,
                   const char *md_type,
                   CountFn count_callback,
                   PackageFn package_callback,
+                  PackageFn files_callback,
                   gpointer user_data,
                   GError **err)
 {
     sctx->md_type = md_type;
+    sctx->xml_context = NULL;
     sctx->error = err;
     sctx->count_fn = count_callback;
     sctx->package_fn = package_callback;
+    sctx->files_fn = files_callback;
     sctx->user_data = user_data;
     sctx->current_package = NULL;
+    sctx->keep_packages = FALSE;
+    sctx->skip = 0;
+    sctx->files_chunk = g_string_chunk_new (PACKAGE_FILES_CHUNK_SIZE);
+    sctx->n_files = 0;
+    sctx->strings = g_string_chunk_new (PARSE_STRINGS_CHUNK_SIZE);
     sctx->want_text = FALSE;
     sctx->text_buffer = g_string_sized_new (PACKAGE_FIELD_SIZE);
 }
 
+static void
+sax_context_parse (SAXContext *sctx,
+                   xmlSAXHandler *handler,
+                   const char *filename)
+{
+    /* Same as xmlSAXUserParseFile (), but keeps the parser context around
+       so that a callback can stop the parse */
+    sctx->xml_context = xmlCreateFileParserCtxt (filename);
+    if (!sctx->xml_context)
+        return;
+
+    memcpy (sctx->xml_context->sax, handler, sizeof (xmlSAXHandler));
+    sctx->xml_context->userData = sctx;
+
+    xmlParseDocument (sctx->xml_context);
+
+    xmlFreeParserCtxt (sctx->xml_context);
+    sctx->xml_context = NULL;
+}
+
 void
 yum_xml_parse_primary (const char *filename,
                        CountFn count_callback,
                        PackageFn package_callback,
+                       PackageFn files_callback,
                        gpointer user_data,
                        GError **err)
 {
@@ -598,16 +731,18 @@ yum_xml_parse_primary (const char *filename,
     ctx.current_file = NULL;
 
     sax_context_init(sctx, "primary.xml", count_callback, package_callback,
-                     user_data, err);
+                     files_callback, user_data, err);
 
     xmlSubstituteEntitiesDefault (1);
-    xmlSAXUserParseFile (&primary_sax_handler, &ctx, filename);
+    sax_context_parse (sctx, &primary_sax_handler, filename);
 
     if (sctx->current_package) {
         g_warning ("Incomplete package lost");
         package_free (sctx->current_package);
     }
 
+    g_string_chunk_free (sctx->files_chunk);
+    g_string_chunk_free (sctx->strings);
     g_string_free (sctx->text_buffer, TRUE);
 }
 
@@ -615,8 +750,9 @@ yum_xml_parse_primary (const char *filename,
 
 
 static void
-parse_package (const char **attrs, Package *p)
+parse_package (const char **attrs, SAXContext *sctx)
 {
+    Package *p = sctx->current_package;
     int i;
     const char *attr;
     const char *value;
@@ -630,7 +766,7 @@ parse_package (const char **attrs, Package *p)
         if (!strcmp (attr, "name"))
             p->name = g_string_chunk_insert (p->chunk, value);
         else if (!strcmp (attr, "arch"))
-            p->arch = g_string_chunk_insert (p->chunk, value);
+            p->arch = sax_context_intern (sctx, value);
     }
 }
 
@@ -660,7 +796,7 @@ filelist_parser_toplevel_start (FilelistSAXContext *ctx,
         ctx->state = FILELIST_PARSER_PACKAGE;
 
         sctx->current_package = package_new ();
-        parse_package (attrs, sctx->current_package);
+        parse_package (attrs, sctx);
     }
 
     else if (sctx->count_fn && !strcmp (name, "filelists")) {
@@ -710,7 +846,7 @@ filelist_parser_package_start (FilelistSAXContext *ctx,
 
             if (!strcmp (attr, "type"))
                 ctx->current_file->type =
-                    g_string_chunk_insert_const (p->chunk, value);
+                    sax_context_intern (sctx, value);
         }
     }
 }
@@ -751,8 +887,11 @@ filelist_parser_package_end (FilelistSAXContext *ctx, const char *name)
         if (sctx->package_fn && !*sctx->error)
             sctx->package_fn (p, sctx->user_data);
 
-        package_free (p);
-        sctx->current_package = NULL;
+        /* The package callback stops the parse by setting an error */
+        if (*sctx->error)
+            xmlStopParser (sctx->xml_context);
+
+        sax_context_package_done (sctx);
 
         if (ctx->current_file) {
             g_free (ctx->current_file);
@@ -763,14 +902,7 @@ filelist_parser_package_end (FilelistSAXContext *ctx, const char *name)
     }
 
     else if (!strcmp (name, "file")) {
-        PackageFile *file = ctx->current_file;
-        file->name = g_string_chunk_insert_len (p->chunk,
-                                                sctx->text_buffer->str,
-                                                sctx->text_buffer->len);
-        if (!file->type)
-            file->type = g_string_chunk_insert_const (p->chunk, "file");
-
-        p->files = g_slist_prepend (p->files, file);
+        sax_context_add_file (sctx, ctx->current_file);
         ctx->current_file = NULL;
     }
 }
@@ -823,6 +955,7 @@ void
 yum_xml_parse_filelists (const char *filename,
                          CountFn count_callback,
                          PackageFn package_callback,
+                         PackageFn files_callback,
                          gpointer user_data,
                          GError **err)
 {
@@ -833,10 +966,10 @@ yum_xml_parse_filelists (const char *filename,
     ctx.current_file = NULL;
     
     sax_context_init(sctx, "filelists.xml", count_callback, package_callback,
-                     user_data, err);
+                     files_callback, user_data, err);
 
     xmlSubstituteEntitiesDefault (1);
-    xmlSAXUserParseFile (&filelist_sax_handler, &ctx, filename);
+    sax_context_parse (sctx, &filelist_sax_handler, filename);
 
     if (sctx->current_package) {
         g_warning ("Incomplete package lost");
@@ -846,6 +979,8 @@ yum_xml_parse_filelists (const char *filename,
     if (ctx.current_file)
         g_free (ctx.current_file);
 
+    g_string_chunk_free (sctx->files_chunk);
+    g_string_chunk_free (sctx->strings);
     g_string_free (sctx->text_buffer, TRUE);
 }
 
@@ -877,7 +1012,7 @@ other_parser_toplevel_start (OtherSAXContext *ctx,
         ctx->state = OTHER_PARSER_PACKAGE;
 
         sctx->current_package = package_new ();
-        parse_package (attrs, sctx->current_package);
+        parse_package (attrs, sctx);
     }
 
     else if (sctx->count_fn && !strcmp (name, "otherdata")) {
@@ -920,6 +1055,8 @@ other_parser_package_start (OtherSAXContext *ctx,
 
     else if (!strcmp (name, "changelog")) {
         ctx->current_entry = changelog_entry_new ();
+        if (sctx->skip & YUM_XML_SKIP_CHANGELOG_TEXT)
+            sctx->want_text = FALSE;
 
         for (i = 0; attrs && attrs[i]; i++) {
             attr = attrs[i];
@@ -927,7 +1064,7 @@ other_parser_package_start (OtherSAXContext *ctx,
 
             if (!strcmp (attr, "author"))
                 ctx->current_entry->author =
-                    g_string_chunk_insert_const (p->chunk, value);
+                    sax_context_intern (sctx, value);
             else if (!strcmp (attr, "date"))
                 ctx->current_entry->date = strtol(value, NULL, 10);
         }
@@ -974,8 +1111,11 @@ other_parser_package_end (OtherSAXContext *ctx, const char *name)
         if (sctx->package_fn && !*sctx->error)
             sctx->package_fn (p, sctx->user_data);
 
-        package_free (p);
-        sctx->current_package = NULL;
+        /* The package callback stops the parse by setting an error */
+        if (*sctx->error)
+            xmlStopParser (sctx->xml_context);
+
+        sax_context_package_done (sctx);
 
         if (ctx->current_entry) {
             g_free (ctx->current_entry);
@@ -986,10 +1126,11 @@ other_parser_package_end (OtherSAXContext *ctx, const char *name)
     }
 
     else if (!strcmp (name, "changelog")) {
-        ctx->current_entry->changelog =
-            g_string_chunk_insert_len (p->chunk,
-                                       sctx->text_buffer->str,
-                                       sctx->text_buffer->len);
+        if (!(sctx->skip & YUM_XML_SKIP_CHANGELOG_TEXT))
+            ctx->current_entry->changelog =
+                g_string_chunk_insert_len (p->chunk,
+                                           sctx->text_buffer->str,
+                                           sctx->text_buffer->len);
 
         p->changelogs = g_slist_prepend (p->changelogs, ctx->current_entry);
         ctx->current_entry = NULL;
@@ -1044,6 +1185,7 @@ void
 yum_xml_parse_other (const char *filename,
                      CountFn count_callback,
                      PackageFn package_callback,
+                     PackageFn files_callback,
                      gpointer user_data,
                      GError **err)
 {
@@ -1054,10 +1196,10 @@ yum_xml_parse_other (const char *filename,
     ctx.current_entry = NULL;
     
     sax_context_init(sctx, "other.xml", count_callback, package_callback,
-                     user_data, err);
+                     files_callback, user_data, err);
 
     xmlSubstituteEntitiesDefault (1);
-    xmlSAXUserParseFile (&other_sax_handler, &ctx, filename);
+    sax_context_parse (sctx, &other_sax_handler, filename);
 
     if (sctx->current_package) {
         g_warning ("Incomplete package lost");
@@ -1067,5 +1209,1500 @@ yum_xml_parse_other (const char *filename,
     if (ctx.current_entry)
         g_free (ctx.current_entry);
 
+    g_string_chunk_free (sctx->files_chunk);
+    g_string_chunk_free (sctx->strings);
     g_string_free (sctx->text_buffer, TRUE);
 }
+
+/*****************************************************************************/
+
+typedef enum {
+    UPDATEINFO_PARSER_TOPLEVEL = 0,
+    UPDATEINFO_PARSER_UPDATE,
+    UPDATEINFO_PARSER_PKGLIST,
+    UPDATEINFO_PARSER_PACKAGE,
+} UpdateinfoSAXContextState;
+
+typedef struct {
+    SAXContext sctx;
+
+    UpdateinfoSAXContextState state;
+
+    AdvisoryFn advisory_fn;
+    Advisory *current_advisory;
+    AdvisoryPackage *current_package;
+    char *current_collection;
+} UpdateinfoSAXContext;
+
+/* <reboot_suggested/> and <reboot_suggested>True</reboot_suggested> */
+static gboolean
+parse_suggested (const char *text)
+{
+    return *text == '\0' ||
+        (g_ascii_strcasecmp (text, "false") && strcmp (text, "0"));
+}
+
+static void
+updateinfo_parser_toplevel_start (UpdateinfoSAXContext *ctx,
+                                  const char *name,
+                                  const char **attrs)
+{
+    Advisory *a;
+    int i;
+    const char *attr;
+    const char *value;
+
+    if (strcmp (name, "update"))
+        return;
+
+    g_assert (ctx->current_advisory == NULL);
+
+    ctx->state = UPDATEINFO_PARSER_UPDATE;
+    ctx->current_advisory = a = advisory_new ();
+
+    for (i = 0; attrs && attrs[i]; i++) {
+        attr = attrs[i];
+        value = attrs[++i];
+
+        if (!strcmp (attr, "from"))
+            a->issuer = g_string_chunk_insert (a->chunk, value);
+        else if (!strcmp (attr, "status"))
+            a->status = g_string_chunk_insert (a->chunk, value);
+        else if (!strcmp (attr, "type"))
+            a->type = g_string_chunk_insert (a->chunk, value);
+        else if (!strcmp (attr, "version"))
+            a->version = g_string_chunk_insert (a->chunk, value);
+    }
+}
+
+static void
+updateinfo_parser_update_start (UpdateinfoSAXContext *ctx,
+                                const char *name,
+                                const char **attrs)
+{
+    SAXContext *sctx = &ctx->sctx;
+    Advisory *a = ctx->current_advisory;
+    int i;
+    const char *attr;
+    const char *value;
+
+    g_assert (a != NULL);
+
+    sctx->want_text = TRUE;
+
+    if (!strcmp (name, "issued") || !strcmp (name, "updated")) {
+        for (i = 0; attrs && attrs[i]; i++) {
+            attr = attrs[i];
+            value = attrs[++i];
+
+            if (strcmp (attr, "date"))
+                continue;
+
+            if (!strcmp (name, "issued"))
+                a->issued = g_string_chunk_insert (a->chunk, value);
+            else
+                a->updated = g_string_chunk_insert (a->chunk, value);
+        }
+    }
+
+    else if (!strcmp (name, "reference")) {
+        AdvisoryReference *reference = advisory_reference_new ();
+
+        for (i = 0; attrs && attrs[i]; i++) {
+            attr = attrs[i];
+            value = attrs[++i];
+
+            if (!strcmp (attr, "type"))
+                reference->type = g_string_chunk_insert (a->chunk, value);
+            else if (!strcmp (attr, "id"))
+                reference->id = g_string_chunk_insert (a->chunk, value);
+            else if (!strcmp (attr, "href"))
+                reference->href = g_string_chunk_insert (a->chunk, value);
+            else if (!strcmp (attr, "title"))
+                reference->title = g_string_chunk_insert (a->chunk, value);
+        }
+
+        a->references = g_slist_prepend (a->references, reference);
+    }
+
+    else if (!strcmp (name, "pkglist")) {
+        ctx->state = UPDATEINFO_PARSER_PKGLIST;
+        sctx->want_text = FALSE;
+    }
+}
+
+static void
+updateinfo_parser_pkglist_start (UpdateinfoSAXContext *ctx,
+                                 const char *name,
+                                 const char **attrs)
+{
+    SAXContext *sctx = &ctx->sctx;
+    Advisory *a = ctx->current_advisory;
+    AdvisoryPackage *package;
+    int i;
+    const char *attr;
+    const char *value;
+
+    if (!strcmp (name, "collection")) {
+        for (i = 0; attrs && attrs[i]; i++) {
+            attr = attrs[i];
+            value = attrs[++i];
+
+            if (!strcmp (attr, "short"))
+                ctx->current_collection =
+                    g_string_chunk_insert (a->chunk, value);
+        }
+    }
+
+    else if (!strcmp (name, "package")) {
+        ctx->state = UPDATEINFO_PARSER_PACKAGE;
+        ctx->current_package = package = advisory_package_new ();
+        package->collection = ctx->current_collection;
+
+        for (i = 0; attrs && attrs[i]; i++) {
+            attr = attrs[i];
+            value = attrs[++i];
+
+            if (!strcmp (attr, "name"))
+                package->name = g_string_chunk_insert (a->chunk, value);
+            else if (!strcmp (attr, "epoch"))
+                package->epoch = g_string_chunk_insert (a->chunk, value);
+            else if (!strcmp (attr, "version"))
+                package->version = g_string_chunk_insert (a->chunk, value);
+            else if (!strcmp (attr, "release"))
+                package->release = g_string_chunk_insert (a->chunk, value);
+            else if (!strcmp (attr, "arch"))
+                package->arch = sax_context_intern (sctx, value);
+            else if (!strcmp (attr, "src"))
+                package->src = g_string_chunk_insert (a->chunk, value);
+        }
+    }
+}
+
+static void
+updateinfo_parser_package_start (UpdateinfoSAXContext *ctx,
+                                 const char *name,
+                                 const char **attrs)
+{
+    SAXContext *sctx = &ctx->sctx;
+    int i;
+    const char *attr;
+    const char *value;
+
+    g_assert (ctx->current_package != NULL);
+
+    sctx->want_text = TRUE;
+
+    if (!strcmp (name, "sum")) {
+        for (i = 0; attrs && attrs[i]; i++) {
+            attr = attrs[i];
+            value = attrs[++i];
+
+            if (!strcmp (attr, "type"))
+                ctx->current_package->sum_type =
+                    g_string_chunk_insert (ctx->current_advisory->chunk,
+                                           value);
+        }
+    }
+}
+
+static void
+updateinfo_sax_start_element (void *data, const char *name, const char **attrs)
+{
+    UpdateinfoSAXContext *ctx = (UpdateinfoSAXContext *) data;
+    SAXContext *sctx = &ctx->sctx;
+
+    if (sctx->text_buffer->len)
+        g_string_truncate (sctx->text_buffer, 0);
+
+    switch (ctx->state) {
+    case UPDATEINFO_PARSER_TOPLEVEL:
+        updateinfo_parser_toplevel_start (ctx, name, attrs);
+        break;
+    case UPDATEINFO_PARSER_UPDATE:
+        updateinfo_parser_update_start (ctx, name, attrs);
+        break;
+    case UPDATEINFO_PARSER_PKGLIST:
+        updateinfo_parser_pkglist_start (ctx, name, attrs);
+        break;
+    case UPDATEINFO_PARSER_PACKAGE:
+        updateinfo_parser_package_start (ctx, name, attrs);
+        break;
+    default:
+        break;
+    }
+}
+
+static void
+updateinfo_parser_update_end (UpdateinfoSAXContext *ctx, const char *name)
+{
+    SAXContext *sctx = &ctx->sctx;
+    Advisory *a = ctx->current_advisory;
+
+    g_assert (a != NULL);
+
+    if (!strcmp (name, "update")) {
+        a->references = g_slist_reverse (a->references);
+        a->packages = g_slist_reverse (a->packages);
+
+        if (ctx->advisory_fn && !*sctx->error)
+            ctx->advisory_fn (a, sctx->user_data);
+
+        /* The advisory callback stops the parse by setting an error */
+        if (*sctx->error)
+            xmlStopParser (sctx->xml_context);
+
+        advisory_free (a);
+        ctx->current_advisory = NULL;
+
+        sctx->want_text = FALSE;
+        ctx->state = UPDATEINFO_PARSER_TOPLEVEL;
+    }
+
+    else if (sctx->text_buffer->len == 0)
+        /* Nothing interesting to do here */
+        return;
+
+    else if (!strcmp (name, "id"))
+        a->id = g_string_chunk_insert_len (a->chunk,
+                                           sctx->text_buffer->str,
+                                           sctx->text_buffer->len);
+    else if (!strcmp (name, "title"))
+        a->title = g_string_chunk_insert_len (a->chunk,
+                                              sctx->text_buffer->str,
+                                              sctx->text_buffer->len);
+    else if (!strcmp (name, "summary"))
+        a->summary = g_string_chunk_insert_len (a->chunk,
+                                                sctx->text_buffer->str,
+                                                sctx->text_buffer->len);
+    else if (!strcmp (name, "description"))
+        a->description = g_string_chunk_insert_len (a->chunk,
+                                                    sctx->text_buffer->str,
+                                                    sctx->text_buffer->len);
+    else if (!strcmp (name, "solution"))
+        a->solution = g_string_chunk_insert_len (a->chunk,
+                                                 sctx->text_buffer->str,
+                                                 sctx->text_buffer->len);
+    else if (!strcmp (name, "pushcount"))
+        a->pushcount = g_string_chunk_insert_len (a->chunk,
+                                                  sctx->text_buffer->str,
+                                                  sctx->text_buffer->len);
+    else if (!strcmp (name, "severity"))
+        a->severity = g_string_chunk_insert_len (a->chunk,
+                                                 sctx->text_buffer->str,
+                                                 sctx->text_buffer->len);
+    else if (!strcmp (name, "release"))
+        a->release = g_string_chunk_insert_len (a->chunk,
+                                                sctx->text_buffer->str,
+                                                sctx->text_buffer->len);
+    else if (!strcmp (name, "rights"))
+        a->rights = g_string_chunk_insert_len (a->chunk,
+                                               sctx->text_buffer->str,
+                                               sctx->text_buffer->len);
+}
+
+static void
+updateinfo_parser_pkglist_end (UpdateinfoSAXContext *ctx, const char *name)
+{
+    if (!strcmp (name, "collection"))
+        ctx->current_collection = NULL;
+    else if (!strcmp (name, "pkglist"))
+        ctx->state = UPDATEINFO_PARSER_UPDATE;
+}
+
+static void
+updateinfo_parser_package_end (UpdateinfoSAXContext *ctx, const char *name)
+{
+    SAXContext *sctx = &ctx->sctx;
+    Advisory *a = ctx->current_advisory;
+    AdvisoryPackage *package = ctx->current_package;
+    const char *text = sctx->text_buffer->str;
+
+    g_assert (package != NULL);
+
+    if (!strcmp (name, "package")) {
+        a->packages = g_slist_prepend (a->packages, package);
+        ctx->current_package = NULL;
+
+        sctx->want_text = FALSE;
+        ctx->state = UPDATEINFO_PARSER_PKGLIST;
+    }
+
+    else if (!strcmp (name, "filename"))
+        package->filename = g_string_chunk_insert_len (a->chunk, text,
+                                                       sctx->text_buffer->len);
+    else if (!strcmp (name, "sum"))
+        package->sum = g_string_chunk_insert_len (a->chunk, text,
+                                                  sctx->text_buffer->len);
+    else if (!strcmp (name, "reboot_suggested"))
+        package->reboot_suggested = parse_suggested (text);
+    else if (!strcmp (name, "restart_suggested"))
+        package->restart_suggested = parse_suggested (text);
+    else if (!strcmp (name, "relogin_suggested"))
+        package->relogin_suggested = parse_suggested (text);
+}
+
+static void
+updateinfo_sax_end_element (void *data, const char *name)
+{
+    UpdateinfoSAXContext *ctx = (UpdateinfoSAXContext *) data;
+    SAXContext *sctx = &ctx->sctx;
+
+    switch (ctx->state) {
+    case UPDATEINFO_PARSER_UPDATE:
+        updateinfo_parser_update_end (ctx, name);
+        break;
+    case UPDATEINFO_PARSER_PKGLIST:
+        updateinfo_parser_pkglist_end (ctx, name);
+        break;
+    case UPDATEINFO_PARSER_PACKAGE:
+        updateinfo_parser_package_end (ctx, name);
+        break;
+    default:
+        break;
+    }
+
+    g_string_truncate (sctx->text_buffer, 0);
+}
+
+static xmlSAXHandler updateinfo_sax_handler = {
+    NULL,      /* internalSubset */
+    NULL,      /* isStandalone */
+    NULL,      /* hasInternalSubset */
+    NULL,      /* hasExternalSubset */
+    NULL,      /* resolveEntity */
+    NULL,      /* getEntity */
+    NULL,      /* entityDecl */
+    NULL,      /* notationDecl */
+    NULL,      /* attributeDecl */
+    NULL,      /* elementDecl */
+    NULL,      /* unparsedEntityDecl */
+    NULL,      /* setDocumentLocator */
+    NULL,      /* startDocument */
+    NULL,      /* endDocument */
+    (startElementSAXFunc) updateinfo_sax_start_element, /* startElement */
+    (endElementSAXFunc) updateinfo_sax_end_element,     /* endElement */
+    NULL,      /* reference */
+    (charactersSAXFunc) sax_characters,      /* characters */
+    NULL,      /* ignorableWhitespace */
+    NULL,      /* processingInstruction */
+    NULL,      /* comment */
+    sax_warning,      /* warning */
+    sax_error,      /* error */
+    sax_error,      /* fatalError */
+};
+
+void
+yum_xml_parse_updateinfo (const char *filename,
+                          CountFn count_callback,
+                          AdvisoryFn advisory_callback,
+                          gpointer user_data,
+                          GError **err)
+{
+    UpdateinfoSAXContext ctx;
+    SAXContext *sctx = &ctx.sctx;
+
+    ctx.state = UPDATEINFO_PARSER_TOPLEVEL;
+    ctx.advisory_fn = advisory_callback;
+    ctx.current_advisory = NULL;
+    ctx.current_package = NULL;
+    ctx.current_collection = NULL;
+
+    sax_context_init(sctx, "updateinfo.xml", count_callback, NULL, NULL,
+                     user_data, err);
+
+    xmlSubstituteEntitiesDefault (1);
+    sax_context_parse (sctx, &updateinfo_sax_handler, filename);
+
+    if (ctx.current_advisory) {
+        g_warning ("Incomplete advisory lost");
+        advisory_free (ctx.current_advisory);
+    }
+
+    if (ctx.current_package)
+        g_free (ctx.current_package);
+
+    g_string_chunk_free (sctx->files_chunk);
+    g_string_chunk_free (sctx->strings);
+    g_string_free (sctx->text_buffer, TRUE);
+}
+
+/*****************************************************************************/
+
+typedef enum {
+    DELTA_PARSER_TOPLEVEL = 0,
+    DELTA_PARSER_NEWPACKAGE,
+    DELTA_PARSER_DELTA,
+} DeltaSAXContextState;
+
+typedef struct {
+    SAXContext sctx;
+
+    DeltaSAXContextState state;
+
+    DeltaPackageFn package_fn;
+    DeltaPackage *current_package;
+    DeltaRpm *current_delta;
+} DeltaSAXContext;
+
+static void
+delta_parser_toplevel_start (DeltaSAXContext *ctx,
+                             const char *name,
+                             const char **attrs)
+{
+    SAXContext *sctx = &ctx->sctx;
+    DeltaPackage *p;
+    int i;
+    const char *attr;
+    const char *value;
+
+    if (strcmp (name, "newpackage"))
+        return;
+
+    g_assert (ctx->current_package == NULL);
+
+    ctx->state = DELTA_PARSER_NEWPACKAGE;
+    ctx->current_package = p = delta_package_new ();
+
+    for (i = 0; attrs && attrs[i]; i++) {
+        attr = attrs[i];
+        value = attrs[++i];
+
+        if (!strcmp (attr, "name"))
+            p->name = g_string_chunk_insert (p->chunk, value);
+        else if (!strcmp (attr, "arch"))
+            p->arch = sax_context_intern (sctx, value);
+        else if (!strcmp (attr, "epoch"))
+            p->epoch = g_string_chunk_insert (p->chunk, value);
+        else if (!strcmp (attr, "version"))
+            p->version = g_string_chunk_insert (p->chunk, value);
+        else if (!strcmp (attr, "release"))
+            p->release = g_string_chunk_insert (p->chunk, value);
+    }
+}
+
+static void
+delta_parser_newpackage_start (DeltaSAXContext *ctx,
+                               const char *name,
+                               const char **attrs)
+{
+    DeltaRpm *delta;
+    int i;
+    const char *attr;
+    const char *value;
+
+    g_assert (ctx->current_package != NULL);
+
+    if (strcmp (name, "delta"))
+        return;
+
+    ctx->state = DELTA_PARSER_DELTA;
+    ctx->current_delta = delta = delta_rpm_new ();
+
+    for (i = 0; attrs && attrs[i]; i++) {
+        attr = attrs[i];
+        value = attrs[++i];
+
+        if (!strcmp (attr, "oldepoch"))
+            delta->oldepoch =
+                g_string_chunk_insert (ctx->current_package->chunk, value);
+        else if (!strcmp (attr, "oldversion"))
+            delta->oldversion =
+                g_string_chunk_insert (ctx->current_package->chunk, value);
+        else if (!strcmp (attr, "oldrelease"))
+            delta->oldrelease =
+                g_string_chunk_insert (ctx->current_package->chunk, value);
+    }
+}
+
+static void
+delta_parser_delta_start (DeltaSAXContext *ctx,
+                          const char *name,
+                          const char **attrs)
+{
+    SAXContext *sctx = &ctx->sctx;
+    int i;
+    const char *attr;
+    const char *value;
+
+    g_assert (ctx->current_delta != NULL);
+
+    sctx->want_text = TRUE;
+
+    if (!strcmp (name, "checksum")) {
+        for (i = 0; attrs && attrs[i]; i++) {
+            attr = attrs[i];
+            value = attrs[++i];
+
+            if (!strcmp (attr, "type"))
+                ctx->current_delta->checksum_type =
+                    g_string_chunk_insert (ctx->current_package->chunk, value);
+        }
+    }
+}
+
+static void
+delta_sax_start_element (void *data, const char *name, const char **attrs)
+{
+    DeltaSAXContext *ctx = (DeltaSAXContext *) data;
+    SAXContext *sctx = &ctx->sctx;
+
+    if (sctx->text_buffer->len)
+        g_string_truncate (sctx->text_buffer, 0);
+
+    switch (ctx->state) {
+    case DELTA_PARSER_TOPLEVEL:
+        delta_parser_toplevel_start (ctx, name, attrs);
+        break;
+    case DELTA_PARSER_NEWPACKAGE:
+        delta_parser_newpackage_start (ctx, name, attrs);
+        break;
+    case DELTA_PARSER_DELTA:
+        delta_parser_delta_start (ctx, name, attrs);
+        break;
+    default:
+        break;
+    }
+}
+
+static void
+delta_parser_newpackage_end (DeltaSAXContext *ctx, const char *name)
+{
+    SAXContext *sctx = &ctx->sctx;
+    DeltaPackage *p = ctx->current_package;
+
+    g_assert (p != NULL);
+
+    if (strcmp (name, "newpackage"))
+        return;
+
+    p->deltas = g_slist_reverse (p->deltas);
+
+    if (ctx->package_fn && !*sctx->error)
+        ctx->package_fn (p, sctx->user_data);
+
+    /* The package callback stops the parse by setting an error */
+    if (*sctx->error)
+        xmlStopParser (sctx->xml_context);
+
+    delta_package_free (p);
+    ctx->current_package = NULL;
+
+    ctx->state = DELTA_PARSER_TOPLEVEL;
+}
+
+static void
+delta_parser_delta_end (DeltaSAXContext *ctx, const char *name)
+{
+    SAXContext *sctx = &ctx->sctx;
+    DeltaPackage *p = ctx->current_package;
+    DeltaRpm *delta = ctx->current_delta;
+
+    g_assert (delta != NULL);
+
+    if (!strcmp (name, "delta")) {
+        p->deltas = g_slist_prepend (p->deltas, delta);
+        ctx->current_delta = NULL;
+
+        sctx->want_text = FALSE;
+        ctx->state = DELTA_PARSER_NEWPACKAGE;
+    }
+
+    else if (sctx->text_buffer->len == 0)
+        /* Nothing interesting to do here */
+        return;
+
+    else if (!strcmp (name, "filename"))
+        delta->filename = g_string_chunk_insert_len (p->chunk,
+                                                     sctx->text_buffer->str,
+                                                     sctx->text_buffer->len);
+    else if (!strcmp (name, "sequence"))
+        delta->sequence = g_string_chunk_insert_len (p->chunk,
+                                                     sctx->text_buffer->str,
+                                                     sctx->text_buffer->len);
+    else if (!strcmp (name, "checksum"))
+        delta->checksum = g_string_chunk_insert_len (p->chunk,
+                                                     sctx->text_buffer->str,
+                                                     sctx->text_buffer->len);
+    else if (!strcmp (name, "size"))
+        delta->size = strtoll (sctx->text_buffer->str, NULL, 10);
+}
+
+static void
+delta_sax_end_element (void *data, const char *name)
+{
+    DeltaSAXContext *ctx = (DeltaSAXContext *) data;
+    SAXContext *sctx = &ctx->sctx;
+
+    switch (ctx->state) {
+    case DELTA_PARSER_NEWPACKAGE:
+        delta_parser_newpackage_end (ctx, name);
+        break;
+    case DELTA_PARSER_DELTA:
+        delta_parser_delta_end (ctx, name);
+        break;
+    default:
+        break;
+    }
+
+    g_string_truncate (sctx->text_buffer, 0);
+}
+
+static xmlSAXHandler delta_sax_handler = {
+    NULL,      /* internalSubset */
+    NULL,      /* isStandalone */
+    NULL,      /* hasInternalSubset */
+    NULL,      /* hasExternalSubset */
+    NULL,      /* resolveEntity */
+    NULL,      /* getEntity */
+    NULL,      /* entityDecl */
+    NULL,      /* notationDecl */
+    NULL,      /* attributeDecl */
+    NULL,      /* elementDecl */
+    NULL,      /* unparsedEntityDecl */
+    NULL,      /* setDocumentLocator */
+    NULL,      /* startDocument */
+    NULL,      /* endDocument */
+    (startElementSAXFunc) delta_sax_start_element, /* startElement */
+    (endElementSAXFunc) delta_sax_end_element,     /* endElement */
+    NULL,      /* reference */
+    (charactersSAXFunc) sax_characters,      /* characters */
+    NULL,      /* ignorableWhitespace */
+    NULL,      /* processingInstruction */
+    NULL,      /* comment */
+    sax_warning,      /* warning */
+    sax_error,      /* error */
+    sax_error,      /* fatalError */
+};
+
+void
+yum_xml_parse_prestodelta (const char *filename,
+                           CountFn count_callback,
+                           DeltaPackageFn package_callback,
+                           gpointer user_data,
+                           GError **err)
+{
+    DeltaSAXContext ctx;
+    SAXContext *sctx = &ctx.sctx;
+
+    ctx.state = DELTA_PARSER_TOPLEVEL;
+    ctx.package_fn = package_callback;
+    ctx.current_package = NULL;
+    ctx.current_delta = NULL;
+
+    sax_context_init(sctx, "prestodelta.xml", count_callback, NULL, NULL,
+                     user_data, err);
+
+    xmlSubstituteEntitiesDefault (1);
+    sax_context_parse (sctx, &delta_sax_handler, filename);
+
+    if (ctx.current_package) {
+        g_warning ("Incomplete package lost");
+        delta_package_free (ctx.current_package);
+    }
+
+    if (ctx.current_delta)
+        g_free (ctx.current_delta);
+
+    g_string_chunk_free (sctx->files_chunk);
+    g_string_chunk_free (sctx->strings);
+    g_string_free (sctx->text_buffer, TRUE);
+}
+
+/*****************************************************************************/
+
+typedef enum {
+    COMPS_PARSER_TOPLEVEL = 0,
+    COMPS_PARSER_ENTRY,
+    COMPS_PARSER_PACKAGELIST,
+    COMPS_PARSER_GROUPLIST,
+} CompsSAXContextState;
+
+typedef struct {
+    SAXContext sctx;
+
+    CompsSAXContextState state;
+
+    CompsEntryFn entry_fn;
+    CompsEntry *current_entry;
+    CompsPackageReq *current_req;
+    CompsGroupId *current_group;
+    /* xml:lang of the name or description being read */
+    char *current_lang;
+    /* Reading an environment's optionlist */
+    gboolean optional;
+} CompsSAXContext;
+
+static gboolean
+parse_comps_boolean (const char *text)
+{
+    return !g_ascii_strcasecmp (text, "true") ||
+        !g_ascii_strcasecmp (text, "yes");
+}
+
+static const char *
+comps_kind_element (CompsKind kind)
+{
+    if (kind == COMPS_CATEGORY)
+        return "category";
+    else if (kind == COMPS_ENVIRONMENT)
+        return "environment";
+    else
+        return "group";
+}
+
+/* Translations of an entry are few, a list is good enough */
+static CompsTranslation *
+comps_entry_translation (CompsEntry *entry, const char *lang)
+{
+    CompsTranslation *translation;
+    GSList *iter;
+
+    for (iter = entry->translations; iter; iter = iter->next) {
+        translation = (CompsTranslation *) iter->data;
+        if (translation->lang == lang)
+            return translation;
+    }
+
+    translation = comps_translation_new ();
+    translation->lang = (char *) lang;
+    entry->translations = g_slist_prepend (entry->translations, translation);
+
+    return translation;
+}
+
+static void
+comps_parser_toplevel_start (CompsSAXContext *ctx,
+                             const char *name,
+                             const char **attrs)
+{
+    CompsKind kind;
+
+    if (!strcmp (name, "group"))
+        kind = COMPS_GROUP;
+    else if (!strcmp (name, "category"))
+        kind = COMPS_CATEGORY;
+    else if (!strcmp (name, "environment"))
+        kind = COMPS_ENVIRONMENT;
+    else
+        return;
+
+    g_assert (ctx->current_entry == NULL);
+
+    ctx->state = COMPS_PARSER_ENTRY;
+    ctx->current_entry = comps_entry_new (kind);
+}
+
+static void
+comps_parser_entry_start (CompsSAXContext *ctx,
+                          const char *name,
+                          const char **attrs)
+{
+    SAXContext *sctx = &ctx->sctx;
+    CompsEntry *entry = ctx->current_entry;
+    int i;
+    const char *attr;
+    const char *value;
+
+    g_assert (entry != NULL);
+
+    if (!strcmp (name, "packagelist")) {
+        if (entry->kind == COMPS_GROUP)
+            ctx->state = COMPS_PARSER_PACKAGELIST;
+        return;
+    }
+
+    if (!strcmp (name, "grouplist") || !strcmp (name, "optionlist")) {
+        if (entry->kind != COMPS_GROUP) {
+            ctx->state = COMPS_PARSER_GROUPLIST;
+            ctx->optional = !strcmp (name, "optionlist");
+        }
+        return;
+    }
+
+    sctx->want_text = TRUE;
+    ctx->current_lang = NULL;
+
+    if (!strcmp (name, "name") || !strcmp (name, "description")) {
+        for (i = 0; attrs && attrs[i]; i++) {
+            attr = attrs[i];
+            value = attrs[++i];
+
+            if (!strcmp (attr, "xml:lang"))
+                ctx->current_lang =
+                    g_string_chunk_insert_const (entry->chunk, value);
+        }
+    }
+}
+
+static void
+comps_parser_packagelist_start (CompsSAXContext *ctx,
+                                const char *name,
+                                const char **attrs)
+{
+    SAXContext *sctx = &ctx->sctx;
+    CompsPackageReq *req;
+    int i;
+    const char *attr;
+    const char *value;
+
+    if (strcmp (name, "packagereq"))
+        return;
+
+    g_assert (ctx->current_req == NULL);
+
+    sctx->want_text = TRUE;
+    ctx->current_req = req = comps_package_req_new ();
+
+    for (i = 0; attrs && attrs[i]; i++) {
+        attr = attrs[i];
+        value = attrs[++i];
+
+        if (!strcmp (attr, "type"))
+            req->type = g_string_chunk_insert_const (ctx->current_entry->chunk,
+                                                     value);
+        else if (!strcmp (attr, "requires"))
+            req->requires = g_string_chunk_insert (ctx->current_entry->chunk,
+                                                   value);
+        else if (!strcmp (attr, "basearchonly"))
+            req->basearchonly = parse_comps_boolean (value);
+    }
+
+    if (!req->type)
+        req->type = g_string_chunk_insert_const (ctx->current_entry->chunk,
+                                                 "mandatory");
+}
+
+static void
+comps_parser_grouplist_start (CompsSAXContext *ctx,
+                              const char *name,
+                              const char **attrs)
+{
+    SAXContext *sctx = &ctx->sctx;
+    CompsGroupId *group;
+    int i;
+    const char *attr;
+    const char *value;
+
+    if (strcmp (name, "groupid"))
+        return;
+
+    g_assert (ctx->current_group == NULL);
+
+    sctx->want_text = TRUE;
+    ctx->current_group = group = comps_group_id_new ();
+    group->optional = ctx->optional;
+
+    for (i = 0; attrs && attrs[i]; i++) {
+        attr = attrs[i];
+        value = attrs[++i];
+
+        if (!strcmp (attr, "default"))
+            group->is_default = parse_comps_boolean (value);
+    }
+}
+
+static void
+comps_sax_start_element (void *data, const char *name, const char **attrs)
+{
+    CompsSAXContext *ctx = (CompsSAXContext *) data;
+    SAXContext *sctx = &ctx->sctx;
+
+    if (sctx->text_buffer->len)
+        g_string_truncate (sctx->text_buffer, 0);
+
+    switch (ctx->state) {
+    case COMPS_PARSER_TOPLEVEL:
+        comps_parser_toplevel_start (ctx, name, attrs);
+        break;
+    case COMPS_PARSER_ENTRY:
+        comps_parser_entry_start (ctx, name, attrs);
+        break;
+    case COMPS_PARSER_PACKAGELIST:
+        comps_parser_packagelist_start (ctx, name, attrs);
+        break;
+    case COMPS_PARSER_GROUPLIST:
+        comps_parser_grouplist_start (ctx, name, attrs);
+        break;
+    default:
+        break;
+    }
+}
+
+static void
+comps_parser_entry_end (CompsSAXContext *ctx, const char *name)
+{
+    SAXContext *sctx = &ctx->sctx;
+    CompsEntry *entry = ctx->current_entry;
+    CompsTranslation *translation;
+    char *text;
+
+    g_assert (entry != NULL);
+
+    sctx->want_text = FALSE;
+
+    if (!strcmp (name, comps_kind_element (entry->kind))) {
+        entry->translations = g_slist_reverse (entry->translations);
+        entry->packages = g_slist_reverse (entry->packages);
+        entry->groups = g_slist_reverse (entry->groups);
+
+        if (ctx->entry_fn && !*sctx->error)
+            ctx->entry_fn (entry, sctx->user_data);
+
+        /* The entry callback stops the parse by setting an error */
+        if (*sctx->error)
+            xmlStopParser (sctx->xml_context);
+
+        comps_entry_free (entry);
+        ctx->current_entry = NULL;
+
+        ctx->state = COMPS_PARSER_TOPLEVEL;
+        return;
+    }
+
+    if (sctx->text_buffer->len == 0)
+        /* Nothing interesting to do here */
+        return;
+
+    if (!strcmp (name, "name") || !strcmp (name, "description")) {
+        text = g_string_chunk_insert_len (entry->chunk,
+                                          sctx->text_buffer->str,
+                                          sctx->text_buffer->len);
+
+        if (!ctx->current_lang) {
+            if (name[0] == 'n')
+                entry->name = text;
+            else
+                entry->description = text;
+            return;
+        }
+
+        translation = comps_entry_translation (entry, ctx->current_lang);
+        if (name[0] == 'n')
+            translation->name = text;
+        else
+            translation->description = text;
+    }
+
+    else if (!strcmp (name, "id"))
+        entry->id = g_string_chunk_insert_len (entry->chunk,
+                                               sctx->text_buffer->str,
+                                               sctx->text_buffer->len);
+    else if (!strcmp (name, "display_order"))
+        entry->display_order = g_string_chunk_insert_len (entry->chunk,
+                                                          sctx->text_buffer->str,
+                                                          sctx->text_buffer->len);
+    else if (!strcmp (name, "langonly"))
+        entry->langonly = g_string_chunk_insert_len (entry->chunk,
+                                                     sctx->text_buffer->str,
+                                                     sctx->text_buffer->len);
+    else if (!strcmp (name, "default"))
+        entry->is_default = parse_comps_boolean (sctx->text_buffer->str);
+    else if (!strcmp (name, "uservisible"))
+        entry->uservisible = parse_comps_boolean (sctx->text_buffer->str);
+}
+
+static void
+comps_parser_packagelist_end (CompsSAXContext *ctx, const char *name)
+{
+    SAXContext *sctx = &ctx->sctx;
+    CompsEntry *entry = ctx->current_entry;
+    CompsPackageReq *req = ctx->current_req;
+
+    if (!strcmp (name, "packagelist")) {
+        ctx->state = COMPS_PARSER_ENTRY;
+        return;
+    }
+
+    if (strcmp (name, "packagereq") || !req)
+        return;
+
+    sctx->want_text = FALSE;
+    ctx->current_req = NULL;
+
+    if (sctx->text_buffer->len == 0) {
+        g_free (req);
+        return;
+    }
+
+    req->name = g_string_chunk_insert_len (entry->chunk,
+                                           sctx->text_buffer->str,
+                                           sctx->text_buffer->len);
+    entry->packages = g_slist_prepend (entry->packages, req);
+}
+
+static void
+comps_parser_grouplist_end (CompsSAXContext *ctx, const char *name)
+{
+    SAXContext *sctx = &ctx->sctx;
+    CompsEntry *entry = ctx->current_entry;
+    CompsGroupId *group = ctx->current_group;
+
+    if (!strcmp (name, "grouplist") || !strcmp (name, "optionlist")) {
+        ctx->state = COMPS_PARSER_ENTRY;
+        return;
+    }
+
+    if (strcmp (name, "groupid") || !group)
+        return;
+
+    sctx->want_text = FALSE;
+    ctx->current_group = NULL;
+
+    if (sctx->text_buffer->len == 0) {
+        g_free (group);
+        return;
+    }
+
+    group->id = g_string_chunk_insert_len (entry->chunk,
+                                           sctx->text_buffer->str,
+                                           sctx->text_buffer->len);
+    entry->groups = g_slist_prepend (entry->groups, group);
+}
+
+static void
+comps_sax_end_element (void *data, const char *name)
+{
+    CompsSAXContext *ctx = (CompsSAXContext *) data;
+    SAXContext *sctx = &ctx->sctx;
+
+    switch (ctx->state) {
+    case COMPS_PARSER_ENTRY:
+        comps_parser_entry_end (ctx, name);
+        break;
+    case COMPS_PARSER_PACKAGELIST:
+        comps_parser_packagelist_end (ctx, name);
+        break;
+    case COMPS_PARSER_GROUPLIST:
+        comps_parser_grouplist_end (ctx, name);
+        break;
+    default:
+        break;
+    }
+
+    g_string_truncate (sctx->text_buffer, 0);
+}
+
+static xmlSAXHandler comps_sax_handler = {
+    NULL,      /* internalSubset */
+    NULL,      /* isStandalone */
+    NULL,      /* hasInternalSubset */
+    NULL,      /* hasExternalSubset */
+    NULL,      /* resolveEntity */
+    NULL,      /* getEntity */
+    NULL,      /* entityDecl */
+    NULL,      /* notationDecl */
+    NULL,      /* attributeDecl */
+    NULL,      /* elementDecl */
+    NULL,      /* unparsedEntityDecl */
+    NULL,      /* setDocumentLocator */
+    NULL,      /* startDocument */
+    NULL,      /* endDocument */
+    (startElementSAXFunc) comps_sax_start_element, /* startElement */
+    (endElementSAXFunc) comps_sax_end_element,     /* endElement */
+    NULL,      /* reference */
+    (charactersSAXFunc) sax_characters,      /* characters */
+    NULL,      /* ignorableWhitespace */
+    NULL,      /* processingInstruction */
+    NULL,      /* comment */
+    sax_warning,      /* warning */
+    sax_error,      /* error */
+    sax_error,      /* fatalError */
+};
+
+void
+yum_xml_parse_comps (const char *filename,
+                     CountFn count_callback,
+                     CompsEntryFn entry_callback,
+                     gpointer user_data,
+                     GError **err)
+{
+    CompsSAXContext ctx;
+    SAXContext *sctx = &ctx.sctx;
+
+    ctx.state = COMPS_PARSER_TOPLEVEL;
+    ctx.entry_fn = entry_callback;
+    ctx.current_entry = NULL;
+    ctx.current_req = NULL;
+    ctx.current_group = NULL;
+    ctx.current_lang = NULL;
+    ctx.optional = FALSE;
+
+    sax_context_init(sctx, "comps.xml", count_callback, NULL, NULL,
+                     user_data, err);
+
+    xmlSubstituteEntitiesDefault (1);
+    sax_context_parse (sctx, &comps_sax_handler, filename);
+
+    if (ctx.current_entry) {
+        g_warning ("Incomplete comps entry lost");
+        comps_entry_free (ctx.current_entry);
+    }
+
+    if (ctx.current_req)
+        g_free (ctx.current_req);
+    if (ctx.current_group)
+        g_free (ctx.current_group);
+
+    g_string_chunk_free (sctx->files_chunk);
+    g_string_chunk_free (sctx->strings);
+    g_string_free (sctx->text_buffer, TRUE);
+}
+
+/*****************************************************************************/
+
+typedef enum {
+    XML_PARSER_PRIMARY = 0,
+    XML_PARSER_FILELISTS,
+    XML_PARSER_OTHER,
+} XmlParserType;
+
+struct _YumXmlParser {
+    /* All start with a SAXContext */
+    union {
+        SAXContext sctx;
+        PrimarySAXContext primary;
+        FilelistSAXContext filelists;
+        OtherSAXContext other;
+    } ctx;
+    XmlParserType type;
+
+    /* Fed data, gzip compressed if it starts with the gzip magic */
+    guchar magic[2];
+    guint n_magic;
+    gboolean sniffed;
+    z_stream strm;
+    gboolean strm_init;
+    gboolean stream_end;
+
+    /* Reading a file for yum_xml_parser_next () */
+    YumGzipReader *reader;
+    GQueue packages;
+    gboolean done;
+};
+
+static YumXmlParser *
+xml_parser_new (XmlParserType type,
+                CountFn count_callback,
+                PackageFn package_callback,
+                PackageFn files_callback,
+                gpointer user_data,
+                GError **err)
+{
+    YumXmlParser *parser;
+    SAXContext *sctx;
+    xmlSAXHandler *handler;
+    const char *md_type;
+
+    parser = g_new0 (YumXmlParser, 1);
+    parser->type = type;
+    g_queue_init (&parser->packages);
+    sctx = &parser->ctx.sctx;
+
+    if (type == XML_PARSER_PRIMARY) {
+        parser->ctx.primary.state = PRIMARY_PARSER_TOPLEVEL;
+        md_type = "primary.xml";
+        handler = &primary_sax_handler;
+    } else if (type == XML_PARSER_FILELISTS) {
+        parser->ctx.filelists.state = FILELIST_PARSER_TOPLEVEL;
+        md_type = "filelists.xml";
+        handler = &filelist_sax_handler;
+    } else {
+        parser->ctx.other.state = OTHER_PARSER_TOPLEVEL;
+        md_type = "other.xml";
+        handler = &other_sax_handler;
+    }
+
+    sax_context_init(sctx, md_type, count_callback, package_callback,
+                     files_callback, user_data, err);
+
+    xmlSubstituteEntitiesDefault (1);
+    sctx->xml_context = xmlCreatePushParserCtxt (handler, parser,
+                                                 NULL, 0, NULL);
+    if (!sctx->xml_context) {
+        g_set_error (err, YUM_PARSER_ERROR, YUM_PARSER_ERROR,
+                     "Can not create %s parser", md_type);
+        yum_xml_parser_free (parser);
+        return NULL;
+    }
+
+    return parser;
+}
+
+YumXmlParser *
+yum_xml_parser_new_primary (CountFn count_callback,
+                            PackageFn package_callback,
+                            PackageFn files_callback,
+                            gpointer user_data,
+                            GError **err)
+{
+    return xml_parser_new (XML_PARSER_PRIMARY, count_callback,
+                           package_callback, files_callback, user_data, err);
+}
+
+YumXmlParser *
+yum_xml_parser_new_filelists (CountFn count_callback,
+                              PackageFn package_callback,
+                              PackageFn files_callback,
+                              gpointer user_data,
+                              GError **err)
+{
+    return xml_parser_new (XML_PARSER_FILELISTS, count_callback,
+                           package_callback, files_callback, user_data, err);
+}
+
+YumXmlParser *
+yum_xml_parser_new_other (CountFn count_callback,
+                          PackageFn package_callback,
+                          gpointer user_data,
+                          GError **err)
+{
+    return xml_parser_new (XML_PARSER_OTHER, count_callback,
+                           package_callback, NULL, user_data, err);
+}
+
+/* Decompresses a piece of gzip data into the XML parser.  Members that
+   follow each other are one document, like gzip -d would make them. */
+static void
+xml_parser_inflate (YumXmlParser *parser, const char *data, int len)
+{
+    SAXContext *sctx = &parser->ctx.sctx;
+    z_stream *strm = &parser->strm;
+    char out[XML_PARSER_READ_SIZE];
+    int ret;
+
+    strm->next_in = (Bytef *) data;
+    strm->avail_in = len;
+
+    do {
+        strm->next_out = (Bytef *) out;
+        strm->avail_out = sizeof (out);
+
+        /* Another member follows, none when the last one ended exactly
+           at the end of the output buffer */
+        if (parser->stream_end) {
+            if (strm->avail_in == 0)
+                break;
+            inflateReset (strm);
+            parser->stream_end = FALSE;
+        }
+
+        ret = inflate (strm, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+            g_set_error (sctx->error, YUM_PARSER_ERROR, YUM_PARSER_ERROR,
+                         "Can not decompress %s: %s", sctx->md_type,
+                         strm->msg ? strm->msg : "invalid data");
+            return;
+        }
+
+        if (strm->avail_out < sizeof (out))
+            xmlParseChunk (sctx->xml_context, out,
+                           sizeof (out) - strm->avail_out, 0);
+        if (*sctx->error)
+            return;
+
+        if (ret == Z_STREAM_END)
+            parser->stream_end = TRUE;
+    } while (strm->avail_in > 0 || strm->avail_out == 0);
+}
+
+static void
+xml_parser_push (YumXmlParser *parser, const char *data, int len)
+{
+    SAXContext *sctx = &parser->ctx.sctx;
+
+    if (parser->strm_init)
+        xml_parser_inflate (parser, data, len);
+    else
+        xmlParseChunk (sctx->xml_context, data, len, 0);
+}
+
+static void
+xml_parser_sniff (YumXmlParser *parser)
+{
+    SAXContext *sctx = &parser->ctx.sctx;
+
+    parser->sniffed = TRUE;
+
+    if (parser->n_magic == 2 &&
+        parser->magic[0] == 0x1f && parser->magic[1] == 0x8b) {
+        /* 16: gzip header and trailer */
+        if (inflateInit2 (&parser->strm, 15 + 16) != Z_OK) {
+            g_set_error (sctx->error, YUM_PARSER_ERROR, YUM_PARSER_ERROR,
+                         "Can not decompress %s: out of memory",
+                         sctx->md_type);
+            return;
+        }
+        parser->strm_init = TRUE;
+    }
+
+    if (parser->n_magic > 0)
+        xml_parser_push (parser, (const char *) parser->magic,
+                         parser->n_magic);
+}
+
+void
+yum_xml_parser_feed (YumXmlParser *parser, const char *data, int len)
+{
+    SAXContext *sctx = &parser->ctx.sctx;
+
+    if (*sctx->error)
+        return;
+
+    if (!parser->sniffed) {
+        while (parser->n_magic < 2 && len > 0) {
+            parser->magic[parser->n_magic++] = *data++;
+            len--;
+        }
+        if (parser->n_magic < 2)
+            return;
+
+        xml_parser_sniff (parser);
+        if (*sctx->error)
+            return;
+    }
+
+    if (len > 0)
+        xml_parser_push (parser, data, len);
+}
+
+void
+yum_xml_parser_finish (YumXmlParser *parser)
+{
+    SAXContext *sctx = &parser->ctx.sctx;
+
+    if (!parser->sniffed && !*sctx->error)
+        xml_parser_sniff (parser);
+
+    if (parser->strm_init && !parser->stream_end && !*sctx->error)
+        g_set_error (sctx->error, YUM_PARSER_ERROR, YUM_PARSER_ERROR,
+                     "Compressed %s is truncated", sctx->md_type);
+
+    if (!*sctx->error)
+        xmlParseChunk (sctx->xml_context, NULL, 0, 1);
+}
+
+guint64
+yum_xml_parser_position (YumXmlParser *parser)
+{
+    return xmlByteConsumed (parser->ctx.sctx.xml_context);
+}
+
+static void
+xml_parser_queue_package (Package *p, gpointer user_data)
+{
+    YumXmlParser *parser = (YumXmlParser *) user_data;
+
+    if (p->pkgId == NULL) {
+        package_free (p);
+        return;
+    }
+
+    g_queue_push_tail (&parser->packages, p);
+}
+
+static YumXmlParser *
+xml_parser_open (XmlParserType type, const char *filename, GError **err)
+{
+    YumXmlParser *parser;
+
+    parser = xml_parser_new (type, NULL, xml_parser_queue_package, NULL,
+                             NULL, err);
+    if (!parser)
+        return NULL;
+
+    parser->ctx.sctx.user_data = parser;
+    parser->ctx.sctx.keep_packages = TRUE;
+
+    parser->reader = yum_gzip_reader_open (filename, err);
+    if (!parser->reader) {
+        yum_xml_parser_free (parser);
+        return NULL;
+    }
+
+    return parser;
+}
+
+YumXmlParser *
+yum_xml_parser_open_primary (const char *filename, GError **err)
+{
+    return xml_parser_open (XML_PARSER_PRIMARY, filename, err);
+}
+
+YumXmlParser *
+yum_xml_parser_open_filelists (const char *filename, GError **err)
+{
+    return xml_parser_open (XML_PARSER_FILELISTS, filename, err);
+}
+
+YumXmlParser *
+yum_xml_parser_open_other (const char *filename, GError **err)
+{
+    return xml_parser_open (XML_PARSER_OTHER, filename, err);
+}
+
+void
+yum_xml_parser_set_skip (YumXmlParser *parser, guint skip)
+{
+    parser->ctx.sctx.skip = skip;
+}
+
+Package *
+yum_xml_parser_next (YumXmlParser *parser)
+{
+    SAXContext *sctx = &parser->ctx.sctx;
+    char buf[XML_PARSER_READ_SIZE];
+    gssize n;
+
+    while (g_queue_is_empty (&parser->packages) && !parser->done) {
+        n = yum_gzip_reader_read (parser->reader, buf, sizeof (buf),
+                                  sctx->error);
+        if (n > 0)
+            yum_xml_parser_feed (parser, buf, n);
+        else if (n == 0)
+            yum_xml_parser_finish (parser);
+
+        if (n <= 0 || *sctx->error)
+            parser->done = TRUE;
+    }
+
+    return g_queue_pop_head (&parser->packages);
+}
+
+void
+yum_xml_parser_free (YumXmlParser *parser)
+{
+    SAXContext *sctx = &parser->ctx.sctx;
+    Package *p;
+
+    if (sctx->xml_context)
+        xmlFreeParserCtxt (sctx->xml_context);
+
+    if (sctx->current_package) {
+        g_warning ("Incomplete package lost");
+        package_free (sctx->current_package);
+    }
+
+    if (parser->type == XML_PARSER_PRIMARY) {
+        if (parser->ctx.primary.current_file)
+            g_free (parser->ctx.primary.current_file);
+    } else if (parser->type == XML_PARSER_FILELISTS) {
+        if (parser->ctx.filelists.current_file)
+            g_free (parser->ctx.filelists.current_file);
+    } else if (parser->ctx.other.current_entry)
+        g_free (parser->ctx.other.current_entry);
+
+    while ((p = g_queue_pop_head (&parser->packages)))
+        package_free (p);
+
+    if (parser->reader)
+        yum_gzip_reader_close (parser->reader);
+    if (parser->strm_init)
+        inflateEnd (&parser->strm);
+
+    g_string_chunk_free (sctx->files_chunk);
+    g_string_chunk_free (sctx->strings);
+    g_string_free (sctx->text_buffer, TRUE);
+
+    g_free (parser);
+}
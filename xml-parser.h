@@ -25,10 +25,16 @@ typedef void (*CountFn) (guint32 count, gpointer data);
 #define YUM_PARSER_ERROR yum_parser_error_quark()
 GQuark yum_parser_error_quark (void);
 
+/* With a files_callback, the file list of a package with a lot of files
+ * is handed to it in batches while the package is parsed and then
+ * dropped; package_callback only gets the files of the last batch.
+ * other.xml has no file lists and ignores it. */
+
 void
 yum_xml_parse_primary (const char *filename,
                        CountFn count_callback,
                        PackageFn package_callback,
+                       PackageFn files_callback,
                        gpointer user_data,
                        GError **err);
 
@@ -36,13 +42,97 @@ void
 yum_xml_parse_filelists (const char *filename,
                          CountFn count_callback,
                          PackageFn package_callback,
+                         PackageFn files_callback,
                          gpointer user_data,
                          GError **err);
 
 void yum_xml_parse_other (const char *filename,
                           CountFn count_callback,
                           PackageFn package_callback,
+                          PackageFn files_callback,
+                          gpointer user_data,
+                          GError **err);
+
+/* updateinfo.xml has no package count, count_callback is never called */
+void yum_xml_parse_updateinfo (const char *filename,
+                               CountFn count_callback,
+                               AdvisoryFn advisory_callback,
+                               gpointer user_data,
+                               GError **err);
+
+/* Also reads deltainfo.xml, which only differs in its top element.
+   Neither has a package count. */
+void yum_xml_parse_prestodelta (const char *filename,
+                                CountFn count_callback,
+                                DeltaPackageFn package_callback,
+                                gpointer user_data,
+                                GError **err);
+
+/* Groups, categories and environments in document order, with the
+   untranslated name and description and the xml:lang ones separately.
+   No count either. */
+void yum_xml_parse_comps (const char *filename,
+                          CountFn count_callback,
+                          CompsEntryFn entry_callback,
                           gpointer user_data,
                           GError **err);
 
+/* Incremental parsing, for data that is not a whole file, e.g. while it
+ * is downloaded: feed it in pieces of any size, then finish.  Data that
+ * starts with the gzip magic is decompressed on the way.  Errors go to
+ * the err given to the constructor and make further feeding a no-op. */
+
+typedef struct _YumXmlParser YumXmlParser;
+
+YumXmlParser *yum_xml_parser_new_primary   (CountFn count_callback,
+                                            PackageFn package_callback,
+                                            PackageFn files_callback,
+                                            gpointer user_data,
+                                            GError **err);
+YumXmlParser *yum_xml_parser_new_filelists (CountFn count_callback,
+                                            PackageFn package_callback,
+                                            PackageFn files_callback,
+                                            gpointer user_data,
+                                            GError **err);
+YumXmlParser *yum_xml_parser_new_other     (CountFn count_callback,
+                                            PackageFn package_callback,
+                                            gpointer user_data,
+                                            GError **err);
+void          yum_xml_parser_feed          (YumXmlParser *parser,
+                                            const char *data,
+                                            int len);
+void          yum_xml_parser_finish        (YumXmlParser *parser);
+void          yum_xml_parser_free          (YumXmlParser *parser);
+
+/* Bytes of XML parsed so far; from a package callback, the offset just
+   past the package's end tag */
+guint64       yum_xml_parser_position      (YumXmlParser *parser);
+
+/* Pulling packages out of a file instead: yum_xml_parser_next () parses
+ * just enough of it for the next package, so memory use does not grow
+ * with the file.  The caller frees each package with package_free (),
+ * before or after the parser: the package holds all its strings, none
+ * come from the pool of the parse (see Package).  Returns NULL at the end
+ * and on errors, which go to err. */
+
+YumXmlParser *yum_xml_parser_open_primary   (const char *filename,
+                                             GError **err);
+YumXmlParser *yum_xml_parser_open_filelists (const char *filename,
+                                             GError **err);
+YumXmlParser *yum_xml_parser_open_other     (const char *filename,
+                                             GError **err);
+Package      *yum_xml_parser_next           (YumXmlParser *parser);
+
+/* Parts of a package a parser can leave out, for callers that never
+   read them; the fields stay NULL.  Set before the first package. */
+typedef enum {
+    YUM_XML_SKIP_DESCRIPTION = 1 << 0,     /* primary */
+    YUM_XML_SKIP_DEPS = 1 << 1,            /* primary */
+    YUM_XML_SKIP_FILES = 1 << 2,           /* primary */
+    YUM_XML_SKIP_CHANGELOG_TEXT = 1 << 3   /* other */
+} YumXmlSkip;
+
+void          yum_xml_parser_set_skip       (YumXmlParser *parser,
+                                             guint skip);
+
 #endif /* __YUM_XML_PARSER_H__ */
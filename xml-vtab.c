@@ -0,0 +1,482 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/* A loadable SQLite extension with virtual tables over the metadata files
+ * themselves, for queries that do not warrant building a cache:
+ *
+ *   .load yumxml
+ *   CREATE VIRTUAL TABLE p USING yum_primary('repodata/primary.xml.gz');
+ *   SELECT name, arch FROM p WHERE rpm_license LIKE '%BSD%';
+ *
+ * yum_primary has a row per package, with the columns of the packages
+ * table; yum_filelists one per file and yum_other one per changelog
+ * entry, each with the NEVRA and pkgId of its package.  Every scan parses
+ * the file again, a package at a time, so memory use does not grow with
+ * it, and INSERT INTO ... SELECT loads a table straight from the parser.
+ * yum_primary never keeps the dependencies and files it has no columns
+ * for, and skips the description, like yum_other the changelog text, in
+ * queries that do not use it.  SQLite scans
+ * the inner table of a join once per outer row, so join a MATERIALIZED
+ * common table expression or a temporary table instead.
+ *
+ * It also has the yum_pack () and yum_unpack () functions for the
+ * description or changelog columns of caches built with COMPRESS_TEXT,
+ * yum_filelist_paths (), yum_filelist_has () and yum_filelist_glob ()
+ * for the encoded rows of the filelist table, and yum_path_lines () for
+ * the file_trigrams table of caches built with PATH_INDEX. */
+
+#include <string.h>
+#include <glib.h>
+#include <sqlite3ext.h>
+
+#include "xml-parser.h"
+#include "sql-functions.h"
+
+SQLITE_EXTENSION_INIT1
+
+typedef YumXmlParser *(*XmlOpenFn) (const char *filename, GError **err);
+typedef GSList *(*XmlRowsFn) (Package *p);
+typedef guint (*XmlSkipFn) (sqlite3_uint64 columns_used);
+typedef void (*XmlColumnFn) (sqlite3_context *ctx,
+                             Package *p,
+                             gpointer item,
+                             int column);
+
+typedef struct {
+    const char *schema;
+    XmlOpenFn open;
+    /* NULL for a row per package, else the list with a row per item */
+    XmlRowsFn rows;
+    XmlColumnFn column;
+    /* The YumXmlSkip flags of a scan, NULL to parse everything */
+    XmlSkipFn skip;
+} XmlTableType;
+
+typedef struct {
+    sqlite3_vtab base;
+    const XmlTableType *type;
+    char *filename;
+} XmlTable;
+
+typedef struct {
+    sqlite3_vtab_cursor base;
+    YumXmlParser *parser;
+    GError *error;
+    Package *package;
+    GSList *item;
+    sqlite3_int64 rowid;
+} XmlCursor;
+
+static void
+result_text (sqlite3_context *ctx, const char *text)
+{
+    if (text)
+        sqlite3_result_text (ctx, text, -1, SQLITE_TRANSIENT);
+    else
+        sqlite3_result_null (ctx);
+}
+
+/* pkgId, name, arch, version, epoch, release, in the order of the cache
+   tables */
+static void
+package_column (sqlite3_context *ctx, Package *p, int column)
+{
+    switch (column) {
+    case 0: result_text (ctx, p->pkgId); break;
+    case 1: result_text (ctx, p->name); break;
+    case 2: result_text (ctx, p->arch); break;
+    case 3: result_text (ctx, p->version); break;
+    case 4: result_text (ctx, p->epoch); break;
+    case 5: result_text (ctx, p->release); break;
+    default: sqlite3_result_null (ctx); break;
+    }
+}
+
+#define PACKAGE_COLUMNS "pkgId TEXT, name TEXT, arch TEXT, version TEXT, " \
+    "epoch TEXT, release TEXT"
+
+/* Primary */
+
+static void
+primary_column (sqlite3_context *ctx, Package *p, gpointer item, int column)
+{
+    switch (column) {
+    case 6: result_text (ctx, p->summary); break;
+    case 7: result_text (ctx, p->description); break;
+    case 8: result_text (ctx, p->url); break;
+    case 9: sqlite3_result_int64 (ctx, p->time_file); break;
+    case 10: sqlite3_result_int64 (ctx, p->time_build); break;
+    case 11: result_text (ctx, p->rpm_license); break;
+    case 12: result_text (ctx, p->rpm_vendor); break;
+    case 13: result_text (ctx, p->rpm_group); break;
+    case 14: result_text (ctx, p->rpm_buildhost); break;
+    case 15: result_text (ctx, p->rpm_sourcerpm); break;
+    case 16: sqlite3_result_int64 (ctx, p->rpm_header_start); break;
+    case 17: sqlite3_result_int64 (ctx, p->rpm_header_end); break;
+    case 18: result_text (ctx, p->rpm_packager); break;
+    case 19: sqlite3_result_int64 (ctx, p->size_package); break;
+    case 20: sqlite3_result_int64 (ctx, p->size_installed); break;
+    case 21: sqlite3_result_int64 (ctx, p->size_archive); break;
+    case 22: result_text (ctx, p->location_href); break;
+    case 23: result_text (ctx, p->location_base); break;
+    case 24: result_text (ctx, p->checksum_type); break;
+    default: package_column (ctx, p, column); break;
+    }
+}
+
+static guint
+primary_skip (sqlite3_uint64 columns_used)
+{
+    guint skip = YUM_XML_SKIP_DEPS | YUM_XML_SKIP_FILES;
+
+    if (!(columns_used & (1 << 7)))
+        skip |= YUM_XML_SKIP_DESCRIPTION;
+
+    return skip;
+}
+
+static const XmlTableType primary_table = {
+    "CREATE TABLE x (" PACKAGE_COLUMNS ", summary TEXT, description TEXT, "
+    "url TEXT, time_file INTEGER, time_build INTEGER, rpm_license TEXT, "
+    "rpm_vendor TEXT, rpm_group TEXT, rpm_buildhost TEXT, "
+    "rpm_sourcerpm TEXT, rpm_header_start INTEGER, "
+    "rpm_header_end INTEGER, rpm_packager TEXT, size_package INTEGER, "
+    "size_installed INTEGER, size_archive INTEGER, location_href TEXT, "
+    "location_base TEXT, checksum_type TEXT)",
+    yum_xml_parser_open_primary,
+    NULL,
+    primary_column,
+    primary_skip
+};
+
+/* Filelists */
+
+static GSList *
+filelists_rows (Package *p)
+{
+    return p->files;
+}
+
+static void
+filelists_column (sqlite3_context *ctx, Package *p, gpointer item,
+                  int column)
+{
+    PackageFile *file = (PackageFile *) item;
+
+    switch (column) {
+    case 6: result_text (ctx, file->name); break;
+    case 7: result_text (ctx, file->type); break;
+    default: package_column (ctx, p, column); break;
+    }
+}
+
+static const XmlTableType filelists_table = {
+    "CREATE TABLE x (" PACKAGE_COLUMNS ", filename TEXT, filetype TEXT)",
+    yum_xml_parser_open_filelists,
+    filelists_rows,
+    filelists_column,
+    NULL
+};
+
+/* Other */
+
+static GSList *
+other_rows (Package *p)
+{
+    return p->changelogs;
+}
+
+static void
+other_column (sqlite3_context *ctx, Package *p, gpointer item, int column)
+{
+    ChangelogEntry *entry = (ChangelogEntry *) item;
+
+    switch (column) {
+    case 6: result_text (ctx, entry->author); break;
+    case 7: sqlite3_result_int64 (ctx, entry->date); break;
+    case 8: result_text (ctx, entry->changelog); break;
+    default: package_column (ctx, p, column); break;
+    }
+}
+
+static guint
+other_skip (sqlite3_uint64 columns_used)
+{
+    return columns_used & (1 << 8) ? 0 : YUM_XML_SKIP_CHANGELOG_TEXT;
+}
+
+static const XmlTableType other_table = {
+    "CREATE TABLE x (" PACKAGE_COLUMNS ", author TEXT, date INTEGER, "
+    "changelog TEXT)",
+    yum_xml_parser_open_other,
+    other_rows,
+    other_column,
+    other_skip
+};
+
+/*****************************************************************************/
+
+/* The argument as written in CREATE VIRTUAL TABLE, quoted or not */
+static char *
+dequote (const char *arg)
+{
+    GString *str;
+    char quote = arg[0];
+
+    if (quote != '\'' && quote != '"')
+        return g_strdup (arg);
+
+    str = g_string_new (NULL);
+    for (arg++; *arg; arg++) {
+        if (*arg == quote) {
+            if (arg[1] != quote)
+                break;
+            arg++;
+        }
+        g_string_append_c (str, *arg);
+    }
+
+    return g_string_free (str, FALSE);
+}
+
+static int
+xml_table_connect (sqlite3 *db,
+                   void *aux,
+                   int argc,
+                   const char *const *argv,
+                   sqlite3_vtab **vtab,
+                   char **errmsg)
+{
+    const XmlTableType *type = (const XmlTableType *) aux;
+    XmlTable *table;
+    int rc;
+
+    /* argv[0..2] are the module, database and table names */
+    if (argc != 4) {
+        *errmsg = sqlite3_mprintf ("%s: takes the metadata filename",
+                                   argv[0]);
+        return SQLITE_ERROR;
+    }
+
+    rc = sqlite3_declare_vtab (db, type->schema);
+    if (rc != SQLITE_OK)
+        return rc;
+
+    table = g_new0 (XmlTable, 1);
+    table->type = type;
+    table->filename = dequote (argv[3]);
+    *vtab = &table->base;
+
+    return SQLITE_OK;
+}
+
+static int
+xml_table_disconnect (sqlite3_vtab *vtab)
+{
+    XmlTable *table = (XmlTable *) vtab;
+
+    g_free (table->filename);
+    g_free (table);
+
+    return SQLITE_OK;
+}
+
+/* Nothing narrows a scan, every one parses the whole file.  The parts
+   of it the scan can skip go to xml_cursor_filter () as idx_num. */
+static int
+xml_table_best_index (sqlite3_vtab *vtab, sqlite3_index_info *info)
+{
+    const XmlTableType *type = ((XmlTable *) vtab)->type;
+
+    info->estimatedCost = 1000000.0;
+
+    /* colUsed is there since 3.10.0, before it every column counts */
+    if (type->skip)
+        info->idxNum = type->skip (sqlite3_libversion_number () >= 3010000 ?
+                                   info->colUsed : ~(sqlite3_uint64) 0);
+
+    return SQLITE_OK;
+}
+
+static int
+xml_cursor_open (sqlite3_vtab *vtab, sqlite3_vtab_cursor **cursor)
+{
+    XmlCursor *cur = g_new0 (XmlCursor, 1);
+
+    *cursor = &cur->base;
+
+    return SQLITE_OK;
+}
+
+static void
+xml_cursor_reset (XmlCursor *cur)
+{
+    if (cur->package)
+        package_free (cur->package);
+    cur->package = NULL;
+    cur->item = NULL;
+
+    if (cur->parser)
+        yum_xml_parser_free (cur->parser);
+    cur->parser = NULL;
+
+    g_clear_error (&cur->error);
+}
+
+static int
+xml_cursor_close (sqlite3_vtab_cursor *cursor)
+{
+    XmlCursor *cur = (XmlCursor *) cursor;
+
+    xml_cursor_reset (cur);
+    g_free (cur);
+
+    return SQLITE_OK;
+}
+
+static int
+xml_cursor_error (XmlCursor *cur)
+{
+    sqlite3_vtab *vtab = cur->base.pVtab;
+
+    sqlite3_free (vtab->zErrMsg);
+    vtab->zErrMsg = sqlite3_mprintf ("%s", cur->error->message);
+
+    return SQLITE_ERROR;
+}
+
+/* Moves to the next row: the next package, or the next item of a list,
+   skipping packages with an empty one */
+static int
+xml_cursor_next (sqlite3_vtab_cursor *cursor)
+{
+    XmlCursor *cur = (XmlCursor *) cursor;
+    const XmlTableType *type = ((XmlTable *) cursor->pVtab)->type;
+
+    cur->rowid++;
+
+    if (cur->item) {
+        cur->item = cur->item->next;
+        if (cur->item)
+            return SQLITE_OK;
+    }
+
+    do {
+        if (cur->package)
+            package_free (cur->package);
+
+        cur->package = yum_xml_parser_next (cur->parser);
+        if (!cur->package)
+            return cur->error ? xml_cursor_error (cur) : SQLITE_OK;
+
+        cur->item = type->rows ? type->rows (cur->package) : NULL;
+    } while (type->rows && !cur->item);
+
+    return SQLITE_OK;
+}
+
+static int
+xml_cursor_filter (sqlite3_vtab_cursor *cursor,
+                   int idx_num,
+                   const char *idx_str,
+                   int argc,
+                   sqlite3_value **argv)
+{
+    XmlCursor *cur = (XmlCursor *) cursor;
+    XmlTable *table = (XmlTable *) cursor->pVtab;
+
+    xml_cursor_reset (cur);
+    cur->rowid = 0;
+
+    cur->parser = table->type->open (table->filename, &cur->error);
+    if (!cur->parser)
+        return xml_cursor_error (cur);
+    yum_xml_parser_set_skip (cur->parser, idx_num);
+
+    return xml_cursor_next (cursor);
+}
+
+static int
+xml_cursor_eof (sqlite3_vtab_cursor *cursor)
+{
+    return ((XmlCursor *) cursor)->package == NULL;
+}
+
+static int
+xml_cursor_column (sqlite3_vtab_cursor *cursor,
+                   sqlite3_context *ctx,
+                   int column)
+{
+    XmlCursor *cur = (XmlCursor *) cursor;
+    const XmlTableType *type = ((XmlTable *) cursor->pVtab)->type;
+
+    type->column (ctx, cur->package, cur->item ? cur->item->data : NULL,
+                  column);
+
+    return SQLITE_OK;
+}
+
+static int
+xml_cursor_rowid (sqlite3_vtab_cursor *cursor, sqlite3_int64 *rowid)
+{
+    *rowid = ((XmlCursor *) cursor)->rowid;
+
+    return SQLITE_OK;
+}
+
+static sqlite3_module xml_module = {
+    0,                                  /* iVersion */
+    xml_table_connect,                  /* xCreate */
+    xml_table_connect,                  /* xConnect */
+    xml_table_best_index,               /* xBestIndex */
+    xml_table_disconnect,               /* xDisconnect */
+    xml_table_disconnect,               /* xDestroy */
+    xml_cursor_open,                    /* xOpen */
+    xml_cursor_close,                   /* xClose */
+    xml_cursor_filter,                  /* xFilter */
+    xml_cursor_next,                    /* xNext */
+    xml_cursor_eof,                     /* xEof */
+    xml_cursor_column,                  /* xColumn */
+    xml_cursor_rowid,                   /* xRowid */
+};
+
+#ifdef _WIN32
+__declspec(dllexport)
+#endif
+int
+sqlite3_yumxml_init (sqlite3 *db, char **errmsg,
+                     const sqlite3_api_routines *api)
+{
+    int rc;
+
+    SQLITE_EXTENSION_INIT2 (api);
+
+    rc = sqlite3_create_module (db, "yum_primary", &xml_module,
+                                (void *) &primary_table);
+    if (rc == SQLITE_OK)
+        rc = sqlite3_create_module (db, "yum_filelists", &xml_module,
+                                    (void *) &filelists_table);
+    if (rc == SQLITE_OK)
+        rc = sqlite3_create_module (db, "yum_other", &xml_module,
+                                    (void *) &other_table);
+    if (rc == SQLITE_OK)
+        rc = yum_sql_register_text_functions (db);
+    if (rc == SQLITE_OK)
+        rc = yum_sql_register_filelist_functions (db);
+
+    return rc;
+}
@@ -13,6 +13,7 @@ BuildRequires: python-devel
 BuildRequires: glib2-devel
 BuildRequires: libxml2-devel
 BuildRequires: sqlite-devel
+BuildRequires: libzstd-devel
 BuildRequires: pkgconfig
 BuildRoot:  %{_tmppath}/%{name}-%{version}-%{release}-root-%(%{__id_u} -n)
 
@@ -35,6 +36,7 @@ Fast metadata parser for yum implemented in C.
 %defattr(-,root,root)
 %doc README AUTHORS ChangeLog
 %{python_sitelib_platform}/_sqlitecache.so
+%{python_sitelib_platform}/yumxml.so
 %{python_sitelib_platform}/sqlitecachec.py
 %{python_sitelib_platform}/sqlitecachec.pyc
 %{python_sitelib_platform}/sqlitecachec.pyo